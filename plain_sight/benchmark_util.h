@@ -0,0 +1,26 @@
+#ifndef _INCLUDE_NET_ZELCON_PLAIN_SIGHT_BENCHMARK_UTIL_H_
+#define _INCLUDE_NET_ZELCON_PLAIN_SIGHT_BENCHMARK_UTIL_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace net_zelcon::plain_sight {
+
+/// @brief `size` random bytes, the same on every call, which neither QR
+/// codes nor the video codec compress.
+inline auto random_payload(const std::size_t size)
+    -> std::vector<std::uint8_t> {
+    std::vector<std::uint8_t> payload(size);
+    std::mt19937_64 rng{42};
+    std::uniform_int_distribution<int> dist{0, 255};
+    std::generate(payload.begin(), payload.end(),
+                  [&] { return static_cast<std::uint8_t>(dist(rng)); });
+    return payload;
+}
+
+} // namespace net_zelcon::plain_sight
+
+#endif // _INCLUDE_NET_ZELCON_PLAIN_SIGHT_BENCHMARK_UTIL_H_
\ No newline at end of file
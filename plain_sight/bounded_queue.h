@@ -0,0 +1,78 @@
+#ifndef _INCLUDE_NET_ZELCON_PLAIN_SIGHT_BOUNDED_QUEUE_H_
+#define _INCLUDE_NET_ZELCON_PLAIN_SIGHT_BOUNDED_QUEUE_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+#include <glog/logging.h>
+
+namespace net_zelcon::plain_sight {
+
+/// @brief Multi-producer, multi-consumer FIFO with a fixed capacity. Used to
+/// connect pipeline stages: a full queue blocks the producer, which bounds the
+/// memory held between stages.
+template <typename T> class bounded_queue_t {
+  public:
+    explicit bounded_queue_t(std::size_t capacity) : capacity_{capacity} {
+        CHECK_GT(capacity_, 0UL);
+    }
+
+    bounded_queue_t(const bounded_queue_t &) = delete;
+    bounded_queue_t &operator=(const bounded_queue_t &) = delete;
+
+    /// @brief Blocks until there is room for `value`.
+    /// @return false if the queue was closed; `value` is dropped
+    auto push(T value) -> bool {
+        std::unique_lock lock{mutex_};
+        not_full_.wait(lock,
+                       [this] { return closed_ || items_.size() < capacity_; });
+        if (closed_) {
+            return false;
+        }
+        items_.push_back(std::move(value));
+        lock.unlock();
+        not_empty_.notify_one();
+        return true;
+    }
+
+    /// @brief Blocks until an item is available.
+    /// @return the oldest item, or `std::nullopt` once the queue is closed and
+    /// drained
+    auto pop() -> std::optional<T> {
+        std::unique_lock lock{mutex_};
+        not_empty_.wait(lock, [this] { return closed_ || !items_.empty(); });
+        if (items_.empty()) {
+            return std::nullopt;
+        }
+        std::optional<T> value{std::move(items_.front())};
+        items_.pop_front();
+        lock.unlock();
+        not_full_.notify_one();
+        return value;
+    }
+
+    /// @brief Wakes every blocked producer and consumer. Items already queued
+    /// can still be popped; further pushes are rejected.
+    void close() {
+        {
+            std::lock_guard lock{mutex_};
+            closed_ = true;
+        }
+        not_full_.notify_all();
+        not_empty_.notify_all();
+    }
+
+  private:
+    const std::size_t capacity_;
+    std::deque<T> items_;
+    std::mutex mutex_;
+    std::condition_variable not_full_, not_empty_;
+    bool closed_ = false;
+};
+
+} // namespace net_zelcon::plain_sight
+
+#endif // _INCLUDE_NET_ZELCON_PLAIN_SIGHT_BOUNDED_QUEUE_H_
\ No newline at end of file
@@ -0,0 +1,155 @@
+#include "plain_sight/capacity.h"
+
+#include <algorithm>
+#include <array>
+#include <glog/logging.h>
+
+namespace net_zelcon::plain_sight {
+
+namespace {
+
+// ISO/IEC 18004 table 9, indexed by ECC level and version (index 0 unused).
+constexpr std::array<std::array<std::uint8_t, 41>, 4> ecc_codewords_per_block{
+    {{0,  7,  10, 15, 20, 26, 18, 20, 24, 30, 18, 20, 24, 26,
+      30, 22, 24, 28, 30, 28, 28, 28, 28, 30, 30, 26, 28, 30,
+      30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30},
+     {0,  10, 16, 26, 18, 24, 16, 18, 22, 22, 26, 30, 22, 22,
+      24, 24, 28, 28, 26, 26, 26, 26, 28, 28, 28, 28, 28, 28,
+      28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28},
+     {0,  13, 22, 18, 26, 18, 24, 18, 22, 20, 24, 28, 26, 24,
+      20, 30, 24, 28, 28, 26, 30, 28, 30, 30, 30, 30, 28, 30,
+      30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30},
+     {0,  17, 28, 22, 16, 22, 28, 26, 26, 24, 28, 24, 28, 22,
+      24, 24, 30, 28, 28, 26, 28, 30, 24, 30, 30, 30, 30, 30,
+      30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30}}};
+
+constexpr std::array<std::array<std::uint8_t, 41>, 4> ecc_blocks{
+    {{0,  1,  1,  1,  1,  1,  2,  2,  2,  2,  4,  4,  4,  4,
+      4,  6,  6,  6,  6,  7,  8,  8,  9,  9,  10, 12, 12, 12,
+      13, 14, 15, 16, 17, 18, 19, 19, 20, 21, 22, 24, 25},
+     {0,  1,  1,  1,  2,  2,  4,  4,  4,  5,  5,  5,  8,  9,
+      9,  10, 10, 11, 13, 14, 16, 17, 17, 18, 20, 21, 23, 25,
+      26, 28, 29, 31, 33, 35, 37, 38, 40, 43, 45, 47, 49},
+     {0,  1,  1,  2,  2,  4,  4,  6,  6,  8,  8,  8,  10, 12,
+      16, 12, 17, 16, 18, 21, 20, 23, 23, 25, 27, 29, 34, 34,
+      35, 38, 40, 43, 45, 48, 51, 53, 56, 59, 62, 65, 68},
+     {0,  1,  1,  2,  4,  4,  4,  5,  6,  8,  8,  11, 11, 16,
+      16, 18, 16, 19, 21, 25, 25, 25, 34, 30, 32, 35, 37, 40,
+      42, 45, 48, 51, 54, 57, 60, 63, 66, 70, 74, 77, 81}}};
+
+/// @brief Modules left for data and ECC codewords once the function patterns
+/// are drawn, remainder bits included.
+auto raw_data_modules(const int version) -> std::size_t {
+    int modules = (16 * version + 128) * version + 64;
+    if (version >= 2) {
+        const int num_align = version / 7 + 2;
+        modules -= (25 * num_align - 10) * num_align - 55;
+        if (version >= 7) {
+            modules -= 36; // version information
+        }
+    }
+    return static_cast<std::size_t>(modules);
+}
+
+/// @brief Bytes taken by the framing of one chunk.
+auto framing_overhead(const framing_t framing) -> std::size_t {
+    return framing == framing_t::sequenced ? framing::chunk_header_size : 0;
+}
+
+} // namespace
+
+auto qr_data_codewords(const int version, const qrcodegen::QrCode::Ecc ecc)
+    -> std::size_t {
+    CHECK_GE(version, qrcodegen::QrCode::MIN_VERSION);
+    CHECK_LE(version, qrcodegen::QrCode::MAX_VERSION);
+    const auto level = static_cast<std::size_t>(ecc);
+    return raw_data_modules(version) / 8 -
+           static_cast<std::size_t>(ecc_codewords_per_block[level][version]) *
+               ecc_blocks[level][version];
+}
+
+auto qr_ecc_blocks(const int version, const qrcodegen::QrCode::Ecc ecc)
+    -> std::size_t {
+    CHECK_GE(version, qrcodegen::QrCode::MIN_VERSION);
+    CHECK_LE(version, qrcodegen::QrCode::MAX_VERSION);
+    return ecc_blocks[static_cast<std::size_t>(ecc)][version];
+}
+
+auto qr_ecc_codewords_per_block(const int version,
+                                const qrcodegen::QrCode::Ecc ecc)
+    -> std::size_t {
+    CHECK_GE(version, qrcodegen::QrCode::MIN_VERSION);
+    CHECK_LE(version, qrcodegen::QrCode::MAX_VERSION);
+    return ecc_codewords_per_block[static_cast<std::size_t>(ecc)][version];
+}
+
+auto qr_byte_capacity(const int version, const qrcodegen::QrCode::Ecc ecc)
+    -> std::size_t {
+    // Mode indicator, then the character count: 8 bits up to version 9, 16
+    // bits beyond.
+    const std::size_t header_bits = 4 + (version < 10 ? 8 : 16);
+    return (qr_data_codewords(version, ecc) * 8 - header_bits) / 8;
+}
+
+auto chunk_plan_t::chunk_count(const std::uint64_t payload_size) const
+    -> std::uint64_t {
+    CHECK_GT(chunk_size, 0U);
+    return (payload_size + chunk_size - 1) / chunk_size;
+}
+
+auto chunk_plan_t::qr_code_count(const std::uint64_t payload_size) const
+    -> std::uint64_t {
+    return chunk_count(payload_size) +
+           (framing == framing_t::sequenced ? 1 : 0) +
+           erasure.overhead_count(chunk_count(payload_size));
+}
+
+auto chunk_plan_t::frame_count(const std::uint64_t payload_size,
+                               const std::size_t tile_count) const
+    -> std::uint64_t {
+    CHECK_GT(tile_count, 0U);
+    return (qr_code_count(payload_size) + tile_count - 1) / tile_count;
+}
+
+auto plan_chunks(const std::uint64_t payload_size, const int min_version,
+                 const int max_version, const qrcodegen::QrCode::Ecc ecc,
+                 const framing_t framing, const erasure_code_t &erasure)
+    -> chunk_plan_t {
+    CHECK_GE(min_version, qrcodegen::QrCode::MIN_VERSION);
+    CHECK_LE(max_version, qrcodegen::QrCode::MAX_VERSION);
+    CHECK_LE(min_version, max_version);
+    CHECK(!erasure.enabled() || framing == framing_t::sequenced)
+        << "Parity chunks need sequenced framing";
+    CHECK(erasure.valid());
+    const auto plan_for = [&](const int version) {
+        return chunk_plan_t{.version = version,
+                            .ecc = ecc,
+                            .chunk_size = qr_byte_capacity(version, ecc) -
+                                          framing_overhead(framing),
+                            .framing = framing,
+                            .erasure = erasure};
+    };
+    const auto largest = plan_for(max_version);
+    const std::size_t manifest_size = erasure.enabled()
+                                          ? framing::erasure_manifest_size
+                                          : framing::manifest_size;
+    if (framing == framing_t::sequenced) {
+        CHECK_GE(qr_byte_capacity(max_version, ecc), manifest_size)
+            << "The manifest does not fit in a version " << max_version
+            << " QR code";
+    }
+    const auto fewest = largest.qr_code_count(payload_size);
+    for (int version = min_version; version < max_version; ++version) {
+        if (framing == framing_t::sequenced &&
+            qr_byte_capacity(version, ecc) < manifest_size) {
+            continue;
+        }
+        const auto plan = plan_for(version);
+        if (plan.qr_code_count(payload_size) == fewest) {
+            return plan;
+        }
+    }
+    return largest;
+}
+
+} // namespace net_zelcon::plain_sight
\ No newline at end of file
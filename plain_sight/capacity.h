@@ -0,0 +1,84 @@
+#ifndef _INCLUDE_NET_ZELCON_PLAIN_SIGHT_CAPACITY_H_
+#define _INCLUDE_NET_ZELCON_PLAIN_SIGHT_CAPACITY_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "plain_sight/framing.h"
+#include <qrcodegen.hpp>
+
+namespace net_zelcon::plain_sight {
+
+/// @brief Number of data codewords (bytes, before error correction) in a QR
+/// symbol of `version` at `ecc`.
+auto qr_data_codewords(int version, qrcodegen::QrCode::Ecc ecc) -> std::size_t;
+
+/// @brief Number of error correction blocks the codewords of a QR symbol of
+/// `version` at `ecc` are split into.
+auto qr_ecc_blocks(int version, qrcodegen::QrCode::Ecc ecc) -> std::size_t;
+
+/// @brief Number of ECC codewords in each error correction block of a QR
+/// symbol of `version` at `ecc`.
+auto qr_ecc_codewords_per_block(int version, qrcodegen::QrCode::Ecc ecc)
+    -> std::size_t;
+
+/// @brief Largest payload, in bytes, that fits in a QR symbol of `version` at
+/// `ecc` as a single byte mode segment.
+auto qr_byte_capacity(int version, qrcodegen::QrCode::Ecc ecc) -> std::size_t;
+
+/// @brief How a payload is cut into QR codes: every QR code is a symbol of
+/// `version` at `ecc` carrying up to `chunk_size` payload bytes, plus the
+/// `framing` overhead. The defaults are the historical fixed settings, which
+/// leave most of every symbol unused; see `plan_chunks()`. With
+/// `framing_t::sequenced`, an `erasure` code adds parity chunks, which
+/// rebuild lost QR codes where a higher `ecc` would only make them less
+/// likely to be lost.
+struct chunk_plan_t {
+    int version = 20;
+    qrcodegen::QrCode::Ecc ecc = qrcodegen::QrCode::Ecc::HIGH;
+    /// @brief Payload bytes per QR code, framing overhead excluded.
+    std::size_t chunk_size = 100;
+    framing_t framing = framing_t::none;
+    /// @brief Mask pattern of every symbol, 0 to 7, which lets
+    /// `qr_symbol_builder_t` build them. -1 has qrcodegen score all eight
+    /// masks for each symbol, as optical scanners want, which is many times
+    /// slower.
+    int mask = 0;
+    /// @brief Parity chunks across QR codes; needs `framing_t::sequenced`.
+    erasure_code_t erasure{};
+
+    /// @brief Width (and height) of every symbol, in modules.
+    [[nodiscard]] auto symbol_size() const noexcept -> int {
+        return version * 4 + 17;
+    }
+    /// @brief Number of payload chunks for `payload_size` bytes.
+    [[nodiscard]] auto chunk_count(std::uint64_t payload_size) const
+        -> std::uint64_t;
+    /// @brief Number of QR codes for `payload_size` bytes, the manifest of
+    /// `framing_t::sequenced`, the parity chunks and the repeated manifests
+    /// included.
+    [[nodiscard]] auto qr_code_count(std::uint64_t payload_size) const
+        -> std::uint64_t;
+    /// @brief Number of video frames for `payload_size` bytes with
+    /// `tile_count` QR codes per frame.
+    [[nodiscard]] auto frame_count(std::uint64_t payload_size,
+                                   std::size_t tile_count = 1) const
+        -> std::uint64_t;
+};
+
+/// @brief Plans the chunking of `payload_size` bytes into QR symbols of a
+/// version between `min_version` and `max_version` at `ecc`, filling every
+/// symbol to capacity.
+/// @details Picks the smallest version that needs no more QR codes than the
+/// largest one does: large payloads get `max_version`, while a payload that
+/// fits in fewer, smaller symbols is not blown up to `max_version`. The chunk
+/// size is that version's byte capacity less the framing header.
+/// @param erasure Erasure code of the plan; needs `framing_t::sequenced`.
+auto plan_chunks(std::uint64_t payload_size, int min_version, int max_version,
+                 qrcodegen::QrCode::Ecc ecc,
+                 framing_t framing = framing_t::none,
+                 const erasure_code_t &erasure = {}) -> chunk_plan_t;
+
+} // namespace net_zelcon::plain_sight
+
+#endif // _INCLUDE_NET_ZELCON_PLAIN_SIGHT_CAPACITY_H_
\ No newline at end of file
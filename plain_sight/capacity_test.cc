@@ -0,0 +1,137 @@
+#include <gtest/gtest.h>
+
+#include "plain_sight/capacity.h"
+#include "plain_sight/framing.h"
+#include "plain_sight/qr_codes.h"
+#include "plain_sight/thread_pool.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+using namespace net_zelcon::plain_sight;
+using Ecc = qrcodegen::QrCode::Ecc;
+
+namespace {
+
+constexpr Ecc all_eccs[] = {Ecc::LOW, Ecc::MEDIUM, Ecc::QUARTILE, Ecc::HIGH};
+
+auto encode_bytes(std::size_t size, int version, Ecc ecc)
+    -> qrcodegen::QrCode {
+    const std::vector<qrcodegen::QrSegment> segments = {
+        qrcodegen::QrSegment::makeBytes(std::vector<std::uint8_t>(size, 0xA5))};
+    return qrcodegen::QrCode::encodeSegments(segments, ecc, version, version,
+                                             -1, false);
+}
+
+} // namespace
+
+TEST(CapacityTest, MatchesQrCodeGenerator) {
+    for (const auto ecc : all_eccs) {
+        for (int version = 1; version <= 40; ++version) {
+            const auto capacity = qr_byte_capacity(version, ecc);
+            EXPECT_EQ(encode_bytes(capacity, version, ecc).getVersion(),
+                      version)
+                << "version " << version << ", ECC " << static_cast<int>(ecc);
+            EXPECT_THROW(encode_bytes(capacity + 1, version, ecc),
+                         qrcodegen::data_too_long)
+                << "version " << version << ", ECC " << static_cast<int>(ecc);
+        }
+    }
+    EXPECT_EQ(qr_byte_capacity(20, Ecc::HIGH), 382U);
+    EXPECT_EQ(qr_byte_capacity(40, Ecc::LOW), 2953U);
+}
+
+TEST(CapacityTest, PlanFillsSymbols) {
+    // Large payloads get the largest version, filled to capacity.
+    auto plan = plan_chunks(1'000'000, 1, 20, Ecc::HIGH);
+    EXPECT_EQ(plan.version, 20);
+    EXPECT_EQ(plan.chunk_size, 382U);
+    EXPECT_EQ(plan.chunk_count(1'000'000), 2'618U);
+    EXPECT_EQ(plan.frame_count(1'000'000, 6), 437U);
+    // A payload that fits in one symbol gets the smallest one that holds it.
+    plan = plan_chunks(100, 1, 20, Ecc::HIGH);
+    EXPECT_EQ(plan.qr_code_count(100), 1U);
+    EXPECT_GE(plan.chunk_size, 100U);
+    EXPECT_LT(qr_byte_capacity(plan.version - 1, Ecc::HIGH), 100U);
+    // Framing takes its header out of every chunk and adds the manifest.
+    plan = plan_chunks(1'000'000, 1, 20, Ecc::HIGH, framing_t::sequenced);
+    EXPECT_EQ(plan.chunk_size, 382U - framing::chunk_header_size);
+    EXPECT_EQ(plan.qr_code_count(1'000'000), plan.chunk_count(1'000'000) + 1);
+    // An empty sequenced payload is just the manifest.
+    plan = plan_chunks(0, 1, 20, Ecc::HIGH, framing_t::sequenced);
+    EXPECT_EQ(plan.qr_code_count(0), 1U);
+    EXPECT_GE(qr_byte_capacity(plan.version, Ecc::HIGH),
+              framing::manifest_size);
+}
+
+TEST(CapacityTest, ChunkedSourceFollowsPlan) {
+    std::vector<std::uint8_t> data(10'000);
+    for (std::size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<std::uint8_t>(i * 13 + 5);
+    }
+    for (const auto framing : {framing_t::none, framing_t::sequenced}) {
+        const auto plan =
+            plan_chunks(data.size(), 10, 25, Ecc::MEDIUM, framing);
+        chunked_qr_code_source_t source{
+            data, std::make_shared<thread_pool_t>(2), plan};
+        ASSERT_EQ(source.symbol_size(), plan.symbol_size());
+        ASSERT_EQ(source.qr_code_count(), plan.qr_code_count(data.size()));
+        std::size_t count = 0;
+        while (auto qr_code = source.next()) {
+            ASSERT_EQ(qr_code->size(), plan.symbol_size());
+            ++count;
+        }
+        EXPECT_EQ(count, plan.qr_code_count(data.size()));
+    }
+}
+
+TEST(CapacityTest, ParityRebuildsLostQrCodes) {
+    std::vector<std::uint8_t> data(10'000);
+    for (std::size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<std::uint8_t>(i * 7 + 1);
+    }
+    const erasure_code_t erasure{
+        .group_size = 8, .parity_chunks = 2, .interleaving = 3};
+    const auto plan = plan_chunks(data.size(), 1, 10, Ecc::MEDIUM,
+                                  framing_t::sequenced, erasure);
+    ASSERT_EQ(plan.version, 10);
+    const auto chunk_count = plan.chunk_count(data.size());
+    EXPECT_EQ(plan.qr_code_count(data.size()),
+              1 + chunk_count + erasure.parity_count(chunk_count) +
+                  erasure.stripe_count(chunk_count));
+    chunked_qr_code_source_t source{
+        data, std::make_shared<thread_pool_t>(2), plan};
+
+    // Drawn like the encoder draws a tile, 2 pixels per module
+    const int width = plan.symbol_size() * 2 + 16;
+    qr_code_decoder_t decoder{width, width};
+    decoder.set_geometry(2, 8);
+    std::vector<std::uint8_t> dst;
+    frame_assembler_t assembler{dst};
+    std::size_t count = 0;
+    while (auto qr_code = source.next()) {
+        // Lose the manifest, which the first stripe's repeats, and chunks 4
+        // to 9, two of each group of the first stripe
+        const std::size_t index = count++;
+        if (index == 0 || (index >= 5 && index < 11)) {
+            continue;
+        }
+        const auto image = decoder.begin();
+        std::fill(image.begin(), image.end(), 235);
+        for (int y = 0; y < width - 16; ++y) {
+            for (int x = 0; x < width - 16; ++x) {
+                if (qr_code->module(x / 2, y / 2)) {
+                    image[static_cast<std::size_t>(8 + y) * width + 8 + x] = 16;
+                }
+            }
+        }
+        std::vector<std::uint8_t> payload;
+        ASSERT_EQ(decoder.finish(payload), 1);
+        assembler.add(payload);
+    }
+    EXPECT_EQ(count, plan.qr_code_count(data.size()));
+    assembler.finish();
+    EXPECT_EQ(assembler.recovered(), 6U);
+    EXPECT_EQ(dst, data);
+}
\ No newline at end of file
@@ -1,10 +1,253 @@
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 
+#include "plain_sight/capacity.h"
+#include "plain_sight/decoder.h"
+#include "plain_sight/encoder.h"
+#include "plain_sight/mapped_file.h"
+#include "plain_sight/output_sink.h"
+#include "plain_sight/qr_codes.h"
+#include "plain_sight/read_ahead.h"
+#include "plain_sight/stats.h"
+#include "plain_sight/thread_pool.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <exception>
 #include <filesystem>
+#include <fmt/core.h>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+DEFINE_uint32(threads, 0,
+              "Threads building QR codes and encoding, or decoding; 0 for one "
+              "per core");
+DEFINE_uint32(scale, 4,
+              "Width and height of a QR code module, in pixels; decode with "
+              "the scale the video was encoded with");
+DEFINE_int32(fps, 30, "Frame rate of the encoded video");
+DEFINE_string(format, "mp4",
+              "Container format of the encoded video; written fragmented to "
+              "a pipe");
+DEFINE_string(ecc, "high",
+              "Error correction level of every QR code: low, medium, quartile "
+              "or high");
+DEFINE_bool(sequenced, false,
+            "Number the chunks after a manifest, so that lost QR codes are "
+            "reported, or with --parity rebuilt; needs a file to encode, and "
+            "is needed to decode too");
+DEFINE_uint32(parity, 0,
+              "Parity chunks per group of chunks, which rebuild as many lost "
+              "QR codes of the group; needs --sequenced");
+DEFINE_uint32(group_size, 32, "Chunks per group protected by --parity");
+DEFINE_uint32(interleaving, 4,
+              "Groups whose chunks are interleaved, which spreads a run of "
+              "lost QR codes over them");
+
+namespace {
+
+using namespace net_zelcon::plain_sight;
+
+constexpr std::string_view usage =
+    "Hides data in plain sight, in a video of QR codes.\n"
+    "\n"
+    "  plain_sight encode [input|-] [output|-]\n"
+    "  plain_sight decode [input|-] [output|-]\n"
+    "\n"
+    "Input and output default to stdin and stdout, for pipelines such as\n"
+    "  tar c dir | plain_sight encode | ... | plain_sight decode | tar x\n"
+    "A file can be encoded with parity instead of high error correction:\n"
+    "  plain_sight --ecc low --sequenced --parity 4 encode file video.mp4\n"
+    "  plain_sight --sequenced decode video.mp4 file";
+
+// Largest QR code version a payload is chunked into; a payload of unknown
+// size gets exactly this.
+constexpr int max_version = 20;
+constexpr std::size_t border_size = 4;
+
+auto is_std_stream(const std::string &path) -> bool {
+    return path.empty() || path == "-";
+}
+
+/// @throws std::runtime_error if `--ecc` names no error correction level
+auto ecc() -> qrcodegen::QrCode::Ecc {
+    using Ecc = qrcodegen::QrCode::Ecc;
+    if (FLAGS_ecc == "low") {
+        return Ecc::LOW;
+    }
+    if (FLAGS_ecc == "medium") {
+        return Ecc::MEDIUM;
+    }
+    if (FLAGS_ecc == "quartile") {
+        return Ecc::QUARTILE;
+    }
+    if (FLAGS_ecc == "high") {
+        return Ecc::HIGH;
+    }
+    throw std::runtime_error{
+        fmt::format("Unknown error correction level {}", FLAGS_ecc)};
+}
+
+auto framing() -> framing_t {
+    return FLAGS_sequenced ? framing_t::sequenced : framing_t::none;
+}
+
+/// @throws std::runtime_error if the parity flags are out of range
+auto erasure_code() -> erasure_code_t {
+    const erasure_code_t erasure{.group_size = FLAGS_group_size,
+                                 .parity_chunks = FLAGS_parity,
+                                 .interleaving = FLAGS_interleaving};
+    if (erasure.enabled() && !FLAGS_sequenced) {
+        throw std::runtime_error{"--parity needs --sequenced"};
+    }
+    if (!erasure.valid()) {
+        throw std::runtime_error{fmt::format(
+            "No erasure code of {} parity chunks per {} chunks, interleaved "
+            "{} ways: groups hold at most 255 chunks, parity included, and "
+            "stripes at most {} parity chunks",
+            erasure.parity_chunks, erasure.group_size, erasure.interleaving,
+            erasure_code_t::max_stripe_parity)};
+    }
+    return erasure;
+}
+
+auto thread_count() -> std::size_t {
+    return FLAGS_threads > 0
+               ? FLAGS_threads
+               : std::max(1U, std::thread::hardware_concurrency());
+}
+
+void print_throughput(std::string_view what, const stats_t &stats) {
+    const double seconds =
+        std::chrono::duration<double>(stats.elapsed()).count();
+    const double mb = static_cast<double>(stats.payload_bytes()) / 1e6;
+    std::cerr << fmt::format(
+        "{} {:.2f} MB in {} frames, {:.3f} s: {:.2f} MB/s, {:.1f} frames/s\n",
+        what, mb, stats.frames(), seconds, seconds > 0 ? mb / seconds : 0.0,
+        seconds > 0 ? static_cast<double>(stats.frames()) / seconds : 0.0);
+}
+
+auto encode(const std::string &input, const std::string &output) -> int {
+    if (is_std_stream(output) && ::isatty(STDOUT_FILENO)) {
+        std::cerr << "plain_sight: not writing a video to a terminal\n";
+        return 1;
+    }
+    const std::size_t threads = thread_count();
+    auto pool = std::make_shared<thread_pool_t>(threads);
+    // Outlive the source reading from them
+    std::unique_ptr<mapped_file_t> file;
+    std::unique_ptr<read_ahead_t> stdin_input;
+    std::shared_ptr<qr_code_source_t> source;
+    const erasure_code_t erasure = erasure_code();
+    if (is_std_stream(input)) {
+        // Framing needs the payload size up front, for the manifest
+        if (FLAGS_sequenced) {
+            throw std::runtime_error{"--sequenced needs a file to encode"};
+        }
+        stdin_input = std::make_unique<read_ahead_t>(STDIN_FILENO);
+        source = std::make_shared<streamed_qr_code_source_t>(
+            [&stdin_input](std::span<std::uint8_t> dst) {
+                return stdin_input->read(dst);
+            },
+            pool, plan_chunks(0, max_version, max_version, ecc()));
+    } else {
+        file = std::make_unique<mapped_file_t>(input);
+        source = std::make_shared<chunked_qr_code_source_t>(
+            file->data(), pool,
+            plan_chunks(file->size(), 1, max_version, ecc(), framing(),
+                        erasure));
+    }
+    std::unique_ptr<video_output_t> destination;
+    if (is_std_stream(output)) {
+        destination = std::make_unique<fd_video_output_t>(STDOUT_FILENO);
+    } else {
+        destination = std::make_unique<file_video_output_t>(output);
+    }
+    auto stats = std::make_shared<stats_t>();
+    auto encoder = encoder_t::builder()
+                       .set_qr_code_source(source)
+                       .set_video_format(FLAGS_format)
+                       .set_border_size(border_size)
+                       .set_scale(FLAGS_scale)
+                       .set_fps(FLAGS_fps)
+                       .set_segment_encoders(threads)
+                       .set_codec_threads(1)
+                       .set_stats(stats)
+                       .build();
+    encoder.encode(std::move(destination));
+    print_throughput("Encoded", *stats);
+    return 0;
+}
+
+auto decode(const std::string &input, const std::string &output) -> int {
+    int fd = STDOUT_FILENO;
+    if (!is_std_stream(output)) {
+        fd = ::open(output.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            throw std::runtime_error{fmt::format(
+                "Could not open {}: {}", output, std::strerror(errno))};
+        }
+    }
+    std::unique_ptr<video_input_t> source;
+    if (is_std_stream(input)) {
+        source = std::make_unique<fd_video_input_t>(STDIN_FILENO);
+    } else {
+        source = std::make_unique<file_video_input_t>(input);
+    }
+    auto stats = std::make_shared<stats_t>();
+    // Videos of ours are sampled where `encode()` drew the QR codes
+    auto decoder = decoder_t::builder()
+                       .set_num_workers(thread_count())
+                       .set_symbol_geometry(FLAGS_scale, border_size)
+                       .set_framing(framing())
+                       .set_stats(stats)
+                       .build();
+    fd_output_sink_t fd_sink{fd};
+    write_behind_output_sink_t sink{fd_sink};
+    decoder.decode(sink, std::move(source));
+    if (fd != STDOUT_FILENO && ::close(fd) != 0) {
+        throw std::runtime_error{fmt::format("Could not close {}: {}", output,
+                                             std::strerror(errno))};
+    }
+    print_throughput("Decoded", *stats);
+    return 0;
+}
+
+} // namespace
 
 int main(int argc, char **argv) {
     ::google::InitGoogleLogging(argv[0]);
+    ::gflags::SetUsageMessage(std::string{usage});
     ::gflags::ParseCommandLineFlags(&argc, &argv, true);
-    return 0;
+    if (argc < 2 || argc > 4) {
+        ::gflags::ShowUsageWithFlagsRestrict(argv[0], "cli.cc");
+        return 2;
+    }
+    const std::string command = argv[1];
+    const std::string input = argc > 2 ? argv[2] : "-";
+    const std::string output = argc > 3 ? argv[3] : "-";
+    try {
+        if (command == "encode") {
+            return encode(input, output);
+        }
+        if (command == "decode") {
+            return decode(input, output);
+        }
+    } catch (const std::exception &e) {
+        std::cerr << "plain_sight: " << e.what() << '\n';
+        return 1;
+    }
+    std::cerr << "plain_sight: unknown command " << std::quoted(command)
+              << "\n";
+    return 2;
 }
\ No newline at end of file
@@ -1,22 +1,38 @@
 #include <memory>
+#include <thread>
+#include <utility>
 
 #include "plain_sight/codec.h"
+#include "plain_sight/capacity.h"
 #include "plain_sight/decoder.h"
 #include "plain_sight/encoder.h"
+#include "plain_sight/mapped_file.h"
 #include "plain_sight/qr_codes.h"
+#include "plain_sight/thread_pool.h"
 
 namespace net_zelcon::plain_sight {
 
+namespace {
+
+/// @brief QR codes of up to version 20 at high ECC, each filled to capacity.
+auto make_qr_code_source(std::span<const std::uint8_t> src)
+    -> std::shared_ptr<qr_code_source_t> {
+    return std::make_shared<chunked_qr_code_source_t>(
+        src, std::make_shared<thread_pool_t>(),
+        plan_chunks(src.size(), 1, 20, qrcodegen::QrCode::Ecc::HIGH));
+}
+
+} // namespace
+
 void encode_raw_data(std::vector<std::uint8_t> &dst,
                      const std::vector<std::uint8_t> &src) {
-    auto qr_codes =
-        std::make_shared<std::vector<qrcodegen::QrCode>>(split_frames(src));
+    auto qr_codes = make_qr_code_source(src);
     auto encoder = encoder_t::builder()
                        .set_border_size(4)
                        .set_fps(30)
                        .set_scale(4)
                        .set_video_format("mp4")
-                       .set_qr_codes(qr_codes)
+                       .set_qr_code_source(qr_codes)
                        .build();
     encoder.encode(std::make_unique<in_memory_video_output_t>(dst));
 }
@@ -24,29 +40,43 @@ void encode_raw_data(std::vector<std::uint8_t> &dst,
 void decode_raw_data(std::vector<std::uint8_t> &dst,
                      std::span<std::uint8_t> src) {
     auto video_input = std::make_unique<in_memory_video_input_t>(src);
-    decoder_t decoder;
+    auto decoder = decoder_t::builder()
+                       .set_num_workers(std::thread::hardware_concurrency())
+                       .build();
     decoder.decode(dst, std::move(video_input));
 }
 
 void encode_file(std::filesystem::path dst,
                  const std::vector<std::uint8_t> &src) {
-    auto qr_codes =
-        std::make_shared<std::vector<qrcodegen::QrCode>>(split_frames(src));
+    encode_file(std::move(dst), std::span<const std::uint8_t>{src});
+}
+
+void encode_file(std::filesystem::path dst,
+                 std::span<const std::uint8_t> src) {
+    auto qr_codes = make_qr_code_source(src);
     auto encoder = encoder_t::builder()
                        .set_border_size(4)
                        .set_fps(30)
                        .set_scale(4)
                        .set_video_format("mp4")
-                       .set_qr_codes(qr_codes)
+                       .set_qr_code_source(qr_codes)
                        .build();
     auto video_output = std::make_unique<file_video_output_t>(dst);
     encoder.encode(std::move(video_output));
 }
 
+void encode_file(std::filesystem::path dst,
+                 const std::filesystem::path &src) {
+    const mapped_file_t mapped{src};
+    encode_file(std::move(dst), mapped.data());
+}
+
 void decode_file(std::vector<std::uint8_t> &dst,
                  const std::filesystem::path &src) {
     auto video_input = std::make_unique<file_video_input_t>(src);
-    decoder_t decoder;
+    auto decoder = decoder_t::builder()
+                       .set_num_workers(std::thread::hardware_concurrency())
+                       .build();
     decoder.decode(dst, std::move(video_input));
 }
 
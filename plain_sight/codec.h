@@ -17,6 +17,16 @@ void decode_raw_data(std::vector<std::uint8_t> &dst,
 void encode_file(std::filesystem::path dst,
                  const std::vector<std::uint8_t> &src);
 
+/// @brief Encodes `src`, e.g., the `data()` of a `mapped_file_t`, into a
+/// video file at `dst`. `src` is read as the QR codes are built, never
+/// copied as a whole.
+void encode_file(std::filesystem::path dst, std::span<const std::uint8_t> src);
+
+/// @brief Encodes the file at `src` into a video file at `dst`, reading it
+/// through a memory mapping.
+/// @throws std::runtime_error if `src` cannot be mapped
+void encode_file(std::filesystem::path dst, const std::filesystem::path &src);
+
 void decode_file(std::vector<std::uint8_t> &dst,
                  const std::filesystem::path &src);
 
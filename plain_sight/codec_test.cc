@@ -1,14 +1,118 @@
 #include <gtest/gtest.h>
 
+#include "plain_sight/capacity.h"
 #include "plain_sight/codec.h"
+#include "plain_sight/decoder.h"
+#include "plain_sight/encoder.h"
+#include "plain_sight/output_sink.h"
+#include "plain_sight/qr_codes.h"
+#include "plain_sight/stats.h"
+#include "plain_sight/thread_pool.h"
 #include "plain_sight/util.h"
 
+#include <csignal>
 #include <cstdint>
 #include <filesystem>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
 #include <vector>
 
+#include <sys/resource.h>
+
 using namespace net_zelcon::plain_sight;
 
+namespace {
+
+/// @brief Hands over the QR codes of `source`, with the middle third of the
+/// rows of those numbered in `damaged` inverted, beyond what their ECC
+/// corrects.
+class damaging_qr_code_source_t : public qr_code_source_t {
+  public:
+    damaging_qr_code_source_t(std::shared_ptr<qr_code_source_t> source,
+                              std::set<std::size_t> damaged)
+        : source_{std::move(source)}, damaged_{std::move(damaged)} {}
+
+    auto symbol_size() const -> int override {
+        return source_->symbol_size();
+    }
+    auto next() -> std::optional<qr_symbol_t> override {
+        auto symbol = source_->next();
+        if (symbol && damaged_.contains(position_++)) {
+            const int size = symbol->size();
+            for (int y = size / 3; y < 2 * size / 3; ++y) {
+                for (int x = 0; x < size; ++x) {
+                    symbol->set_module(x, y, !symbol->module(x, y));
+                }
+            }
+        }
+        return symbol;
+    }
+    auto qr_code_count() const -> std::optional<std::size_t> override {
+        return source_->qr_code_count();
+    }
+    auto chunk_plan() const -> std::optional<chunk_plan_t> override {
+        return source_->chunk_plan();
+    }
+    auto payload_size() const -> std::optional<std::uint64_t> override {
+        return source_->payload_size();
+    }
+
+  private:
+    std::shared_ptr<qr_code_source_t> source_;
+    std::set<std::size_t> damaged_;
+    std::size_t position_ = 0;
+};
+
+/// @brief Video of `src` chunked as `plan` says, with QR codes `damaged`
+/// damaged.
+auto encode_damaged(const std::vector<std::uint8_t> &src,
+                    const chunk_plan_t &plan, std::set<std::size_t> damaged)
+    -> std::vector<std::uint8_t> {
+    std::vector<std::uint8_t> encoded;
+    encoder_t::builder()
+        .set_border_size(4)
+        .set_fps(30)
+        .set_scale(4)
+        .set_video_format("mp4")
+        .set_qr_code_source(std::make_shared<damaging_qr_code_source_t>(
+            std::make_shared<chunked_qr_code_source_t>(
+                src, std::make_shared<thread_pool_t>(), plan),
+            std::move(damaged)))
+        .build()
+        .encode(std::make_unique<in_memory_video_output_t>(encoded));
+    return encoded;
+}
+
+/// @brief Caps the size of the files this process writes for its lifetime,
+/// so that writes past `limit` bytes fail with `EFBIG` rather than raise
+/// `SIGXFSZ`.
+class file_size_limit_t {
+  public:
+    explicit file_size_limit_t(const rlim_t limit)
+        : handler_{std::signal(SIGXFSZ, SIG_IGN)} {
+        CHECK_EQ(::getrlimit(RLIMIT_FSIZE, &saved_), 0);
+        rlimit capped = saved_;
+        capped.rlim_cur = limit;
+        CHECK_EQ(::setrlimit(RLIMIT_FSIZE, &capped), 0);
+    }
+    ~file_size_limit_t() {
+        ::setrlimit(RLIMIT_FSIZE, &saved_);
+        std::signal(SIGXFSZ, handler_);
+    }
+    file_size_limit_t(const file_size_limit_t &) = delete;
+    file_size_limit_t &operator=(const file_size_limit_t &) = delete;
+
+  private:
+    rlimit saved_{};
+    void (*handler_)(int);
+};
+
+} // namespace
+
 TEST(CodecEndToEndTest, Filesystem) {
     // load some file
     std::vector<std::uint8_t> some_file;
@@ -42,6 +146,19 @@ TEST(EncodingTest, InMemoryVsFileFidelity) {
     ASSERT_EQ(encoded_file_bytes, encoded_in_memory);
 }
 
+TEST(EncodingTest, FailedFileWriteThrows) {
+    std::vector<std::uint8_t> some_file;
+    read_file(some_file, std::filesystem::path{"/usr/include/errno.h"});
+    const std::filesystem::path encoded_path{"/tmp/output_too_large.mp4"};
+    {
+        // The video fits in one block, so only its tail, written when the
+        // output finishes, reaches the file and fails.
+        const file_size_limit_t limit{4096};
+        EXPECT_THROW(encode_file(encoded_path, some_file), std::runtime_error);
+    }
+    std::filesystem::remove(encoded_path);
+}
+
 TEST(CodecEndToEndTest, InMemory) {
     // load some file
     std::vector<std::uint8_t> some_file;
@@ -59,4 +176,484 @@ TEST(CodecEndToEndTest, InMemory) {
     // check that it's the same
     ASSERT_EQ(some_file.size(), decoded.size());
     ASSERT_EQ(some_file, decoded);
+}
+
+TEST(DecodingTest, ParallelMatchesSerial) {
+    std::vector<std::uint8_t> some_file;
+    read_file(some_file, std::filesystem::path{"/usr/include/errno.h"});
+    std::vector<std::uint8_t> encoded;
+    encode_raw_data(encoded, some_file);
+    const std::span<std::uint8_t> video{encoded.data(), encoded.size()};
+    std::vector<std::uint8_t> serial;
+    decoder_t{}.decode(serial,
+                       std::make_unique<in_memory_video_input_t>(video));
+    std::vector<std::uint8_t> parallel;
+    decoder_t::builder().set_num_workers(3).build().decode(
+        parallel, std::make_unique<in_memory_video_input_t>(video));
+    ASSERT_EQ(serial, some_file);
+    ASSERT_EQ(parallel, some_file);
+}
+
+TEST(CodecEndToEndTest, Tiles) {
+    std::vector<std::uint8_t> some_file;
+    read_file(some_file, std::filesystem::path{"/usr/include/errno.h"});
+    std::vector<std::uint8_t> encoded;
+    encoder_t::builder()
+        .set_border_size(4)
+        .set_fps(30)
+        .set_scale(4)
+        .set_tiles(3, 2)
+        .set_video_format("mp4")
+        .set_qr_code_source(std::make_shared<chunked_qr_code_source_t>(
+            some_file, std::make_shared<thread_pool_t>()))
+        .build()
+        .encode(std::make_unique<in_memory_video_output_t>(encoded));
+    const std::span<std::uint8_t> video{encoded.data(), encoded.size()};
+    std::vector<std::uint8_t> tiled;
+    decoder_t::builder().set_num_workers(3).set_tiles(3, 2).build().decode(
+        tiled, std::make_unique<in_memory_video_input_t>(video));
+    ASSERT_EQ(tiled, some_file);
+}
+
+TEST(CodecEndToEndTest, KnownSymbolGeometry) {
+    std::vector<std::uint8_t> some_file;
+    read_file(some_file, std::filesystem::path{"/usr/include/errno.h"});
+    std::vector<std::uint8_t> encoded;
+    encoder_t::builder()
+        .set_border_size(4)
+        .set_fps(30)
+        .set_scale(4)
+        .set_tiles(3, 2)
+        .set_video_format("mp4")
+        .set_qr_code_source(std::make_shared<chunked_qr_code_source_t>(
+            some_file, std::make_shared<thread_pool_t>()))
+        .build()
+        .encode(std::make_unique<in_memory_video_output_t>(encoded));
+    const std::span<std::uint8_t> video{encoded.data(), encoded.size()};
+    for (const size_t num_workers : {0, 3}) {
+        auto stats = std::make_shared<stats_t>();
+        std::vector<std::uint8_t> decoded;
+        decoder_t::builder()
+            .set_num_workers(num_workers)
+            .set_tiles(3, 2)
+            .set_symbol_geometry(4, 4)
+            .set_stats(stats)
+            .build()
+            .decode(decoded, std::make_unique<in_memory_video_input_t>(video));
+        ASSERT_EQ(decoded, some_file);
+        EXPECT_GT(stats->time(stage_t::qr_sample).count(), 0);
+    }
+}
+
+TEST(CodecEndToEndTest, SymbolGeometryOfAnotherScale) {
+    std::vector<std::uint8_t> some_file;
+    read_file(some_file, std::filesystem::path{"/usr/include/errno.h"});
+    std::vector<std::uint8_t> encoded;
+    encoder_t::builder()
+        .set_border_size(4)
+        .set_fps(30)
+        .set_scale(2)
+        .set_video_format("mp4")
+        .set_qr_code_source(std::make_shared<chunked_qr_code_source_t>(
+            some_file, std::make_shared<thread_pool_t>()))
+        .build()
+        .encode(std::make_unique<in_memory_video_output_t>(encoded));
+    const std::span<std::uint8_t> video{encoded.data(), encoded.size()};
+    for (const size_t num_workers : {0, 3}) {
+        // Decoded as if encoded with scale 4, falling back to detection
+        auto stats = std::make_shared<stats_t>();
+        std::vector<std::uint8_t> decoded;
+        decoder_t::builder()
+            .set_num_workers(num_workers)
+            .set_symbol_geometry(4, 4)
+            .set_stats(stats)
+            .build()
+            .decode(decoded, std::make_unique<in_memory_video_input_t>(video));
+        ASSERT_EQ(decoded, some_file);
+        EXPECT_EQ(stats->time(stage_t::qr_sample).count(), 0);
+        EXPECT_GT(stats->time(stage_t::qr_identify).count(), 0);
+    }
+}
+
+TEST(CodecEndToEndTest, SequencedFraming) {
+    std::vector<std::uint8_t> some_file;
+    read_file(some_file, std::filesystem::path{"/usr/include/errno.h"});
+    std::vector<std::uint8_t> encoded;
+    encoder_t::builder()
+        .set_border_size(4)
+        .set_fps(30)
+        .set_scale(4)
+        .set_video_format("mp4")
+        .set_qr_code_source(std::make_shared<chunked_qr_code_source_t>(
+            some_file, std::make_shared<thread_pool_t>(), 0,
+            framing_t::sequenced))
+        .build()
+        .encode(std::make_unique<in_memory_video_output_t>(encoded));
+    const std::span<std::uint8_t> video{encoded.data(), encoded.size()};
+    for (const size_t num_workers : {0, 3}) {
+        std::vector<std::uint8_t> decoded;
+        decoder_t::builder()
+            .set_num_workers(num_workers)
+            .set_framing(framing_t::sequenced)
+            .build()
+            .decode(decoded, std::make_unique<in_memory_video_input_t>(video));
+        ASSERT_EQ(decoded, some_file);
+    }
+}
+
+TEST(DecodingTest, ParityRebuildsDamagedQrCodes) {
+    std::vector<std::uint8_t> some_file;
+    read_file(some_file, std::filesystem::path{"/usr/include/stdio.h"});
+    const erasure_code_t erasure{
+        .group_size = 8, .parity_chunks = 2, .interleaving = 2};
+    // The manifest, whose repeats stand in for it, and a data chunk
+    auto encoded = encode_damaged(
+        some_file,
+        plan_chunks(some_file.size(), 1, 20, qrcodegen::QrCode::Ecc::LOW,
+                    framing_t::sequenced, erasure),
+        {0, 3});
+    std::span<std::uint8_t> video{encoded.data(), encoded.size()};
+    for (const auto [num_workers, shards] :
+         {std::pair<size_t, size_t>{0, 0}, {3, 0}, {0, 3}}) {
+        auto stats = std::make_shared<stats_t>();
+        std::vector<std::uint8_t> decoded;
+        decoder_t::builder()
+            .set_num_workers(num_workers)
+            .set_shards(shards)
+            .set_framing(framing_t::sequenced)
+            .set_symbol_geometry(4, 4)
+            .set_stats(stats)
+            .build()
+            .decode(decoded, std::make_unique<in_memory_video_input_t>(video));
+        ASSERT_EQ(decoded, some_file)
+            << num_workers << " workers, " << shards << " shards";
+        EXPECT_EQ(stats->decode_failures(), 2U);
+        EXPECT_EQ(stats->recovered_chunks(), 1U);
+        EXPECT_EQ(stats->duplicate_chunks(), 0U);
+    }
+
+    // Undamaged, nothing is rebuilt, even where parity is decoded first
+    encoded = encode_damaged(
+        some_file,
+        plan_chunks(some_file.size(), 1, 20, qrcodegen::QrCode::Ecc::LOW,
+                    framing_t::sequenced, erasure),
+        {});
+    video = {encoded.data(), encoded.size()};
+    for (const auto [num_workers, shards] :
+         {std::pair<size_t, size_t>{3, 0}, {0, 3}}) {
+        auto stats = std::make_shared<stats_t>();
+        std::vector<std::uint8_t> decoded;
+        decoder_t::builder()
+            .set_num_workers(num_workers)
+            .set_shards(shards)
+            .set_framing(framing_t::sequenced)
+            .set_symbol_geometry(4, 4)
+            .set_stats(stats)
+            .build()
+            .decode(decoded, std::make_unique<in_memory_video_input_t>(video));
+        ASSERT_EQ(decoded, some_file)
+            << num_workers << " workers, " << shards << " shards";
+        EXPECT_EQ(stats->decode_failures(), 0U);
+        EXPECT_EQ(stats->recovered_chunks(), 0U);
+        EXPECT_EQ(stats->duplicate_chunks(), 0U);
+    }
+
+    // Without framing, nothing stands in for a lost QR code
+    encoded = encode_damaged(
+        some_file,
+        plan_chunks(some_file.size(), 1, 20, qrcodegen::QrCode::Ecc::LOW), {3});
+    video = {encoded.data(), encoded.size()};
+    for (const size_t num_workers : {0, 3}) {
+        std::vector<std::uint8_t> decoded;
+        EXPECT_THROW(
+            decoder_t::builder().set_num_workers(num_workers).build().decode(
+                decoded, std::make_unique<in_memory_video_input_t>(video)),
+            std::runtime_error)
+            << num_workers << " workers";
+    }
+}
+
+TEST(DecodingTest, ByteRange) {
+    std::vector<std::uint8_t> some_file;
+    read_file(some_file, std::filesystem::path{"/usr/include/errno.h"});
+    std::vector<std::uint8_t> encoded;
+    encoder_t::builder()
+        .set_border_size(4)
+        .set_fps(30)
+        .set_scale(4)
+        .set_video_format("mp4")
+        .set_qr_code_source(std::make_shared<chunked_qr_code_source_t>(
+            some_file, std::make_shared<thread_pool_t>(), 0,
+            framing_t::sequenced))
+        .build()
+        .encode(std::make_unique<in_memory_video_output_t>(encoded));
+    const std::span<std::uint8_t> video{encoded.data(), encoded.size()};
+    const auto decode_range = [&](std::size_t offset, std::size_t length) {
+        std::vector<std::uint8_t> decoded;
+        decoder_t::builder()
+            .set_framing(framing_t::sequenced)
+            .build()
+            .decode_range(decoded,
+                          std::make_unique<in_memory_video_input_t>(video),
+                          offset, length);
+        return decoded;
+    };
+    const std::size_t size = some_file.size();
+    // Within a chunk, across chunks, the middle, the tail (past the first
+    // GOP), everything and nothing
+    const std::vector<std::pair<std::size_t, std::size_t>> ranges{
+        {10, 20},      {90, 110}, {size / 2, size / 4},
+        {size - 7, 7}, {0, size}, {size, 0}};
+    for (const auto &[offset, length] : ranges) {
+        ASSERT_EQ(decode_range(offset, length),
+                  std::vector<std::uint8_t>(some_file.begin() + offset,
+                                            some_file.begin() + offset +
+                                                length))
+            << "offset " << offset << ", length " << length;
+    }
+    EXPECT_THROW(decode_range(size - 1, 2), std::out_of_range);
+}
+
+TEST(CodecEndToEndTest, Grid) {
+    std::vector<std::uint8_t> some_file;
+    read_file(some_file, std::filesystem::path{"/usr/include/stdio.h"});
+    for (const auto &layout : {grid_layout_t{.columns = 96,
+                                             .rows = 96,
+                                             .cell_size = 4,
+                                             .bits_per_cell = 1},
+                               grid_layout_t{.columns = 64,
+                                             .rows = 64,
+                                             .cell_size = 6,
+                                             .bits_per_cell = 2}}) {
+        std::vector<std::uint8_t> encoded;
+        encoder_t::builder()
+            .set_fps(30)
+            .set_video_format("mp4")
+            .set_grid(layout, some_file)
+            .build()
+            .encode(std::make_unique<in_memory_video_output_t>(encoded));
+        const std::span<std::uint8_t> video{encoded.data(), encoded.size()};
+        for (const size_t num_workers : {0, 3}) {
+            std::vector<std::uint8_t> decoded;
+            decoder_t::builder()
+                .set_num_workers(num_workers)
+                .set_grid(layout)
+                .build()
+                .decode(decoded,
+                        std::make_unique<in_memory_video_input_t>(video));
+            ASSERT_EQ(decoded, some_file)
+                << layout.bits_per_cell << " bits per cell";
+        }
+    }
+}
+
+TEST(CodecEndToEndTest, PlaneMultiplexing) {
+    std::vector<std::uint8_t> some_file;
+    read_file(some_file, std::filesystem::path{"/usr/include/errno.h"});
+    std::vector<std::uint8_t> encoded;
+    encoder_t::builder()
+        .set_border_size(4)
+        .set_fps(30)
+        .set_scale(4)
+        .set_tiles(2, 1)
+        .set_pixel_format(AV_PIX_FMT_YUV444P)
+        .set_plane_multiplexing(true)
+        .set_video_format("mp4")
+        .set_qr_code_source(std::make_shared<chunked_qr_code_source_t>(
+            some_file, std::make_shared<thread_pool_t>()))
+        .build()
+        .encode(std::make_unique<in_memory_video_output_t>(encoded));
+    const std::span<std::uint8_t> video{encoded.data(), encoded.size()};
+    for (const size_t num_workers : {0, 3}) {
+        std::vector<std::uint8_t> decoded;
+        decoder_t::builder()
+            .set_num_workers(num_workers)
+            .set_tiles(2, 1)
+            .set_plane_multiplexing(true)
+            .build()
+            .decode(decoded, std::make_unique<in_memory_video_input_t>(video));
+        ASSERT_EQ(decoded, some_file);
+    }
+}
+
+TEST(CodecEndToEndTest, CodecThreads) {
+    std::vector<std::uint8_t> some_file;
+    read_file(some_file, std::filesystem::path{"/usr/include/errno.h"});
+    for (const auto threading : {codec_threading_t::any,
+                                 codec_threading_t::frame,
+                                 codec_threading_t::slice}) {
+        std::vector<std::uint8_t> encoded;
+        encoder_t::builder()
+            .set_border_size(4)
+            .set_fps(30)
+            .set_scale(4)
+            .set_pipeline_depth(2)
+            .set_codec_threads(4, threading)
+            .set_video_format("mp4")
+            .set_qr_code_source(std::make_shared<chunked_qr_code_source_t>(
+                some_file, std::make_shared<thread_pool_t>()))
+            .build()
+            .encode(std::make_unique<in_memory_video_output_t>(encoded));
+        const std::span<std::uint8_t> video{encoded.data(), encoded.size()};
+        std::vector<std::uint8_t> decoded;
+        decoder_t::builder()
+            .set_num_workers(2)
+            .set_codec_threads(4, threading)
+            .build()
+            .decode(decoded, std::make_unique<in_memory_video_input_t>(video));
+        ASSERT_EQ(decoded, some_file);
+    }
+}
+
+TEST(DecodingTest, ShardedMatchesSerial) {
+    std::vector<std::uint8_t> some_file;
+    read_file(some_file, std::filesystem::path{"/usr/include/stdio.h"});
+    for (const auto framing : {framing_t::none, framing_t::sequenced}) {
+        std::vector<std::uint8_t> encoded;
+        encoder_t::builder()
+            .set_border_size(4)
+            .set_fps(30)
+            .set_scale(4)
+            .set_video_format("mp4")
+            .set_qr_code_source(std::make_shared<chunked_qr_code_source_t>(
+                some_file, std::make_shared<thread_pool_t>(), 0, framing))
+            .build()
+            .encode(std::make_unique<in_memory_video_output_t>(encoded));
+        const std::span<std::uint8_t> video{encoded.data(), encoded.size()};
+        // More shards than GOPs, too
+        for (const size_t shards : {2, 5, 1000}) {
+            std::vector<std::uint8_t> decoded;
+            decoder_t::builder()
+                .set_shards(shards)
+                .set_framing(framing)
+                .build()
+                .decode(decoded,
+                        std::make_unique<in_memory_video_input_t>(video));
+            ASSERT_EQ(decoded, some_file) << shards << " shards";
+        }
+    }
+}
+
+TEST(CodecEndToEndTest, SegmentEncoders) {
+    std::vector<std::uint8_t> some_file;
+    read_file(some_file, std::filesystem::path{"/usr/include/stdio.h"});
+    std::vector<std::uint8_t> encoded;
+    encoder_t::builder()
+        .set_border_size(4)
+        .set_fps(30)
+        .set_scale(4)
+        .set_segment_encoders(3)
+        .set_codec_threads(1)
+        .set_video_format("mp4")
+        .set_qr_code_source(std::make_shared<chunked_qr_code_source_t>(
+            some_file, std::make_shared<thread_pool_t>()))
+        .build()
+        .encode(std::make_unique<in_memory_video_output_t>(encoded));
+    const std::span<std::uint8_t> video{encoded.data(), encoded.size()};
+    for (const size_t shards : {0, 3}) {
+        std::vector<std::uint8_t> decoded;
+        decoder_t::builder().set_shards(shards).build().decode(
+            decoded, std::make_unique<in_memory_video_input_t>(video));
+        ASSERT_EQ(decoded, some_file) << shards << " shards";
+    }
+}
+
+TEST(DecodingTest, StreamsToSink) {
+    std::vector<std::uint8_t> some_file;
+    read_file(some_file, std::filesystem::path{"/usr/include/stdio.h"});
+    for (const auto framing : {framing_t::none, framing_t::sequenced}) {
+        std::vector<std::uint8_t> encoded;
+        encoder_t::builder()
+            .set_border_size(4)
+            .set_fps(30)
+            .set_scale(4)
+            .set_video_format("mp4")
+            .set_qr_code_source(std::make_shared<chunked_qr_code_source_t>(
+                some_file, std::make_shared<thread_pool_t>(), 0, framing))
+            .build()
+            .encode(std::make_unique<in_memory_video_output_t>(encoded));
+        const std::span<std::uint8_t> video{encoded.data(), encoded.size()};
+        for (const auto [num_workers, shards] :
+             {std::pair<size_t, size_t>{0, 0}, {3, 0}, {0, 3}}) {
+            std::ostringstream decoded;
+            ostream_output_sink_t sink{decoded};
+            decoder_t::builder()
+                .set_num_workers(num_workers)
+                .set_shards(shards)
+                .set_framing(framing)
+                .build()
+                .decode(sink,
+                        std::make_unique<in_memory_video_input_t>(video));
+            const std::string expected{some_file.begin(), some_file.end()};
+            ASSERT_EQ(decoded.str(), expected)
+                << num_workers << " workers, " << shards << " shards";
+        }
+    }
+}
+
+TEST(CodecEndToEndTest, Streams) {
+    std::vector<std::uint8_t> some_file;
+    read_file(some_file, std::filesystem::path{"/usr/include/errno.h"});
+    std::vector<std::uint8_t> encoded;
+    encode_raw_data(encoded, some_file);
+    std::istringstream video{std::string{encoded.begin(), encoded.end()}};
+    std::ostringstream decoded;
+    decode(decoded, video);
+    ASSERT_EQ(decoded.str(), std::string(some_file.begin(), some_file.end()));
+}
+
+TEST(CodecEndToEndTest, Stats) {
+    std::vector<std::uint8_t> some_file;
+    read_file(some_file, std::filesystem::path{"/usr/include/stdio.h"});
+    const auto encoder_stats = std::make_shared<stats_t>();
+    const auto encoder =
+        encoder_t::builder()
+            .set_border_size(4)
+            .set_fps(30)
+            .set_scale(4)
+            .set_video_format("mp4")
+            .set_qr_code_source(std::make_shared<chunked_qr_code_source_t>(
+                some_file, std::make_shared<thread_pool_t>()))
+            .set_stats(encoder_stats);
+    const auto frame_count = encoder.projected_frame_count();
+    ASSERT_TRUE(frame_count.has_value());
+    std::vector<std::uint8_t> encoded;
+    encoder.build().encode(std::make_unique<in_memory_video_output_t>(encoded));
+    EXPECT_EQ(encoder_stats->frames(), *frame_count);
+    EXPECT_EQ(encoder_stats->payload_bytes(), some_file.size());
+    EXPECT_GT(encoder_stats->video_bytes(), 0U);
+    EXPECT_LE(encoder_stats->video_bytes(), encoded.size());
+    EXPECT_EQ(encoder_stats->frame_latency().count(), *frame_count);
+    for (const auto stage : {stage_t::qr_generation, stage_t::render,
+                             stage_t::codec_send, stage_t::mux}) {
+        EXPECT_GT(encoder_stats->time(stage).count(), 0) << stage_name(stage);
+    }
+    EXPECT_EQ(encoder_stats->time(stage_t::qr_identify).count(), 0);
+
+    const std::span<std::uint8_t> video{encoded.data(), encoded.size()};
+    for (const size_t num_workers : {0, 3}) {
+        const auto decoder_stats = std::make_shared<stats_t>();
+        std::vector<std::uint8_t> decoded;
+        decoder_t::builder()
+            .set_num_workers(num_workers)
+            .set_stats(decoder_stats)
+            .build()
+            .decode(decoded, std::make_unique<in_memory_video_input_t>(video));
+        ASSERT_TRUE(decoded == some_file) << num_workers << " workers";
+        EXPECT_EQ(decoder_stats->frames(), *frame_count);
+        EXPECT_EQ(decoder_stats->payload_bytes(), some_file.size());
+        EXPECT_EQ(decoder_stats->video_bytes(),
+                  encoder_stats->video_bytes());
+        EXPECT_EQ(decoder_stats->decode_failures(), 0U);
+        EXPECT_EQ(decoder_stats->frame_latency().count(), *frame_count);
+        for (const auto stage :
+             {stage_t::demux, stage_t::codec_send, stage_t::codec_receive,
+              stage_t::pixel_conversion, stage_t::qr_identify,
+              stage_t::qr_decode}) {
+            EXPECT_GT(decoder_stats->time(stage).count(), 0)
+                << stage_name(stage);
+        }
+        EXPECT_GT(decoder_stats->elapsed().count(), 0);
+        EXPECT_EQ(decoder_stats->time(stage_t::render).count(), 0);
+    }
 }
\ No newline at end of file
@@ -1,18 +1,35 @@
 #include "plain_sight/decoder.h"
+#include "plain_sight/bounded_queue.h"
+#include "plain_sight/framing.h"
+#include "plain_sight/grid_codec.h"
 #include "plain_sight/qr_codes.h"
 #include "plain_sight/util.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
 #include <fmt/core.h>
+#include <functional>
+#include <future>
 #include <glog/logging.h>
 #include <limits>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
 #include <stdexcept>
+#include <thread>
 #include <tuple>
+#include <variant>
 
 extern "C" {
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
 #include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
 #include <libswscale/swscale.h>
 }
 
@@ -20,46 +37,166 @@ namespace net_zelcon::plain_sight {
 
 namespace {
 
-struct image_buf_t {
-    std::vector<std::uint8_t> buf;
-    int width;
-    int height;
+/// @brief A rectangle of pixels within a frame, of its luma or, if `plane`
+/// is not negative, of that 8-bit plane.
+struct rect_t {
+    int x, y, width, height;
+    int plane = -1;
 };
 
-auto get_frame_pixels(image_buf_t &img, const AVFrame *frame) -> void {
-    constexpr auto destination_format = AV_PIX_FMT_BGR8;
-    libav_ptr_t<SwsContext, sws_freeContext> sws_ctx{
-        sws_getContext(frame->width, frame->height,
-                       static_cast<AVPixelFormat>(frame->format), frame->width,
-                       frame->height, destination_format, SWS_BILINEAR, nullptr,
-                       nullptr, nullptr),
-        sws_freeContext};
-    if (!sws_ctx) {
-        throw std::runtime_error{"Could not initialize sws context"};
-    }
-    libav_ptr_t<AVFrame, av_frame_free> grayscale_frame{av_frame_alloc(),
-                                                        av_frame_free};
-    CHECK(grayscale_frame) << "Could not allocate bgr frame";
-    int err =
-        av_image_alloc(grayscale_frame->data, grayscale_frame->linesize,
-                       frame->width, frame->height, destination_format, 1);
-    CHECK(err >= 0) << "Could not allocate raw picture buffer";
-
-    err = sws_scale_frame(sws_ctx.get(), grayscale_frame.get(), frame);
-    if (err < 0) {
-        LOG(ERROR) << "Could not scale frame:" << libav_error(err);
-        throw std::runtime_error{"Could not scale frame"};
+/// @brief Tile `tile` of a frame split into `columns` × `rows` equal tiles,
+/// numbered row by row.
+auto tile_rect(const AVFrame *frame, const int columns, const int rows,
+               const int tile) -> rect_t {
+    CHECK_EQ(frame->width % columns, 0)
+        << "Frame width " << frame->width << " is not a multiple of "
+        << columns << " tiles";
+    CHECK_EQ(frame->height % rows, 0)
+        << "Frame height " << frame->height << " is not a multiple of " << rows
+        << " tiles";
+    const int width = frame->width / columns;
+    const int height = frame->height / rows;
+    return {tile % columns * width, tile / columns * height, width, height};
+}
+
+/// @brief Number of planes of `frame` carrying QR codes: one, its luma,
+/// unless the video was encoded with plane multiplexing.
+auto symbol_planes(const AVFrame *frame, const bool plane_multiplexing)
+    -> int {
+    if (!plane_multiplexing) {
+        return 1;
+    }
+    const auto format = static_cast<AVPixelFormat>(frame->format);
+    const int planes = multiplexable_planes(format);
+    if (planes == 0) {
+        LOG(ERROR) << "Pixel format " << av_get_pix_fmt_name(format)
+                   << " cannot carry QR codes in separate planes";
+        throw std::runtime_error{fmt::format(
+            "Pixel format {} cannot carry QR codes in separate planes",
+            av_get_pix_fmt_name(format))};
     }
+    return planes;
+}
 
-    img.height = grayscale_frame->height;
-    img.width = grayscale_frame->linesize[0];
-    img.buf.clear();
-    std::copy(grayscale_frame->data[0],
-              grayscale_frame->data[0] +
-                  grayscale_frame->linesize[0] * img.height,
-              std::back_inserter(img.buf));
+/// @brief Where QR code `symbol` of a frame split into `columns` × `rows`
+/// tiles is: tile by tile in the luma or, with plane multiplexing, tile by
+/// tile in each plane in turn.
+auto symbol_rect(const AVFrame *frame, const int columns, const int rows,
+                 const bool plane_multiplexing, const int symbol) -> rect_t {
+    const int num_tiles = columns * rows;
+    rect_t rect = tile_rect(frame, columns, rows, symbol % num_tiles);
+    if (plane_multiplexing) {
+        rect.plane = symbol / num_tiles;
+    }
+    return rect;
 }
 
+/// @brief Writes the luma of decoded frames into a caller-provided 8-bit gray
+/// image, e.g., the `quirc` image buffer.
+/// @details Formats that store luma as 8-bit samples (YUV, planar or
+/// semi-planar or packed, and gray) are copied row by row, honoring
+/// `linesize`; this is the only copy of the pixels. Anything else (RGB,
+/// paletted, high bit depth) is converted by an `SwsContext` that is kept
+/// across frames and writes straight into the destination. A rectangle of
+/// a given plane is copied as is.
+class luma_reader_t {
+  public:
+    /// @brief Writes the luma, or the plane, of `rect` of `frame` to `dst`,
+    /// `rect.width` pixels per row.
+    void read(std::span<std::uint8_t> dst, const AVFrame *frame,
+              const rect_t &rect) {
+        CHECK_GE(rect.x, 0);
+        CHECK_GE(rect.y, 0);
+        CHECK_LE(rect.x + rect.width, frame->width);
+        CHECK_LE(rect.y + rect.height, frame->height);
+        CHECK_GE(dst.size(), static_cast<std::size_t>(rect.width) *
+                                 static_cast<std::size_t>(rect.height))
+            << "Destination image too small";
+        const auto format = static_cast<AVPixelFormat>(frame->format);
+        if (rect.plane >= 0) {
+            AVComponentDescriptor component{};
+            component.plane = rect.plane;
+            component.step = 1;
+            component.depth = 8;
+            copy_luma(dst, frame, component, rect);
+        } else if (has_8bit_luma(format)) {
+            copy_luma(dst, frame, av_pix_fmt_desc_get(format)->comp[0], rect);
+        } else if (rect.width == frame->width &&
+                   rect.height == frame->height) {
+            convert(dst, frame);
+        } else {
+            // Converting a part of a frame would need per-plane offsets; the
+            // whole frame is converted instead.
+            gray_.resize(static_cast<std::size_t>(frame->width) *
+                         frame->height);
+            convert(gray_, frame);
+            for (int y = 0; y < rect.height; ++y) {
+                std::copy_n(gray_.data() +
+                                static_cast<std::size_t>(rect.y + y) *
+                                    frame->width +
+                                rect.x,
+                            rect.width, dst.data() + y * rect.width);
+            }
+        }
+    }
+
+  private:
+    static auto has_8bit_luma(const AVPixelFormat format) -> bool {
+        const AVPixFmtDescriptor *const desc = av_pix_fmt_desc_get(format);
+        return desc != nullptr &&
+               (desc->flags &
+                (AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_PAL |
+                 AV_PIX_FMT_FLAG_BITSTREAM | AV_PIX_FMT_FLAG_HWACCEL)) == 0 &&
+               desc->comp[0].depth == 8 && desc->comp[0].shift == 0;
+    }
+
+    static void copy_luma(std::span<std::uint8_t> dst, const AVFrame *frame,
+                          const AVComponentDescriptor &luma,
+                          const rect_t &rect) {
+        const auto width = static_cast<std::size_t>(rect.width);
+        for (int y = 0; y < rect.height; ++y) {
+            const std::uint8_t *src =
+                frame->data[luma.plane] +
+                (rect.y + y) * frame->linesize[luma.plane] +
+                rect.x * luma.step + luma.offset;
+            std::uint8_t *const row = dst.data() + y * width;
+            if (luma.step == 1) {
+                std::copy_n(src, width, row);
+                continue;
+            }
+            for (std::size_t x = 0; x < width; ++x, src += luma.step) {
+                row[x] = *src;
+            }
+        }
+    }
+
+    void convert(std::span<std::uint8_t> dst, const AVFrame *frame) {
+        sws_ctx_.reset(sws_getCachedContext(
+            sws_ctx_.release(), frame->width, frame->height,
+            static_cast<AVPixelFormat>(frame->format), frame->width,
+            frame->height, AV_PIX_FMT_GRAY8, SWS_BILINEAR, nullptr, nullptr,
+            nullptr));
+        if (!sws_ctx_) {
+            throw std::runtime_error{"Could not initialize sws context"};
+        }
+        std::uint8_t *const dst_data[4] = {dst.data(), nullptr, nullptr,
+                                           nullptr};
+        const int dst_linesize[4] = {frame->width, 0, 0, 0};
+        const int err =
+            sws_scale(sws_ctx_.get(), frame->data, frame->linesize, 0,
+                      frame->height, dst_data, dst_linesize);
+        if (err < 0) {
+            LOG(ERROR) << "Could not scale frame:" << libav_error(err);
+            throw std::runtime_error{"Could not scale frame"};
+        }
+    }
+
+    libav_ptr_t<SwsContext, sws_freeContext> sws_ctx_{nullptr,
+                                                      sws_freeContext};
+    // Whole converted frame, for reading a part of a frame without luma
+    std::vector<std::uint8_t> gray_;
+};
+
 auto find_video_stream(AVFormatContext *const format_context)
     -> std::tuple<const AVCodec *, const AVCodecParameters *, int> {
     const AVCodec *decoder = nullptr;
@@ -90,6 +227,428 @@ auto find_video_stream(AVFormatContext *const format_context)
     return {decoder, codec_params, video_stream_idx};
 }
 
+/// @brief Opens a decoder for the video stream of `format_context`, running
+/// on `threads` threads (zero for one per core) of the kinds in `threading`.
+/// @return the codec context and the index of the video stream
+auto open_video_stream(AVFormatContext *format_context, const size_t threads,
+                       const codec_threading_t threading)
+    -> std::pair<libav_ptr_t<AVCodecContext, avcodec_free_context>, int> {
+    int err = avformat_find_stream_info(format_context, nullptr);
+    if (err < 0) {
+        LOG(ERROR) << "Could not find stream info:" << libav_error(err);
+        throw std::runtime_error{
+            fmt::format("Could not find stream info: {}", libav_error(err))};
+    }
+    // find video stream index
+    const auto [codec, codec_params, video_stream_idx] =
+        find_video_stream(format_context);
+    // allocate codec context
+    libav_ptr_t<AVCodecContext, avcodec_free_context> codec_context{
+        avcodec_alloc_context3(codec), avcodec_free_context};
+    CHECK(codec_context) << "Could not allocate codec context";
+    err = avcodec_parameters_to_context(codec_context.get(), codec_params);
+    if (err < 0) {
+        LOG(ERROR) << "Could not copy codec params to codec context:"
+                   << libav_error(err);
+        throw std::runtime_error{
+            fmt::format("Could not copy codec params to codec context: {}",
+                        libav_error(err))};
+    }
+    set_codec_threads(codec_context.get(), threads, threading);
+    err = avcodec_open2(codec_context.get(), codec, nullptr);
+    if (err < 0) {
+        LOG(ERROR) << "Could not open codec:" << libav_error(err);
+        throw std::runtime_error{
+            fmt::format("Could not open codec: {}", libav_error(err))};
+    }
+    return {std::move(codec_context), video_stream_idx};
+}
+
+/// @brief Positions the demuxer on the last keyframe at or before
+/// `timestamp`, in the video stream's time base, and drops the decoder's
+/// buffered frames.
+void seek_to_timestamp(AVFormatContext *format_context,
+                       AVCodecContext *codec_context,
+                       const int video_stream_idx,
+                       const std::int64_t timestamp) {
+    const int err = av_seek_frame(format_context, video_stream_idx, timestamp,
+                                  AVSEEK_FLAG_BACKWARD);
+    if (err < 0) {
+        LOG(ERROR) << "Could not seek to timestamp " << timestamp << ": "
+                   << libav_error(err);
+        throw std::runtime_error{
+            fmt::format("Could not seek to timestamp {}: {}", timestamp,
+                        libav_error(err))};
+    }
+    avcodec_flush_buffers(codec_context);
+}
+
+/// @brief Positions the demuxer on the last keyframe at or before frame
+/// `frame_number` (counted from zero) and drops the decoder's buffered
+/// frames. The frame's timestamp is derived from the stream's frame rate; the
+/// container's own index maps it to a keyframe.
+void seek_to_frame(AVFormatContext *format_context,
+                   AVCodecContext *codec_context, const int video_stream_idx,
+                   const std::int64_t frame_number) {
+    const AVStream *const stream = format_context->streams[video_stream_idx];
+    const AVRational frame_rate = stream->avg_frame_rate.num > 0
+                                      ? stream->avg_frame_rate
+                                      : stream->r_frame_rate;
+    std::int64_t timestamp =
+        stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+    if (frame_rate.num > 0) {
+        timestamp += av_rescale_q(frame_number, av_inv_q(frame_rate),
+                                  stream->time_base);
+    }
+    seek_to_timestamp(format_context, codec_context, video_stream_idx,
+                      timestamp);
+}
+
+/// @brief Timestamps of the keyframes of the video stream, in the order the
+/// container's index lists them. Seeking to one lands on its keyframe.
+auto keyframe_timestamps(AVFormatContext *format_context,
+                         const int video_stream_idx)
+    -> std::vector<std::int64_t> {
+    AVStream *const stream = format_context->streams[video_stream_idx];
+    std::vector<std::int64_t> timestamps;
+    const int num_entries = avformat_index_get_entries_count(stream);
+    for (int i = 0; i < num_entries; ++i) {
+        const AVIndexEntry *const entry = avformat_index_get_entry(stream, i);
+        if (entry != nullptr && (entry->flags & AVINDEX_KEYFRAME) != 0 &&
+            (entry->flags & AVINDEX_DISCARD_FRAME) == 0 &&
+            (timestamps.empty() || entry->timestamp > timestamps.back())) {
+            timestamps.push_back(entry->timestamp);
+        }
+    }
+    return timestamps;
+}
+
+auto is_keyframe(const AVFrame *frame) -> bool {
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(58, 7, 100)
+    return (frame->flags & AV_FRAME_FLAG_KEY) != 0;
+#else
+    return frame->key_frame != 0;
+#endif
+}
+
+/// @brief Decodes the QR codes in `rect` of a video frame and hands their
+/// payloads to `sink`. `qr_code_decoder` is created on first use, once the
+/// dimensions are known, sampling symbols of `geometry` if it is set and
+/// fits the tile, and reporting to `stats` if it is not null.
+/// @param tolerate_loss Whether a tile without a readable QR code is only
+/// counted as a decode failure, as when the chunks are framed and the
+/// assembler reports, or rebuilds, the ones that are lost. A QR code that is
+/// found but does not decode is counted by `qr_code_decoder` itself.
+/// @throws std::runtime_error if the tile is neither blank nor holds a QR
+/// code that decodes, unless `tolerate_loss` is set
+void decode_frame(const payload_sink_t &sink,
+                  std::unique_ptr<qr_code_decoder_t> &qr_code_decoder,
+                  luma_reader_t &luma_reader, const AVFrame *frame,
+                  const rect_t &rect,
+                  const std::optional<symbol_geometry_t> &geometry,
+                  stats_t *stats, const bool tolerate_loss) {
+    if (!qr_code_decoder) {
+        qr_code_decoder =
+            std::make_unique<qr_code_decoder_t>(rect.width, rect.height);
+        qr_code_decoder->set_stats(stats);
+        if (geometry && qr_code_decoder->fits_geometry(
+                            geometry->scale, geometry->border_size)) {
+            qr_code_decoder->set_geometry(geometry->scale,
+                                          geometry->border_size);
+        } else if (geometry) {
+            // E.g., a video encoded with another scale, whose QR codes
+            // detection still finds
+            LOG_FIRST_N(WARNING, 1)
+                << "No QR code of scale " << geometry->scale << " and border "
+                << geometry->border_size << " fits a " << rect.width << "x"
+                << rect.height << " tile; detecting QR codes instead";
+        }
+    }
+    CHECK_EQ(qr_code_decoder->width(), rect.width);
+    CHECK_EQ(qr_code_decoder->height(), rect.height);
+    {
+        const stage_timer_t timer{stats, stage_t::pixel_conversion};
+        luma_reader.read(qr_code_decoder->begin(), frame, rect);
+    }
+    std::size_t payloads = 0;
+    const int found =
+        qr_code_decoder->finish([&](std::span<const std::uint8_t> payload) {
+            ++payloads;
+            sink(payload);
+        });
+    if (payloads > 0) {
+        return;
+    }
+    if (found == 0) {
+        // The encoder leaves the unused tiles of the last frame blank. quirc
+        // thresholds its buffer in place, so read the luma again to tell.
+        const auto image = qr_code_decoder->begin();
+        {
+            const stage_timer_t timer{stats, stage_t::pixel_conversion};
+            luma_reader.read(image, frame, rect);
+        }
+        if (std::all_of(image.begin(), image.end(),
+                        [](const std::uint8_t luma) { return luma >= 128; })) {
+            return;
+        }
+        if (stats != nullptr) {
+            stats->add_decode_failures(1);
+        }
+    }
+    if (!tolerate_loss) {
+        LOG(ERROR) << "No QR code decoded in a tile";
+        throw std::runtime_error{"No QR code decoded in a tile"};
+    }
+    LOG(WARNING) << "No QR code decoded in a tile, leaving its chunk missing";
+}
+
+/// @brief Checks that `assembler` has the whole payload, accounting the
+/// chunks it rebuilt and those it dropped as duplicates to `stats`, which may
+/// be null.
+void finish_assembly(frame_assembler_t &assembler, stats_t *stats) {
+    // `finish()` rebuilds the chunks, and they count even if some others
+    // stay missing.
+    std::exception_ptr error;
+    try {
+        assembler.finish();
+    } catch (const std::runtime_error &) {
+        error = std::current_exception();
+    }
+    if (stats != nullptr) {
+        stats->add_recovered_chunks(assembler.recovered());
+        stats->add_duplicate_chunks(assembler.duplicates());
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+/// @brief Samples the grid of a video frame and hands its payload to `sink`.
+/// `luma` is scratch space for the frame's luma. `stats` may be null.
+void decode_grid_frame(const payload_sink_t &sink,
+                       const grid_codec_t &grid_codec,
+                       luma_reader_t &luma_reader,
+                       std::vector<std::uint8_t> &luma, const AVFrame *frame,
+                       stats_t *stats) {
+    const grid_layout_t &layout = grid_codec.layout();
+    if (frame->width != layout.width() || frame->height != layout.height()) {
+        LOG(ERROR) << "Frame of " << frame->width << "x" << frame->height
+                   << " does not match the grid layout of " << layout.width()
+                   << "x" << layout.height();
+        throw std::runtime_error{fmt::format(
+            "Frame of {}x{} does not match the grid layout of {}x{}",
+            frame->width, frame->height, layout.width(), layout.height())};
+    }
+    luma.resize(static_cast<std::size_t>(frame->width) * frame->height);
+    {
+        const stage_timer_t timer{stats, stage_t::pixel_conversion};
+        luma_reader.read(luma, frame, {0, 0, frame->width, frame->height});
+    }
+    std::vector<std::uint8_t> payload;
+    std::size_t corrected = 0;
+    {
+        const stage_timer_t timer{stats, stage_t::grid_decode};
+        corrected = grid_codec.decode(luma.data(), frame->width, payload);
+    }
+    DLOG_IF(INFO, corrected > 0) << "Corrected " << corrected << " bytes";
+    sink(payload);
+}
+
+/// @brief Demuxes and decodes every frame of the video stream, handing each
+/// decoded frame to `fn`. `fn` may take ownership of the frame's buffers with
+/// `av_frame_move_ref`; otherwise they are released after `fn` returns. `fn`
+/// returns whether to carry on; when it stops early, the demuxer and decoder
+/// are left mid-stream, to be repositioned with `seek_to_frame()`. `stats`
+/// may be null.
+template <typename Fn>
+void for_each_frame(AVFormatContext *format_context,
+                    AVCodecContext *codec_context, const int video_stream_idx,
+                    stats_t *stats, Fn &&fn) {
+    libav_ptr_t<AVFrame, av_frame_free> frame{av_frame_alloc(), av_frame_free};
+    CHECK(frame) << "Could not allocate frame";
+    libav_ptr_t<AVPacket, av_packet_free> packet{av_packet_alloc(),
+                                                 av_packet_free};
+    CHECK(packet) << "Could not allocate packet";
+    int frame_counter = 0;
+    int err = 0;
+    while (err >= 0) {
+        {
+            const stage_timer_t timer{stats, stage_t::demux};
+            err = av_read_frame(format_context, packet.get());
+        }
+        if (err >= 0 && packet->stream_index != video_stream_idx) {
+            av_packet_unref(packet.get());
+            continue;
+        }
+        if (err < 0) {
+            // send flush packet
+            const stage_timer_t timer{stats, stage_t::codec_send};
+            err = avcodec_send_packet(codec_context, nullptr);
+        } else {
+            if (packet->pts ==
+                AV_NOPTS_VALUE) { // no timestamp value available for this frame
+                packet->pts = packet->dts = frame_counter;
+            }
+            if (stats != nullptr) {
+                stats->add_video_bytes(
+                    static_cast<std::uint64_t>(packet->size));
+            }
+            const stage_timer_t timer{stats, stage_t::codec_send};
+            err = avcodec_send_packet(codec_context, packet.get());
+        }
+        av_packet_unref(packet.get());
+        if (err < 0) {
+            LOG(ERROR) << "Error sending packet to decoder:"
+                       << libav_error(err);
+            throw std::runtime_error{fmt::format(
+                "Error sending packet to decoder: {}", libav_error(err))};
+        }
+        while (err >= 0) {
+            // process decoded frame
+            {
+                const stage_timer_t timer{stats, stage_t::codec_receive};
+                err = avcodec_receive_frame(codec_context, frame.get());
+            }
+            if (err == AVERROR_EOF) {
+                return;
+            } else if (err == AVERROR(EAGAIN)) {
+                DLOG(INFO) << "EAGAIN";
+                err = 0;
+                break;
+            } else if (err < 0) {
+                LOG(ERROR) << "Error during decoding:" << libav_error(err);
+                throw std::runtime_error{
+                    fmt::format("Error during decoding: {}", libav_error(err))};
+            } else if (err >= 0) {
+                DLOG(INFO) << "Received frame " << frame_counter
+                           << " from decoder";
+                if (stats != nullptr) {
+                    stats->add_frames(1);
+                }
+                const bool carry_on = fn(frame.get());
+                av_frame_unref(frame.get());
+                if (!carry_on) {
+                    return;
+                }
+            } else {
+                LOG(FATAL) << "should be unreachable!";
+            }
+            frame_counter++;
+        }
+    }
+}
+
+/// @brief When a frame came out of the libav decoder, and how many of its
+/// jobs are not done yet; the last one records the frame's latency.
+struct frame_clock_t {
+    std::chrono::steady_clock::time_point received;
+    std::atomic<int> jobs_left;
+};
+
+/// @brief QR detection of one tile of a frame.
+struct frame_job_t {
+    std::shared_ptr<const AVFrame> frame;
+    rect_t rect;
+    std::promise<std::vector<std::uint8_t>> payload;
+    /// @brief Shared by the frame's jobs; null without stats
+    std::shared_ptr<frame_clock_t> clock;
+};
+
+/// @brief Worker threads that each own a `qr_code_decoder_t` (and with it a
+/// `quirc` instance) and decode the frames submitted to them.
+class frame_workers_t {
+  public:
+    /// @param assembler If not null, payloads are handed to it straight from
+    /// the workers and the jobs' results stay empty.
+    /// @param grid_codec If not null, frames are sampled with it instead of
+    /// being searched for QR codes.
+    /// @param geometry Geometry of the QR codes, if known
+    /// @param stats May be null
+    frame_workers_t(const size_t num_workers, frame_assembler_t *assembler,
+                    const grid_codec_t *grid_codec,
+                    const std::optional<symbol_geometry_t> &geometry,
+                    stats_t *stats)
+        : jobs_{num_workers}, assembler_{assembler}, grid_codec_{grid_codec},
+          geometry_{geometry}, stats_{stats} {
+        CHECK_GT(num_workers, 0UL);
+        for (size_t i = 0; i < num_workers; ++i) {
+            threads_.emplace_back([this] { run(); });
+        }
+    }
+
+    ~frame_workers_t() noexcept {
+        jobs_.close();
+        for (auto &thread : threads_) {
+            thread.join();
+        }
+    }
+
+    frame_workers_t(const frame_workers_t &) = delete;
+    frame_workers_t &operator=(const frame_workers_t &) = delete;
+
+    void submit(frame_job_t job) { jobs_.push(std::move(job)); }
+
+  private:
+    void run() {
+        std::unique_ptr<qr_code_decoder_t> qr_code_decoder{nullptr};
+        luma_reader_t luma_reader{};
+        std::vector<std::uint8_t> luma;
+        while (auto job = jobs_.pop()) {
+            try {
+                std::vector<std::uint8_t> payload;
+                const payload_sink_t sink =
+                    [&](std::span<const std::uint8_t> data) {
+                        if (assembler_ != nullptr) {
+                            assembler_->add(data);
+                        } else {
+                            payload.insert(payload.end(), data.begin(),
+                                           data.end());
+                        }
+                    };
+                if (grid_codec_ != nullptr) {
+                    decode_grid_frame(sink, *grid_codec_, luma_reader, luma,
+                                      job->frame.get(), stats_);
+                } else {
+                    decode_frame(sink, qr_code_decoder, luma_reader,
+                                 job->frame.get(), job->rect, geometry_,
+                                 stats_, assembler_ != nullptr);
+                }
+                if (job->clock && --job->clock->jobs_left == 0) {
+                    stats_->record_frame_latency(
+                        std::chrono::steady_clock::now() -
+                        job->clock->received);
+                }
+                job->payload.set_value(std::move(payload));
+            } catch (...) {
+                job->payload.set_exception(std::current_exception());
+            }
+        }
+    }
+
+    bounded_queue_t<frame_job_t> jobs_;
+    frame_assembler_t *assembler_;
+    const grid_codec_t *grid_codec_;
+    std::optional<symbol_geometry_t> geometry_;
+    stats_t *stats_;
+    std::vector<std::thread> threads_;
+};
+
+/// @brief Passes the payload on to `dst`, counting its bytes into `stats`.
+class counting_output_sink_t : public output_sink_t {
+  public:
+    counting_output_sink_t(output_sink_t &dst, stats_t &stats)
+        : dst_{dst}, stats_{stats} {}
+    void write(std::span<const std::uint8_t> data) override {
+        stats_.add_payload_bytes(data.size());
+        dst_.write(data);
+    }
+    void flush() override { dst_.flush(); }
+
+  private:
+    output_sink_t &dst_;
+    stats_t &stats_;
+};
+
 } // namespace
 
 in_memory_video_input_t::in_memory_video_input_t(std::span<std::uint8_t> video)
@@ -172,14 +731,21 @@ int64_t in_memory_video_input_t::seek(void *opaque, int64_t offset,
     return self->offset_;
 }
 
+auto in_memory_video_input_t::reopen() const
+    -> std::unique_ptr<video_input_t> {
+    return std::make_unique<in_memory_video_input_t>(video_);
+}
+
 auto in_memory_video_input_t::format_context() const -> AVFormatContext * {
     CHECK(format_context_) << "Attempted null pointer access on "
                               "`format_context_`. This should never happen.";
     return format_context_;
 }
 
-file_video_input_t::file_video_input_t(const std::filesystem::path &video_path)
-    : video_path_{video_path}, format_context_{nullptr, &avformat_close_input} {
+file_video_input_t::file_video_input_t(const std::filesystem::path &video_path,
+                                       const file_io_options_t &io_options)
+    : video_path_{video_path}, io_options_{io_options},
+      format_context_{nullptr, &avformat_close_input} {
     CHECK(!video_path.empty()) << "Video path is empty";
     if (!std::filesystem::exists(video_path)) {
         const auto error_message = fmt::format(
@@ -187,18 +753,27 @@ file_video_input_t::file_video_input_t(const std::filesystem::path &video_path)
         LOG(ERROR) << error_message;
         throw std::runtime_error{error_message};
     }
-    AVFormatContext *p = nullptr;
+    io_ = std::make_unique<file_io_t>(video_path, file_io_t::mode_t::read,
+                                      io_options);
+    AVFormatContext *p = avformat_alloc_context();
+    CHECK(p != nullptr) << "Could not allocate AVFormatContext";
+    p->pb = io_->io_context();
+    p->flags |= AVFMT_FLAG_CUSTOM_IO;
+    // The path still serves as a hint for probing the format.
     int err = avformat_open_input(&p, video_path.c_str(), nullptr, nullptr);
     if (err < 0) {
         LOG(ERROR) << "Could not open input file: " << libav_error(err);
         throw std::runtime_error{libav_error(err)};
     }
-    CHECK(p != nullptr) << "Could not allocate AVFormatContext";
     format_context_.reset(p);
 }
 
 file_video_input_t::~file_video_input_t() noexcept {}
 
+auto file_video_input_t::reopen() const -> std::unique_ptr<video_input_t> {
+    return std::make_unique<file_video_input_t>(video_path_, io_options_);
+}
+
 auto file_video_input_t::format_context() const -> AVFormatContext * {
     CHECK(format_context_)
         << "Attempted null pointer access on `format_context_`. "
@@ -206,98 +781,753 @@ auto file_video_input_t::format_context() const -> AVFormatContext * {
     return format_context_.get();
 }
 
+stream_video_input_t::stream_video_input_t(std::streambuf &video)
+    : video_{video} {
+    const bool seekable =
+        video_.pubseekoff(0, std::ios_base::cur, std::ios_base::in) !=
+        std::streampos{std::streamoff{-1}};
+    buffer_ = static_cast<std::uint8_t *>(av_malloc(buffer_size_));
+    CHECK(buffer_ != nullptr) << "Could not allocate libav buffer";
+    io_context_ =
+        avio_alloc_context(buffer_, buffer_size_, 0, this, &read_packet,
+                           nullptr, seekable ? &seek : nullptr);
+    CHECK(io_context_ != nullptr) << "Could not allocate libav io context";
+    format_context_ = avformat_alloc_context();
+    CHECK(format_context_ != nullptr) << "Could not allocate AVFormatContext";
+    format_context_->pb = io_context_;
+    format_context_->flags |= AVFMT_FLAG_CUSTOM_IO;
+    int err = avformat_open_input(&format_context_, "", nullptr, nullptr);
+    if (err < 0) {
+        LOG(ERROR) << "Could not open input stream"
+                   << (seekable ? "" : " (not seekable)") << ": "
+                   << libav_error(err);
+        throw std::runtime_error{libav_error(err)};
+    }
+}
+
+stream_video_input_t::~stream_video_input_t() noexcept {
+    av_free(io_context_->buffer);
+    avformat_close_input(&format_context_);
+    avio_context_free(&io_context_);
+}
+
+int stream_video_input_t::read_packet(void *opaque, std::uint8_t *buf,
+                                      int buf_size) {
+    CHECK(opaque != nullptr) << "Opaque pointer is null. It should point to a "
+                                "`stream_video_input_t`.";
+    auto *const self = static_cast<stream_video_input_t *>(opaque);
+    const std::streamsize bytes_read =
+        self->video_.sgetn(reinterpret_cast<char *>(buf), buf_size);
+    if (bytes_read <= 0) {
+        return AVERROR_EOF;
+    }
+    return static_cast<int>(bytes_read);
+}
+
+int64_t stream_video_input_t::seek(void *opaque, int64_t offset,
+                                   int whence) {
+    CHECK(opaque != nullptr) << "Opaque pointer is null. It should point to a "
+                                "`stream_video_input_t`.";
+    auto *const self = static_cast<stream_video_input_t *>(opaque);
+    std::streambuf &video = self->video_;
+    const std::streampos failed{std::streamoff{-1}};
+    std::ios_base::seekdir dir = std::ios_base::beg;
+    switch (whence & ~AVSEEK_FORCE) {
+    case SEEK_SET:
+        break;
+    case SEEK_CUR:
+        dir = std::ios_base::cur;
+        break;
+    case SEEK_END:
+        dir = std::ios_base::end;
+        break;
+    case AVSEEK_SIZE: {
+        const std::streampos position =
+            video.pubseekoff(0, std::ios_base::cur, std::ios_base::in);
+        const std::streampos end =
+            video.pubseekoff(0, std::ios_base::end, std::ios_base::in);
+        if (position == failed || end == failed ||
+            video.pubseekpos(position, std::ios_base::in) == failed) {
+            return AVERROR(ENOSYS);
+        }
+        return static_cast<int64_t>(end);
+    }
+    default:
+        LOG(ERROR) << "Invalid whence value: " << whence;
+        return AVERROR(EINVAL);
+    }
+    const std::streampos position = video.pubseekoff(offset, dir,
+                                                     std::ios_base::in);
+    if (position == failed) {
+        LOG(ERROR) << "Could not seek stream to offset " << offset
+                   << ", whence " << whence;
+        return AVERROR(EINVAL);
+    }
+    return static_cast<int64_t>(position);
+}
+
+auto stream_video_input_t::format_context() const -> AVFormatContext * {
+    CHECK(format_context_) << "Attempted null pointer access on "
+                              "`format_context_`. This should never happen.";
+    return format_context_;
+}
+
+fd_video_input_t::fd_video_input_t(const int fd) : input_{fd} {
+    auto *const buffer = static_cast<std::uint8_t *>(av_malloc(buffer_size_));
+    CHECK(buffer != nullptr) << "Could not allocate libav buffer";
+    io_context_ = avio_alloc_context(buffer, buffer_size_, 0, this,
+                                     &read_packet, nullptr, nullptr);
+    CHECK(io_context_ != nullptr) << "Could not allocate libav io context";
+    format_context_ = avformat_alloc_context();
+    CHECK(format_context_ != nullptr) << "Could not allocate AVFormatContext";
+    format_context_->pb = io_context_;
+    format_context_->flags |= AVFMT_FLAG_CUSTOM_IO;
+    int err = avformat_open_input(&format_context_, "", nullptr, nullptr);
+    if (err < 0) {
+        LOG(ERROR) << "Could not open input from file descriptor " << fd
+                   << ": " << libav_error(err);
+        av_free(io_context_->buffer);
+        avio_context_free(&io_context_);
+        throw std::runtime_error{libav_error(err)};
+    }
+}
+
+fd_video_input_t::~fd_video_input_t() noexcept {
+    av_free(io_context_->buffer);
+    avformat_close_input(&format_context_);
+    avio_context_free(&io_context_);
+}
+
+int fd_video_input_t::read_packet(void *opaque, std::uint8_t *buf,
+                                  int buf_size) {
+    CHECK(opaque != nullptr) << "Opaque pointer is null. It should point to a "
+                                "`fd_video_input_t`.";
+    auto *const self = static_cast<fd_video_input_t *>(opaque);
+    std::size_t bytes_read = 0;
+    try {
+        bytes_read = self->input_.read(
+            {buf, static_cast<std::size_t>(std::max(buf_size, 0))});
+    } catch (const std::exception &) {
+        // Logged by `read_ahead_t`
+        return AVERROR(EIO);
+    }
+    if (bytes_read == 0) {
+        return AVERROR_EOF;
+    }
+    return static_cast<int>(bytes_read);
+}
+
+auto fd_video_input_t::format_context() const -> AVFormatContext * {
+    CHECK(format_context_) << "Attempted null pointer access on "
+                              "`format_context_`. This should never happen.";
+    return format_context_;
+}
+
 void decoder_t::decode(std::vector<std::uint8_t> &dst,
                        std::unique_ptr<video_input_t> src) {
-    int err = 0;
+    const auto started = std::chrono::steady_clock::now();
+    vector_output_sink_t sink{dst};
+    // A vector takes chunks straight into place, in any order.
+    std::optional<frame_assembler_t> assembler;
+    if (framing_ == framing_t::sequenced) {
+        dst.clear();
+        assembler.emplace(dst);
+    }
+    const std::size_t initial_size = dst.size();
+    decode(sink, assembler ? &*assembler : nullptr, std::move(src));
+    if (stats_) {
+        stats_->add_payload_bytes(dst.size() - initial_size);
+        stats_->add_elapsed(std::chrono::steady_clock::now() - started);
+    }
+}
+
+void decoder_t::decode(output_sink_t &dst,
+                       std::unique_ptr<video_input_t> src) {
+    const auto started = std::chrono::steady_clock::now();
+    std::optional<counting_output_sink_t> counting;
+    if (stats_) {
+        counting.emplace(dst, *stats_);
+    }
+    output_sink_t &out = counting ? *counting : dst;
+    std::optional<frame_assembler_t> assembler;
+    if (framing_ == framing_t::sequenced) {
+        assembler.emplace(out);
+    }
+    decode(out, assembler ? &*assembler : nullptr, std::move(src));
+    out.flush();
+    if (stats_) {
+        stats_->add_elapsed(std::chrono::steady_clock::now() - started);
+    }
+}
+
+void decoder_t::decode(output_sink_t &dst, frame_assembler_t *assembler,
+                       std::unique_ptr<video_input_t> src) {
     CHECK(src) << "Video input IO context must be usable";
+    if (shards_ > 1 && decode_sharded(dst, assembler, *src)) {
+        return;
+    }
+    stats_t *const stats = stats_.get();
     AVFormatContext *format_context = src->format_context();
-    err = avformat_find_stream_info(format_context, nullptr);
+    const auto [codec_context, video_stream_idx] =
+        open_video_stream(format_context, codec_threads_, codec_threading_);
+    const int tile_columns = static_cast<int>(tile_columns_);
+    const int tile_rows = static_cast<int>(tile_rows_);
+    const int num_tiles = tile_columns * tile_rows;
+    std::optional<grid_codec_t> grid_codec;
+    if (grid_layout_) {
+        grid_codec.emplace(*grid_layout_);
+    }
+    if (num_workers_ == 0) {
+        std::unique_ptr<qr_code_decoder_t> qr_code_decoder{nullptr};
+        luma_reader_t luma_reader{};
+        std::vector<std::uint8_t> luma;
+        const payload_sink_t sink = [&](std::span<const std::uint8_t> data) {
+            if (assembler != nullptr) {
+                assembler->add(data);
+            } else {
+                dst.write(data);
+            }
+        };
+        for_each_frame(
+            format_context, codec_context.get(), video_stream_idx, stats,
+            [&](AVFrame *frame) {
+                const auto received = std::chrono::steady_clock::now();
+                if (grid_codec) {
+                    decode_grid_frame(sink, *grid_codec, luma_reader, luma,
+                                      frame, stats);
+                } else {
+                    const int num_symbols =
+                        num_tiles * symbol_planes(frame, plane_multiplexing_);
+                    for (int symbol = 0; symbol < num_symbols; ++symbol) {
+                        decode_frame(sink, qr_code_decoder, luma_reader, frame,
+                                     symbol_rect(frame, tile_columns,
+                                                 tile_rows,
+                                                 plane_multiplexing_, symbol),
+                                     geometry_, stats, assembler != nullptr);
+                    }
+                }
+                if (stats != nullptr) {
+                    stats->record_frame_latency(
+                        std::chrono::steady_clock::now() - received);
+                }
+                return true;
+            });
+        if (assembler != nullptr) {
+            finish_assembly(*assembler, stats);
+        }
+        return;
+    }
+    // Demuxing and libav decoding stay on this thread; QR detection, the
+    // dominant cost, is spread across the workers, one job per tile (and
+    // plane).
+    // Payloads are appended in frame and tile order by waiting on the oldest
+    // outstanding job first, which also bounds the number of jobs in flight.
+    frame_workers_t workers{num_workers_, assembler,
+                            grid_codec ? &*grid_codec : nullptr, geometry_,
+                            stats};
+    std::deque<std::future<std::vector<std::uint8_t>>> pending;
+    const auto append_oldest = [&] {
+        const auto payload = pending.front().get();
+        pending.pop_front();
+        dst.write(payload);
+    };
+    for_each_frame(format_context, codec_context.get(), video_stream_idx,
+                   stats, [&](AVFrame *frame) {
+                       libav_frame_ptr_t owned{av_frame_alloc(),
+                                               av_frame_free};
+                       CHECK(owned) << "Could not allocate frame";
+                       av_frame_move_ref(owned.get(), frame);
+                       // Shared by the frame's tile jobs
+                       const std::shared_ptr<const AVFrame> shared{
+                           std::move(owned)};
+                       const int num_symbols =
+                           num_tiles *
+                           symbol_planes(shared.get(), plane_multiplexing_);
+                       std::shared_ptr<frame_clock_t> clock;
+                       if (stats != nullptr) {
+                           clock = std::make_shared<frame_clock_t>(
+                               std::chrono::steady_clock::now(), num_symbols);
+                       }
+                       for (int symbol = 0; symbol < num_symbols; ++symbol) {
+                           frame_job_t job{shared,
+                                           symbol_rect(shared.get(),
+                                                       tile_columns, tile_rows,
+                                                       plane_multiplexing_,
+                                                       symbol),
+                                           {},
+                                           clock};
+                           pending.emplace_back(job.payload.get_future());
+                           workers.submit(std::move(job));
+                           if (pending.size() > max_frames_in_flight_) {
+                               append_oldest();
+                           }
+                       }
+                       return true;
+                   });
+    while (!pending.empty()) {
+        append_oldest();
+    }
+    if (assembler != nullptr) {
+        finish_assembly(*assembler, stats);
+    }
+}
+
+auto decoder_t::decode_sharded(output_sink_t &dst,
+                               frame_assembler_t *assembler,
+                               const video_input_t &src) -> bool {
+    stats_t *const stats = stats_.get();
+    AVFormatContext *format_context = src.format_context();
+    int err = avformat_find_stream_info(format_context, nullptr);
     if (err < 0) {
         LOG(ERROR) << "Could not find stream info:" << libav_error(err);
         throw std::runtime_error{
             fmt::format("Could not find stream info: {}", libav_error(err))};
     }
-    // find video stream index
-    const auto [codec, codec_params, video_stream_idx] =
-        find_video_stream(format_context);
-    // allocate codec context
-    libav_ptr_t<AVCodecContext, avcodec_free_context> codec_context{
-        avcodec_alloc_context3(codec), avcodec_free_context};
-    CHECK(codec_context) << "Could not allocate codec context";
-    err = avcodec_parameters_to_context(codec_context.get(), codec_params);
-    if (err < 0) {
-        LOG(ERROR) << "Could not copy codec params to codec context:"
-                   << libav_error(err);
-        throw std::runtime_error{
-            fmt::format("Could not copy codec params to codec context: {}",
-                        libav_error(err))};
+    const int video_stream_idx = std::get<2>(find_video_stream(format_context));
+    const std::vector<std::int64_t> keyframes =
+        keyframe_timestamps(format_context, video_stream_idx);
+    if (keyframes.size() < 2) {
+        LOG(INFO) << "Container index lists " << keyframes.size()
+                  << " keyframes, decoding without shards";
+        return false;
     }
-    err = avcodec_open2(codec_context.get(), codec, nullptr);
-    if (err < 0) {
-        LOG(ERROR) << "Could not open codec:" << libav_error(err);
-        throw std::runtime_error{
-            fmt::format("Could not open codec: {}", libav_error(err))};
+    // Segment `i` is GOPs `first_gop[i]` to `first_gop[i + 1]`, exclusive.
+    // Several segments per thread even out GOPs that take longer than others;
+    // a cap on their length bounds the payloads waiting to be written.
+    constexpr std::size_t max_gops_per_segment = 16;
+    const std::size_t num_segments = std::min(
+        keyframes.size(),
+        std::max(shards_ * 4, keyframes.size() / max_gops_per_segment));
+    std::vector<std::size_t> first_gop(num_segments + 1);
+    for (std::size_t i = 0; i <= num_segments; ++i) {
+        first_gop[i] = i * keyframes.size() / num_segments;
     }
-    libav_ptr_t<AVFrame, av_frame_free> frame{av_frame_alloc(), av_frame_free};
-    CHECK(frame) << "Could not allocate frame";
-    libav_ptr_t<AVPacket, av_packet_free> packet{av_packet_alloc(),
-                                                 av_packet_free};
-    CHECK(packet) << "Could not allocate packet";
-    std::unique_ptr<qr_code_decoder_t> qr_code_decoder{nullptr};
-    image_buf_t img{};
-    int frame_counter = 0;
-    err = 0;
-    while (err >= 0) {
-        err = av_read_frame(format_context, packet.get());
-        if (err >= 0 && packet->stream_index != video_stream_idx) {
-            continue;
+    std::vector<std::unique_ptr<video_input_t>> inputs;
+    for (std::size_t i = 0; i < std::min(shards_, num_segments); ++i) {
+        auto input = src.reopen();
+        if (!input) {
+            LOG(INFO) << "Video input cannot be reopened, decoding without "
+                         "shards";
+            return false;
         }
-        if (err < 0) {
-            // send flush packet
-            err = avcodec_send_packet(codec_context.get(), nullptr);
-        } else {
-            if (packet->pts ==
-                AV_NOPTS_VALUE) { // no timestamp value available for this frame
-                packet->pts = packet->dts = frame_counter;
+        inputs.push_back(std::move(input));
+    }
+
+    const int tile_columns = static_cast<int>(tile_columns_);
+    const int tile_rows = static_cast<int>(tile_rows_);
+    const int num_tiles = tile_columns * tile_rows;
+    std::optional<grid_codec_t> grid_codec;
+    if (grid_layout_) {
+        grid_codec.emplace(*grid_layout_);
+    }
+    // Payloads of each segment, unless the assembler takes them, written out
+    // and released as soon as the segments before them have been. Threads
+    // do not start a segment more than `window` segments past the oldest one
+    // not written, which bounds the payloads held back.
+    std::vector<std::vector<std::uint8_t>> payloads(num_segments);
+    std::vector<bool> done(num_segments, false);
+    std::size_t written = 0;
+    const std::size_t window = inputs.size() * 2;
+    std::mutex mutex;
+    std::condition_variable progress;
+    std::atomic<std::size_t> next_segment{0};
+    std::atomic<bool> failed{false};
+    std::vector<std::exception_ptr> errors(inputs.size());
+    const auto wait_for_window = [&](const std::size_t segment) {
+        std::unique_lock lock{mutex};
+        progress.wait(lock,
+                      [&] { return segment < written + window || failed; });
+    };
+    const auto finish_segment = [&](const std::size_t segment) {
+        std::lock_guard lock{mutex};
+        done[segment] = true;
+        for (; written < num_segments && done[written]; ++written) {
+            dst.write(payloads[written]);
+            std::vector<std::uint8_t>{}.swap(payloads[written]);
+        }
+        progress.notify_all();
+    };
+    const auto run_shard = [&](video_input_t &input,
+                               std::exception_ptr &error) {
+        try {
+            AVFormatContext *const shard_format_context =
+                input.format_context();
+            const auto [codec_context, shard_stream_idx] = open_video_stream(
+                shard_format_context, codec_threads_, codec_threading_);
+            std::unique_ptr<qr_code_decoder_t> qr_code_decoder{nullptr};
+            luma_reader_t luma_reader{};
+            std::vector<std::uint8_t> luma;
+            for (std::size_t segment = next_segment++;
+                 segment < num_segments && !failed;
+                 segment = next_segment++) {
+                wait_for_window(segment);
+                if (failed) {
+                    break;
+                }
+                std::vector<std::uint8_t> &payload = payloads[segment];
+                const payload_sink_t sink =
+                    [&](std::span<const std::uint8_t> data) {
+                        if (assembler != nullptr) {
+                            assembler->add(data);
+                        } else {
+                            payload.insert(payload.end(), data.begin(),
+                                           data.end());
+                        }
+                    };
+                seek_to_timestamp(shard_format_context, codec_context.get(),
+                                  shard_stream_idx,
+                                  keyframes[first_gop[segment]]);
+                // Frames come out in presentation order. Anything before
+                // the segment's first keyframe belongs to the previous
+                // segment; the keyframe of the next segment ends this one.
+                const std::size_t num_gops =
+                    first_gop[segment + 1] - first_gop[segment];
+                const bool last = segment + 1 == num_segments;
+                std::size_t gops_seen = 0;
+                for_each_frame(
+                    shard_format_context, codec_context.get(),
+                    shard_stream_idx, stats, [&](AVFrame *frame) {
+                        const auto received = std::chrono::steady_clock::now();
+                        if (is_keyframe(frame)) {
+                            ++gops_seen;
+                        }
+                        if (gops_seen == 0) {
+                            return true;
+                        }
+                        if (gops_seen > num_gops && !last) {
+                            return false;
+                        }
+                        if (grid_codec) {
+                            decode_grid_frame(sink, *grid_codec, luma_reader,
+                                              luma, frame, stats);
+                        } else {
+                            const int num_symbols =
+                                num_tiles *
+                                symbol_planes(frame, plane_multiplexing_);
+                            for (int symbol = 0; symbol < num_symbols;
+                                 ++symbol) {
+                                decode_frame(
+                                    sink, qr_code_decoder, luma_reader, frame,
+                                    symbol_rect(frame, tile_columns, tile_rows,
+                                                plane_multiplexing_, symbol),
+                                    geometry_, stats, assembler != nullptr);
+                            }
+                        }
+                        if (stats != nullptr) {
+                            stats->record_frame_latency(
+                                std::chrono::steady_clock::now() - received);
+                        }
+                        return true;
+                    });
+                finish_segment(segment);
             }
-            err = avcodec_send_packet(codec_context.get(), packet.get());
+        } catch (...) {
+            error = std::current_exception();
+            std::lock_guard lock{mutex};
+            failed = true;
+            progress.notify_all();
         }
-        av_packet_unref(packet.get());
-        if (err < 0) {
-            LOG(ERROR) << "Error sending packet to decoder:"
-                       << libav_error(err);
-            throw std::runtime_error{fmt::format(
-                "Error sending packet to decoder: {}", libav_error(err))};
+    };
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < inputs.size(); ++i) {
+        threads.emplace_back(run_shard, std::ref(*inputs[i]),
+                             std::ref(errors[i]));
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    for (const auto &error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
         }
-        while (err >= 0) {
-            // process decoded frame
-            err = avcodec_receive_frame(codec_context.get(), frame.get());
-            if (err == AVERROR_EOF) {
-                return;
-            } else if (err == AVERROR(EAGAIN)) {
-                DLOG(INFO) << "EAGAIN";
-                err = 0;
-                break;
-            } else if (err < 0) {
-                LOG(ERROR) << "Error during decoding:" << libav_error(err);
-                throw std::runtime_error{
-                    fmt::format("Error during decoding: {}", libav_error(err))};
-            } else if (err >= 0) {
-                DLOG(INFO) << "Received frame " << frame_counter
-                           << " from decoder";
-                get_frame_pixels(img, frame.get());
-                av_frame_unref(frame.get());
-                if (!qr_code_decoder) {
-                    qr_code_decoder = std::make_unique<qr_code_decoder_t>(
-                        img.width, img.height);
-                }
-                qr_code_decoder->decode(dst, img.buf);
-            } else {
-                LOG(FATAL) << "should be unreachable!";
+    }
+    if (assembler != nullptr) {
+        finish_assembly(*assembler, stats);
+    }
+    return true;
+}
+
+void decoder_t::decode_range(std::vector<std::uint8_t> &dst,
+                             std::unique_ptr<video_input_t> src,
+                             const std::uint64_t offset,
+                             const std::size_t length) {
+    CHECK(src) << "Video input IO context must be usable";
+    CHECK(framing_ == framing_t::sequenced)
+        << "Byte ranges can only be decoded from sequenced videos";
+    const auto started = std::chrono::steady_clock::now();
+    stats_t *const stats = stats_.get();
+    AVFormatContext *format_context = src->format_context();
+    const auto [codec_context, video_stream_idx] =
+        open_video_stream(format_context, codec_threads_, codec_threading_);
+    const int tile_columns = static_cast<int>(tile_columns_);
+    const int tile_rows = static_cast<int>(tile_rows_);
+    const int num_tiles = tile_columns * tile_rows;
+    std::unique_ptr<qr_code_decoder_t> qr_code_decoder{nullptr};
+    luma_reader_t luma_reader{};
+
+    // The manifest is the first QR code of the first frame, and with an
+    // erasure code follows the parity chunks of every stripe.
+    std::optional<manifest_t> manifest;
+    int num_symbols = num_tiles;
+    for_each_frame(
+        format_context, codec_context.get(), video_stream_idx, stats,
+        [&](AVFrame *frame) {
+            num_symbols =
+                num_tiles * symbol_planes(frame, plane_multiplexing_);
+            for (int symbol = 0; symbol < num_symbols && !manifest;
+                 ++symbol) {
+                decode_frame(
+                    [&](std::span<const std::uint8_t> data) {
+                        const auto parsed = framing::parse(data);
+                        if (const auto *found =
+                                std::get_if<manifest_t>(&parsed)) {
+                            manifest = *found;
+                        }
+                    },
+                    qr_code_decoder, luma_reader, frame,
+                    symbol_rect(frame, tile_columns, tile_rows,
+                                plane_multiplexing_, symbol),
+                    geometry_, stats, true);
             }
-            frame_counter++;
+            return !manifest;
+        });
+    if (!manifest) {
+        LOG(ERROR) << "No manifest found";
+        throw std::runtime_error{"No manifest found"};
+    }
+    if (offset > manifest->total_length ||
+        length > manifest->total_length - offset) {
+        LOG(ERROR) << "Range of " << length << " bytes at " << offset
+                   << " is outside the " << manifest->total_length
+                   << " byte payload";
+        throw std::out_of_range{fmt::format(
+            "Range of {} bytes at {} is outside the {} byte payload", length,
+            offset, manifest->total_length)};
+    }
+    dst.resize(length);
+    if (length == 0) {
+        return;
+    }
+
+    const auto first =
+        static_cast<std::uint32_t>(offset / manifest->chunk_size);
+    const auto last = static_cast<std::uint32_t>((offset + length - 1) /
+                                                 manifest->chunk_size);
+    std::vector<bool> received(last - first + 1, false);
+    std::size_t remaining = received.size();
+    // Lowest sequence number in the frame being decoded; manifests and
+    // parity chunks do not count.
+    std::int64_t lowest = 0;
+    const payload_sink_t sink = [&](std::span<const std::uint8_t> data) {
+        const auto parsed = framing::parse(data);
+        const auto *chunk = std::get_if<chunk_t>(&parsed);
+        if (chunk == nullptr) {
+            return;
+        }
+        const std::uint32_t sequence_number = chunk->sequence_number;
+        lowest = std::min<std::int64_t>(lowest, sequence_number);
+        if (sequence_number < first || sequence_number > last ||
+            received[sequence_number - first]) {
+            return;
+        }
+        if (chunk->data.size() != manifest->chunk_length(sequence_number)) {
+            LOG(ERROR) << "Chunk " << sequence_number << " is "
+                       << chunk->data.size() << " bytes instead of "
+                       << manifest->chunk_length(sequence_number);
+            throw std::runtime_error{fmt::format(
+                "Chunk {} is {} bytes instead of {}", sequence_number,
+                chunk->data.size(), manifest->chunk_length(sequence_number))};
         }
+        // Copy the part of the chunk that overlaps the range.
+        const std::uint64_t chunk_offset =
+            manifest->chunk_offset(sequence_number);
+        const std::uint64_t begin = std::max(chunk_offset, offset);
+        const std::uint64_t end =
+            std::min(chunk_offset + chunk->data.size(), offset + length);
+        std::copy(chunk->data.begin() + (begin - chunk_offset),
+                  chunk->data.begin() + (end - chunk_offset),
+                  dst.begin() + (begin - offset));
+        received[sequence_number - first] = true;
+        --remaining;
+    };
+    // Decodes from the keyframe before `frame_number` until every chunk in
+    // the range has been seen. Returns false, having decoded just one frame,
+    // if that keyframe turned out to be past the first chunk.
+    const auto decode_from = [&](const std::int64_t frame_number) {
+        seek_to_frame(format_context, codec_context.get(), video_stream_idx,
+                      frame_number);
+        bool first_frame = true;
+        bool overshot = false;
+        for_each_frame(format_context, codec_context.get(), video_stream_idx,
+                       stats, [&](AVFrame *frame) {
+                           const auto received =
+                               std::chrono::steady_clock::now();
+                           lowest = std::numeric_limits<std::int64_t>::max();
+                           for (int symbol = 0; symbol < num_symbols;
+                                ++symbol) {
+                               decode_frame(
+                                   sink, qr_code_decoder, luma_reader, frame,
+                                   symbol_rect(frame, tile_columns, tile_rows,
+                                               plane_multiplexing_, symbol),
+                                   geometry_, stats, true);
+                           }
+                           if (stats != nullptr) {
+                               stats->record_frame_latency(
+                                   std::chrono::steady_clock::now() -
+                                   received);
+                           }
+                           // Frames without data chunks tell nothing
+                           if (lowest !=
+                               std::numeric_limits<std::int64_t>::max()) {
+                               overshot = first_frame && lowest > first;
+                               first_frame = false;
+                           }
+                           return remaining > 0 && !overshot;
+                       });
+        return !overshot;
+    };
+    // QR code `i` of the video, counting the manifest, is in frame
+    // `i / num_symbols`; chunk `n` is QR code `n + 1`, plus the parity
+    // chunks and repeated manifests sent before it.
+    if (!decode_from(static_cast<std::int64_t>(
+                         first + 1 +
+                         manifest->erasure.overhead_before(first)) /
+                     num_symbols)) {
+        LOG(WARNING) << "Seek landed past chunk " << first
+                     << ", decoding from the start";
+        decode_from(0);
+    }
+    if (remaining > 0) {
+        LOG(ERROR) << remaining << " of " << received.size()
+                   << " chunks in range missing";
+        throw std::runtime_error{fmt::format(
+            "{} of {} chunks in range missing", remaining, received.size())};
+    }
+    if (stats != nullptr) {
+        stats->add_payload_bytes(length);
+        stats->add_elapsed(std::chrono::steady_clock::now() - started);
+    }
+}
+
+auto decoder_t::builder_t::set_num_workers(const size_t num_workers) noexcept
+    -> builder_t & {
+    num_workers_ = num_workers;
+    return *this;
+}
+
+auto decoder_t::builder_t::set_max_frames_in_flight(
+    const size_t max_frames_in_flight) noexcept -> builder_t & {
+    max_frames_in_flight_ = max_frames_in_flight;
+    return *this;
+}
+
+auto decoder_t::builder_t::set_tiles(const size_t columns,
+                                     const size_t rows) noexcept
+    -> builder_t & {
+    tile_columns_ = columns;
+    tile_rows_ = rows;
+    return *this;
+}
+
+auto decoder_t::builder_t::set_framing(const framing_t framing) noexcept
+    -> builder_t & {
+    framing_ = framing;
+    return *this;
+}
+
+auto decoder_t::builder_t::set_plane_multiplexing(const bool enabled) noexcept
+    -> builder_t & {
+    plane_multiplexing_ = enabled;
+    return *this;
+}
+
+auto decoder_t::builder_t::set_codec_threads(
+    const size_t threads, const codec_threading_t threading) noexcept
+    -> builder_t & {
+    codec_threads_ = threads;
+    codec_threading_ = threading;
+    return *this;
+}
+
+auto decoder_t::builder_t::set_shards(const size_t shards) noexcept
+    -> builder_t & {
+    shards_ = shards;
+    return *this;
+}
+
+auto decoder_t::builder_t::set_stats(std::shared_ptr<stats_t> stats) noexcept
+    -> builder_t & {
+    stats_ = std::move(stats);
+    return *this;
+}
+
+auto decoder_t::builder_t::set_symbol_geometry(
+    const size_t scale, const size_t border_size) noexcept -> builder_t & {
+    geometry_ = symbol_geometry_t{static_cast<int>(scale),
+                                  static_cast<int>(border_size)};
+    return *this;
+}
+
+auto decoder_t::builder_t::set_grid(const grid_layout_t &layout) noexcept
+    -> builder_t & {
+    grid_layout_ = layout;
+    return *this;
+}
+
+auto decoder_t::builder_t::build() const -> decoder_t {
+    CHECK_GT(tile_columns_, 0UL);
+    CHECK_GT(tile_rows_, 0UL);
+    if (grid_layout_) {
+        CHECK(tile_columns_ == 1 && tile_rows_ == 1)
+            << "The grid symbology has no tiles";
+        CHECK(framing_ == framing_t::none)
+            << "The grid symbology has no framing";
+        CHECK(!plane_multiplexing_) << "The grid symbology uses the luma only";
+        CHECK(!geometry_) << "The grid symbology has no QR codes";
+    }
+    if (geometry_) {
+        CHECK_GT(geometry_->scale, 0);
     }
+    const size_t max_frames_in_flight = max_frames_in_flight_ > 0
+                                            ? max_frames_in_flight_
+                                            : std::max(num_workers_ * 4, 1UL);
+    return decoder_t{num_workers_,
+                     max_frames_in_flight,
+                     tile_columns_,
+                     tile_rows_,
+                     framing_,
+                     grid_layout_,
+                     plane_multiplexing_,
+                     codec_threads_,
+                     codec_threading_,
+                     shards_,
+                     stats_,
+                     geometry_};
+}
+
+void decode(std::ostream &dst, const std::istream &video) {
+    CHECK(video.rdbuf() != nullptr) << "Input stream has no buffer";
+    ostream_output_sink_t sink{dst};
+    decoder_t::builder()
+        .set_num_workers(std::thread::hardware_concurrency())
+        .build()
+        .decode(sink, std::make_unique<stream_video_input_t>(*video.rdbuf()));
+}
+
+void decode(std::vector<std::uint8_t> &dst, const std::istream &video) {
+    CHECK(video.rdbuf() != nullptr) << "Input stream has no buffer";
+    decoder_t::builder()
+        .set_num_workers(std::thread::hardware_concurrency())
+        .build()
+        .decode(dst, std::make_unique<stream_video_input_t>(*video.rdbuf()));
+}
+
+void decode(std::vector<std::uint8_t> &dst,
+            const std::filesystem::path video_path) {
+    decoder_t::builder()
+        .set_num_workers(std::thread::hardware_concurrency())
+        .build()
+        .decode(dst, std::make_unique<file_video_input_t>(video_path));
 }
 
 template <typename OutputIt>
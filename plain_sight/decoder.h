@@ -1,5 +1,12 @@
 #ifndef _INCLUDE_NET_ZELCON_PLAIN_SIGHT_DECODER_H_
 
+#include "plain_sight/file_io.h"
+#include "plain_sight/framing.h"
+#include "plain_sight/grid_codec.h"
+#include "plain_sight/output_sink.h"
+#include "plain_sight/qr_codes.h"
+#include "plain_sight/read_ahead.h"
+#include "plain_sight/stats.h"
 #include "plain_sight/util.h"
 #include <concepts>
 #include <cstdint>
@@ -8,7 +15,9 @@
 #include <istream>
 #include <iterator>
 #include <memory>
+#include <optional>
 #include <span>
+#include <streambuf>
 #include <vector>
 
 extern "C" {
@@ -20,6 +29,12 @@ extern "C" {
 
 namespace net_zelcon::plain_sight {
 
+/// @brief Decodes the video read from `video` and writes the payload to
+/// `dst` as it is decoded, holding only a few frames' worth of it in memory.
+/// A stream that cannot seek must hold a container that can be demuxed front
+/// to back, e.g., fragmented MP4.
+/// @throws std::runtime_error if the video cannot be decoded or `dst`
+/// cannot be written
 void decode(std::ostream &dst, const std::istream &video);
 
 void decode(std::vector<std::uint8_t> &dst, const std::istream &video);
@@ -31,6 +46,12 @@ class video_input_t {
   public:
     virtual ~video_input_t() noexcept {}
     virtual auto format_context() const -> AVFormatContext * = 0;
+    /// @brief Another, independent input of the same video, e.g., for
+    /// decoding parts of it on other threads; null if the video cannot be
+    /// read twice.
+    virtual auto reopen() const -> std::unique_ptr<video_input_t> {
+        return nullptr;
+    }
 };
 
 class in_memory_video_input_t : public video_input_t {
@@ -38,6 +59,7 @@ class in_memory_video_input_t : public video_input_t {
     explicit in_memory_video_input_t(std::span<std::uint8_t> video);
     ~in_memory_video_input_t() noexcept override;
     auto format_context() const -> AVFormatContext * override;
+    auto reopen() const -> std::unique_ptr<video_input_t> override;
 
   private:
     const std::span<std::uint8_t> video_;
@@ -66,21 +88,244 @@ class in_memory_video_input_t : public video_input_t {
     static int64_t seek(void *opaque, int64_t offset, int whence);
 };
 
+/// @brief A video file, read through `file_io_t` in large blocks requested
+/// ahead of the demuxer.
 class file_video_input_t : public video_input_t {
   public:
-    explicit file_video_input_t(const std::filesystem::path &video_path);
+    explicit file_video_input_t(const std::filesystem::path &video_path,
+                                const file_io_options_t &io_options = {});
     ~file_video_input_t() noexcept override;
     auto format_context() const -> AVFormatContext * override;
+    auto reopen() const -> std::unique_ptr<video_input_t> override;
 
   private:
     std::filesystem::path video_path_;
+    file_io_options_t io_options_;
+    // Outlives the format context, which reads through it
+    std::unique_ptr<file_io_t> io_;
     libav_ptr_t<AVFormatContext, avformat_close_input> format_context_;
 };
 
+/// @brief A video read from a stream buffer, e.g., the `rdbuf()` of a file
+/// stream or of `std::cin`. Seeks if the buffer can; see `decode()` for
+/// streams that cannot.
+class stream_video_input_t : public video_input_t {
+  public:
+    explicit stream_video_input_t(std::streambuf &video);
+    ~stream_video_input_t() noexcept override;
+    auto format_context() const -> AVFormatContext * override;
+
+  private:
+    std::streambuf &video_;
+    AVIOContext *io_context_;
+    std::uint8_t *buffer_;
+    constexpr static std::size_t buffer_size_ = 1 << 16;
+    AVFormatContext *format_context_;
+
+    /// @brief Callback for `avio_alloc_context`, reading from `video_`.
+    static int read_packet(void *opaque, std::uint8_t *buf, int buf_size);
+
+    /// @brief Callback for `avio_alloc_context`, seeking `video_`; only
+    /// installed if the buffer could tell its position.
+    static int64_t seek(void *opaque, int64_t offset, int whence);
+};
+
+/// @brief A video read from a file descriptor that need not seek, e.g.,
+/// stdin or a pipe, through a `read_ahead_t`, so that reading the input
+/// overlaps decoding. Like any stream that cannot seek, it must hold a
+/// container that can be demuxed front to back, e.g., fragmented MP4. The
+/// descriptor is not closed.
+class fd_video_input_t : public video_input_t {
+  public:
+    explicit fd_video_input_t(int fd);
+    ~fd_video_input_t() noexcept override;
+    auto format_context() const -> AVFormatContext * override;
+
+  private:
+    read_ahead_t input_;
+    AVIOContext *io_context_;
+    constexpr static std::size_t buffer_size_ = 1 << 16;
+    AVFormatContext *format_context_;
+
+    /// @brief Callback for `avio_alloc_context`, reading from `input_`.
+    static int read_packet(void *opaque, std::uint8_t *buf, int buf_size);
+};
+
 class decoder_t {
   public:
+    class builder_t {
+      public:
+        /// @brief Number of threads running QR detection. Zero decodes every
+        /// frame on the thread calling `decode()`.
+        auto set_num_workers(const size_t num_workers) noexcept -> builder_t &;
+
+        /// @brief Maximum number of decoded frames (tiles, with a tile grid)
+        /// waiting for, or undergoing, QR detection. Zero picks a multiple of
+        /// the number of workers.
+        auto
+        set_max_frames_in_flight(const size_t max_frames_in_flight) noexcept
+            -> builder_t &;
+
+        /// @brief Threads of the libav decoder, zero for one per core, and
+        /// the kinds of threading it may use; defaults to one thread per core
+        /// and any kind. Decoded frames are reference-counted buffers from
+        /// the decoder's own pools, passed to the workers without copies.
+        auto set_codec_threads(const size_t threads,
+                               const codec_threading_t threading =
+                                   codec_threading_t::any) noexcept
+            -> builder_t &;
+
+        /// @brief Decode the video in keyframe-aligned segments on
+        /// `shards` threads, each with its own input (see
+        /// `video_input_t::reopen()`), libav decoder and `quirc` instance,
+        /// and concatenate the results in order. Segments are runs of GOPs
+        /// found in the container's index. Takes the place of the workers;
+        /// videos without an index, or inputs that cannot be reopened, are
+        /// decoded as if `shards` were zero. Zero or one disables sharding.
+        auto set_shards(const size_t shards) noexcept -> builder_t &;
+
+        /// @brief Split every frame into a grid of equal tiles, each holding
+        /// one QR code, as written by `encoder_t::builder_t::set_tiles()`.
+        /// Tiles are decoded independently, in parallel when there are
+        /// workers. Without a grid, all QR codes found in a frame are
+        /// decoded by one `quirc` instance, in row-by-row order; quirc's
+        /// limit on finder pattern candidates makes that unreliable beyond a
+        /// few large QR codes per frame.
+        auto set_tiles(const size_t columns, const size_t rows) noexcept
+            -> builder_t &;
+
+        /// @brief Framing the video was encoded with. With
+        /// `framing_t::sequenced`, `decode()` replaces the contents of `dst`
+        /// with the payload, allocated once from the manifest; chunks are
+        /// written into place by the workers as they are decoded, and
+        /// missing chunks are reported as errors.
+        auto set_framing(const framing_t framing) noexcept -> builder_t &;
+
+        /// @brief Read QR codes from every color plane, tile by tile in each
+        /// plane in turn, as written by
+        /// `encoder_t::builder_t::set_plane_multiplexing()`. The frames'
+        /// pixel format must have separate full resolution 8-bit planes,
+        /// e.g., YUV444P.
+        auto set_plane_multiplexing(const bool enabled) noexcept
+            -> builder_t &;
+
+        /// @brief Decode a video of the grid symbology written with
+        /// `encoder_t::builder_t::set_grid()` and the same `layout`. Cells
+        /// are sampled where the layout puts them; there is no QR detection.
+        /// Excludes tiles and framing.
+        auto set_grid(const grid_layout_t &layout) noexcept -> builder_t &;
+
+        /// @brief Count frames, bytes and decode failures and time the
+        /// pipeline's stages into `stats` while decoding; see `stage_t` for
+        /// the decoder's stages. Null, the default, collects nothing.
+        auto set_stats(std::shared_ptr<stats_t> stats) noexcept
+            -> builder_t &;
+
+        /// @brief The video was encoded with these
+        /// `encoder_t::builder_t::set_scale()` and `set_border_size()`
+        /// settings. Every tile is then read by sampling its modules where
+        /// the encoder drew them, which skips quirc's costly search for QR
+        /// codes; quirc is only run on tiles whose samples do not decode.
+        /// If no QR code of that geometry fits the video's tiles, e.g., for a
+        /// video encoded with another scale, every tile is read through
+        /// quirc, with a warning.
+        auto set_symbol_geometry(const size_t scale,
+                                 const size_t border_size) noexcept
+            -> builder_t &;
+
+        [[nodiscard]] auto build() const -> decoder_t;
+
+      private:
+        size_t num_workers_ = 0;
+        size_t max_frames_in_flight_ = 0;
+        size_t tile_columns_ = 1, tile_rows_ = 1;
+        framing_t framing_ = framing_t::none;
+        std::optional<grid_layout_t> grid_layout_;
+        bool plane_multiplexing_ = false;
+        size_t codec_threads_ = 0;
+        codec_threading_t codec_threading_ = codec_threading_t::any;
+        size_t shards_ = 0;
+        std::shared_ptr<stats_t> stats_;
+        std::optional<symbol_geometry_t> geometry_;
+    };
+    static auto builder() -> builder_t { return builder_t{}; }
+
+    decoder_t() noexcept = default;
+
     void decode(std::vector<std::uint8_t> &dst,
                 std::unique_ptr<video_input_t> src);
+
+    /// @brief Decodes `src` and writes the payload to `dst`, in order, as
+    /// the frames holding it are decoded, then flushes `dst`. Only the
+    /// payloads of the frames in flight, and of the shards, are held in
+    /// memory; with `framing_t::sequenced`, so are chunks decoded ahead of
+    /// one that is missing, until the missing chunk is reported.
+    void decode(output_sink_t &dst, std::unique_ptr<video_input_t> src);
+
+    /// @brief Decodes `length` bytes of the payload starting at `offset`
+    /// into `dst`, which is resized to `length`. Requires
+    /// `framing_t::sequenced`: the manifest in the first frame gives the
+    /// chunk size, from which the frames holding the range follow. The
+    /// demuxer seeks to the keyframe before the first of them, so only the
+    /// GOPs covering the range are decoded, and decoding stops as soon as
+    /// the range is complete. QR detection runs on the calling thread.
+    /// @throws std::out_of_range if the range extends past the payload
+    /// @throws std::runtime_error if a chunk of the range is missing
+    void decode_range(std::vector<std::uint8_t> &dst,
+                      std::unique_ptr<video_input_t> src, std::uint64_t offset,
+                      std::size_t length);
+
+    /// @brief The object the decoding calls fill in, if one was set with
+    /// `builder_t::set_stats()`.
+    [[nodiscard]] auto stats() const noexcept -> std::shared_ptr<stats_t> {
+        return stats_;
+    }
+
+  private:
+    explicit decoder_t(const size_t num_workers,
+                       const size_t max_frames_in_flight,
+                       const size_t tile_columns = 1,
+                       const size_t tile_rows = 1,
+                       const framing_t framing = framing_t::none,
+                       std::optional<grid_layout_t> grid_layout =
+                           std::nullopt,
+                       const bool plane_multiplexing = false,
+                       const size_t codec_threads = 0,
+                       const codec_threading_t codec_threading =
+                           codec_threading_t::any,
+                       const size_t shards = 0,
+                       std::shared_ptr<stats_t> stats = nullptr,
+                       std::optional<symbol_geometry_t> geometry =
+                           std::nullopt) noexcept
+        : num_workers_{num_workers},
+          max_frames_in_flight_{max_frames_in_flight},
+          tile_columns_{tile_columns}, tile_rows_{tile_rows},
+          framing_{framing}, grid_layout_{grid_layout},
+          plane_multiplexing_{plane_multiplexing},
+          codec_threads_{codec_threads}, codec_threading_{codec_threading},
+          shards_{shards}, stats_{std::move(stats)}, geometry_{geometry} {}
+
+    /// @brief Writes the payload to `dst` or, if not null, hands the QR
+    /// code payloads to `assembler` and finishes it.
+    void decode(output_sink_t &dst, frame_assembler_t *assembler,
+                std::unique_ptr<video_input_t> src);
+
+    /// @brief `decode()` with `set_shards()`.
+    /// @return false, having left `dst` alone, if `src` cannot be sharded
+    auto decode_sharded(output_sink_t &dst, frame_assembler_t *assembler,
+                        const video_input_t &src) -> bool;
+
+    size_t num_workers_ = 0;
+    size_t max_frames_in_flight_ = 1;
+    size_t tile_columns_ = 1, tile_rows_ = 1;
+    framing_t framing_ = framing_t::none;
+    std::optional<grid_layout_t> grid_layout_;
+    bool plane_multiplexing_ = false;
+    size_t codec_threads_ = 0;
+    codec_threading_t codec_threading_ = codec_threading_t::any;
+    size_t shards_ = 0;
+    std::shared_ptr<stats_t> stats_;
+    std::optional<symbol_geometry_t> geometry_;
 };
 
 template <typename OutputIt>
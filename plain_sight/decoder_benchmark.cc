@@ -0,0 +1,168 @@
+#include <benchmark/benchmark.h>
+
+#include "plain_sight/benchmark_util.h"
+#include "plain_sight/capacity.h"
+#include "plain_sight/codec.h"
+#include "plain_sight/decoder.h"
+#include "plain_sight/frame_renderer.h"
+#include "plain_sight/qr_codes.h"
+#include "plain_sight/util.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+namespace {
+
+using net_zelcon::plain_sight::decode_raw_data;
+using net_zelcon::plain_sight::decoder_t;
+using net_zelcon::plain_sight::encode_raw_data;
+using net_zelcon::plain_sight::frame_renderer_t;
+using net_zelcon::plain_sight::in_memory_video_input_t;
+using net_zelcon::plain_sight::libav_frame_ptr_t;
+using net_zelcon::plain_sight::plan_chunks;
+using net_zelcon::plain_sight::qr_code_decoder_t;
+using net_zelcon::plain_sight::qr_symbol_t;
+using net_zelcon::plain_sight::random_payload;
+using net_zelcon::plain_sight::split_frames;
+
+// Frames of the video `encode_raw_data()` makes of `payload`: one QR code
+// each, planned as it plans them.
+auto video_frames(const std::vector<std::uint8_t> &payload) -> std::size_t {
+    return plan_chunks(payload.size(), 1, 20, qrcodegen::QrCode::Ecc::HIGH)
+        .qr_code_count(payload.size());
+}
+
+// Arguments: scale, whether the geometry is known.
+//
+// QR detection and decoding of one rendered QR code, the decoder's dominant
+// per-frame cost, or sampling and decoding it where the encoder drew it.
+// Bytes are payload bytes decoded.
+void BM_QrCodeDecode(benchmark::State &state) {
+    const int scale = static_cast<int>(state.range(0));
+    const bool sampled = state.range(1) != 0;
+    const auto payload = random_payload(2 << 10);
+    const auto qr_codes = split_frames(payload);
+    const auto renderer = frame_renderer_t::create(
+        AV_PIX_FMT_GRAY8, qr_codes.front().getSize(), scale, 4);
+    libav_frame_ptr_t frame{av_frame_alloc(), av_frame_free};
+    frame->width = renderer->width();
+    frame->height = renderer->height();
+    frame->format = AV_PIX_FMT_GRAY8;
+    if (av_frame_get_buffer(frame.get(), 32) < 0) {
+        state.SkipWithError("Could not allocate frame");
+        return;
+    }
+    renderer->prepare(frame.get());
+    renderer->render(frame.get(), qr_symbol_t{qr_codes.front()});
+    std::vector<std::uint8_t> image(
+        static_cast<std::size_t>(frame->width) * frame->height);
+    for (int y = 0; y < frame->height; ++y) {
+        std::copy_n(frame->data[0] + y * frame->linesize[0], frame->width,
+                    image.begin() + y * frame->width);
+    }
+    qr_code_decoder_t decoder{frame->width, frame->height};
+    if (sampled) {
+        decoder.set_geometry(scale, 4);
+    }
+    std::vector<std::uint8_t> decoded;
+    for (auto _ : state) {
+        decoded.clear();
+        decoder.decode(decoded, image);
+        benchmark::DoNotOptimize(decoded.data());
+    }
+    if (!std::equal(decoded.begin(), decoded.end(), payload.begin(),
+                    payload.begin() + 100)) {
+        state.SkipWithError("Decoded chunk differs");
+    }
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations()) *
+                            static_cast<std::int64_t>(decoded.size()));
+    state.counters["frames_per_second"] = benchmark::Counter(
+        static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+}
+
+BENCHMARK(BM_QrCodeDecode)
+    ->ArgsProduct({{1, 2, 4}, {0, 1}})
+    ->ArgNames({"scale", "sampled"});
+
+// Arguments: payload size in KiB.
+//
+// The whole decoder, demuxing and libav decoding included, as
+// `decode_raw_data()` runs it: one QR detection worker per core.
+void BM_DecodeRawData(benchmark::State &state) {
+    const auto payload =
+        random_payload(static_cast<std::size_t>(state.range(0)) << 10);
+    std::vector<std::uint8_t> video;
+    encode_raw_data(video, payload);
+    const std::size_t frames = video_frames(payload);
+    std::vector<std::uint8_t> decoded;
+    for (auto _ : state) {
+        decoded.clear();
+        decode_raw_data(decoded, video);
+        benchmark::DoNotOptimize(decoded.data());
+    }
+    if (decoded != payload) {
+        state.SkipWithError("Decoded payload differs");
+    }
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations()) *
+                            static_cast<std::int64_t>(payload.size()));
+    state.counters["frames_per_second"] = benchmark::Counter(
+        static_cast<double>(state.iterations() * frames),
+        benchmark::Counter::kIsRate);
+}
+
+BENCHMARK(BM_DecodeRawData)
+    ->Arg(64)
+    ->Arg(1024)
+    ->ArgNames({"KiB"})
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+// Arguments: payload size in KiB, QR detection workers, shards.
+//
+// `decoder_t` with the parallelism spelled out, to compare the worker and
+// sharded paths on the same video.
+void BM_Decoder(benchmark::State &state) {
+    const auto payload =
+        random_payload(static_cast<std::size_t>(state.range(0)) << 10);
+    std::vector<std::uint8_t> video;
+    encode_raw_data(video, payload);
+    const auto workers = static_cast<std::size_t>(state.range(1));
+    const auto shards = static_cast<std::size_t>(state.range(2));
+    auto decoder = decoder_t::builder()
+                       .set_num_workers(workers)
+                       .set_shards(shards)
+                       .build();
+    const std::size_t frames = video_frames(payload);
+    std::vector<std::uint8_t> decoded;
+    for (auto _ : state) {
+        decoded.clear();
+        decoder.decode(decoded, std::make_unique<in_memory_video_input_t>(
+                                    std::span<std::uint8_t>{video}));
+        benchmark::DoNotOptimize(decoded.data());
+    }
+    if (decoded != payload) {
+        state.SkipWithError("Decoded payload differs");
+    }
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations()) *
+                            static_cast<std::int64_t>(payload.size()));
+    state.counters["frames_per_second"] = benchmark::Counter(
+        static_cast<double>(state.iterations() * frames),
+        benchmark::Counter::kIsRate);
+}
+
+BENCHMARK(BM_Decoder)
+    ->Args({1024, 0, 0})
+    ->Args({1024, 4, 0})
+    ->Args({1024, 0, 4})
+    ->ArgNames({"KiB", "workers", "shards"})
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+} // namespace
\ No newline at end of file
@@ -1,64 +1,432 @@
 #include "plain_sight/encoder.h"
+#include "plain_sight/bounded_queue.h"
+#include "plain_sight/frame_pool.h"
+#include "plain_sight/frame_renderer.h"
 #include "plain_sight/util.h"
 
 #include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <exception>
 #include <fmt/core.h>
 #include <functional>
+#include <future>
 #include <glog/logging.h>
+#include <optional>
+#include <thread>
 
 extern "C" {
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
 #include <libavformat/avio.h>
 #include <libavutil/imgutils.h>
-#include <libswscale/swscale.h>
+#include <libavutil/pixdesc.h>
 }
 
 namespace net_zelcon::plain_sight {
 
 namespace {
 
-void write_frame(AVFormatContext *fmt_ctx, AVCodecContext *enc_ctx,
-                 AVFrame *frame, AVPacket *pkt) {
-    int err = avcodec_send_frame(enc_ctx, frame);
+using packet_ptr_t = libav_ptr_t<AVPacket, av_packet_free>;
+
+/// @brief Sends `frame`, or the flush packet if it is null, to the encoder
+/// and hands every packet that comes out to `on_packet`, which may take it
+/// over with `av_packet_move_ref`. `stats` may be null.
+template <typename Fn>
+void encode_frame(AVCodecContext *enc_ctx, AVFrame *frame, AVPacket *pkt,
+                  stats_t *stats, Fn &&on_packet) {
+    int err = 0;
+    {
+        const stage_timer_t timer{stats, stage_t::codec_send};
+        err = avcodec_send_frame(enc_ctx, frame);
+    }
     if (err < 0) {
         LOG(FATAL) << "Could not send frame: " << libav_error(err);
     }
+    if (stats != nullptr && frame != nullptr) {
+        stats->add_frames(1);
+    }
     while (err >= 0) {
-        err = avcodec_receive_packet(enc_ctx, pkt);
+        {
+            const stage_timer_t timer{stats, stage_t::codec_receive};
+            err = avcodec_receive_packet(enc_ctx, pkt);
+        }
         if (err == AVERROR(EAGAIN) || err == AVERROR_EOF) {
             return;
         } else if (err < 0 && err != AVERROR_EOF) {
             LOG(FATAL) << "Could not receive packet: " << libav_error(err);
         } else if (err >= 0) {
-            // rescale output packet timestamp values from codec to stream
-            // timebase
-            av_packet_rescale_ts(pkt, enc_ctx->time_base,
-                                 fmt_ctx->streams[0]->time_base);
-            pkt->stream_index = fmt_ctx->streams[0]->index;
-            // write packet
-            err = av_interleaved_write_frame(fmt_ctx, pkt);
-            if (err < 0) {
-                LOG(FATAL) << "Could not write frame: " << libav_error(err);
-            }
+            on_packet(pkt);
         }
         av_packet_unref(pkt);
     }
 }
 
-void prepare_frame(AVFrame *dst, const AVCodecContext *const codec_context) {
-    dst->width = codec_context->width;
-    dst->height = codec_context->height;
-    dst->format = codec_context->pix_fmt;
-    int err = av_frame_get_buffer(dst, 1);
-    CHECK(err >= 0) << "Could not allocate frame buffers: " << libav_error(err);
+/// @brief Writes `pkt`, with timestamps in `time_base`, to the only stream
+/// of `fmt_ctx`. `stats` may be null.
+void mux_packet(AVFormatContext *fmt_ctx, const AVRational time_base,
+                AVPacket *pkt, stats_t *stats) {
+    const stage_timer_t timer{stats, stage_t::mux};
+    if (stats != nullptr) {
+        stats->add_video_bytes(static_cast<std::uint64_t>(pkt->size));
+    }
+    // rescale output packet timestamp values from codec to stream timebase
+    av_packet_rescale_ts(pkt, time_base, fmt_ctx->streams[0]->time_base);
+    pkt->stream_index = fmt_ctx->streams[0]->index;
+    const int err = av_interleaved_write_frame(fmt_ctx, pkt);
+    if (err < 0) {
+        LOG(FATAL) << "Could not write frame: " << libav_error(err);
+    }
+}
+
+void write_frame(AVFormatContext *fmt_ctx, AVCodecContext *enc_ctx,
+                 AVFrame *frame, AVPacket *pkt, stats_t *stats) {
+    encode_frame(enc_ctx, frame, pkt, stats, [&](AVPacket *encoded) {
+        mux_packet(fmt_ctx, enc_ctx->time_base, encoded, stats);
+    });
+}
+
+/// @brief Fills the chroma planes of a frame for the grid symbology with
+/// neutral gray; the grid codec draws the luma plane.
+void prepare_grid_frame(AVFrame *dst) {
+    const auto format = static_cast<AVPixelFormat>(dst->format);
+    const AVPixFmtDescriptor *const desc = av_pix_fmt_desc_get(format);
+    CHECK(desc != nullptr);
+    CHECK((desc->flags & (AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_PAL |
+                          AV_PIX_FMT_FLAG_BITSTREAM | AV_PIX_FMT_FLAG_ALPHA |
+                          AV_PIX_FMT_FLAG_HWACCEL)) == 0 &&
+          desc->comp[0].depth == 8 && desc->comp[0].step == 1 &&
+          desc->comp[0].plane == 0 &&
+          (desc->nb_components == 1 || (desc->comp[1].plane != 0 &&
+                                        desc->comp[1].depth == 8)))
+        << "The grid symbology needs 8-bit planar luma, not "
+        << av_get_pix_fmt_name(format);
+    for (int plane = 1; plane < 4 && dst->data[plane] != nullptr; ++plane) {
+        const int rows = -((-dst->height) >> desc->log2_chroma_h);
+        std::memset(dst->data[plane], 128,
+                    static_cast<std::size_t>(dst->linesize[plane]) * rows);
+    }
+}
+
+/// @brief What goes into one frame: the QR codes of its tiles, or its part
+/// of the grid payload.
+struct frame_content_t {
+    std::vector<qr_symbol_t> qr_codes;
+    std::span<const std::uint8_t> grid_part;
+};
+
+/// @brief Cuts the encoder's input into frames, in order. Not thread-safe.
+class frame_contents_t {
+  public:
+    /// @param grid_codec If not null, `grid_payload` is cut into frames of
+    /// its capacity; otherwise frames of `tile_count` QR codes are pulled
+    /// from `source`.
+    /// @param stats If not null, the time spent waiting for `source` is
+    /// accounted to `stage_t::qr_generation`.
+    frame_contents_t(qr_code_source_t *source, const std::size_t tile_count,
+                     const grid_codec_t *grid_codec,
+                     std::span<const std::uint8_t> grid_payload,
+                     stats_t *stats)
+        : source_{source}, tile_count_{tile_count}, grid_codec_{grid_codec},
+          grid_payload_{grid_payload}, stats_{stats} {}
+
+    /// @return the next frame's content, or `std::nullopt` past the last
+    /// frame. Only the last frame can be partially filled.
+    auto next() -> std::optional<frame_content_t> {
+        frame_content_t content;
+        if (grid_codec_ != nullptr) {
+            if (grid_payload_.empty()) {
+                return std::nullopt;
+            }
+            content.grid_part = grid_payload_.first(
+                std::min(grid_payload_.size(), grid_codec_->capacity()));
+            grid_payload_ = grid_payload_.subspan(content.grid_part.size());
+            return content;
+        }
+        const stage_timer_t timer{stats_, stage_t::qr_generation};
+        while (content.qr_codes.size() < tile_count_) {
+            auto qr_code = source_->next();
+            if (!qr_code) {
+                break;
+            }
+            content.qr_codes.push_back(std::move(*qr_code));
+        }
+        if (content.qr_codes.empty()) {
+            return std::nullopt;
+        }
+        return content;
+    }
+
+  private:
+    qr_code_source_t *source_;
+    std::size_t tile_count_;
+    const grid_codec_t *grid_codec_;
+    std::span<const std::uint8_t> grid_payload_;
+    stats_t *stats_;
+};
+
+/// @brief Draws `content` into `frame`, prepared for `renderer` or, if
+/// `grid_codec` is not null, for the grid symbology. `stats` may be null.
+void draw_content(AVFrame *frame, const frame_content_t &content,
+                  frame_renderer_t *renderer, const grid_codec_t *grid_codec,
+                  stats_t *stats) {
+    const stage_timer_t timer{stats, stage_t::render};
+    if (grid_codec != nullptr) {
+        grid_codec->render(content.grid_part, frame->data[0],
+                           frame->linesize[0]);
+    } else {
+        renderer->render(frame, content.qr_codes);
+    }
+}
+
+/// @brief Consecutive frames of the video, encoded on their own as closed
+/// GOPs.
+struct segment_job_t {
+    /// @brief Timestamp of the first frame
+    std::int64_t first_pts;
+    std::vector<frame_content_t> frames;
+    std::promise<std::vector<packet_ptr_t>> packets;
+};
+
+/// @brief Worker threads that each render and encode whole segments with an
+/// encoder of their own, opened afresh for every segment so that it starts
+/// with a keyframe and refers to no other segment.
+class segment_encoders_t {
+  public:
+    using open_codec_t =
+        std::function<libav_ptr_t<AVCodecContext, avcodec_free_context>()>;
+    using make_renderer_t =
+        std::function<std::unique_ptr<frame_renderer_t>()>;
+
+    /// @param make_renderer Creates each worker's renderer; null with a
+    /// `grid_codec`
+    /// @param stats May be null
+    segment_encoders_t(const std::size_t num_encoders, open_codec_t open_codec,
+                       make_renderer_t make_renderer,
+                       const grid_codec_t *grid_codec, stats_t *stats)
+        : jobs_{num_encoders}, open_codec_{std::move(open_codec)},
+          make_renderer_{std::move(make_renderer)}, grid_codec_{grid_codec},
+          stats_{stats} {
+        CHECK_GT(num_encoders, 0UL);
+        for (std::size_t i = 0; i < num_encoders; ++i) {
+            threads_.emplace_back([this] { run(); });
+        }
+    }
+
+    ~segment_encoders_t() noexcept {
+        jobs_.close();
+        for (auto &thread : threads_) {
+            thread.join();
+        }
+    }
+
+    segment_encoders_t(const segment_encoders_t &) = delete;
+    segment_encoders_t &operator=(const segment_encoders_t &) = delete;
+
+    void submit(segment_job_t job) { jobs_.push(std::move(job)); }
+
+  private:
+    void run() {
+        std::unique_ptr<frame_renderer_t> renderer;
+        std::optional<frame_pool_t> pool;
+        packet_ptr_t packet{av_packet_alloc(), av_packet_free};
+        CHECK(packet) << "Failed to allocate AVPacket";
+        while (auto job = jobs_.pop()) {
+            try {
+                const auto codec_context = open_codec_();
+                if (!pool) {
+                    if (make_renderer_) {
+                        renderer = make_renderer_();
+                    }
+                    pool.emplace(codec_context->width, codec_context->height,
+                                 codec_context->pix_fmt, [&](AVFrame *frame) {
+                                     if (renderer) {
+                                         renderer->prepare(frame);
+                                     } else {
+                                         prepare_grid_frame(frame);
+                                     }
+                                 });
+                }
+                std::vector<packet_ptr_t> packets;
+                const auto keep = [&](AVPacket *encoded) {
+                    auto &kept =
+                        packets.emplace_back(av_packet_alloc(), av_packet_free);
+                    CHECK(kept) << "Failed to allocate AVPacket";
+                    av_packet_move_ref(kept.get(), encoded);
+                };
+                std::int64_t pts = job->first_pts;
+                for (const auto &content : job->frames) {
+                    const auto started = std::chrono::steady_clock::now();
+                    auto frame = pool->acquire();
+                    draw_content(frame.get(), content, renderer.get(),
+                                 grid_codec_, stats_);
+                    frame->pts = pts++;
+                    encode_frame(codec_context.get(), frame.get(),
+                                 packet.get(), stats_, keep);
+                    if (stats_ != nullptr) {
+                        stats_->record_frame_latency(
+                            std::chrono::steady_clock::now() - started);
+                    }
+                }
+                encode_frame(codec_context.get(), nullptr, packet.get(),
+                             stats_, keep);
+                job->packets.set_value(std::move(packets));
+            } catch (...) {
+                job->packets.set_exception(std::current_exception());
+            }
+        }
+    }
+
+    bounded_queue_t<segment_job_t> jobs_;
+    open_codec_t open_codec_;
+    make_renderer_t make_renderer_;
+    const grid_codec_t *grid_codec_;
+    stats_t *stats_;
+    std::vector<std::thread> threads_;
+};
+
+/// @brief A frame handed from the render stage to the encode stage.
+struct rendered_frame_t {
+    libav_frame_ptr_t frame;
+    /// @brief When rendering it started, for `stats_t::frame_latency()`
+    std::chrono::steady_clock::time_point started;
+};
+
+/// @brief Renders the frames of `contents` on a thread of their own, at
+/// most `pipeline_depth` frames ahead of `codec_context`, which encodes them
+/// on the calling thread; then flushes the encoder. `stats` may be null.
+void encode_pipelined(AVFormatContext *format_context,
+                      AVCodecContext *codec_context,
+                      const segment_encoders_t::make_renderer_t &make_renderer,
+                      const grid_codec_t *grid_codec,
+                      frame_contents_t &contents,
+                      const std::size_t pipeline_depth, stats_t *stats) {
+    packet_ptr_t packet{av_packet_alloc(), av_packet_free};
+    CHECK(packet) << "Failed to allocate AVPacket";
+    const std::unique_ptr<frame_renderer_t> renderer =
+        make_renderer ? make_renderer() : nullptr;
+    // The render stage draws into frames from `pool` and hands them to the
+    // encode stage through `rendered`, whose capacity bounds how far rendering
+    // can run ahead of the libav encoder. A frame's buffer returns to the pool
+    // once the encoder, which may hold several frames with frame threading,
+    // releases its reference too.
+    bounded_queue_t<rendered_frame_t> rendered{pipeline_depth};
+    frame_pool_t pool{codec_context->width, codec_context->height,
+                      codec_context->pix_fmt, [&](AVFrame *frame) {
+                          if (renderer) {
+                              renderer->prepare(frame);
+                          } else {
+                              prepare_grid_frame(frame);
+                          }
+                      }};
+    std::exception_ptr render_error;
+    std::thread render_stage{[&] {
+        try {
+            int frame_counter = 1;
+            while (auto content = contents.next()) {
+                // Only the last frame can be partially filled; its blank
+                // tiles wipe the background, but no frame is rendered after
+                // it.
+                const auto started = std::chrono::steady_clock::now();
+                auto frame = pool.acquire();
+                draw_content(frame.get(), *content, renderer.get(),
+                             grid_codec, stats);
+                frame->pts = frame_counter++;
+                if (!rendered.push({std::move(frame), started})) {
+                    break; // encode stage gave up
+                }
+            }
+        } catch (...) {
+            render_error = std::current_exception();
+        }
+        rendered.close();
+    }};
+    try {
+        while (auto frame = rendered.pop()) {
+            DLOG(INFO) << "Sending frame " << frame->frame->pts
+                       << " to encoder";
+            write_frame(format_context, codec_context, frame->frame.get(),
+                        packet.get(), stats);
+            if (stats != nullptr) {
+                stats->record_frame_latency(std::chrono::steady_clock::now() -
+                                            frame->started);
+            }
+        }
+    } catch (...) {
+        rendered.close();
+        render_stage.join();
+        throw;
+    }
+    render_stage.join();
+    if (render_error) {
+        std::rethrow_exception(render_error);
+    }
+    // Flush encoder with null flush packet, signaling end of the stream. If the
+    // encoder still has packets buffered, it will return them.
+    write_frame(format_context, codec_context, nullptr, packet.get(), stats);
+}
+
+/// @brief Cuts `contents` into segments of `segment_frames` frames, encodes
+/// them on `num_encoders` threads and muxes their packets in order, as a
+/// stream copy. Packet timestamps are in `time_base`.
+/// @details Each segment starts with a keyframe and its frames carry their
+/// place in the whole video as timestamps, so the segments' packets line up
+/// into one stream. Segments are muxed as soon as they and all before them
+/// are done; the number of segments in flight is bounded by a small multiple
+/// of the number of encoders. `stats` may be null.
+void encode_segments(AVFormatContext *format_context,
+                     const AVRational time_base,
+                     const segment_encoders_t::open_codec_t &open_codec,
+                     const segment_encoders_t::make_renderer_t &make_renderer,
+                     const grid_codec_t *grid_codec,
+                     frame_contents_t &contents,
+                     const std::size_t num_encoders,
+                     const std::size_t segment_frames, stats_t *stats) {
+    segment_encoders_t encoders{num_encoders, open_codec, make_renderer,
+                                grid_codec, stats};
+    std::deque<std::future<std::vector<packet_ptr_t>>> pending;
+    const auto mux_oldest = [&] {
+        const auto packets = pending.front().get();
+        pending.pop_front();
+        for (const auto &packet : packets) {
+            mux_packet(format_context, time_base, packet.get(), stats);
+        }
+    };
+    std::int64_t pts = 1;
+    bool done = false;
+    while (!done) {
+        segment_job_t job{pts, {}, {}};
+        while (job.frames.size() < segment_frames) {
+            auto content = contents.next();
+            if (!content) {
+                done = true;
+                break;
+            }
+            job.frames.push_back(std::move(*content));
+        }
+        if (job.frames.empty()) {
+            break;
+        }
+        pts += static_cast<std::int64_t>(job.frames.size());
+        pending.emplace_back(job.packets.get_future());
+        encoders.submit(std::move(job));
+        if (pending.size() > num_encoders * 2) {
+            mux_oldest();
+        }
+    }
+    while (!pending.empty()) {
+        mux_oldest();
+    }
 }
 
 } // namespace
 
 void draw_QR_code(AVFrame *dst, const qrcodegen::QrCode &qr_code,
                   const int border_size, const int scale) {
-    // TODO: Parallelize this. It is embarassingly parallelizable.
+    // Straightforward per-pixel reference implementation. `encoder_t` renders
+    // with `frame_renderer_t`, which caches everything that does not change
+    // between frames.
     CHECK(dst != nullptr);
     CHECK_EQ(dst->width, dst->height);
     const int computed_size = qr_code.getSize() * scale + border_size * 2;
@@ -105,34 +473,38 @@ void draw_frame(AVCodecContext *const codec_context, AVFrame *const frame,
     CHECK_EQ(frame->width, computed_size)
         << "frame->width: " << frame->width
         << " != computed_size: " << computed_size;
-    if (codec_context->pix_fmt != AV_PIX_FMT_YUV420P) {
-        // Convert from YUV420P because `draw_QR_code` only writes a YUV420P
-        // image.
-        libav_ptr_t<SwsContext, sws_freeContext> sws_context{
-            sws_getContext(frame->width, frame->height, AV_PIX_FMT_YUV420P,
-                           frame->width, frame->height, codec_context->pix_fmt,
-                           SWS_BILINEAR, nullptr, nullptr, nullptr),
-            sws_freeContext};
-        CHECK(sws_context) << "Failed to allocate SwsContext";
-        libav_ptr_t<AVFrame, av_frame_free> temp_frame{av_frame_alloc(),
-                                                       av_frame_free};
-        CHECK(temp_frame) << "Failed to allocate AVFrame";
-        prepare_frame(temp_frame.get(), codec_context);
-        DCHECK_EQ(temp_frame->width, frame->width);
-        DCHECK_EQ(temp_frame->height, frame->height);
-        DCHECK_EQ(static_cast<AVPixelFormat>(temp_frame->format),
-                  AV_PIX_FMT_YUV420P);
-        draw_QR_code(temp_frame.get(), qr_code, border_size, scale);
-        sws_scale(sws_context.get(), temp_frame->data, temp_frame->linesize, 0,
-                  frame->height, frame->data, frame->linesize);
-        // TODO: use some associated class object to obviate some of these
-        // allocations above
-    } else {
-        draw_QR_code(frame, qr_code, border_size, scale);
+    // One-off rendering. Callers drawing more than one frame should keep a
+    // `frame_renderer_t` around instead, as `encoder_t` does.
+    auto renderer = frame_renderer_t::create(
+        codec_context->pix_fmt, qr_code.getSize(), scale, border_size);
+    renderer->prepare(frame);
+    renderer->render(frame, qr_symbol_t{qr_code});
+}
+
+auto choose_pixel_format(const AVCodec *const codec,
+                         const AVPixelFormat requested) -> AVPixelFormat {
+    const AVPixelFormat preferred =
+        requested != AV_PIX_FMT_NONE ? requested : AV_PIX_FMT_YUV420P;
+    if (codec->pix_fmts == nullptr) {
+        return preferred; // codec does not advertise its formats
+    }
+    for (const AVPixelFormat *it = codec->pix_fmts; *it != AV_PIX_FMT_NONE;
+         ++it) {
+        if (*it == preferred) {
+            return preferred;
+        }
     }
+    CHECK_EQ(requested, AV_PIX_FMT_NONE)
+        << "Codec " << codec->name << " does not support pixel format "
+        << av_get_pix_fmt_name(requested);
+    // Fall back to the codec's own preference; the renderer draws into any
+    // format directly or, failing that, through a cached conversion.
+    return codec->pix_fmts[0];
 }
 
 void encoder_t::encode(std::unique_ptr<video_output_t> destination) {
+    const auto started = std::chrono::steady_clock::now();
+    stats_t *const stats = stats_.get();
     AVFormatContext *format_context = destination->format_context();
     CHECK(format_context) << "Failed to allocate AVFormatContext";
     format_context->oformat =
@@ -147,76 +519,144 @@ void encoder_t::encode(std::unique_ptr<video_output_t> destination) {
         format_context->oformat->video_codec); // probably is AV_CODEC_ID_H264
     CHECK(codec != nullptr) << "Codec for " << std::quoted(video_format_)
                             << " not found on host system";
-    libav_ptr_t<AVCodecContext, avcodec_free_context> codec_context{
-        avcodec_alloc_context3(codec), avcodec_free_context};
-    CHECK(codec_context) << "Failed to allocate AVCodecContext";
-    if (format_context->oformat->flags & AVFMT_GLOBALHEADER) {
-        codec_context->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
-    }
-    codec_context->codec_id = format_context->oformat->video_codec;
-    codec_context->codec_type = AVMEDIA_TYPE_VIDEO;
-    const auto size = calculate_dimensions();
-    codec_context->width = size;
-    codec_context->height = size;
-    // frame rate
-    codec_context->time_base = AVRational{1, fps_};
-    codec_context->pix_fmt = AV_PIX_FMT_YUV420P;
-    codec_context->gop_size = gop_size_;
-    codec_context->bit_rate = bitrate_;
-    //  initialize codec
-    int err = avcodec_open2(codec_context.get(), codec, nullptr);
-    if (err < 0) {
-        LOG(FATAL) << "Could not open codec:" << libav_error(err);
-    }
-    err =
+    const auto [width, height] = calculate_dimensions();
+    const AVPixelFormat pixel_format = choose_pixel_format(
+        codec, plane_multiplexing_ && pixel_format_ == AV_PIX_FMT_NONE
+                   ? AV_PIX_FMT_YUV444P
+                   : pixel_format_);
+    // Every segment encoder is opened the same way, so that their packets
+    // fit the stream parameters taken from the first.
+    const auto open_codec = [&, width = width, height = height] {
+        libav_ptr_t<AVCodecContext, avcodec_free_context> codec_context{
+            avcodec_alloc_context3(codec), avcodec_free_context};
+        CHECK(codec_context) << "Failed to allocate AVCodecContext";
+        if (format_context->oformat->flags & AVFMT_GLOBALHEADER) {
+            codec_context->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+        }
+        codec_context->codec_id = format_context->oformat->video_codec;
+        codec_context->codec_type = AVMEDIA_TYPE_VIDEO;
+        codec_context->width = static_cast<int>(width);
+        codec_context->height = static_cast<int>(height);
+        // frame rate
+        codec_context->time_base = AVRational{1, fps_};
+        codec_context->pix_fmt = pixel_format;
+        codec_context->gop_size = gop_size_;
+        codec_context->bit_rate = bitrate_;
+        set_codec_threads(codec_context.get(), codec_threads_,
+                          codec_threading_);
+        //  initialize codec
+        const int err = avcodec_open2(codec_context.get(), codec, nullptr);
+        if (err < 0) {
+            LOG(FATAL) << "Could not open codec:" << libav_error(err);
+        }
+        return codec_context;
+    };
+    const auto codec_context = open_codec();
+    int err =
         avcodec_parameters_from_context(stream->codecpar, codec_context.get());
     if (err < 0) {
         LOG(FATAL) << "Could not initialize codec parameters:"
                    << libav_error(err);
     }
+    // An MP4 index can only be written up front, with fragments, if the
+    // muxer cannot seek back to patch it in; other muxers ignore the flags.
+    AVDictionary *options = nullptr;
+    if (!destination->seekable()) {
+        av_dict_set(&options, "movflags",
+                    "frag_keyframe+empty_moov+default_base_moof", 0);
+    }
     //  write file header
-    err = avformat_write_header(format_context, nullptr);
+    {
+        const stage_timer_t timer{stats, stage_t::mux};
+        err = avformat_write_header(format_context, &options);
+    }
+    av_dict_free(&options);
     if (err < 0) {
         LOG(FATAL) << "Could not write header:" << libav_error(err);
     }
-    // allocate frame
-    libav_ptr_t<AVFrame, av_frame_free> frame{av_frame_alloc(), av_frame_free};
-    CHECK(frame) << "Failed to allocate AVFrame";
-    prepare_frame(frame.get(), codec_context.get());
-    // allocate packet
-    libav_ptr_t<AVPacket, av_packet_free> packet{av_packet_alloc(),
-                                                 av_packet_free};
-    int frame_counter = 1;
-    for (const auto &qr_code : *qr_codes_) {
-        // encode frame
-        draw_frame(codec_context.get(), frame.get(), qr_code, border_size_,
-                   scale_);
-        frame->pts = frame_counter;
-        DLOG(INFO) << "Sending frame " << frame_counter << " / "
-                   << qr_codes_->size() << " to encoder";
-        write_frame(format_context, codec_context.get(), frame.get(),
-                    packet.get());
-        frame_counter++;
-    }
-    CHECK_EQ(static_cast<size_t>(frame_counter), qr_codes_->size() + 1);
-    // Flush encoder with null flush packet, signaling end of the stream. If the
-    // encoder still has packets buffered, it will return them.
-    write_frame(format_context, codec_context.get(), nullptr, packet.get());
+    // Exactly one of the two draws the frames.
+    std::optional<grid_codec_t> grid_codec;
+    segment_encoders_t::make_renderer_t make_renderer;
+    if (grid_layout_) {
+        grid_codec.emplace(*grid_layout_);
+    } else {
+        make_renderer = [&, segmented = segment_encoders_ > 1] {
+            auto renderer =
+                (plane_multiplexing_ ? frame_renderer_t::create_multiplexed
+                                     : frame_renderer_t::create)(
+                    pixel_format, qr_code_source_->symbol_size(),
+                    static_cast<int>(scale_), static_cast<int>(border_size_),
+                    render_threads_ > 1 && !segmented
+                        ? std::make_shared<thread_pool_t>(render_threads_)
+                        : nullptr,
+                    static_cast<int>(tile_columns_),
+                    static_cast<int>(tile_rows_));
+            CHECK_EQ(renderer->width(), codec_context->width);
+            CHECK_EQ(renderer->height(), codec_context->height);
+            return renderer;
+        };
+    }
+    const std::size_t tile_count =
+        tile_columns_ * tile_rows_ *
+        (plane_multiplexing_ ? multiplexable_planes(pixel_format) : 1);
+    frame_contents_t contents{qr_code_source_.get(), tile_count,
+                              grid_codec ? &*grid_codec : nullptr,
+                              grid_payload_, stats};
+    if (segment_encoders_ > 1) {
+        encode_segments(format_context, codec_context->time_base, open_codec,
+                        make_renderer, grid_codec ? &*grid_codec : nullptr,
+                        contents, segment_encoders_,
+                        gop_size_ * gops_per_segment_, stats);
+    } else {
+        encode_pipelined(format_context, codec_context.get(), make_renderer,
+                         grid_codec ? &*grid_codec : nullptr, contents,
+                         pipeline_depth_, stats);
+    }
     //  Write trailer
-    err = av_write_trailer(format_context);
+    {
+        const stage_timer_t timer{stats, stage_t::mux};
+        err = av_write_trailer(format_context);
+    }
     if (err < 0) {
         LOG(FATAL) << "Could not write trailer:" << libav_error(err);
     }
+    destination->finish();
+    if (stats != nullptr) {
+        stats->add_payload_bytes(
+            grid_layout_ ? grid_payload_.size()
+                         : qr_code_source_->payload_size().value_or(0));
+        stats->add_elapsed(std::chrono::steady_clock::now() - started);
+    }
 }
 
 auto encoder_t::builder_t::build() const -> encoder_t {
-    CHECK(qr_codes_.operator bool());
     CHECK(!video_format_.empty());
+    CHECK_GT(fps_, 0);
+    CHECK_GT(pipeline_depth_, 0UL);
+    if (grid_layout_) {
+        // Validates the layout
+        const grid_codec_t grid_codec{*grid_layout_};
+        return encoder_t{nullptr,         video_format_,  scale_,
+                         border_size_,    fps_,           pipeline_depth_,
+                         render_threads_, pixel_format_,  1,
+                         1,               grid_layout_,   grid_payload_,
+                         false,           codec_threads_, codec_threading_,
+                         segment_encoders_, stats_};
+    }
+    CHECK(qr_code_source_ || qr_codes_);
     CHECK_GT(scale_, 0UL);
     CHECK_GT(border_size_, 0UL);
-    CHECK_GT(fps_, 0);
-    return encoder_t{std::move(qr_codes_), video_format_, scale_, border_size_,
-                     fps_};
+    CHECK_GT(tile_columns_, 0UL);
+    CHECK_GT(tile_rows_, 0UL);
+    auto source = qr_code_source_
+                      ? qr_code_source_
+                      : std::make_shared<vector_qr_code_source_t>(qr_codes_);
+    return encoder_t{std::move(source),   video_format_,  scale_,
+                     border_size_,        fps_,           pipeline_depth_,
+                     render_threads_,     pixel_format_,  tile_columns_,
+                     tile_rows_,          std::nullopt,   {},
+                     plane_multiplexing_, codec_threads_, codec_threading_,
+                     segment_encoders_,   stats_};
 }
 
 auto encoder_t::builder_t::video_format() const noexcept -> std::string_view {
@@ -228,6 +668,49 @@ auto encoder_t::builder_t::qr_codes() const noexcept
     return qr_codes_;
 }
 
+auto encoder_t::builder_t::chunk_plan() const
+    -> std::optional<chunk_plan_t> {
+    return qr_code_source_ && !grid_layout_ ? qr_code_source_->chunk_plan()
+                                            : std::nullopt;
+}
+
+auto encoder_t::builder_t::projected_frame_count() const
+    -> std::optional<std::uint64_t> {
+    if (grid_layout_) {
+        const grid_codec_t grid_codec{*grid_layout_};
+        return (grid_payload_.size() + grid_codec.capacity() - 1) /
+               grid_codec.capacity();
+    }
+    std::optional<std::size_t> qr_code_count;
+    if (qr_code_source_) {
+        qr_code_count = qr_code_source_->qr_code_count();
+    } else if (qr_codes_) {
+        qr_code_count = qr_codes_->size();
+    }
+    if (!qr_code_count) {
+        return std::nullopt;
+    }
+    std::uint64_t tile_count = tile_columns_ * tile_rows_;
+    CHECK_GT(tile_count, 0UL);
+    if (plane_multiplexing_) {
+        tile_count *= multiplexable_planes(pixel_format_ != AV_PIX_FMT_NONE
+                                               ? pixel_format_
+                                               : AV_PIX_FMT_YUV444P);
+    }
+    return (*qr_code_count + tile_count - 1) / tile_count;
+}
+
+auto encoder_t::builder_t::projected_output_size() const
+    -> std::optional<std::uint64_t> {
+    const auto frame_count = projected_frame_count();
+    if (!frame_count) {
+        return std::nullopt;
+    }
+    CHECK_GT(fps_, 0);
+    return *frame_count * static_cast<std::uint64_t>(bitrate_) / 8 /
+           static_cast<std::uint64_t>(fps_);
+}
+
 auto encoder_t::builder_t::set_qr_codes(
     std::shared_ptr<std::vector<qrcodegen::QrCode>> qr_codes) noexcept
     -> encoder_t::builder_t & {
@@ -235,18 +718,80 @@ auto encoder_t::builder_t::set_qr_codes(
     return *this;
 }
 
-auto encoder_t::calculate_dimensions() const -> size_t {
-    CHECK(qr_codes_);
-    CHECK(!qr_codes_->empty());
-    const auto &first_qr_code = qr_codes_->front();
-    CHECK(std::all_of(qr_codes_->begin(), qr_codes_->end(),
-                      [&first_qr_code](const auto &qr_code) {
-                          return first_qr_code.getSize() == qr_code.getSize();
-                      }))
-        << "All QR codes must be the same size";
-    const int computed_size =
-        first_qr_code.getSize() * scale_ + border_size_ * 2;
-    return computed_size;
+auto encoder_t::builder_t::set_qr_code_source(
+    std::shared_ptr<qr_code_source_t> source) noexcept -> builder_t & {
+    qr_code_source_ = std::move(source);
+    return *this;
+}
+
+auto encoder_t::builder_t::qr_code_source() const noexcept
+    -> std::shared_ptr<qr_code_source_t> {
+    return qr_code_source_;
+}
+
+auto encoder_t::builder_t::set_pixel_format(
+    const AVPixelFormat pixel_format) noexcept -> builder_t & {
+    pixel_format_ = pixel_format;
+    return *this;
+}
+
+auto encoder_t::builder_t::set_tiles(const size_t columns,
+                                     const size_t rows) noexcept
+    -> builder_t & {
+    tile_columns_ = columns;
+    tile_rows_ = rows;
+    return *this;
+}
+
+auto encoder_t::builder_t::set_render_threads(const size_t threads) noexcept
+    -> builder_t & {
+    render_threads_ = threads;
+    return *this;
+}
+
+auto encoder_t::builder_t::set_codec_threads(
+    const size_t threads, const codec_threading_t threading) noexcept
+    -> builder_t & {
+    codec_threads_ = threads;
+    codec_threading_ = threading;
+    return *this;
+}
+
+auto encoder_t::builder_t::set_segment_encoders(const size_t encoders) noexcept
+    -> builder_t & {
+    segment_encoders_ = encoders;
+    return *this;
+}
+
+auto encoder_t::builder_t::set_pipeline_depth(const size_t depth) noexcept
+    -> builder_t & {
+    pipeline_depth_ = depth;
+    return *this;
+}
+
+auto encoder_t::calculate_dimensions() const -> std::pair<size_t, size_t> {
+    if (grid_layout_) {
+        return {static_cast<size_t>(grid_layout_->width()),
+                static_cast<size_t>(grid_layout_->height())};
+    }
+    CHECK(qr_code_source_);
+    const size_t tile_size =
+        qr_code_source_->symbol_size() * scale_ + border_size_ * 2;
+    return {tile_size * tile_columns_, tile_size * tile_rows_};
+}
+
+auto encoder_t::builder_t::set_plane_multiplexing(const bool enabled) noexcept
+    -> builder_t & {
+    plane_multiplexing_ = enabled;
+    return *this;
+}
+
+auto encoder_t::builder_t::set_grid(
+    const grid_layout_t &layout,
+    std::span<const std::uint8_t> payload) noexcept -> builder_t & {
+    grid_layout_ = layout;
+    grid_payload_ = payload;
+    return *this;
 }
 
 auto encoder_t::builder_t::set_video_format(
@@ -272,7 +817,14 @@ auto encoder_t::builder_t::set_fps(const int fps) noexcept -> builder_t & {
     return *this;
 }
 
-file_video_output_t::file_video_output_t(const std::filesystem::path &filename)
+auto encoder_t::builder_t::set_stats(std::shared_ptr<stats_t> stats) noexcept
+    -> builder_t & {
+    stats_ = std::move(stats);
+    return *this;
+}
+
+file_video_output_t::file_video_output_t(const std::filesystem::path &filename,
+                                         const file_io_options_t &io_options)
     : filename_{filename} {
     CHECK(!filename.empty());
     CHECK((std::filesystem::perms::owner_write &
@@ -291,15 +843,25 @@ file_video_output_t::file_video_output_t(const std::filesystem::path &filename)
                                              libav_error(err))};
     }
     CHECK(format_context_ != nullptr);
-    err = avio_open(&format_context_->pb, filename.c_str(), AVIO_FLAG_WRITE);
-    if (err < 0) {
-        LOG(FATAL) << "avio_open failed: " << libav_error(err);
+    try {
+        io_ = std::make_unique<file_io_t>(filename, file_io_t::mode_t::write,
+                                          io_options);
+    } catch (...) {
+        avformat_free_context(format_context_);
+        throw;
     }
+    format_context_->pb = io_->io_context();
+    format_context_->flags |= AVFMT_FLAG_CUSTOM_IO;
 }
 
 file_video_output_t::~file_video_output_t() noexcept {
-    if (io_context_ != nullptr)
-        avio_closep(&format_context_->pb);
+    if (io_) {
+        try {
+            io_->close();
+        } catch (const std::exception &) {
+            // Logged by `close()`
+        }
+    }
     avformat_free_context(format_context_);
 }
 
@@ -307,10 +869,11 @@ auto file_video_output_t::format_context() -> AVFormatContext * {
     return format_context_;
 }
 
+void file_video_output_t::finish() { io_->close(); }
+
 file_video_output_t::file_video_output_t(file_video_output_t &&src) noexcept {
     this->filename_ = std::move(src.filename_);
-    this->io_context_ = src.io_context_;
-    src.io_context_ = nullptr;
+    this->io_ = std::move(src.io_);
     this->format_context_ = src.format_context_;
     src.format_context_ = nullptr;
 }
@@ -322,6 +885,57 @@ file_video_output_t::operator=(file_video_output_t &&src) noexcept {
     return *this;
 }
 
+fd_video_output_t::fd_video_output_t(const int fd)
+    : fd_sink_{fd}, sink_{fd_sink_} {
+    auto *const buffer = static_cast<std::uint8_t *>(av_malloc(buffer_size_));
+    CHECK(buffer != nullptr) << "Failed to allocate AVIO buffer";
+    io_context_ = avio_alloc_context(buffer, buffer_size_, AVIO_FLAG_WRITE,
+                                     this, nullptr, &write_packet, nullptr);
+    CHECK(io_context_ != nullptr);
+    format_context_ = avformat_alloc_context();
+    CHECK(format_context_ != nullptr);
+    format_context_->pb = io_context_;
+    format_context_->flags |= AVFMT_FLAG_CUSTOM_IO;
+}
+
+fd_video_output_t::~fd_video_output_t() noexcept {
+    av_free(io_context_->buffer);
+    avio_context_free(&io_context_);
+    avformat_free_context(format_context_);
+}
+
+auto fd_video_output_t::format_context() -> AVFormatContext * {
+    return format_context_;
+}
+
+void fd_video_output_t::finish() {
+    avio_flush(io_context_);
+    if (io_context_->error < 0) {
+        LOG(ERROR) << "Could not write video: "
+                   << libav_error(io_context_->error);
+        throw std::runtime_error{fmt::format("Could not write video: {}",
+                                             libav_error(io_context_->error))};
+    }
+    sink_.flush();
+}
+
+int fd_video_output_t::write_packet(void *opaque, std::uint8_t *buf,
+                                    int buf_size) noexcept {
+    CHECK(buf != nullptr);
+    CHECK(opaque != nullptr);
+    auto *const self = static_cast<fd_video_output_t *>(opaque);
+    if (buf_size <= 0) {
+        return AVERROR_EOF;
+    }
+    try {
+        self->sink_.write({buf, static_cast<std::size_t>(buf_size)});
+    } catch (const std::exception &) {
+        // Logged by the sink
+        return AVERROR(EIO);
+    }
+    return buf_size;
+}
+
 in_memory_video_output_t::in_memory_video_output_t(
     std::vector<std::uint8_t> &sink)
     : sink_{sink} {
@@ -4,12 +4,19 @@
 #include <cstdint>
 #include <filesystem>
 #include <memory>
+#include <optional>
 #include <span>
 #include <string>
 #include <string_view>
+#include <utility>
 #include <vector>
 
+#include "plain_sight/file_io.h"
+#include "plain_sight/grid_codec.h"
+#include "plain_sight/output_sink.h"
 #include "plain_sight/qr_codes.h"
+#include "plain_sight/stats.h"
+#include "plain_sight/util.h"
 #include <qrcodegen.hpp>
 
 extern "C" {
@@ -57,6 +64,12 @@ class video_output_t {
   public:
     virtual ~video_output_t() noexcept {}
     virtual auto format_context() -> AVFormatContext * = 0;
+    /// @brief Whether the muxer may seek back, e.g., to patch the MP4 index
+    /// in. Formats that need to are written fragmented otherwise.
+    virtual auto seekable() const noexcept -> bool { return true; }
+    /// @brief Completes the output once the trailer is written.
+    /// @throws std::runtime_error if it cannot be written out
+    virtual void finish() {}
 };
 
 class in_memory_video_output_t : public video_output_t {
@@ -89,12 +102,18 @@ class in_memory_video_output_t : public video_output_t {
                              int whence) noexcept;
 };
 
+/// @brief A video file, written through `file_io_t` in large blocks that
+/// reach the file while the next ones are muxed.
 class file_video_output_t : public video_output_t {
   public:
-    explicit file_video_output_t(const std::filesystem::path &filename);
+    explicit file_video_output_t(const std::filesystem::path &filename,
+                                 const file_io_options_t &io_options = {});
     auto get_file_contents() const noexcept -> std::span<std::uint8_t>;
     ~file_video_output_t() noexcept override;
     auto format_context() -> AVFormatContext * override;
+    /// @brief Writes the last block and closes the file.
+    /// @throws std::runtime_error if a write failed
+    void finish() override;
 
     file_video_output_t() = delete;
     file_video_output_t(file_video_output_t &&) noexcept;
@@ -104,8 +123,36 @@ class file_video_output_t : public video_output_t {
 
   private:
     std::filesystem::path filename_;
+    std::unique_ptr<file_io_t> io_;
+    AVFormatContext *format_context_;
+};
+
+/// @brief A video written to a file descriptor that need not seek, e.g.,
+/// stdout or a pipe, through a `write_behind_output_sink_t`, so that writing
+/// the output overlaps encoding. MP4 and similar formats are written
+/// fragmented. The descriptor is not closed.
+class fd_video_output_t : public video_output_t {
+  public:
+    explicit fd_video_output_t(int fd);
+    ~fd_video_output_t() noexcept override;
+    auto format_context() -> AVFormatContext * override;
+    auto seekable() const noexcept -> bool override { return false; }
+    /// @brief Waits until everything muxed has been written.
+    void finish() override;
+
+    fd_video_output_t(const fd_video_output_t &) = delete;
+    fd_video_output_t &operator=(const fd_video_output_t &) = delete;
+
+  private:
+    fd_output_sink_t fd_sink_;
+    write_behind_output_sink_t sink_;
     AVIOContext *io_context_;
     AVFormatContext *format_context_;
+    constexpr static std::size_t buffer_size_ = 1 << 16;
+
+    // @brief Callback for `avio_alloc_context()`, writing to `sink_`.
+    static int write_packet(void *opaque, std::uint8_t *buf,
+                            int buf_size) noexcept;
 };
 
 class encoding_session_t {
@@ -127,6 +174,78 @@ class encoder_t {
         auto set_qr_codes(std::shared_ptr<std::vector<qrcodegen::QrCode>>
                               qr_codes) noexcept -> builder_t &;
 
+        /// @brief Set a lazily evaluated QR code sequence. QR codes are
+        /// pulled from the source while earlier frames are being rendered and
+        /// encoded. Takes precedence over `set_qr_codes()`.
+        auto set_qr_code_source(
+            std::shared_ptr<qr_code_source_t> source) noexcept -> builder_t &;
+
+        /// @brief Number of frames that may be rendered ahead of the libav
+        /// encoder. Bounds the memory held between the render and encode
+        /// stages; frames the encoder holds on to with frame threading come
+        /// on top.
+        auto set_pipeline_depth(const size_t depth) noexcept -> builder_t &;
+
+        /// @brief Threads of the libav encoder, zero for one per core, and
+        /// the kinds of threading it may use. Frames are pooled and
+        /// reference-counted, so a frame-threaded encoder keeps several in
+        /// flight without copying them. Defaults to one thread per core and
+        /// any kind of threading.
+        auto set_codec_threads(const size_t threads,
+                               const codec_threading_t threading =
+                                   codec_threading_t::any) noexcept
+            -> builder_t &;
+
+        /// @brief Encode on `encoders` threads at once, each rendering and
+        /// encoding segments of consecutive frames with a libav encoder of
+        /// its own. Every segment is a closed run of whole GOPs; the packets
+        /// are muxed into the one output in order, as they came out of the
+        /// encoders. Zero or one encodes all frames with a single encoder.
+        /// Each encoder gets `set_codec_threads()` threads, so one per
+        /// encoder is usually best; `set_render_threads()` is ignored.
+        auto set_segment_encoders(const size_t encoders) noexcept
+            -> builder_t &;
+
+        /// @brief Number of threads each frame's module rows are rendered on.
+        /// Zero or one renders on the pipeline's render thread alone.
+        auto set_render_threads(const size_t threads) noexcept -> builder_t &;
+
+        /// @brief Pixel format of the encoded frames. Must be supported by
+        /// the format's codec. By default YUV420P is used if the codec
+        /// supports it, otherwise the codec's preferred format.
+        auto set_pixel_format(const AVPixelFormat pixel_format) noexcept
+            -> builder_t &;
+
+        /// @brief Pack a grid of QR codes, each with its own border, into
+        /// every frame, filled row by row. Tiles of the last frame that are
+        /// left over stay blank. Decode with the same grid, see
+        /// `decoder_t::builder_t::set_tiles()`.
+        /// @param columns Number of QR codes side by side
+        /// @param rows Number of QR codes on top of each other
+        auto set_tiles(const size_t columns, const size_t rows) noexcept
+            -> builder_t &;
+
+        /// @brief Draw independent QR codes into each color plane, e.g., the
+        /// Y, U and V planes of YUV444P, roughly tripling the payload per
+        /// frame. Needs a pixel format with separate full resolution 8-bit
+        /// planes, see `multiplexable_planes()`; defaults to YUV444P, which
+        /// the format's codec must support. Each plane holds the full grid
+        /// of tiles. Decode with
+        /// `decoder_t::builder_t::set_plane_multiplexing()`.
+        auto set_plane_multiplexing(const bool enabled) noexcept
+            -> builder_t &;
+
+        /// @brief Encode `payload` with the grid symbology instead of QR
+        /// codes: every frame is a `layout` grid carrying
+        /// `grid_codec_t::capacity()` bytes. Takes precedence over the QR code
+        /// settings. Needs a pixel format with 8-bit planar luma, such as the
+        /// default YUV420P. Decode with the same layout, see
+        /// `decoder_t::builder_t::set_grid()`.
+        /// @note `payload` must outlive the encoder.
+        auto set_grid(const grid_layout_t &layout,
+                      std::span<const std::uint8_t> payload) noexcept
+            -> builder_t &;
+
         /// @brief Set the video format to be encoded.
         /// @param video_format short name of the video format (e.g., "mp4")
         /// @see `$ ffmpeg -formats` for full list of supported formats on the
@@ -139,21 +258,59 @@ class encoder_t {
         auto set_scale(const size_t scale) noexcept -> builder_t &;
         auto set_fps(const int fps) noexcept -> builder_t &;
 
+        /// @brief Count frames and bytes and time the pipeline's stages into
+        /// `stats` while encoding; see `stage_t` for the encoder's stages.
+        /// Null, the default, collects nothing.
+        auto set_stats(std::shared_ptr<stats_t> stats) noexcept
+            -> builder_t &;
+
         [[nodiscard]] auto video_format() const noexcept -> std::string_view;
         [[nodiscard]] auto qr_codes() const noexcept
             -> std::shared_ptr<std::vector<qrcodegen::QrCode>>;
+        [[nodiscard]] auto qr_code_source() const noexcept
+            -> std::shared_ptr<qr_code_source_t>;
+        /// @brief How the QR code source cuts the payload into QR codes,
+        /// when it is a chunking source.
+        [[nodiscard]] auto chunk_plan() const -> std::optional<chunk_plan_t>;
+        /// @brief Number of video frames `encode()` will write, when the
+        /// QR code source knows its length.
+        [[nodiscard]] auto projected_frame_count() const
+            -> std::optional<std::uint64_t>;
+        /// @brief Approximate size in bytes of the encoded video, from the
+        /// frame count, frame rate and target bitrate; container overhead
+        /// is not included.
+        [[nodiscard]] auto projected_output_size() const
+            -> std::optional<std::uint64_t>;
         [[nodiscard]] auto build() const -> encoder_t;
 
       private:
         std::shared_ptr<std::vector<qrcodegen::QrCode>> qr_codes_;
+        std::shared_ptr<qr_code_source_t> qr_code_source_;
         std::string video_format_;
-        size_t scale_, border_size_;
-        int fps_;
+        size_t scale_ = 0, border_size_ = 0;
+        int fps_ = 0;
+        size_t pipeline_depth_ = 8;
+        size_t render_threads_ = 0;
+        size_t codec_threads_ = 0;
+        codec_threading_t codec_threading_ = codec_threading_t::any;
+        size_t segment_encoders_ = 0;
+        AVPixelFormat pixel_format_ = AV_PIX_FMT_NONE;
+        size_t tile_columns_ = 1, tile_rows_ = 1;
+        std::optional<grid_layout_t> grid_layout_;
+        std::span<const std::uint8_t> grid_payload_;
+        bool plane_multiplexing_ = false;
+        std::shared_ptr<stats_t> stats_;
     };
     static auto builder() -> builder_t { return builder_t{}; }
 
     auto encode(std::unique_ptr<video_output_t> destination) -> void;
 
+    /// @brief The object `encode()` fills in, if one was set with
+    /// `builder_t::set_stats()`.
+    [[nodiscard]] auto stats() const noexcept -> std::shared_ptr<stats_t> {
+        return stats_;
+    }
+
     encoder_t(const encoder_t &) = delete;
     encoder_t &operator=(const encoder_t &) = delete;
     encoder_t(encoder_t &&) noexcept = default;
@@ -161,17 +318,50 @@ class encoder_t {
     ~encoder_t() noexcept = default;
 
   private:
-    explicit encoder_t(std::shared_ptr<std::vector<qrcodegen::QrCode>> qr_codes,
+    explicit encoder_t(std::shared_ptr<qr_code_source_t> qr_code_source,
                        std::string video_format, const size_t scale,
-                       const size_t border_size, const int fps = 20) noexcept
-        : qr_codes_{qr_codes}, video_format_{video_format}, scale_{scale},
-          border_size_{border_size}, fps_{fps} {}
-    auto calculate_dimensions() const -> size_t;
-    std::shared_ptr<std::vector<qrcodegen::QrCode>> qr_codes_;
+                       const size_t border_size, const int fps = 20,
+                       const size_t pipeline_depth = 8,
+                       const size_t render_threads = 0,
+                       const AVPixelFormat pixel_format = AV_PIX_FMT_NONE,
+                       const size_t tile_columns = 1,
+                       const size_t tile_rows = 1,
+                       std::optional<grid_layout_t> grid_layout = std::nullopt,
+                       std::span<const std::uint8_t> grid_payload = {},
+                       const bool plane_multiplexing = false,
+                       const size_t codec_threads = 0,
+                       const codec_threading_t codec_threading =
+                           codec_threading_t::any,
+                       const size_t segment_encoders = 0,
+                       std::shared_ptr<stats_t> stats = nullptr) noexcept
+        : qr_code_source_{qr_code_source}, video_format_{video_format},
+          scale_{scale}, border_size_{border_size}, fps_{fps},
+          pipeline_depth_{pipeline_depth}, render_threads_{render_threads},
+          pixel_format_{pixel_format}, tile_columns_{tile_columns},
+          tile_rows_{tile_rows}, grid_layout_{grid_layout},
+          grid_payload_{grid_payload}, plane_multiplexing_{plane_multiplexing},
+          codec_threads_{codec_threads}, codec_threading_{codec_threading},
+          segment_encoders_{segment_encoders}, stats_{std::move(stats)} {}
+    /// @return Frame width and height in pixels
+    auto calculate_dimensions() const -> std::pair<size_t, size_t>;
+    std::shared_ptr<qr_code_source_t> qr_code_source_;
     std::string video_format_;
     size_t scale_, border_size_;
     int fps_;
+    size_t pipeline_depth_;
+    size_t render_threads_;
+    AVPixelFormat pixel_format_;
+    size_t tile_columns_, tile_rows_;
+    std::optional<grid_layout_t> grid_layout_;
+    std::span<const std::uint8_t> grid_payload_;
+    bool plane_multiplexing_;
+    size_t codec_threads_;
+    codec_threading_t codec_threading_;
+    size_t segment_encoders_;
+    std::shared_ptr<stats_t> stats_;
     constexpr static int gop_size_ = 12;
+    // Length of the segments of `set_segment_encoders()`, in GOPs
+    constexpr static int gops_per_segment_ = 8;
     constexpr static int bitrate_ = 400000;
 };
 
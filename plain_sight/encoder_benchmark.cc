@@ -0,0 +1,121 @@
+#include <benchmark/benchmark.h>
+
+#include "plain_sight/benchmark_util.h"
+#include "plain_sight/encoder.h"
+#include "plain_sight/frame_renderer.h"
+#include "plain_sight/qr_codes.h"
+#include "plain_sight/thread_pool.h"
+#include "plain_sight/util.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libavutil/pixdesc.h>
+}
+
+namespace {
+
+using net_zelcon::plain_sight::chunked_qr_code_source_t;
+using net_zelcon::plain_sight::encoder_t;
+using net_zelcon::plain_sight::frame_renderer_t;
+using net_zelcon::plain_sight::in_memory_video_output_t;
+using net_zelcon::plain_sight::libav_frame_ptr_t;
+using net_zelcon::plain_sight::qr_symbol_t;
+using net_zelcon::plain_sight::random_payload;
+using net_zelcon::plain_sight::split_frames;
+using net_zelcon::plain_sight::thread_pool_t;
+
+// Benchmark arguments index into this; the renderer has a dedicated path for
+// each of these, and falls back to a conversion for anything else.
+constexpr AVPixelFormat pixel_formats[] = {
+    AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUV444P, AV_PIX_FMT_NV12,
+    AV_PIX_FMT_GRAY8,   AV_PIX_FMT_RGB24,
+};
+
+// Arguments: pixel format (index into `pixel_formats`), scale.
+//
+// Renders distinct QR codes into one prepared frame, the per-frame work of
+// the encoder's render stage. Bytes are payload bytes carried by the QR
+// codes.
+void BM_RenderFrame(benchmark::State &state) {
+    const AVPixelFormat pixel_format = pixel_formats[state.range(0)];
+    const int scale = static_cast<int>(state.range(1));
+    const auto payload = random_payload(64 << 10);
+    std::vector<qr_symbol_t> qr_codes;
+    for (const auto &qr_code : split_frames(payload)) {
+        qr_codes.emplace_back(qr_code);
+    }
+    const auto renderer = frame_renderer_t::create(
+        pixel_format, qr_codes.front().size(), scale, 4);
+    libav_frame_ptr_t frame{av_frame_alloc(), av_frame_free};
+    frame->width = renderer->width();
+    frame->height = renderer->height();
+    frame->format = pixel_format;
+    if (av_frame_get_buffer(frame.get(), 32) < 0) {
+        state.SkipWithError("Could not allocate frame");
+        return;
+    }
+    renderer->prepare(frame.get());
+    std::size_t i = 0;
+    for (auto _ : state) {
+        renderer->render(frame.get(), qr_codes[i++ % qr_codes.size()]);
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations()) *
+                            static_cast<std::int64_t>(payload.size()) /
+                            static_cast<std::int64_t>(qr_codes.size()));
+    state.counters["frames_per_second"] = benchmark::Counter(
+        static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+    state.SetLabel(av_get_pix_fmt_name(pixel_format));
+}
+
+BENCHMARK(BM_RenderFrame)
+    ->ArgsProduct({benchmark::CreateDenseRange(
+                       0, std::size(pixel_formats) - 1, 1),
+                   {1, 4, 8}})
+    ->ArgNames({"format", "scale"});
+
+// Arguments: payload size in KiB, scale, pixel format (index into
+// `pixel_formats`).
+//
+// The whole encoder, QR code building included, into an in-memory MP4.
+void BM_Encode(benchmark::State &state) {
+    const auto payload =
+        random_payload(static_cast<std::size_t>(state.range(0)) << 10);
+    const auto scale = static_cast<std::size_t>(state.range(1));
+    const AVPixelFormat pixel_format = pixel_formats[state.range(2)];
+    const auto pool = std::make_shared<thread_pool_t>();
+    std::size_t frames = 0;
+    for (auto _ : state) {
+        const auto qr_codes =
+            std::make_shared<chunked_qr_code_source_t>(payload, pool);
+        frames += qr_codes->qr_code_count().value_or(0);
+        std::vector<std::uint8_t> video;
+        encoder_t::builder()
+            .set_border_size(4)
+            .set_fps(30)
+            .set_scale(scale)
+            .set_pixel_format(pixel_format)
+            .set_video_format("mp4")
+            .set_qr_code_source(qr_codes)
+            .build()
+            .encode(std::make_unique<in_memory_video_output_t>(video));
+        benchmark::DoNotOptimize(video.data());
+    }
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations()) *
+                            static_cast<std::int64_t>(payload.size()));
+    state.counters["frames_per_second"] = benchmark::Counter(
+        static_cast<double>(frames), benchmark::Counter::kIsRate);
+    state.SetLabel(av_get_pix_fmt_name(pixel_format));
+}
+
+BENCHMARK(BM_Encode)
+    ->ArgsProduct({{64, 1024}, {2, 4}, {0, 1}})
+    ->ArgNames({"KiB", "scale", "format"})
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+} // namespace
\ No newline at end of file
@@ -0,0 +1,160 @@
+#include "plain_sight/erasure_code.h"
+
+#include <algorithm>
+#include <array>
+#include <glog/logging.h>
+
+namespace net_zelcon::plain_sight {
+
+auto erasure_code_t::valid() const noexcept -> bool {
+    return !enabled() ||
+           (group_size > 0 && parity_chunks < 255 &&
+            group_size <= 255 - parity_chunks && interleaving > 0 &&
+            interleaving <= 0xffff &&
+            static_cast<std::uint64_t>(interleaving) * parity_chunks <=
+                max_stripe_parity);
+}
+
+auto erasure_code_t::stripe_count(const std::uint64_t chunk_count) const
+    -> std::uint64_t {
+    if (!enabled()) {
+        return 0;
+    }
+    return (chunk_count + stripe_size() - 1) / stripe_size();
+}
+
+auto erasure_code_t::group_count(const std::uint64_t chunk_count) const
+    -> std::uint64_t {
+    if (!enabled()) {
+        return 0;
+    }
+    // Full stripes, then a group per data chunk of the last stripe, up to
+    // `interleaving`
+    const std::uint64_t rest = chunk_count % stripe_size();
+    return chunk_count / stripe_size() * interleaving +
+           std::min<std::uint64_t>(rest, interleaving);
+}
+
+auto erasure_code_t::group_data_count(const std::uint64_t group,
+                                      const std::uint64_t chunk_count) const
+    -> std::uint32_t {
+    const std::uint64_t stripe = group / interleaving;
+    const std::uint64_t first = stripe * stripe_size();
+    if (first >= chunk_count) {
+        return 0;
+    }
+    const std::uint64_t in_stripe =
+        std::min(stripe_size(), chunk_count - first);
+    const std::uint64_t offset = group % interleaving;
+    if (offset >= in_stripe) {
+        return 0;
+    }
+    return static_cast<std::uint32_t>((in_stripe - offset + interleaving - 1) /
+                                      interleaving);
+}
+
+auto erasure_code_t::locate(const std::uint64_t sequence_number) const
+    -> std::pair<std::uint64_t, std::uint32_t> {
+    const std::uint64_t stripe = sequence_number / stripe_size();
+    const std::uint64_t offset = sequence_number % stripe_size();
+    return {stripe * interleaving + offset % interleaving,
+            static_cast<std::uint32_t>(offset / interleaving)};
+}
+
+auto erasure_code_t::data_chunk(const std::uint64_t group,
+                                const std::uint32_t index) const
+    -> std::uint64_t {
+    return group / interleaving * stripe_size() +
+           static_cast<std::uint64_t>(index) * interleaving +
+           group % interleaving;
+}
+
+auto erasure_code_t::overhead_before(
+    const std::uint64_t sequence_number) const -> std::uint64_t {
+    if (!enabled()) {
+        return 0;
+    }
+    return sequence_number / stripe_size() *
+           (static_cast<std::uint64_t>(interleaving) * parity_chunks + 1);
+}
+
+erasure_coder_t::erasure_coder_t(const erasure_code_t &code)
+    : code_{code}, reed_solomon_{code.parity_chunks} {
+    CHECK(code_.enabled());
+    CHECK(code_.valid()) << "Erasure code of " << code_.group_size << " + "
+                         << code_.parity_chunks << " chunks, interleaved "
+                         << code_.interleaving << " ways";
+}
+
+void erasure_coder_t::encode(
+    std::span<const std::span<const std::uint8_t>> data,
+    const std::size_t chunk_size,
+    std::vector<std::vector<std::uint8_t>> &parity) const {
+    CHECK(!data.empty());
+    CHECK_LE(data.size(), code_.group_size);
+    const std::size_t parity_size = code_.parity_chunks;
+    parity.resize(parity_size);
+    for (auto &chunk : parity) {
+        chunk.assign(chunk_size, 0);
+    }
+    // One codeword per byte position, across the chunks
+    std::array<std::uint8_t, 255> column{}, column_parity{};
+    for (std::size_t j = 0; j < chunk_size; ++j) {
+        for (std::size_t i = 0; i < data.size(); ++i) {
+            CHECK_LE(data[i].size(), chunk_size);
+            column[i] = j < data[i].size() ? data[i][j] : 0;
+        }
+        reed_solomon_.encode({column.data(), data.size()},
+                             {column_parity.data(), parity_size});
+        for (std::size_t i = 0; i < parity_size; ++i) {
+            parity[i][j] = column_parity[i];
+        }
+    }
+}
+
+auto erasure_coder_t::recover(std::span<std::vector<std::uint8_t>> chunks,
+                              const std::size_t data_count,
+                              const std::size_t chunk_size) const -> bool {
+    CHECK_GT(data_count, 0U);
+    CHECK_LE(data_count, code_.group_size);
+    CHECK_EQ(chunks.size(), data_count + code_.parity_chunks);
+    std::vector<std::size_t> erasures;
+    for (std::size_t i = 0; i < chunks.size(); ++i) {
+        if (chunks[i].empty()) {
+            erasures.push_back(i);
+        }
+    }
+    if (erasures.size() > code_.parity_chunks) {
+        return false;
+    }
+    if (std::none_of(erasures.begin(), erasures.end(),
+                     [data_count](const std::size_t i) {
+                         return i < data_count;
+                     })) {
+        return true;
+    }
+    std::array<std::uint8_t, 255> column{};
+    const std::span<std::uint8_t> codeword{column.data(), chunks.size()};
+    for (const std::size_t i : erasures) {
+        chunks[i].assign(chunk_size, 0);
+    }
+    for (std::size_t j = 0; j < chunk_size; ++j) {
+        for (std::size_t i = 0; i < chunks.size(); ++i) {
+            CHECK_LE(chunks[i].size(), chunk_size);
+            codeword[i] = j < chunks[i].size() ? chunks[i][j] : 0;
+        }
+        reed_solomon_.decode_erasures(codeword, erasures);
+        for (const std::size_t i : erasures) {
+            chunks[i][j] = codeword[i];
+        }
+    }
+    // Only the data chunks were asked for
+    for (const std::size_t i : erasures) {
+        if (i >= data_count) {
+            chunks[i].clear();
+        }
+    }
+    return true;
+}
+
+} // namespace net_zelcon::plain_sight
\ No newline at end of file
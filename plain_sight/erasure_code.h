@@ -0,0 +1,126 @@
+#ifndef _INCLUDE_NET_ZELCON_PLAIN_SIGHT_ERASURE_CODE_H_
+#define _INCLUDE_NET_ZELCON_PLAIN_SIGHT_ERASURE_CODE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "plain_sight/reed_solomon.h"
+
+namespace net_zelcon::plain_sight {
+
+/// @brief Reed-Solomon erasure code across the chunks of a
+/// `framing_t::sequenced` payload, which rebuilds chunks whose QR codes were
+/// lost, e.g., to a frame too damaged to decode.
+/// @details The data chunks are dealt into groups of up to `group_size`, and
+/// every group gets `parity_chunks` parity chunks of the full chunk size:
+/// byte `j` of the parity chunks is the Reed-Solomon parity of byte `j` of
+/// the group's data chunks, short chunks counting as zero padded. Any
+/// `parity_chunks` chunks of a group, data or parity, can be lost.
+/// `interleaving` consecutive groups make a stripe, whose data chunks are
+/// dealt to them round robin and followed by their parity chunks, dealt the
+/// same way, and by the manifest again, so that losing the first one loses
+/// nothing. A run of up to `interleaving * parity_chunks` lost QR codes,
+/// say a few frames of tiles, is thus spread over the groups of a stripe.
+/// Parity chunk `n` is parity chunk `n % parity_chunks` of group
+/// `n / parity_chunks`.
+struct erasure_code_t {
+    /// @brief Data chunks per group, at most `255 - parity_chunks`.
+    std::uint32_t group_size = 0;
+    /// @brief Parity chunks per group; 0 turns the code off.
+    std::uint32_t parity_chunks = 0;
+    /// @brief Groups per stripe, 1 to 65535, and at most
+    /// `max_stripe_parity / parity_chunks`.
+    std::uint32_t interleaving = 1;
+
+    /// @brief Most parity chunks of a stripe, which the encoder builds
+    /// together.
+    static constexpr std::uint64_t max_stripe_parity = 1024;
+
+    [[nodiscard]] auto enabled() const noexcept -> bool {
+        return parity_chunks > 0;
+    }
+    /// @brief Whether the parameters are in range; always true when off.
+    [[nodiscard]] auto valid() const noexcept -> bool;
+    /// @brief Data chunks per stripe.
+    [[nodiscard]] auto stripe_size() const noexcept -> std::uint64_t {
+        return static_cast<std::uint64_t>(group_size) * interleaving;
+    }
+    /// @brief Number of groups of `chunk_count` data chunks; the last
+    /// stripe's may be fewer, and smaller, than the others.
+    [[nodiscard]] auto group_count(std::uint64_t chunk_count) const
+        -> std::uint64_t;
+    /// @brief Number of parity chunks of `chunk_count` data chunks.
+    [[nodiscard]] auto parity_count(std::uint64_t chunk_count) const
+        -> std::uint64_t {
+        return group_count(chunk_count) * parity_chunks;
+    }
+    /// @brief Number of stripes of `chunk_count` data chunks, and so of
+    /// repeated manifests.
+    [[nodiscard]] auto stripe_count(std::uint64_t chunk_count) const
+        -> std::uint64_t;
+    /// @brief Number of QR codes the code adds to `chunk_count` data
+    /// chunks: parity chunks and repeated manifests.
+    [[nodiscard]] auto overhead_count(std::uint64_t chunk_count) const
+        -> std::uint64_t {
+        return parity_count(chunk_count) + stripe_count(chunk_count);
+    }
+    /// @brief Number of data chunks in `group`.
+    [[nodiscard]] auto group_data_count(std::uint64_t group,
+                                        std::uint64_t chunk_count) const
+        -> std::uint32_t;
+    /// @brief Group of data chunk `sequence_number`, and its index there.
+    [[nodiscard]] auto locate(std::uint64_t sequence_number) const
+        -> std::pair<std::uint64_t, std::uint32_t>;
+    /// @brief Sequence number of data chunk `index` of `group`.
+    [[nodiscard]] auto data_chunk(std::uint64_t group,
+                                  std::uint32_t index) const -> std::uint64_t;
+    /// @brief Number of QR codes the code adds before data chunk
+    /// `sequence_number`: the parity chunks and repeated manifests of the
+    /// stripes before its own.
+    [[nodiscard]] auto overhead_before(std::uint64_t sequence_number) const
+        -> std::uint64_t;
+
+    auto operator==(const erasure_code_t &) const -> bool = default;
+};
+
+/// @brief Computes and applies the parity of the groups of an
+/// `erasure_code_t`. Instances are immutable and safe to share between
+/// threads.
+class erasure_coder_t {
+  public:
+    /// @param code Must be enabled and valid
+    explicit erasure_coder_t(const erasure_code_t &code);
+
+    [[nodiscard]] auto code() const noexcept -> const erasure_code_t & {
+        return code_;
+    }
+
+    /// @brief Computes the parity chunks of a group of data chunks, each at
+    /// most `chunk_size` bytes, into `parity`, which is resized to
+    /// `code().parity_chunks` chunks of `chunk_size` bytes.
+    void encode(std::span<const std::span<const std::uint8_t>> data,
+                std::size_t chunk_size,
+                std::vector<std::vector<std::uint8_t>> &parity) const;
+
+    /// @brief Rebuilds the lost data chunks of a group.
+    /// @param chunks The group's `data_count` data chunks, followed by its
+    /// parity chunks; lost ones are empty, the others are intact and at
+    /// most `chunk_size` bytes. Rebuilt data chunks are `chunk_size` bytes,
+    /// zero padded.
+    /// @return false, having changed nothing, if more chunks are lost than
+    /// there are parity chunks
+    auto recover(std::span<std::vector<std::uint8_t>> chunks,
+                 std::size_t data_count, std::size_t chunk_size) const
+        -> bool;
+
+  private:
+    erasure_code_t code_;
+    reed_solomon_t reed_solomon_;
+};
+
+} // namespace net_zelcon::plain_sight
+
+#endif // _INCLUDE_NET_ZELCON_PLAIN_SIGHT_ERASURE_CODE_H_
\ No newline at end of file
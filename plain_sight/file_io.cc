@@ -0,0 +1,565 @@
+#include "plain_sight/file_io.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fmt/core.h>
+#include <glog/logging.h>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef PLAIN_SIGHT_HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+extern "C" {
+#include <libavutil/error.h>
+#include <libavutil/mem.h>
+}
+
+namespace net_zelcon::plain_sight {
+
+namespace {
+
+// Alignment of `O_DIRECT` buffers, offsets and lengths; a multiple of the
+// logical block size of any device we write to
+constexpr std::size_t alignment = 4096;
+
+using aligned_buffer_t = std::unique_ptr<std::uint8_t[], decltype(&std::free)>;
+
+auto allocate_aligned(const std::size_t size) -> aligned_buffer_t {
+    void *const buffer = std::aligned_alloc(alignment, size);
+    CHECK(buffer != nullptr) << "Could not allocate " << size << " bytes";
+    return {static_cast<std::uint8_t *>(buffer), &std::free};
+}
+
+[[noreturn]] void fail(const std::string &what,
+                       const std::filesystem::path &path, const int error) {
+    LOG(ERROR) << "Could not " << what << " " << path << ": "
+               << std::strerror(error);
+    throw std::runtime_error{fmt::format("Could not {} {}: {}", what,
+                                         path.string(),
+                                         std::strerror(error))};
+}
+
+} // namespace
+
+/// @brief A block of the file in an aligned buffer, and the request moving
+/// it to or from the file.
+struct file_io_t::slot_t {
+    aligned_buffer_t buffer{nullptr, &std::free};
+    // File offset of `buffer[0]`
+    std::int64_t offset = 0;
+    // Bytes of the request, and bytes to transfer before it is complete:
+    // fewer for a read of the end of the file.
+    std::size_t length = 0;
+    std::size_t expected = 0;
+    // Bytes transferred, by the whole request and by its last part
+    std::size_t done = 0;
+    std::size_t last = 0;
+    // `errno` of a failed request
+    int error = 0;
+    bool write = false;
+    bool in_flight = false;
+
+    void reset(const std::int64_t block_offset, const std::size_t size) {
+        offset = block_offset;
+        length = expected = size;
+        done = last = 0;
+        error = 0;
+    }
+};
+
+/// @brief Carries out requests for slots, completing them in any order.
+class file_io_t::queue_t {
+  public:
+    virtual ~queue_t() noexcept = default;
+    /// @brief Starts transferring the bytes of `slot` from `slot.done` on.
+    virtual void submit(slot_t &slot) = 0;
+    /// @brief Waits for a request to complete, records the outcome in its
+    /// slot and returns the slot.
+    virtual auto wait() -> slot_t & = 0;
+    [[nodiscard]] virtual auto is_io_uring() const noexcept -> bool = 0;
+
+  protected:
+    static void record(slot_t &slot, const std::int64_t result) {
+        if (result < 0) {
+            slot.error = static_cast<int>(-result);
+            slot.last = 0;
+        } else {
+            slot.last = static_cast<std::size_t>(result);
+            slot.done += slot.last;
+        }
+    }
+};
+
+/// @brief Carries out each request with one `pread` or `pwrite` as it is
+/// submitted.
+class file_io_t::pread_queue_t : public file_io_t::queue_t {
+  public:
+    explicit pread_queue_t(const int fd) : fd_{fd} {}
+
+    void submit(slot_t &slot) override {
+        std::uint8_t *const buffer = slot.buffer.get() + slot.done;
+        const std::size_t size = slot.length - slot.done;
+        const auto offset = static_cast<off_t>(slot.offset + slot.done);
+        ssize_t result;
+        do {
+            result = slot.write ? ::pwrite(fd_, buffer, size, offset)
+                                : ::pread(fd_, buffer, size, offset);
+        } while (result < 0 && errno == EINTR);
+        record(slot, result < 0 ? -errno : result);
+        completed_.push_back(&slot);
+    }
+
+    auto wait() -> slot_t & override {
+        CHECK(!completed_.empty()) << "No request in flight";
+        slot_t &slot = *completed_.front();
+        completed_.pop_front();
+        return slot;
+    }
+
+    [[nodiscard]] auto is_io_uring() const noexcept -> bool override {
+        return false;
+    }
+
+  private:
+    int fd_;
+    std::deque<slot_t *> completed_;
+};
+
+#ifdef PLAIN_SIGHT_HAVE_LIBURING
+/// @brief Submits requests to an io_uring of its own, so that they run
+/// while the caller demuxes or muxes.
+class file_io_t::uring_queue_t : public file_io_t::queue_t {
+  public:
+    /// @return null if the kernel does not allow io_uring, e.g., under a
+    /// seccomp policy
+    static auto create(const int fd, const unsigned depth)
+        -> std::unique_ptr<uring_queue_t> {
+        std::unique_ptr<uring_queue_t> queue{new uring_queue_t{fd}};
+        const int err = io_uring_queue_init(depth, &queue->ring_, 0);
+        if (err < 0) {
+            LOG(WARNING) << "Could not set up io_uring, using pread/pwrite: "
+                         << std::strerror(-err);
+            return nullptr;
+        }
+        queue->initialized_ = true;
+        return queue;
+    }
+
+    ~uring_queue_t() noexcept override {
+        if (initialized_) {
+            io_uring_queue_exit(&ring_);
+        }
+    }
+
+    void submit(slot_t &slot) override {
+        io_uring_sqe *const sqe = io_uring_get_sqe(&ring_);
+        CHECK(sqe != nullptr) << "More requests than the queue depth";
+        std::uint8_t *const buffer = slot.buffer.get() + slot.done;
+        const auto size = static_cast<unsigned>(slot.length - slot.done);
+        const auto offset = static_cast<__u64>(slot.offset + slot.done);
+        if (slot.write) {
+            io_uring_prep_write(sqe, fd_, buffer, size, offset);
+        } else {
+            io_uring_prep_read(sqe, fd_, buffer, size, offset);
+        }
+        io_uring_sqe_set_data(sqe, &slot);
+        const int err = io_uring_submit(&ring_);
+        if (err < 0) {
+            record(slot, err);
+            failed_.push_back(&slot);
+        }
+    }
+
+    auto wait() -> slot_t & override {
+        if (!failed_.empty()) {
+            slot_t &slot = *failed_.front();
+            failed_.pop_front();
+            return slot;
+        }
+        io_uring_cqe *cqe = nullptr;
+        int err;
+        do {
+            err = io_uring_wait_cqe(&ring_, &cqe);
+        } while (err == -EINTR);
+        CHECK_EQ(err, 0) << "Could not wait for io_uring completion: "
+                         << std::strerror(-err);
+        slot_t &slot = *static_cast<slot_t *>(io_uring_cqe_get_data(cqe));
+        record(slot, cqe->res);
+        io_uring_cqe_seen(&ring_, cqe);
+        return slot;
+    }
+
+    [[nodiscard]] auto is_io_uring() const noexcept -> bool override {
+        return true;
+    }
+
+  private:
+    explicit uring_queue_t(const int fd) : fd_{fd} {}
+
+    int fd_;
+    io_uring ring_{};
+    bool initialized_ = false;
+    // Requests that could not be submitted, completed with their error
+    std::deque<slot_t *> failed_;
+};
+#endif
+
+file_io_t::file_io_t(const std::filesystem::path &path, const mode_t mode,
+                     const file_io_options_t &options)
+    : path_{path}, mode_{mode}, buffer_size_{options.buffer_size} {
+    CHECK_GT(options.buffer_size, 0UL);
+    CHECK_EQ(options.buffer_size % alignment, 0UL)
+        << "Buffer size must be a multiple of " << alignment;
+    CHECK_GT(options.queue_depth, 0UL);
+    const int flags = mode == mode_t::read
+                          ? O_RDONLY | O_CLOEXEC
+                          : O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+    if (options.direct) {
+        fd_ = ::open(path.c_str(), flags | O_DIRECT, 0644);
+        if (fd_ >= 0) {
+            direct_ = true;
+        } else if (errno == EINVAL) {
+            LOG(WARNING) << "File system of " << path
+                         << " does not support O_DIRECT, using buffered I/O";
+        }
+    }
+    if (fd_ < 0) {
+        fd_ = ::open(path.c_str(), flags, 0644);
+    }
+    if (fd_ < 0) {
+        fail("open", path, errno);
+    }
+    if (mode == mode_t::read) {
+        struct stat status {};
+        if (::fstat(fd_, &status) != 0) {
+            const int error = errno;
+            ::close(fd_);
+            fail("stat", path, error);
+        }
+        size_ = status.st_size;
+    }
+#ifdef PLAIN_SIGHT_HAVE_LIBURING
+    if (options.io_uring) {
+        queue_ = uring_queue_t::create(
+            fd_, static_cast<unsigned>(options.queue_depth));
+    }
+#endif
+    if (!queue_) {
+        queue_ = std::make_unique<pread_queue_t>(fd_);
+    }
+    for (std::size_t i = 0; i < options.queue_depth; ++i) {
+        auto &slot = slots_.emplace_back(std::make_unique<slot_t>());
+        slot->buffer = allocate_aligned(buffer_size_);
+        slot->write = mode == mode_t::write;
+        free_.push_back(slot.get());
+    }
+    auto *const buffer =
+        static_cast<std::uint8_t *>(av_malloc(avio_buffer_size_));
+    CHECK(buffer != nullptr) << "Could not allocate AVIO buffer";
+    io_context_ = avio_alloc_context(
+        buffer, avio_buffer_size_, mode == mode_t::write ? 1 : 0, this,
+        mode == mode_t::read ? &read_packet : nullptr,
+        mode == mode_t::write ? &write_packet : nullptr, &seek);
+    CHECK(io_context_ != nullptr) << "Could not allocate AVIO context";
+}
+
+file_io_t::~file_io_t() noexcept {
+    try {
+        close();
+    } catch (const std::exception &) {
+        // Logged by `close()`
+    }
+    av_freep(&io_context_->buffer);
+    avio_context_free(&io_context_);
+}
+
+auto file_io_t::uses_io_uring() const noexcept -> bool {
+    return queue_->is_io_uring();
+}
+
+void file_io_t::close() {
+    if (fd_ < 0) {
+        return;
+    }
+    if (mode_ == mode_t::write) {
+        avio_flush(io_context_);
+        if (current_ != nullptr && current_->length > 0) {
+            // `O_DIRECT` writes whole aligned blocks; the padding is cut off
+            // below.
+            if (direct_) {
+                const std::size_t padded =
+                    (current_->length + alignment - 1) / alignment * alignment;
+                std::fill(current_->buffer.get() + current_->length,
+                          current_->buffer.get() + padded, 0);
+                current_->length = current_->expected = padded;
+            }
+            submit(*current_);
+            current_ = nullptr;
+        }
+    }
+    drain();
+    if (mode_ == mode_t::write && error_ == 0 && direct_ &&
+        ::ftruncate(fd_, size_) != 0) {
+        error_ = errno;
+    }
+    if (::close(fd_) != 0 && error_ == 0) {
+        error_ = errno;
+    }
+    fd_ = -1;
+    if (mode_ == mode_t::write && error_ != 0) {
+        fail("write", path_, error_);
+    }
+}
+
+int file_io_t::read_packet(void *opaque, std::uint8_t *buf,
+                           int buf_size) noexcept {
+    CHECK(opaque != nullptr) << "Opaque pointer is null. It should point to a "
+                                "`file_io_t`.";
+    return static_cast<file_io_t *>(opaque)->read(
+        buf, static_cast<std::size_t>(buf_size));
+}
+
+int file_io_t::write_packet(void *opaque, std::uint8_t *buf,
+                            int buf_size) noexcept {
+    CHECK(opaque != nullptr) << "Opaque pointer is null. It should point to a "
+                                "`file_io_t`.";
+    return static_cast<file_io_t *>(opaque)->write(
+        buf, static_cast<std::size_t>(buf_size));
+}
+
+std::int64_t file_io_t::seek(void *opaque, std::int64_t offset,
+                             int whence) noexcept {
+    CHECK(opaque != nullptr) << "Opaque pointer is null. It should point to a "
+                                "`file_io_t`.";
+    auto *const self = static_cast<file_io_t *>(opaque);
+    std::int64_t position;
+    switch (whence & ~AVSEEK_FORCE) {
+    case SEEK_SET:
+        position = offset;
+        break;
+    case SEEK_CUR:
+        position = self->position_ + offset;
+        break;
+    case SEEK_END:
+        position = self->size_ + offset;
+        break;
+    case AVSEEK_SIZE:
+        return self->size_;
+    default:
+        LOG(ERROR) << "Invalid whence value: " << whence;
+        return AVERROR(EINVAL);
+    }
+    if (position < 0) {
+        LOG(ERROR) << "Invalid offset value: " << offset;
+        return AVERROR(EINVAL);
+    }
+    self->position_ = position;
+    return position;
+}
+
+auto file_io_t::read(std::uint8_t *dst, const std::size_t size) -> int {
+    if (position_ >= size_) {
+        return AVERROR_EOF;
+    }
+    const auto block_size = static_cast<std::int64_t>(buffer_size_);
+    if (ahead_.empty() || position_ < ahead_.front()->offset ||
+        position_ >= ahead_.back()->offset + block_size) {
+        // A seek, or the end of what was read ahead
+        while (!ahead_.empty()) {
+            release_front();
+        }
+        next_offset_ = position_ / block_size * block_size;
+    } else {
+        while (ahead_.front()->offset + block_size <= position_) {
+            release_front();
+        }
+    }
+    read_ahead();
+    const slot_t &slot = *ahead_.front();
+    await(slot);
+    if (slot.error != 0) {
+        LOG(ERROR) << "Could not read " << path_ << " at " << slot.offset
+                   << ": " << std::strerror(slot.error);
+        return AVERROR(slot.error);
+    }
+    const std::int64_t available =
+        slot.offset + static_cast<std::int64_t>(slot.done) - position_;
+    if (available <= 0) {
+        return AVERROR_EOF;
+    }
+    const auto count =
+        static_cast<std::size_t>(std::min<std::int64_t>(available, size));
+    std::copy_n(slot.buffer.get() + (position_ - slot.offset), count, dst);
+    position_ += static_cast<std::int64_t>(count);
+    return static_cast<int>(count);
+}
+
+void file_io_t::read_ahead() {
+    while (!free_.empty() && next_offset_ < size_) {
+        slot_t &slot = *free_.back();
+        free_.pop_back();
+        slot.reset(next_offset_, buffer_size_);
+        slot.expected = static_cast<std::size_t>(std::min<std::int64_t>(
+            static_cast<std::int64_t>(buffer_size_), size_ - next_offset_));
+        submit(slot);
+        ahead_.push_back(&slot);
+        next_offset_ += static_cast<std::int64_t>(buffer_size_);
+    }
+}
+
+void file_io_t::release_front() {
+    slot_t &slot = *ahead_.front();
+    ahead_.pop_front();
+    // The buffer cannot be reused while the kernel may write to it.
+    await(slot);
+    free_.push_back(&slot);
+}
+
+auto file_io_t::write(const std::uint8_t *src, std::size_t size) -> int {
+    if (error_ != 0) {
+        LOG(ERROR) << "Could not write " << path_ << ": "
+                   << std::strerror(error_);
+        return AVERROR(error_);
+    }
+    const auto written = static_cast<int>(size);
+    if (position_ < size_) {
+        // The muxer went back, e.g., to fill in a header.
+        const auto overlap = static_cast<std::size_t>(
+            std::min<std::int64_t>(size_ - position_, size));
+        const int err = patch(src, overlap);
+        if (err < 0) {
+            return err;
+        }
+        position_ += static_cast<std::int64_t>(overlap);
+        src += overlap;
+        size -= overlap;
+    }
+    if (size > 0) {
+        // A seek past the end leaves a hole, filled with zeros.
+        static const std::uint8_t zeros[alignment] = {};
+        while (position_ > size_) {
+            append(zeros, static_cast<std::size_t>(std::min<std::int64_t>(
+                              position_ - size_, sizeof(zeros))));
+        }
+        append(src, size);
+        position_ = size_;
+    }
+    return error_ != 0 ? AVERROR(error_) : written;
+}
+
+void file_io_t::append(const std::uint8_t *src, std::size_t size) {
+    while (size > 0) {
+        if (current_ == nullptr) {
+            while (free_.empty()) {
+                wait_one();
+            }
+            current_ = free_.back();
+            free_.pop_back();
+            current_->reset(size_, 0);
+        }
+        const std::size_t count =
+            std::min(size, buffer_size_ - current_->length);
+        std::copy_n(src, count, current_->buffer.get() + current_->length);
+        current_->length += count;
+        current_->expected = current_->length;
+        size_ += static_cast<std::int64_t>(count);
+        src += count;
+        size -= count;
+        if (current_->length == buffer_size_) {
+            submit(*current_);
+            current_ = nullptr;
+        }
+    }
+}
+
+auto file_io_t::patch(const std::uint8_t *src, std::size_t size) -> int {
+    drain();
+    // The part in the block being filled is patched in memory.
+    if (current_ != nullptr && position_ + static_cast<std::int64_t>(size) >
+                                   current_->offset) {
+        const std::int64_t begin = std::max(position_, current_->offset);
+        const auto skip = static_cast<std::size_t>(begin - position_);
+        std::copy_n(src + skip, size - skip,
+                    current_->buffer.get() + (begin - current_->offset));
+        size = skip;
+    }
+    // The rest is in the file already. Patches are small and rare, so they
+    // are written synchronously, through the page cache.
+    if (direct_ && ::fcntl(fd_, F_SETFL, ::fcntl(fd_, F_GETFL) & ~O_DIRECT) !=
+                       0) {
+        error_ = errno;
+    }
+    for (std::size_t done = 0; done < size && error_ == 0;) {
+        const ssize_t result =
+            ::pwrite(fd_, src + done, size - done, position_ + done);
+        if (result < 0 && errno != EINTR) {
+            error_ = errno;
+        } else if (result > 0) {
+            done += static_cast<std::size_t>(result);
+        }
+    }
+    if (direct_ && ::fcntl(fd_, F_SETFL, ::fcntl(fd_, F_GETFL) | O_DIRECT) !=
+                       0 && error_ == 0) {
+        error_ = errno;
+    }
+    if (error_ != 0) {
+        LOG(ERROR) << "Could not write " << path_ << " at " << position_
+                   << ": " << std::strerror(error_);
+        return AVERROR(error_);
+    }
+    return 0;
+}
+
+void file_io_t::submit(slot_t &slot) {
+    slot.in_flight = true;
+    ++in_flight_;
+    queue_->submit(slot);
+}
+
+void file_io_t::complete(slot_t &slot) {
+    if (slot.error == 0 && slot.done < slot.expected) {
+        if (slot.last > 0) {
+            // A short transfer; request the rest.
+            queue_->submit(slot);
+            return;
+        }
+        if (slot.write) {
+            slot.error = EIO;
+        } else {
+            // The file is shorter than it was when opened.
+            slot.expected = slot.done;
+        }
+    }
+    slot.in_flight = false;
+    --in_flight_;
+    if (slot.write) {
+        if (slot.error != 0 && error_ == 0) {
+            error_ = slot.error;
+        }
+        free_.push_back(&slot);
+    }
+}
+
+void file_io_t::wait_one() { complete(queue_->wait()); }
+
+void file_io_t::await(const slot_t &slot) {
+    while (slot.in_flight) {
+        wait_one();
+    }
+}
+
+void file_io_t::drain() {
+    while (in_flight_ > 0) {
+        wait_one();
+    }
+}
+
+} // namespace net_zelcon::plain_sight
\ No newline at end of file
@@ -0,0 +1,123 @@
+#ifndef _INCLUDE_NET_ZELCON_PLAIN_SIGHT_FILE_IO_H_
+#define _INCLUDE_NET_ZELCON_PLAIN_SIGHT_FILE_IO_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+extern "C" {
+#include <libavformat/avio.h>
+}
+
+namespace net_zelcon::plain_sight {
+
+/// @brief How `file_io_t` reads and writes a file.
+struct file_io_options_t {
+    /// @brief Bytes per read or write request; a multiple of 4096.
+    std::size_t buffer_size = 1 << 20;
+    /// @brief Requests in flight at once: blocks read ahead of the demuxer,
+    /// or written behind the muxer.
+    std::size_t queue_depth = 4;
+    /// @brief Open the file with `O_DIRECT`, bypassing the page cache. File
+    /// systems that refuse it get buffered I/O, with a warning.
+    bool direct = false;
+    /// @brief Submit requests through io_uring, if built with liburing and
+    /// the kernel allows it. Otherwise requests are carried out with
+    /// `pread`/`pwrite` on the calling thread, still in large blocks.
+    bool io_uring = true;
+};
+
+/// @brief A file read or written through an `AVIOContext` backed by large,
+/// aligned buffers, in place of libav's file protocol and its small blocking
+/// reads and writes.
+/// @details Reads are sequential blocks of `buffer_size` bytes, up to
+/// `queue_depth` of them requested ahead of the demuxer; a seek outside of
+/// them starts over at the new position. Writes fill one block at a time and
+/// leave it to complete while the next is filled; the muxer's seeks back to
+/// patch headers wait for the writes in flight and patch the file, or the
+/// block being filled, in place.
+class file_io_t {
+  public:
+    enum class mode_t { read, write };
+
+    /// @brief Opens `path` to read, or creates or truncates it to write.
+    /// @throws std::runtime_error if the file cannot be opened
+    file_io_t(const std::filesystem::path &path, mode_t mode,
+              const file_io_options_t &options = {});
+    /// @brief Closes the file, logging any error; see `close()`.
+    ~file_io_t() noexcept;
+
+    file_io_t(const file_io_t &) = delete;
+    file_io_t &operator=(const file_io_t &) = delete;
+
+    /// @brief The context to set as `AVFormatContext::pb`, together with
+    /// `AVFMT_FLAG_CUSTOM_IO`. Owned by this object.
+    [[nodiscard]] auto io_context() const noexcept -> AVIOContext * {
+        return io_context_;
+    }
+
+    /// @brief Whether requests go through io_uring.
+    [[nodiscard]] auto uses_io_uring() const noexcept -> bool;
+
+    /// @brief Writes out everything the context and this object buffer,
+    /// waits for it to reach the file and closes it. Does nothing after the
+    /// first call.
+    /// @throws std::runtime_error if a write failed
+    void close();
+
+  private:
+    struct slot_t;
+    class queue_t;
+    class pread_queue_t;
+    class uring_queue_t;
+
+    // Callbacks for `avio_alloc_context()`, with `opaque` pointing to `this`
+    static int read_packet(void *opaque, std::uint8_t *buf,
+                           int buf_size) noexcept;
+    static int write_packet(void *opaque, std::uint8_t *buf,
+                            int buf_size) noexcept;
+    static std::int64_t seek(void *opaque, std::int64_t offset,
+                             int whence) noexcept;
+
+    auto read(std::uint8_t *dst, std::size_t size) -> int;
+    auto write(const std::uint8_t *src, std::size_t size) -> int;
+    void append(const std::uint8_t *src, std::size_t size);
+    auto patch(const std::uint8_t *src, std::size_t size) -> int;
+    void read_ahead();
+    void release_front();
+    void submit(slot_t &slot);
+    void complete(slot_t &slot);
+    void wait_one();
+    void await(const slot_t &slot);
+    void drain();
+
+    std::filesystem::path path_;
+    mode_t mode_;
+    std::size_t buffer_size_;
+    int fd_ = -1;
+    bool direct_ = false;
+    // Size of the file when reading; bytes written so far when writing
+    std::int64_t size_ = 0;
+    std::int64_t position_ = 0;
+    std::unique_ptr<queue_t> queue_;
+    std::vector<std::unique_ptr<slot_t>> slots_;
+    std::vector<slot_t *> free_;
+    std::size_t in_flight_ = 0;
+    // Reading: blocks requested, in file order, and where the next one
+    // starts
+    std::deque<slot_t *> ahead_;
+    std::int64_t next_offset_ = 0;
+    // Writing: the block being filled, and the first error of a write
+    slot_t *current_ = nullptr;
+    int error_ = 0;
+    AVIOContext *io_context_ = nullptr;
+    // Size of the `AVIOContext`'s own buffer, between libav and the blocks
+    constexpr static std::size_t avio_buffer_size_ = 1 << 16;
+};
+
+} // namespace net_zelcon::plain_sight
+
+#endif // _INCLUDE_NET_ZELCON_PLAIN_SIGHT_FILE_IO_H_
\ No newline at end of file
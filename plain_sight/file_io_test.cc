@@ -0,0 +1,127 @@
+#include <gtest/gtest.h>
+
+#include "plain_sight/file_io.h"
+#include "plain_sight/util.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <libavformat/avio.h>
+}
+
+using namespace net_zelcon::plain_sight;
+
+namespace {
+
+auto some_bytes(const std::size_t size) -> std::vector<std::uint8_t> {
+    std::vector<std::uint8_t> bytes(size);
+    std::mt19937 rng{1};
+    std::generate(bytes.begin(), bytes.end(),
+                  [&] { return static_cast<std::uint8_t>(rng()); });
+    return bytes;
+}
+
+auto temp_path(const std::string &name) -> std::filesystem::path {
+    return std::filesystem::temp_directory_path() / name;
+}
+
+// Small blocks, so that a few hundred kilobytes span many of them
+auto small_blocks(const bool direct, const bool io_uring)
+    -> file_io_options_t {
+    return {.buffer_size = 16 << 10,
+            .queue_depth = 3,
+            .direct = direct,
+            .io_uring = io_uring};
+}
+
+} // namespace
+
+class FileIoTest : public testing::TestWithParam<std::tuple<bool, bool>> {
+  protected:
+    auto options() const -> file_io_options_t {
+        return small_blocks(std::get<0>(GetParam()), std::get<1>(GetParam()));
+    }
+};
+
+TEST_P(FileIoTest, WritesInBlocksAndPatches) {
+    const auto path = temp_path("plain_sight_file_io_write");
+    auto expected = some_bytes(300'007);
+    {
+        file_io_t file{path, file_io_t::mode_t::write, options()};
+        AVIOContext *const io = file.io_context();
+        // Pieces of all sizes, like a muxer writing packets
+        std::size_t offset = 0;
+        for (std::size_t piece = 1; offset < expected.size(); piece *= 3) {
+            const std::size_t size =
+                std::min(piece % 50'000 + 1, expected.size() - offset);
+            avio_write(io, expected.data() + offset, static_cast<int>(size));
+            offset += size;
+        }
+        // Fill in a header written long ago, and one in the last block
+        const std::vector<std::uint8_t> header{1, 2, 3, 4, 5, 6, 7, 8};
+        for (const std::int64_t at : {10L, 299'000L}) {
+            ASSERT_EQ(avio_seek(io, at, SEEK_SET), at);
+            avio_write(io, header.data(), static_cast<int>(header.size()));
+            std::copy(header.begin(), header.end(), expected.begin() + at);
+        }
+        ASSERT_GE(avio_seek(io, 0, SEEK_END), 0);
+        file.close();
+    }
+    std::vector<std::uint8_t> written;
+    read_file(written, path);
+    std::filesystem::remove(path);
+    EXPECT_EQ(written.size(), expected.size());
+    EXPECT_TRUE(written == expected);
+}
+
+TEST_P(FileIoTest, ReadsAheadAndSeeks) {
+    const auto path = temp_path("plain_sight_file_io_read");
+    const auto expected = some_bytes(200'003);
+    {
+        file_io_t writer{path, file_io_t::mode_t::write};
+        avio_write(writer.io_context(), expected.data(),
+                   static_cast<int>(expected.size()));
+    }
+    file_io_t file{path, file_io_t::mode_t::read, options()};
+    AVIOContext *const io = file.io_context();
+    EXPECT_EQ(avio_size(io), static_cast<std::int64_t>(expected.size()));
+    std::vector<std::uint8_t> read(expected.size());
+    ASSERT_EQ(avio_read(io, read.data(), static_cast<int>(read.size())),
+              static_cast<int>(read.size()));
+    EXPECT_TRUE(read == expected);
+    // Back and forth, like a demuxer looking for its index
+    std::mt19937 rng{2};
+    for (int i = 0; i < 20; ++i) {
+        const std::int64_t at = rng() % expected.size();
+        const int size = static_cast<int>(
+            std::min<std::int64_t>(1 + rng() % 40'000, expected.size() - at));
+        ASSERT_EQ(avio_seek(io, at, SEEK_SET), at);
+        std::vector<std::uint8_t> part(size);
+        ASSERT_EQ(avio_read(io, part.data(), size), size);
+        EXPECT_TRUE(std::equal(part.begin(), part.end(),
+                               expected.begin() + at));
+    }
+    std::uint8_t byte;
+    ASSERT_EQ(avio_seek(io, 0, SEEK_END),
+              static_cast<std::int64_t>(expected.size()));
+    EXPECT_EQ(avio_read(io, &byte, 1), AVERROR_EOF);
+    std::filesystem::remove(path);
+}
+
+INSTANTIATE_TEST_SUITE_P(DirectAndUring, FileIoTest,
+                         testing::Combine(testing::Bool(), testing::Bool()));
+
+TEST(FileIoErrorTest, MissingFileThrows) {
+    EXPECT_THROW((file_io_t{"/nonexistent/plain_sight",
+                            file_io_t::mode_t::read}),
+                 std::runtime_error);
+    EXPECT_THROW((file_io_t{"/nonexistent/plain_sight",
+                            file_io_t::mode_t::write}),
+                 std::runtime_error);
+}
\ No newline at end of file
@@ -0,0 +1,71 @@
+#include "plain_sight/frame_pool.h"
+
+#include <glog/logging.h>
+#include <utility>
+
+extern "C" {
+#include <libavutil/imgutils.h>
+}
+
+namespace net_zelcon::plain_sight {
+
+frame_pool_t::frame_pool_t(const int width, const int height,
+                           const AVPixelFormat pixel_format, prepare_t prepare)
+    : width_{width}, height_{height}, pixel_format_{pixel_format},
+      prepare_{std::move(prepare)} {
+    const int size =
+        av_image_get_buffer_size(pixel_format_, width_, height_, align_);
+    CHECK_GT(size, 0) << "Could not compute frame buffer size: "
+                      << libav_error(size);
+    pool_ = av_buffer_pool_init2(static_cast<std::size_t>(size), this,
+                                 &allocate, nullptr);
+    CHECK(pool_ != nullptr) << "Could not allocate AVBufferPool";
+}
+
+frame_pool_t::~frame_pool_t() noexcept {
+    // Frees the pool once the last buffer in use comes back.
+    av_buffer_pool_uninit(&pool_);
+}
+
+auto frame_pool_t::allocate(void *opaque, const std::size_t size)
+    -> AVBufferRef * {
+    auto *const self = static_cast<frame_pool_t *>(opaque);
+    AVBufferRef *const buffer = av_buffer_alloc(size);
+    if (buffer != nullptr) {
+        std::lock_guard lock{self->mutex_};
+        ++self->buffer_count_;
+        self->fresh_.insert(buffer->data);
+    }
+    return buffer;
+}
+
+auto frame_pool_t::acquire() -> libav_frame_ptr_t {
+    libav_frame_ptr_t frame{av_frame_alloc(), av_frame_free};
+    CHECK(frame) << "Could not allocate frame";
+    frame->width = width_;
+    frame->height = height_;
+    frame->format = pixel_format_;
+    frame->buf[0] = av_buffer_pool_get(pool_);
+    CHECK(frame->buf[0] != nullptr) << "Could not allocate frame buffer";
+    const int err =
+        av_image_fill_arrays(frame->data, frame->linesize,
+                             frame->buf[0]->data, pixel_format_, width_,
+                             height_, align_);
+    CHECK_GE(err, 0) << "Could not lay out frame planes: " << libav_error(err);
+    bool fresh = false;
+    {
+        std::lock_guard lock{mutex_};
+        fresh = fresh_.erase(frame->buf[0]->data) > 0;
+    }
+    if (fresh && prepare_) {
+        prepare_(frame.get());
+    }
+    return frame;
+}
+
+auto frame_pool_t::buffer_count() const -> std::size_t {
+    std::lock_guard lock{mutex_};
+    return buffer_count_;
+}
+
+} // namespace net_zelcon::plain_sight
\ No newline at end of file
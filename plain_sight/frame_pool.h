@@ -0,0 +1,67 @@
+#ifndef _INCLUDE_NET_ZELCON_PLAIN_SIGHT_FRAME_POOL_H_
+#define _INCLUDE_NET_ZELCON_PLAIN_SIGHT_FRAME_POOL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <unordered_set>
+
+#include "plain_sight/util.h"
+
+extern "C" {
+#include <libavutil/buffer.h>
+#include <libavutil/frame.h>
+#include <libavutil/pixfmt.h>
+}
+
+namespace net_zelcon::plain_sight {
+
+/// @brief Reference-counted video frames of one size and pixel format, with
+/// buffers recycled through an `AVBufferPool`.
+/// @details Each frame from `acquire()` holds the only reference to one
+/// pooled buffer carrying all of its planes. The buffer goes back to the pool,
+/// contents intact, once every reference is gone: the caller's, and any a
+/// codec took with `av_frame_ref()` to keep the frame in flight. An encoder
+/// with frame threading can therefore hold several frames at once without
+/// copying them, and the pool only grows to as many buffers as are in use at
+/// the same time. Buffers outlive the pool if a codec still holds them.
+class frame_pool_t {
+  public:
+    /// @brief Draws what every frame has in common into a new buffer.
+    using prepare_t = std::function<void(AVFrame *)>;
+
+    /// @param prepare If set, called on a frame the first time its buffer is
+    /// handed out, and never again for that buffer.
+    frame_pool_t(int width, int height, AVPixelFormat pixel_format,
+                 prepare_t prepare = nullptr);
+    ~frame_pool_t() noexcept;
+
+    frame_pool_t(const frame_pool_t &) = delete;
+    frame_pool_t &operator=(const frame_pool_t &) = delete;
+
+    /// @brief A writable frame with a pooled buffer. Thread-safe.
+    auto acquire() -> libav_frame_ptr_t;
+
+    /// @brief Number of buffers allocated so far.
+    [[nodiscard]] auto buffer_count() const -> std::size_t;
+
+  private:
+    /// @brief Allocation callback of the `AVBufferPool`, `opaque` being
+    /// `this`.
+    static auto allocate(void *opaque, std::size_t size) -> AVBufferRef *;
+
+    const int width_, height_;
+    const AVPixelFormat pixel_format_;
+    const prepare_t prepare_;
+    AVBufferPool *pool_;
+    mutable std::mutex mutex_;
+    std::size_t buffer_count_ = 0;
+    // Buffers allocated but not yet prepared
+    std::unordered_set<const std::uint8_t *> fresh_;
+    constexpr static int align_ = 32;
+};
+
+} // namespace net_zelcon::plain_sight
+
+#endif // _INCLUDE_NET_ZELCON_PLAIN_SIGHT_FRAME_POOL_H_
\ No newline at end of file
@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+
+#include "plain_sight/frame_pool.h"
+#include "plain_sight/util.h"
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+using namespace net_zelcon::plain_sight;
+
+TEST(FramePoolTest, FramesHaveTheRequestedGeometry) {
+    frame_pool_t pool{64, 48, AV_PIX_FMT_YUV420P};
+    const auto frame = pool.acquire();
+    EXPECT_EQ(frame->width, 64);
+    EXPECT_EQ(frame->height, 48);
+    EXPECT_EQ(frame->format, AV_PIX_FMT_YUV420P);
+    ASSERT_NE(frame->buf[0], nullptr);
+    for (int plane = 0; plane < 3; ++plane) {
+        ASSERT_NE(frame->data[plane], nullptr);
+        EXPECT_GE(frame->linesize[plane], plane == 0 ? 64 : 32);
+        EXPECT_EQ(frame->linesize[plane] % 32, 0);
+    }
+    EXPECT_EQ(frame->data[3], nullptr);
+}
+
+TEST(FramePoolTest, RecyclesBuffersAndPreparesEachOnce) {
+    int prepared = 0;
+    frame_pool_t pool{32, 32, AV_PIX_FMT_GRAY8, [&](AVFrame *frame) {
+                          ++prepared;
+                          frame->data[0][0] = 42;
+                      }};
+    const std::uint8_t *data = nullptr;
+    {
+        const auto frame = pool.acquire();
+        EXPECT_EQ(frame->data[0][0], 42);
+        frame->data[0][1] = 7;
+        data = frame->data[0];
+    }
+    const auto frame = pool.acquire();
+    EXPECT_EQ(frame->data[0], data);
+    EXPECT_EQ(frame->data[0][0], 42);
+    EXPECT_EQ(frame->data[0][1], 7) << "Recycled buffers keep their contents";
+    EXPECT_EQ(prepared, 1);
+    EXPECT_EQ(pool.buffer_count(), 1U);
+}
+
+TEST(FramePoolTest, BuffersHeldElsewhereAreNotHandedOut) {
+    int prepared = 0;
+    frame_pool_t pool{32, 32, AV_PIX_FMT_GRAY8,
+                      [&](AVFrame *) { ++prepared; }};
+    // Like a frame-threaded encoder, keep references to the frames sent to
+    // it after the caller has let go of them.
+    std::vector<libav_frame_ptr_t> held;
+    for (int i = 0; i < 3; ++i) {
+        const auto frame = pool.acquire();
+        auto &ref = held.emplace_back(av_frame_alloc(), av_frame_free);
+        ASSERT_EQ(av_frame_ref(ref.get(), frame.get()), 0);
+    }
+    EXPECT_EQ(pool.buffer_count(), 3U);
+    EXPECT_EQ(prepared, 3);
+    for (std::size_t i = 0; i < held.size(); ++i) {
+        for (std::size_t j = i + 1; j < held.size(); ++j) {
+            EXPECT_NE(held[i]->data[0], held[j]->data[0]);
+        }
+    }
+    held.clear();
+    for (int i = 0; i < 3; ++i) {
+        pool.acquire();
+    }
+    EXPECT_EQ(pool.buffer_count(), 3U);
+    EXPECT_EQ(prepared, 3);
+}
+
+TEST(FramePoolTest, FramesOutliveThePool) {
+    std::optional<frame_pool_t> pool{std::in_place, 16, 16,
+                                     AV_PIX_FMT_GRAY8};
+    const auto frame = pool->acquire();
+    pool.reset();
+    frame->data[0][0] = 1;
+    EXPECT_EQ(frame->data[0][0], 1);
+}
\ No newline at end of file
@@ -0,0 +1,567 @@
+#include "plain_sight/frame_renderer.h"
+#include "plain_sight/qr_layout.h"
+#include "plain_sight/util.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <glog/logging.h>
+#include <optional>
+#include <utility>
+#include <vector>
+
+extern "C" {
+#include <libavutil/pixdesc.h>
+#include <libswscale/swscale.h>
+}
+
+namespace net_zelcon::plain_sight {
+
+namespace {
+
+constexpr std::uint8_t black = 0;
+constexpr std::uint8_t white = 255;
+constexpr std::uint8_t neutral_chroma = 128;
+constexpr std::uint8_t opaque = 255;
+constexpr int max_pixel_step = 8;
+
+/// @brief A plane the QR code is drawn into, e.g., Y of YUV420P, the packed
+/// plane of RGB24, or each of G, B and R of GBRP.
+struct symbol_plane_t {
+    int plane;
+    // Bytes per pixel
+    int step;
+    // Bytes of one black and one white pixel. Any chroma, alpha or padding
+    // bytes sharing the plane are part of the pattern.
+    std::array<std::uint8_t, max_pixel_step> black_pixel, white_pixel;
+    // Whether both patterns repeat a single byte, so runs can be `memset`.
+    bool uniform;
+    // Chroma bytes past the last pixel of a row, e.g., the V of the last
+    // YUYV422 pair when the width is odd.
+    int tail_bytes;
+};
+
+/// @brief A plane with the same value everywhere, e.g., the chroma planes of
+/// YUV formats or an alpha plane.
+struct fill_plane_t {
+    int plane;
+    int row_bytes;
+    int rows;
+    std::uint8_t value;
+};
+
+struct pixel_layout_t {
+    std::vector<symbol_plane_t> symbol_planes;
+    std::vector<fill_plane_t> fill_planes;
+};
+
+auto ceil_rshift(int value, int shift) -> int {
+    return -((-value) >> shift);
+}
+
+auto image_size_for(int symbol_size, int scale, int border_size) -> int {
+    return symbol_size * scale + border_size * 2;
+}
+
+/// @brief Works out, from the pixel format descriptor, where a gray pixel's
+/// bytes go in each plane.
+/// @return `std::nullopt` if the format is not 8 bits per component or is
+/// paletted, bitstream or hardware.
+auto describe_pixel_format(AVPixelFormat pixel_format, int width, int height)
+    -> std::optional<pixel_layout_t> {
+    const AVPixFmtDescriptor *const desc = av_pix_fmt_desc_get(pixel_format);
+    if (desc == nullptr ||
+        (desc->flags & (AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_BITSTREAM |
+                        AV_PIX_FMT_FLAG_HWACCEL)) != 0) {
+        return std::nullopt;
+    }
+    const bool rgb = (desc->flags & AV_PIX_FMT_FLAG_RGB) != 0;
+    const bool has_alpha = (desc->flags & AV_PIX_FMT_FLAG_ALPHA) != 0;
+    const int num_components = desc->nb_components;
+    // Components are ordered Y, U, V (or gray) or R, G, B, then alpha.
+    const auto is_gray = [&](int i) { return rgb ? i < 3 : i == 0; };
+    const auto is_alpha = [&](int i) {
+        return has_alpha && i == num_components - 1;
+    };
+    for (int i = 0; i < num_components; ++i) {
+        if (desc->comp[i].depth != 8 || desc->comp[i].shift != 0) {
+            return std::nullopt;
+        }
+    }
+    pixel_layout_t layout;
+    for (int plane = 0; plane < 4; ++plane) {
+        int step = 0;
+        bool has_gray = false, all_alpha = true, any = false;
+        for (int i = 0; i < num_components; ++i) {
+            const auto &comp = desc->comp[i];
+            if (comp.plane != plane) {
+                continue;
+            }
+            any = true;
+            all_alpha = all_alpha && is_alpha(i);
+            if (is_gray(i)) {
+                if (has_gray && comp.step != step) {
+                    return std::nullopt;
+                }
+                has_gray = true;
+                step = comp.step;
+            } else if (step == 0) {
+                step = comp.step;
+            }
+        }
+        if (!any) {
+            continue;
+        }
+        if (!has_gray) {
+            const bool subsampled = !all_alpha;
+            layout.fill_planes.push_back(fill_plane_t{
+                plane,
+                (subsampled ? ceil_rshift(width, desc->log2_chroma_w)
+                            : width) *
+                    step,
+                subsampled ? ceil_rshift(height, desc->log2_chroma_h)
+                           : height,
+                all_alpha ? opaque : neutral_chroma});
+            continue;
+        }
+        if (step > max_pixel_step) {
+            return std::nullopt;
+        }
+        symbol_plane_t symbol_plane{plane, step, {}, {}, true, 0};
+        // Bytes not covered by any component (padding) get the gray value in
+        // RGB formats, which keeps e.g. RGB0 `memset`-able.
+        symbol_plane.black_pixel.fill(rgb ? black : neutral_chroma);
+        symbol_plane.white_pixel.fill(rgb ? white : neutral_chroma);
+        for (int i = 0; i < num_components; ++i) {
+            const auto &comp = desc->comp[i];
+            if (comp.plane != plane) {
+                continue;
+            }
+            const int offset = comp.offset % step;
+            const int pixels =
+                is_gray(i) || is_alpha(i)
+                    ? width
+                    : ceil_rshift(width, desc->log2_chroma_w);
+            symbol_plane.tail_bytes =
+                std::max(symbol_plane.tail_bytes,
+                         (pixels - 1) * comp.step + comp.offset + 1 -
+                             width * step);
+            symbol_plane.black_pixel[offset] =
+                is_gray(i) ? black : (is_alpha(i) ? opaque : neutral_chroma);
+            symbol_plane.white_pixel[offset] =
+                is_gray(i) ? white : (is_alpha(i) ? opaque : neutral_chroma);
+        }
+        for (int i = 1; i < step; ++i) {
+            symbol_plane.uniform =
+                symbol_plane.uniform &&
+                symbol_plane.black_pixel[i] == symbol_plane.black_pixel[0] &&
+                symbol_plane.white_pixel[i] == symbol_plane.white_pixel[0];
+        }
+        layout.symbol_planes.push_back(symbol_plane);
+    }
+    if (layout.symbol_planes.empty()) {
+        return std::nullopt;
+    }
+    return layout;
+}
+
+/// @brief Writes `num_pixels` copies of the `step`-byte `pixel` to `dst`.
+void fill_pixels(std::uint8_t *dst, std::size_t num_pixels,
+                 const std::uint8_t *pixel, int step, bool uniform) {
+    const std::size_t total = num_pixels * step;
+    if (uniform) {
+        std::memset(dst, pixel[0], total);
+        return;
+    }
+    // Double the filled prefix with each copy; every copy is a large,
+    // vectorized `memcpy` after the first few.
+    std::memcpy(dst, pixel, std::min<std::size_t>(step, total));
+    for (std::size_t filled = step; filled < total; filled *= 2) {
+        std::memcpy(dst + filled, dst, std::min(filled, total - filled));
+    }
+}
+
+/// @brief Tile geometry shared by the renderers.
+struct tiling_t {
+    tiling_t(int symbol_size, int scale, int border_size, int columns,
+             int rows)
+        : symbol_size{symbol_size}, scale{scale}, border_size{border_size},
+          columns{columns}, rows{rows},
+          tile_size{image_size_for(symbol_size, scale, border_size)} {
+        CHECK_GT(scale, 0);
+        CHECK_GE(border_size, 0);
+        CHECK_GT(columns, 0);
+        CHECK_GT(rows, 0);
+    }
+
+    auto width() const -> int { return columns * tile_size; }
+    auto height() const -> int { return rows * tile_size; }
+    auto count() const -> int { return columns * rows; }
+    /// @brief Top left pixel of tile `tile`'s symbol, inside its border.
+    auto symbol_origin(int tile) const -> std::pair<int, int> {
+        return {tile % columns * tile_size + border_size,
+                tile / columns * tile_size + border_size};
+    }
+
+    int symbol_size, scale, border_size, columns, rows, tile_size;
+};
+
+/// @brief Renderer for formats `describe_pixel_format()` understands. Draws
+/// straight into the encoder's frames.
+class direct_frame_renderer_t final : public frame_renderer_t {
+  public:
+    direct_frame_renderer_t(AVPixelFormat pixel_format, pixel_layout_t layout,
+                            tiling_t tiling,
+                            std::shared_ptr<thread_pool_t> pool)
+        : pixel_format_{pixel_format}, pixel_layout_{std::move(layout)},
+          layout_{qr_layout_t::version_for_size(tiling.symbol_size)},
+          tiling_{tiling},
+          background_(static_cast<std::size_t>(tiling_.width()) *
+                          tiling_.height(),
+                      white),
+          dynamic_spans_(tiling.symbol_size), pool_{std::move(pool)} {
+        const int scale = tiling_.scale;
+        for (int y = 0; y < layout_.size(); ++y) {
+            for (int x = 0; x < layout_.size(); ++x) {
+                if (!layout_.is_static(x, y)) {
+                    auto &spans = dynamic_spans_[y];
+                    if (!spans.empty() && spans.back().second == x) {
+                        spans.back().second = x + 1;
+                    } else {
+                        spans.emplace_back(x, x + 1);
+                    }
+                    continue;
+                }
+                if (!layout_.is_dark(x, y)) {
+                    continue;
+                }
+                for (int tile = 0; tile < tiling_.count(); ++tile) {
+                    const auto [x0, y0] = tiling_.symbol_origin(tile);
+                    for (int dy = 0; dy < scale; ++dy) {
+                        auto *const row =
+                            background_.data() +
+                            static_cast<std::size_t>(y0 + y * scale + dy) *
+                                tiling_.width() +
+                            x0;
+                        std::fill_n(row + x * scale, scale, black);
+                    }
+                }
+            }
+        }
+    }
+
+    auto width() const noexcept -> int override { return tiling_.width(); }
+    auto height() const noexcept -> int override { return tiling_.height(); }
+    auto tile_count() const noexcept -> int override {
+        return tiling_.count();
+    }
+
+    void prepare(AVFrame *frame) override {
+        check_frame(frame);
+        for (const auto &plane : pixel_layout_.symbol_planes) {
+            for (int y = 0; y < height(); ++y) {
+                const auto *const src =
+                    background_.data() + static_cast<std::size_t>(y) * width();
+                auto *dst =
+                    frame->data[plane.plane] + y * frame->linesize[plane.plane];
+                for (int x = 0; x < width(); ++x, dst += plane.step) {
+                    std::memcpy(dst,
+                                src[x] == black ? plane.black_pixel.data()
+                                                : plane.white_pixel.data(),
+                                plane.step);
+                }
+                std::memset(dst, neutral_chroma, plane.tail_bytes);
+            }
+        }
+        for (const auto &plane : pixel_layout_.fill_planes) {
+            for (int y = 0; y < plane.rows; ++y) {
+                std::memset(frame->data[plane.plane] +
+                                y * frame->linesize[plane.plane],
+                            plane.value, plane.row_bytes);
+            }
+        }
+    }
+
+    void render(AVFrame *frame,
+                std::span<const qr_symbol_t> qr_codes) override {
+        check_frame(frame);
+        CHECK_LE(qr_codes.size(), static_cast<std::size_t>(tile_count()));
+        for (const auto &qr_code : qr_codes) {
+            CHECK_EQ(qr_code.size(), layout_.size());
+        }
+        // Module rows of all tiles, numbered tile by tile
+        const int num_rows = tile_count() * layout_.size();
+        if (!pool_ || pool_->size() <= 1) {
+            render_rows(frame, qr_codes, 0, num_rows);
+            return;
+        }
+        const int num_tasks =
+            std::min(num_rows, static_cast<int>(pool_->size()));
+        std::vector<std::future<void>> tasks;
+        tasks.reserve(num_tasks);
+        for (int task = 0; task < num_tasks; ++task) {
+            const int first_row = num_rows * task / num_tasks;
+            const int last_row = num_rows * (task + 1) / num_tasks;
+            tasks.emplace_back(pool_->submit([=, this] {
+                render_rows(frame, qr_codes, first_row, last_row);
+            }));
+        }
+        for (auto &task : tasks) {
+            task.get();
+        }
+    }
+
+  private:
+    void check_frame(const AVFrame *frame) const {
+        CHECK(frame != nullptr);
+        CHECK_EQ(frame->format, pixel_format_);
+        CHECK_EQ(frame->width, width());
+        CHECK_EQ(frame->height, height());
+    }
+
+    void render_rows(AVFrame *frame,
+                     std::span<const qr_symbol_t> qr_codes,
+                     int first_row, int last_row) const {
+        const int scale = tiling_.scale;
+        const int symbol_size = layout_.size();
+        for (const auto &plane : pixel_layout_.symbol_planes) {
+            const int linesize = frame->linesize[plane.plane];
+            const int row_bytes = symbol_size * scale * plane.step;
+            for (int row_index = first_row; row_index < last_row;
+                 ++row_index) {
+                const int tile = row_index / symbol_size;
+                const int y = row_index % symbol_size;
+                const auto [x0, y0] = tiling_.symbol_origin(tile);
+                std::uint8_t *const row = frame->data[plane.plane] +
+                                          (y0 + y * scale) * linesize +
+                                          x0 * plane.step;
+                if (static_cast<std::size_t>(tile) >= qr_codes.size()) {
+                    // Blank tile, static modules included
+                    fill_pixels(row,
+                                static_cast<std::size_t>(symbol_size) * scale,
+                                plane.white_pixel.data(), plane.step,
+                                plane.uniform);
+                } else {
+                    render_row(row, plane, qr_codes[tile], y);
+                }
+                // The remaining pixel rows of the module row are identical,
+                // static modules included.
+                for (int dy = 1; dy < scale; ++dy) {
+                    std::memcpy(row + dy * linesize, row, row_bytes);
+                }
+            }
+        }
+    }
+
+    /// @brief Draws the first pixel row of module row `y`. Neighbouring
+    /// modules of the same color are merged into a single fill, found a
+    /// 64-module word at a time.
+    void render_row(std::uint8_t *row, const symbol_plane_t &plane,
+                    const qr_symbol_t &qr_code, int y) const {
+        const int scale = tiling_.scale;
+        for (const auto &[begin, end] : dynamic_spans_[y]) {
+            for (int run_start = begin; run_start < end;) {
+                const int run_end = qr_code.run_end(run_start, y, end);
+                fill_pixels(row + run_start * scale * plane.step,
+                            static_cast<std::size_t>(run_end - run_start) *
+                                scale,
+                            qr_code.module(run_start, y)
+                                ? plane.black_pixel.data()
+                                : plane.white_pixel.data(),
+                            plane.step, plane.uniform);
+                run_start = run_end;
+            }
+        }
+    }
+
+    AVPixelFormat pixel_format_;
+    pixel_layout_t pixel_layout_;
+    qr_layout_t layout_;
+    tiling_t tiling_;
+    // Luma of the static background of the whole frame, `width()` pixels per
+    // row.
+    std::vector<std::uint8_t> background_;
+    // Per module row, the half-open ranges of module columns that are not
+    // static and have to be drawn for every QR code.
+    std::vector<std::vector<std::pair<int, int>>> dynamic_spans_;
+    std::shared_ptr<thread_pool_t> pool_;
+};
+
+/// @brief Fallback for formats that cannot be written directly: renders
+/// YUV420P into a frame owned by the renderer and converts it.
+class converting_frame_renderer_t final : public frame_renderer_t {
+  public:
+    converting_frame_renderer_t(AVPixelFormat pixel_format, tiling_t tiling,
+                                std::shared_ptr<thread_pool_t> pool)
+        : pixel_format_{pixel_format},
+          renderer_{AV_PIX_FMT_YUV420P,
+                    *describe_pixel_format(AV_PIX_FMT_YUV420P, tiling.width(),
+                                           tiling.height()),
+                    tiling, std::move(pool)},
+          intermediate_{av_frame_alloc(), av_frame_free},
+          sws_context_{nullptr, sws_freeContext} {
+        CHECK(intermediate_) << "Failed to allocate AVFrame";
+        intermediate_->width = width();
+        intermediate_->height = height();
+        intermediate_->format = AV_PIX_FMT_YUV420P;
+        const int err = av_frame_get_buffer(intermediate_.get(), 0);
+        CHECK(err >= 0) << "Could not allocate frame buffers: "
+                        << libav_error(err);
+        renderer_.prepare(intermediate_.get());
+        sws_context_.reset(sws_getContext(
+            width(), height(), AV_PIX_FMT_YUV420P, width(), height(),
+            pixel_format_, SWS_BILINEAR, nullptr, nullptr, nullptr));
+        CHECK(sws_context_) << "Failed to allocate SwsContext";
+    }
+
+    auto width() const noexcept -> int override { return renderer_.width(); }
+    auto height() const noexcept -> int override {
+        return renderer_.height();
+    }
+    auto tile_count() const noexcept -> int override {
+        return renderer_.tile_count();
+    }
+
+    void prepare(AVFrame *frame) override {
+        CHECK(frame != nullptr);
+        CHECK_EQ(frame->format, pixel_format_);
+    }
+
+    void render(AVFrame *frame,
+                std::span<const qr_symbol_t> qr_codes) override {
+        CHECK(frame != nullptr);
+        CHECK_EQ(frame->format, pixel_format_);
+        if (intermediate_blanked_) {
+            renderer_.prepare(intermediate_.get());
+        }
+        renderer_.render(intermediate_.get(), qr_codes);
+        intermediate_blanked_ =
+            qr_codes.size() < static_cast<std::size_t>(tile_count());
+        sws_scale(sws_context_.get(), intermediate_->data,
+                  intermediate_->linesize, 0, intermediate_->height,
+                  frame->data, frame->linesize);
+    }
+
+  private:
+    AVPixelFormat pixel_format_;
+    direct_frame_renderer_t renderer_;
+    libav_frame_ptr_t intermediate_;
+    // Whether the last render left tiles blank, wiping their background
+    bool intermediate_blanked_ = false;
+    libav_ptr_t<SwsContext, sws_freeContext> sws_context_;
+};
+
+/// @brief Draws a separate set of tiles into each color plane of a planar
+/// format, as if every plane were a GRAY8 frame of its own.
+class multiplexed_frame_renderer_t final : public frame_renderer_t {
+  public:
+    multiplexed_frame_renderer_t(AVPixelFormat pixel_format, int planes,
+                                 tiling_t tiling,
+                                 std::shared_ptr<thread_pool_t> pool)
+        : pixel_format_{pixel_format}, planes_{planes},
+          renderer_{AV_PIX_FMT_GRAY8,
+                    *describe_pixel_format(AV_PIX_FMT_GRAY8, tiling.width(),
+                                           tiling.height()),
+                    tiling, std::move(pool)},
+          view_{av_frame_alloc(), av_frame_free} {
+        CHECK(view_) << "Failed to allocate AVFrame";
+        view_->width = width();
+        view_->height = height();
+        view_->format = AV_PIX_FMT_GRAY8;
+    }
+
+    auto width() const noexcept -> int override { return renderer_.width(); }
+    auto height() const noexcept -> int override {
+        return renderer_.height();
+    }
+    auto tile_count() const noexcept -> int override {
+        return renderer_.tile_count() * planes_;
+    }
+
+    void prepare(AVFrame *frame) override {
+        CHECK(frame != nullptr);
+        CHECK_EQ(frame->format, pixel_format_);
+        for (int plane = 0; plane < planes_; ++plane) {
+            renderer_.prepare(view_of(frame, plane));
+        }
+        // Opaque alpha plane, if there is one
+        if (frame->data[planes_] != nullptr) {
+            for (int y = 0; y < height(); ++y) {
+                std::memset(frame->data[planes_] +
+                                y * frame->linesize[planes_],
+                            opaque, width());
+            }
+        }
+    }
+
+    void render(AVFrame *frame,
+                std::span<const qr_symbol_t> qr_codes) override {
+        CHECK(frame != nullptr);
+        CHECK_EQ(frame->format, pixel_format_);
+        CHECK_LE(qr_codes.size(), static_cast<std::size_t>(tile_count()));
+        // Plane by plane; planes past the end of `qr_codes` are blanked.
+        const auto per_plane = static_cast<std::size_t>(renderer_.tile_count());
+        for (int plane = 0; plane < planes_; ++plane) {
+            const std::size_t first =
+                std::min(qr_codes.size(), plane * per_plane);
+            renderer_.render(
+                view_of(frame, plane),
+                qr_codes.subspan(first,
+                                 std::min(per_plane, qr_codes.size() - first)));
+        }
+    }
+
+  private:
+    auto view_of(AVFrame *frame, int plane) -> AVFrame * {
+        view_->data[0] = frame->data[plane];
+        view_->linesize[0] = frame->linesize[plane];
+        return view_.get();
+    }
+
+    AVPixelFormat pixel_format_;
+    int planes_;
+    direct_frame_renderer_t renderer_;
+    // GRAY8 frame aliasing one plane of the frame being drawn
+    libav_frame_ptr_t view_;
+};
+
+} // namespace
+
+auto frame_renderer_t::create(AVPixelFormat pixel_format, int symbol_size,
+                              int scale, int border_size,
+                              std::shared_ptr<thread_pool_t> pool,
+                              int tile_columns, int tile_rows)
+    -> std::unique_ptr<frame_renderer_t> {
+    CHECK_NE(pixel_format, AV_PIX_FMT_NONE);
+    const tiling_t tiling{symbol_size, scale, border_size, tile_columns,
+                          tile_rows};
+    if (auto layout = describe_pixel_format(pixel_format, tiling.width(),
+                                            tiling.height())) {
+        return std::make_unique<direct_frame_renderer_t>(
+            pixel_format, std::move(*layout), tiling, std::move(pool));
+    }
+    LOG(WARNING) << "No direct renderer for pixel format "
+                 << av_get_pix_fmt_name(pixel_format)
+                 << "; frames will be converted from YUV420P";
+    return std::make_unique<converting_frame_renderer_t>(pixel_format, tiling,
+                                                         std::move(pool));
+}
+
+auto frame_renderer_t::create_multiplexed(AVPixelFormat pixel_format,
+                                          int symbol_size, int scale,
+                                          int border_size,
+                                          std::shared_ptr<thread_pool_t> pool,
+                                          int tile_columns, int tile_rows)
+    -> std::unique_ptr<frame_renderer_t> {
+    const int planes = multiplexable_planes(pixel_format);
+    CHECK_GT(planes, 0) << "Pixel format " << av_get_pix_fmt_name(pixel_format)
+                        << " has no separate full resolution 8-bit planes";
+    return std::make_unique<multiplexed_frame_renderer_t>(
+        pixel_format, planes,
+        tiling_t{symbol_size, scale, border_size, tile_columns, tile_rows},
+        std::move(pool));
+}
+
+} // namespace net_zelcon::plain_sight
\ No newline at end of file
@@ -0,0 +1,87 @@
+#ifndef _INCLUDE_NET_ZELCON_PLAIN_SIGHT_FRAME_RENDERER_H_
+#define _INCLUDE_NET_ZELCON_PLAIN_SIGHT_FRAME_RENDERER_H_
+
+#include <memory>
+#include <span>
+
+#include "plain_sight/qr_symbol.h"
+#include "plain_sight/thread_pool.h"
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libavutil/pixfmt.h>
+}
+
+namespace net_zelcon::plain_sight {
+
+/// @brief Draws QR codes of one fixed version into frames of one fixed pixel
+/// format.
+/// @details A frame is a grid of `tile_columns` × `tile_rows` tiles, each
+/// holding one QR code and its own border; tiles are numbered row by row.
+/// Everything that is the same in every frame — the borders, the static
+/// function patterns and the planes that do not carry the QR codes — is drawn
+/// once per frame buffer by `prepare()`. `render()` then only writes the
+/// modules that vary between QR codes.
+class frame_renderer_t {
+  public:
+    virtual ~frame_renderer_t() noexcept {}
+
+    /// @brief Width of the frames in pixels.
+    [[nodiscard]] virtual auto width() const noexcept -> int = 0;
+    /// @brief Height of the frames in pixels.
+    [[nodiscard]] virtual auto height() const noexcept -> int = 0;
+    /// @brief Number of QR codes per frame.
+    [[nodiscard]] virtual auto tile_count() const noexcept -> int = 0;
+
+    /// @brief Draws the static background into `frame`. Needed once per frame
+    /// buffer; the background survives any number of `render()` calls that
+    /// fill every tile.
+    virtual void prepare(AVFrame *frame) = 0;
+
+    /// @brief Draws `qr_codes[i]` into tile `i` of `frame`, which must have
+    /// been passed to `prepare()`. Tiles past the end of `qr_codes` are left
+    /// blank; `prepare()` has to be called again before the frame is
+    /// rendered into once more.
+    virtual void render(AVFrame *frame,
+                        std::span<const qr_symbol_t> qr_codes) = 0;
+
+    void render(AVFrame *frame, const qr_symbol_t &qr_code) {
+        render(frame, std::span<const qr_symbol_t>{&qr_code, 1});
+    }
+
+    /// @brief Picks the renderer for `pixel_format`.
+    /// @details 8-bit planar, semi-planar and packed YUV, gray and RGB
+    /// formats (e.g., YUV420P, NV12, YUV444P, GRAY8, YUYV422, RGB24, BGRA,
+    /// GBRP) are written directly. Any other format is drawn as YUV420P and
+    /// converted with a `SwsContext` that, like the intermediate frame, is
+    /// allocated once.
+    /// @param symbol_size QR code size in modules
+    /// @param scale How many pixels per QR code module
+    /// @param border_size Whitespace on each side of each QR code
+    /// @param pool If not null, module rows are rendered in parallel on it.
+    /// @param tile_columns Number of QR codes side by side
+    /// @param tile_rows Number of QR codes on top of each other
+    static auto create(AVPixelFormat pixel_format, int symbol_size, int scale,
+                       int border_size,
+                       std::shared_ptr<thread_pool_t> pool = nullptr,
+                       int tile_columns = 1, int tile_rows = 1)
+        -> std::unique_ptr<frame_renderer_t>;
+
+    /// @brief Renderer that draws independent QR codes into every color
+    /// plane of `pixel_format`, which must have separate full resolution
+    /// 8-bit planes (see `multiplexable_planes()`), e.g., YUV444P or GBRP.
+    /// @details Each plane holds its own grid of tiles, black and white
+    /// being the plane's extreme values. `tile_count()` is the number of
+    /// tiles times the number of planes; QR codes fill the first plane's
+    /// tiles, then the second's, and so on.
+    static auto create_multiplexed(AVPixelFormat pixel_format,
+                                   int symbol_size, int scale, int border_size,
+                                   std::shared_ptr<thread_pool_t> pool =
+                                       nullptr,
+                                   int tile_columns = 1, int tile_rows = 1)
+        -> std::unique_ptr<frame_renderer_t>;
+};
+
+} // namespace net_zelcon::plain_sight
+
+#endif // _INCLUDE_NET_ZELCON_PLAIN_SIGHT_FRAME_RENDERER_H_
\ No newline at end of file
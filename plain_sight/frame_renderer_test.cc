@@ -0,0 +1,220 @@
+#include <gtest/gtest.h>
+
+#include "plain_sight/frame_renderer.h"
+#include "plain_sight/qr_layout.h"
+#include "plain_sight/util.h"
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <qrcodegen.hpp>
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libavutil/pixdesc.h>
+}
+
+using namespace net_zelcon::plain_sight;
+
+namespace {
+
+auto make_qr_code(int version, std::uint8_t seed, int mask = -1)
+    -> qr_symbol_t {
+    std::vector<std::uint8_t> payload(7);
+    for (std::size_t i = 0; i < payload.size(); ++i) {
+        payload[i] = static_cast<std::uint8_t>(seed * 37 + i * 11);
+    }
+    return qr_symbol_t{qrcodegen::QrCode::encodeSegments(
+        {qrcodegen::QrSegment::makeBytes(payload)},
+        qrcodegen::QrCode::Ecc::HIGH, version, version, mask, false)};
+}
+
+auto allocate_frame(int width, int height, AVPixelFormat pixel_format)
+    -> libav_frame_ptr_t {
+    libav_frame_ptr_t frame{av_frame_alloc(), av_frame_free};
+    frame->width = width;
+    frame->height = height;
+    frame->format = pixel_format;
+    EXPECT_GE(av_frame_get_buffer(frame.get(), 0), 0);
+    return frame;
+}
+
+// Value of component `i` of pixel (x, y), read through the format descriptor.
+auto component_at(const AVFrame *frame, const AVPixFmtDescriptor *desc,
+                  int i, int x, int y) -> int {
+    const auto &comp = desc->comp[i];
+    const bool chroma =
+        !(desc->flags & AV_PIX_FMT_FLAG_RGB) && (i == 1 || i == 2);
+    if (chroma) {
+        x >>= desc->log2_chroma_w;
+        y >>= desc->log2_chroma_h;
+    }
+    return frame->data[comp.plane][y * frame->linesize[comp.plane] +
+                                   x * comp.step + comp.offset];
+}
+
+// Checks that tile `i` of `frame` shows `qr_codes[i]` and any further tiles
+// are blank.
+void expect_frame_shows(const AVFrame *frame,
+                        std::span<const qr_symbol_t> qr_codes,
+                        int border_size, int scale, int tile_columns = 1) {
+    const auto *desc =
+        av_pix_fmt_desc_get(static_cast<AVPixelFormat>(frame->format));
+    const bool rgb = (desc->flags & AV_PIX_FMT_FLAG_RGB) != 0;
+    const int symbol_size = qr_codes.front().size();
+    const int tile_size = symbol_size * scale + border_size * 2;
+    for (int y = 0; y < frame->height; ++y) {
+        for (int x = 0; x < frame->width; ++x) {
+            const auto tile = static_cast<std::size_t>(
+                y / tile_size * tile_columns + x / tile_size);
+            const int tile_x = x % tile_size, tile_y = y % tile_size;
+            const int module_x = (tile_x - border_size) / scale;
+            const int module_y = (tile_y - border_size) / scale;
+            const bool in_symbol =
+                tile_x >= border_size && tile_y >= border_size &&
+                module_x < symbol_size && module_y < symbol_size;
+            const bool dark = in_symbol && tile < qr_codes.size() &&
+                              qr_codes[tile].module(module_x, module_y);
+            for (int i = 0; i < desc->nb_components; ++i) {
+                int expected = dark ? 0 : 255;
+                if (i == 3) {
+                    expected = 255; // opaque
+                } else if (!rgb && i > 0) {
+                    expected = 128; // no chroma
+                }
+                ASSERT_EQ(component_at(frame, desc, i, x, y), expected)
+                    << desc->name << " component " << i << " at (" << x
+                    << ", " << y << ")";
+            }
+        }
+    }
+}
+
+} // namespace
+
+TEST(QrLayoutTest, StaticModulesMatchQrcodegen) {
+    for (const int version : {1, 2, 7, 20, 32, 40}) {
+        const qr_layout_t layout{version};
+        for (int mask = 0; mask < 8; ++mask) {
+            const auto qr_code =
+                make_qr_code(version, static_cast<std::uint8_t>(mask), mask);
+            ASSERT_EQ(layout.size(), qr_code.size());
+            for (int y = 0; y < layout.size(); ++y) {
+                for (int x = 0; x < layout.size(); ++x) {
+                    if (layout.is_static(x, y)) {
+                        ASSERT_EQ(layout.is_dark(x, y), qr_code.module(x, y))
+                            << "version " << version << " at (" << x << ", "
+                            << y << ")";
+                    }
+                }
+            }
+        }
+    }
+}
+
+class FrameRendererTest : public testing::TestWithParam<AVPixelFormat> {};
+
+TEST_P(FrameRendererTest, MatchesModules) {
+    constexpr int border_size = 4, scale = 3;
+    const auto first = make_qr_code(20, 1);
+    const auto second = make_qr_code(20, 2);
+    for (const auto threads : {0, 3}) {
+        auto renderer = frame_renderer_t::create(
+            GetParam(), first.size(), scale, border_size,
+            threads > 0 ? std::make_shared<thread_pool_t>(threads) : nullptr);
+        auto frame = allocate_frame(renderer->width(), renderer->height(),
+                                    GetParam());
+        renderer->prepare(frame.get());
+        renderer->render(frame.get(), first);
+        expect_frame_shows(frame.get(), {&first, 1}, border_size, scale);
+        // Rendering into a previously used frame must not leave anything of
+        // the earlier QR code behind.
+        renderer->render(frame.get(), second);
+        expect_frame_shows(frame.get(), {&second, 1}, border_size, scale);
+    }
+}
+
+TEST_P(FrameRendererTest, Tiles) {
+    constexpr int border_size = 2, scale = 2, columns = 3, rows = 2;
+    std::vector<qr_symbol_t> qr_codes;
+    for (std::uint8_t i = 0; i < columns * rows; ++i) {
+        qr_codes.push_back(make_qr_code(7, i));
+    }
+    auto renderer = frame_renderer_t::create(
+        GetParam(), qr_codes.front().size(), scale, border_size,
+        std::make_shared<thread_pool_t>(4), columns, rows);
+    ASSERT_EQ(renderer->tile_count(), columns * rows);
+    auto frame =
+        allocate_frame(renderer->width(), renderer->height(), GetParam());
+    renderer->prepare(frame.get());
+    renderer->render(frame.get(), qr_codes);
+    expect_frame_shows(frame.get(), qr_codes, border_size, scale, columns);
+    // A partially filled frame, like the last one of a video
+    const std::span<const qr_symbol_t> some{qr_codes.data(), 4};
+    renderer->render(frame.get(), some);
+    expect_frame_shows(frame.get(), some, border_size, scale, columns);
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    PixelFormats, FrameRendererTest,
+    testing::Values(AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUV444P, AV_PIX_FMT_GRAY8,
+                    AV_PIX_FMT_NV12, AV_PIX_FMT_YUYV422, AV_PIX_FMT_RGB24,
+                    AV_PIX_FMT_BGRA, AV_PIX_FMT_GBRP),
+    [](const testing::TestParamInfo<AVPixelFormat> &info) {
+        return std::string{av_get_pix_fmt_name(info.param)};
+    });
+
+TEST(MultiplexedFrameRendererTest, EveryPlaneCarriesItsOwnTiles) {
+    constexpr int border_size = 2, scale = 2, columns = 2, rows = 1;
+    std::vector<qr_symbol_t> qr_codes;
+    for (std::uint8_t i = 0; i < 3 * columns * rows; ++i) {
+        qr_codes.push_back(make_qr_code(5, i));
+    }
+    EXPECT_EQ(multiplexable_planes(AV_PIX_FMT_YUV420P), 0);
+    EXPECT_EQ(multiplexable_planes(AV_PIX_FMT_GRAY8), 0);
+    EXPECT_EQ(multiplexable_planes(AV_PIX_FMT_RGB24), 0);
+    for (const auto pixel_format : {AV_PIX_FMT_YUV444P, AV_PIX_FMT_GBRP}) {
+        ASSERT_EQ(multiplexable_planes(pixel_format), 3);
+        auto renderer = frame_renderer_t::create_multiplexed(
+            pixel_format, qr_codes.front().size(), scale, border_size,
+            nullptr, columns, rows);
+        ASSERT_EQ(renderer->tile_count(), 3 * columns * rows);
+        auto frame = allocate_frame(renderer->width(), renderer->height(),
+                                    pixel_format);
+        libav_frame_ptr_t view{av_frame_alloc(), av_frame_free};
+        view->width = frame->width;
+        view->height = frame->height;
+        view->format = AV_PIX_FMT_GRAY8;
+        // All planes filled, then the first plane and a half
+        for (const std::size_t count : {qr_codes.size(), std::size_t{3}}) {
+            renderer->prepare(frame.get());
+            const std::span<const qr_symbol_t> shown{qr_codes.data(),
+                                                           count};
+            renderer->render(frame.get(), shown);
+            for (std::size_t plane = 0; plane < 3; ++plane) {
+                view->data[0] = frame->data[plane];
+                view->linesize[0] = frame->linesize[plane];
+                const std::size_t first =
+                    std::min(count, plane * columns * rows);
+                const auto expected = shown.subspan(
+                    first, std::min<std::size_t>(columns * rows,
+                                                 count - first));
+                if (expected.empty()) {
+                    // Nothing but white in a blank plane
+                    for (int y = 0; y < view->height; ++y) {
+                        for (int x = 0; x < view->width; ++x) {
+                            ASSERT_EQ(
+                                view->data[0][y * view->linesize[0] + x], 255);
+                        }
+                    }
+                    continue;
+                }
+                expect_frame_shows(view.get(), expected, border_size, scale,
+                                   columns);
+            }
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,359 @@
+#include "plain_sight/framing.h"
+
+#include <algorithm>
+#include <fmt/core.h>
+#include <glog/logging.h>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+namespace net_zelcon::plain_sight {
+
+namespace {
+
+template <typename T> void put_le(std::vector<std::uint8_t> &dst, T value) {
+    for (std::size_t i = 0; i < sizeof(T); ++i) {
+        dst.push_back(static_cast<std::uint8_t>(value >> (8 * i)));
+    }
+}
+
+template <typename T> auto get_le(std::span<const std::uint8_t> src) -> T {
+    T value = 0;
+    for (std::size_t i = 0; i < sizeof(T); ++i) {
+        value |= static_cast<T>(src[i]) << (8 * i);
+    }
+    return value;
+}
+
+[[noreturn]] void malformed(const std::string &what) {
+    LOG(ERROR) << "Malformed framed payload: " << what;
+    throw std::runtime_error{fmt::format("Malformed framed payload: {}", what)};
+}
+
+} // namespace
+
+auto manifest_t::for_payload(std::uint64_t total_length,
+                             std::uint32_t chunk_size,
+                             const erasure_code_t &erasure) -> manifest_t {
+    CHECK_GT(chunk_size, 0U);
+    CHECK(erasure.valid());
+    const std::uint64_t chunk_count =
+        (total_length + chunk_size - 1) / chunk_size;
+    CHECK_LE(chunk_count, std::numeric_limits<std::uint32_t>::max())
+        << "Payload of " << total_length << " bytes needs too many chunks";
+    CHECK_LE(erasure.parity_count(chunk_count),
+             std::numeric_limits<std::uint32_t>::max())
+        << "Payload of " << total_length
+        << " bytes needs too many parity chunks";
+    return {total_length, chunk_size, static_cast<std::uint32_t>(chunk_count),
+            erasure};
+}
+
+auto manifest_t::chunk_length(std::uint32_t sequence_number) const
+    -> std::size_t {
+    CHECK_LT(sequence_number, chunk_count);
+    return static_cast<std::size_t>(
+        std::min<std::uint64_t>(chunk_size,
+                                total_length - chunk_offset(sequence_number)));
+}
+
+namespace framing {
+
+void write_manifest(std::vector<std::uint8_t> &dst,
+                    const manifest_t &manifest) {
+    dst.push_back(manifest_tag);
+    put_le(dst, manifest.total_length);
+    put_le(dst, manifest.chunk_size);
+    put_le(dst, manifest.chunk_count);
+    if (manifest.erasure.enabled()) {
+        dst.push_back(static_cast<std::uint8_t>(manifest.erasure.group_size));
+        dst.push_back(
+            static_cast<std::uint8_t>(manifest.erasure.parity_chunks));
+        put_le(dst, static_cast<std::uint16_t>(manifest.erasure.interleaving));
+    }
+}
+
+void write_chunk(std::vector<std::uint8_t> &dst, std::uint32_t sequence_number,
+                 std::span<const std::uint8_t> data) {
+    dst.push_back(chunk_tag);
+    put_le(dst, sequence_number);
+    dst.insert(dst.end(), data.begin(), data.end());
+}
+
+void write_parity_chunk(std::vector<std::uint8_t> &dst,
+                        std::uint32_t sequence_number,
+                        std::span<const std::uint8_t> data) {
+    dst.push_back(parity_tag);
+    put_le(dst, sequence_number);
+    dst.insert(dst.end(), data.begin(), data.end());
+}
+
+auto parse(std::span<const std::uint8_t> payload)
+    -> std::variant<manifest_t, chunk_t, parity_chunk_t> {
+    if (payload.empty()) {
+        malformed("empty");
+    }
+    switch (payload[0]) {
+    case manifest_tag: {
+        if (payload.size() != manifest_size &&
+            payload.size() != erasure_manifest_size) {
+            malformed(fmt::format("manifest of {} bytes", payload.size()));
+        }
+        manifest_t manifest{get_le<std::uint64_t>(payload.subspan(1)),
+                            get_le<std::uint32_t>(payload.subspan(9)),
+                            get_le<std::uint32_t>(payload.subspan(13))};
+        if (payload.size() == erasure_manifest_size) {
+            manifest.erasure = {payload[17], payload[18],
+                                get_le<std::uint16_t>(payload.subspan(19))};
+            if (!manifest.erasure.enabled() || !manifest.erasure.valid()) {
+                malformed("invalid erasure code");
+            }
+        }
+        if (manifest.chunk_size == 0 ||
+            (manifest.total_length + manifest.chunk_size - 1) /
+                    manifest.chunk_size !=
+                manifest.chunk_count) {
+            malformed("inconsistent manifest");
+        }
+        return manifest;
+    }
+    case chunk_tag:
+        if (payload.size() < chunk_header_size) {
+            malformed(fmt::format("chunk of {} bytes", payload.size()));
+        }
+        return chunk_t{get_le<std::uint32_t>(payload.subspan(1)),
+                       payload.subspan(chunk_header_size)};
+    case parity_tag:
+        if (payload.size() < chunk_header_size) {
+            malformed(
+                fmt::format("parity chunk of {} bytes", payload.size()));
+        }
+        return parity_chunk_t{get_le<std::uint32_t>(payload.subspan(1)),
+                              payload.subspan(chunk_header_size)};
+    default:
+        malformed(fmt::format("unknown tag {:#04x}", payload[0]));
+    }
+}
+
+} // namespace framing
+
+frame_assembler_t::frame_assembler_t(std::vector<std::uint8_t> &dst)
+    : dst_{&dst} {}
+
+frame_assembler_t::frame_assembler_t(output_sink_t &dst) : sink_{&dst} {}
+
+void frame_assembler_t::add(std::span<const std::uint8_t> payload) {
+    const auto parsed = framing::parse(payload);
+    if (const auto *manifest = std::get_if<manifest_t>(&parsed)) {
+        std::lock_guard lock{mutex_};
+        if (ready_.load(std::memory_order_relaxed)) {
+            if (*manifest != manifest_) {
+                malformed("conflicting manifests");
+            }
+            return;
+        }
+        manifest_ = *manifest;
+        if (dst_ != nullptr) {
+            dst_->resize(manifest_.total_length);
+        }
+        received_ =
+            std::make_unique<std::atomic<bool>[]>(manifest_.chunk_count);
+        if (manifest_.erasure.enabled()) {
+            erasure_coder_ =
+                std::make_unique<const erasure_coder_t>(manifest_.erasure);
+            groups_done_.assign(
+                manifest_.erasure.group_count(manifest_.chunk_count), false);
+        }
+        ready_.store(true, std::memory_order_release);
+        for (const auto &early : early_) {
+            take(framing::parse(early));
+        }
+        early_.clear();
+        early_.shrink_to_fit();
+        return;
+    }
+    if (!ready_.load(std::memory_order_acquire)) {
+        std::unique_lock lock{mutex_};
+        // The manifest may have arrived while waiting for the lock.
+        if (!ready_.load(std::memory_order_relaxed)) {
+            early_.emplace_back(payload.begin(), payload.end());
+            return;
+        }
+    }
+    take(parsed);
+}
+
+void frame_assembler_t::take(
+    const std::variant<manifest_t, chunk_t, parity_chunk_t> &parsed) {
+    const auto &erasure = manifest_.erasure;
+    if (const auto *chunk = std::get_if<chunk_t>(&parsed)) {
+        place(chunk->sequence_number, chunk->data);
+        if (erasure_coder_) {
+            const auto [group, index] = erasure.locate(chunk->sequence_number);
+            collect(group, index, chunk->data);
+        }
+        return;
+    }
+    const auto &parity = std::get<parity_chunk_t>(parsed);
+    if (!erasure_coder_) {
+        malformed("parity chunk without an erasure code");
+    }
+    if (parity.sequence_number >= erasure.parity_count(manifest_.chunk_count)) {
+        malformed(fmt::format("parity chunk {} of {}", parity.sequence_number,
+                              erasure.parity_count(manifest_.chunk_count)));
+    }
+    if (parity.data.size() != manifest_.chunk_size) {
+        malformed(fmt::format("parity chunk {} is {} bytes instead of {}",
+                              parity.sequence_number, parity.data.size(),
+                              manifest_.chunk_size));
+    }
+    const std::uint64_t group = parity.sequence_number / erasure.parity_chunks;
+    collect(group,
+            erasure.group_data_count(group, manifest_.chunk_count) +
+                parity.sequence_number % erasure.parity_chunks,
+            parity.data);
+}
+
+auto frame_assembler_t::place(std::uint32_t sequence_number,
+                              std::span<const std::uint8_t> data) -> bool {
+    if (sequence_number >= manifest_.chunk_count) {
+        malformed(fmt::format("chunk {} of {}", sequence_number,
+                              manifest_.chunk_count));
+    }
+    if (data.size() != manifest_.chunk_length(sequence_number)) {
+        malformed(fmt::format("chunk {} is {} bytes instead of {}",
+                              sequence_number, data.size(),
+                              manifest_.chunk_length(sequence_number)));
+    }
+    if (received_[sequence_number].exchange(true,
+                                            std::memory_order_relaxed)) {
+        duplicates_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    if (dst_ != nullptr) {
+        // Chunks never overlap, so concurrent writers touch disjoint bytes.
+        std::copy(data.begin(), data.end(),
+                  dst_->begin() + manifest_.chunk_offset(sequence_number));
+        return true;
+    }
+    std::lock_guard lock{sink_mutex_};
+    if (sequence_number != next_) {
+        ahead_.emplace(sequence_number,
+                       std::vector<std::uint8_t>(data.begin(), data.end()));
+        return true;
+    }
+    sink_->write(data);
+    ++next_;
+    for (auto it = ahead_.begin(); it != ahead_.end() && it->first == next_;
+         it = ahead_.erase(it)) {
+        sink_->write(it->second);
+        ++next_;
+    }
+    return true;
+}
+
+void frame_assembler_t::collect(const std::uint64_t group,
+                                const std::size_t index,
+                                std::span<const std::uint8_t> data) {
+    const std::size_t data_count =
+        manifest_.erasure.group_data_count(group, manifest_.chunk_count);
+    std::lock_guard lock{erasure_mutex_};
+    if (groups_done_[group]) {
+        return;
+    }
+    auto &pending = groups_[group];
+    if (pending.chunks.empty()) {
+        pending.chunks.resize(data_count + manifest_.erasure.parity_chunks);
+    }
+    if (!pending.chunks[index].empty()) {
+        return;
+    }
+    pending.chunks[index].assign(data.begin(), data.end());
+    ++pending.received;
+    if (index < data_count) {
+        ++pending.data_received;
+    }
+    if (pending.data_received == data_count) {
+        groups_.erase(group);
+        groups_done_[group] = true;
+    }
+}
+
+void frame_assembler_t::rebuild() {
+    const auto &erasure = manifest_.erasure;
+    std::lock_guard lock{erasure_mutex_};
+    for (auto &[group, pending] : groups_) {
+        const std::size_t data_count =
+            erasure.group_data_count(group, manifest_.chunk_count);
+        if (pending.received < data_count) {
+            continue;
+        }
+        std::vector<std::uint32_t> lost;
+        for (std::uint32_t i = 0; i < data_count; ++i) {
+            if (pending.chunks[i].empty()) {
+                lost.push_back(i);
+            }
+        }
+        CHECK(erasure_coder_->recover(pending.chunks, data_count,
+                                      manifest_.chunk_size));
+        for (const std::uint32_t i : lost) {
+            const auto sequence_number =
+                static_cast<std::uint32_t>(erasure.data_chunk(group, i));
+            auto &chunk = pending.chunks[i];
+            chunk.resize(manifest_.chunk_length(sequence_number));
+            if (place(sequence_number, chunk)) {
+                recovered_.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        groups_done_[group] = true;
+    }
+    groups_.clear();
+}
+
+auto frame_assembler_t::manifest() const -> std::optional<manifest_t> {
+    if (!ready_.load(std::memory_order_acquire)) {
+        return std::nullopt;
+    }
+    return manifest_;
+}
+
+auto frame_assembler_t::missing() const -> std::vector<std::uint32_t> {
+    std::vector<std::uint32_t> missing;
+    if (!ready_.load(std::memory_order_acquire)) {
+        return missing;
+    }
+    for (std::uint32_t i = 0; i < manifest_.chunk_count; ++i) {
+        if (!received_[i].load(std::memory_order_relaxed)) {
+            missing.push_back(i);
+        }
+    }
+    return missing;
+}
+
+void frame_assembler_t::finish() {
+    if (!ready_.load(std::memory_order_acquire)) {
+        LOG(ERROR) << "No manifest found";
+        throw std::runtime_error{"No manifest found"};
+    }
+    if (erasure_coder_) {
+        rebuild();
+    }
+    const auto missing_chunks = missing();
+    if (!missing_chunks.empty()) {
+        LOG(ERROR) << missing_chunks.size() << " of " << manifest_.chunk_count
+                   << " chunks missing, first is " << missing_chunks.front();
+        throw std::runtime_error{
+            fmt::format("{} of {} chunks missing, first is {}",
+                        missing_chunks.size(), manifest_.chunk_count,
+                        missing_chunks.front())};
+    }
+    if (recovered() > 0) {
+        LOG(WARNING) << "Rebuilt " << recovered()
+                     << " lost chunks from parity chunks";
+    }
+    if (duplicates() > 0) {
+        LOG(WARNING) << "Dropped " << duplicates() << " duplicate chunks";
+    }
+}
+
+} // namespace net_zelcon::plain_sight
\ No newline at end of file
@@ -0,0 +1,211 @@
+#ifndef _INCLUDE_NET_ZELCON_PLAIN_SIGHT_FRAMING_H_
+#define _INCLUDE_NET_ZELCON_PLAIN_SIGHT_FRAMING_H_
+
+#include "plain_sight/erasure_code.h"
+#include "plain_sight/output_sink.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace net_zelcon::plain_sight {
+
+/// @brief How payload bytes are laid out in the QR codes of a video.
+enum class framing_t {
+    /// @brief QR codes carry raw payload bytes, in order.
+    none,
+    /// @brief The first QR code carries a `manifest_t`; every other one a
+    /// sequence number followed by its chunk of the payload, or, with an
+    /// `erasure_code_t`, a parity chunk. Chunks can be placed in the output
+    /// no matter the order they are decoded in.
+    sequenced,
+};
+
+/// @brief Describes the whole payload. Carried by the first QR code of a
+/// `framing_t::sequenced` video.
+struct manifest_t {
+    std::uint64_t total_length;
+    /// @brief Bytes in every chunk but the last, which may be shorter.
+    std::uint32_t chunk_size;
+    std::uint32_t chunk_count;
+    /// @brief Parity sent along with the chunks, if enabled.
+    erasure_code_t erasure{};
+
+    /// @brief Manifest of `total_length` bytes cut into `chunk_size` chunks,
+    /// protected by `erasure`.
+    static auto for_payload(std::uint64_t total_length,
+                            std::uint32_t chunk_size,
+                            const erasure_code_t &erasure = {}) -> manifest_t;
+
+    /// @brief Offset of chunk `sequence_number` in the payload.
+    [[nodiscard]] auto chunk_offset(std::uint32_t sequence_number) const
+        -> std::uint64_t {
+        return static_cast<std::uint64_t>(sequence_number) * chunk_size;
+    }
+    /// @brief Length of chunk `sequence_number`.
+    [[nodiscard]] auto chunk_length(std::uint32_t sequence_number) const
+        -> std::size_t;
+
+    auto operator==(const manifest_t &) const -> bool = default;
+};
+
+/// @brief One chunk of a `framing_t::sequenced` payload.
+struct chunk_t {
+    std::uint32_t sequence_number;
+    std::span<const std::uint8_t> data;
+};
+
+/// @brief One parity chunk of a `framing_t::sequenced` payload; see
+/// `erasure_code_t` for its numbering.
+struct parity_chunk_t {
+    std::uint32_t sequence_number;
+    std::span<const std::uint8_t> data;
+};
+
+/// @brief The wire format of `framing_t::sequenced`. Every QR code payload
+/// starts with a tag byte; integers are little endian.
+/// - manifest: `'M'`, total length (u64), chunk size (u32), chunk count
+///   (u32), and, with an erasure code, group size (u8), parity chunks (u8)
+///   and interleaving (u16)
+/// - chunk: `'C'`, sequence number (u32), chunk bytes
+/// - parity chunk: `'P'`, parity sequence number (u32), `chunk_size` bytes
+namespace framing {
+
+constexpr std::uint8_t manifest_tag = 'M';
+constexpr std::uint8_t chunk_tag = 'C';
+constexpr std::uint8_t parity_tag = 'P';
+constexpr std::size_t manifest_size = 1 + 8 + 4 + 4;
+constexpr std::size_t erasure_manifest_size = manifest_size + 1 + 1 + 2;
+constexpr std::size_t chunk_header_size = 1 + 4;
+
+void write_manifest(std::vector<std::uint8_t> &dst, const manifest_t &manifest);
+
+void write_chunk(std::vector<std::uint8_t> &dst, std::uint32_t sequence_number,
+                 std::span<const std::uint8_t> data);
+
+void write_parity_chunk(std::vector<std::uint8_t> &dst,
+                        std::uint32_t sequence_number,
+                        std::span<const std::uint8_t> data);
+
+/// @brief Parses one QR code payload.
+/// @throws std::runtime_error if `payload` is neither a manifest nor a
+/// chunk nor a parity chunk
+auto parse(std::span<const std::uint8_t> payload)
+    -> std::variant<manifest_t, chunk_t, parity_chunk_t>;
+
+} // namespace framing
+
+/// @brief Reassembles a `framing_t::sequenced` payload from QR code payloads
+/// decoded in any order, on any number of threads.
+/// @details Once the manifest arrives, the output is allocated once and every
+/// chunk is copied straight to its place; chunks decoded before the manifest
+/// are held back until then. Duplicate chunks are counted and dropped.
+/// Assembling into an `output_sink_t` instead writes chunks out in order as
+/// soon as all those before them have been written, holding back only the
+/// chunks decoded ahead of a gap.
+/// With an erasure code, the chunks of each group are also kept until all
+/// its data chunks have arrived. Since chunks arrive in any order, a group
+/// still missing data chunks may yet receive them, so it is rebuilt only by
+/// `finish()`, if it has as many chunks, data or parity, as it has data
+/// chunks; the rebuilt chunks are then placed like decoded ones.
+class frame_assembler_t {
+  public:
+    /// @param dst Output; resized to the payload length once the manifest is
+    /// known. Must outlive the assembler and not be touched until `finish()`.
+    explicit frame_assembler_t(std::vector<std::uint8_t> &dst);
+
+    /// @param dst Output, written under a lock, so never concurrently. Must
+    /// outlive the assembler. A missing chunk holds back every chunk after
+    /// it until `finish()` reports it.
+    explicit frame_assembler_t(output_sink_t &dst);
+
+    frame_assembler_t(const frame_assembler_t &) = delete;
+    frame_assembler_t &operator=(const frame_assembler_t &) = delete;
+
+    /// @brief Takes one QR code payload. Safe to call concurrently.
+    /// @throws std::runtime_error if the payload is malformed or
+    /// contradicts the manifest
+    void add(std::span<const std::uint8_t> payload);
+
+    /// @return the manifest, if it has been seen
+    [[nodiscard]] auto manifest() const -> std::optional<manifest_t>;
+    /// @brief Sequence numbers of the chunks not received yet. Empty before
+    /// the manifest is known.
+    [[nodiscard]] auto missing() const -> std::vector<std::uint32_t>;
+    [[nodiscard]] auto duplicates() const noexcept -> std::size_t {
+        return duplicates_.load(std::memory_order_relaxed);
+    }
+    /// @brief Number of chunks rebuilt from parity chunks.
+    [[nodiscard]] auto recovered() const noexcept -> std::size_t {
+        return recovered_.load(std::memory_order_relaxed);
+    }
+
+    /// @brief Rebuilds the lost chunks the parity chunks allow and checks
+    /// that the payload is complete. Call after the last `add()` has
+    /// returned.
+    /// @throws std::runtime_error if the manifest or any chunk is missing
+    void finish();
+
+  private:
+    /// @brief The chunks of a group received so far: its data chunks, then
+    /// its parity chunks, empty until received.
+    struct erasure_group_t {
+        std::vector<std::vector<std::uint8_t>> chunks;
+        std::size_t received = 0, data_received = 0;
+    };
+
+    /// @brief Takes a chunk or parity chunk once the manifest is known.
+    void take(const std::variant<manifest_t, chunk_t, parity_chunk_t> &parsed);
+
+    /// @return whether the chunk is new, i.e., not a duplicate
+    auto place(std::uint32_t sequence_number,
+               std::span<const std::uint8_t> data) -> bool;
+
+    /// @brief Keeps chunk `index` of `group` for the erasure code until the
+    /// group has all its data chunks.
+    void collect(std::uint64_t group, std::size_t index,
+                 std::span<const std::uint8_t> data);
+
+    /// @brief Places the lost data chunks of the groups that can be rebuilt.
+    void rebuild();
+
+    // Exactly one of the two outputs is set.
+    std::vector<std::uint8_t> *dst_ = nullptr;
+    output_sink_t *sink_ = nullptr;
+    mutable std::mutex mutex_;
+    // Set, with release semantics, once `manifest_`, `dst_` and `received_`
+    // are ready for lock-free chunk placement.
+    std::atomic<bool> ready_{false};
+    manifest_t manifest_{};
+    std::unique_ptr<std::atomic<bool>[]> received_;
+    // Payloads that arrived before the manifest, guarded by `mutex_`
+    std::vector<std::vector<std::uint8_t>> early_;
+    std::atomic<std::size_t> duplicates_{0};
+    // Set with the manifest if it has an erasure code
+    std::unique_ptr<const erasure_coder_t> erasure_coder_;
+    // Groups that have chunks but not all their data chunks, and
+    // whether each group is done, guarded by `erasure_mutex_`
+    std::mutex erasure_mutex_;
+    std::unordered_map<std::uint64_t, erasure_group_t> groups_;
+    std::vector<bool> groups_done_;
+    std::atomic<std::size_t> recovered_{0};
+    // With a sink, guards the next chunk to write and the chunks decoded
+    // ahead of it. Separate from `mutex_`, which is held while the early
+    // chunks are placed.
+    std::mutex sink_mutex_;
+    std::uint32_t next_ = 0;
+    std::map<std::uint32_t, std::vector<std::uint8_t>> ahead_;
+};
+
+} // namespace net_zelcon::plain_sight
+
+#endif // _INCLUDE_NET_ZELCON_PLAIN_SIGHT_FRAMING_H_
\ No newline at end of file
@@ -0,0 +1,318 @@
+#include <gtest/gtest.h>
+
+#include "plain_sight/framing.h"
+#include "plain_sight/output_sink.h"
+#include "plain_sight/thread_pool.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <future>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+using namespace net_zelcon::plain_sight;
+
+namespace {
+
+// The framed QR code payloads of `data`, manifest first, then the chunks and
+// the parity chunks of `erasure`.
+auto frame_payload(const std::vector<std::uint8_t> &data,
+                   std::uint32_t chunk_size,
+                   const erasure_code_t &erasure = {})
+    -> std::vector<std::vector<std::uint8_t>> {
+    const auto manifest =
+        manifest_t::for_payload(data.size(), chunk_size, erasure);
+    const auto chunk = [&](const std::uint64_t i) {
+        const auto sequence_number = static_cast<std::uint32_t>(i);
+        return std::span{data}.subspan(manifest.chunk_offset(sequence_number),
+                                       manifest.chunk_length(sequence_number));
+    };
+    std::vector<std::vector<std::uint8_t>> payloads(1);
+    framing::write_manifest(payloads.front(), manifest);
+    for (std::uint32_t i = 0; i < manifest.chunk_count; ++i) {
+        framing::write_chunk(payloads.emplace_back(), i, chunk(i));
+    }
+    if (!erasure.enabled()) {
+        return payloads;
+    }
+    const erasure_coder_t coder{erasure};
+    std::vector<std::vector<std::uint8_t>> parity;
+    for (std::uint64_t group = 0;
+         group < erasure.group_count(manifest.chunk_count); ++group) {
+        std::vector<std::span<const std::uint8_t>> group_data;
+        for (std::uint32_t i = 0;
+             i < erasure.group_data_count(group, manifest.chunk_count); ++i) {
+            group_data.push_back(chunk(erasure.data_chunk(group, i)));
+        }
+        coder.encode(group_data, chunk_size, parity);
+        for (std::uint32_t i = 0; i < erasure.parity_chunks; ++i) {
+            framing::write_parity_chunk(
+                payloads.emplace_back(),
+                static_cast<std::uint32_t>(group * erasure.parity_chunks + i),
+                parity[i]);
+        }
+    }
+    return payloads;
+}
+
+auto make_data(std::size_t size) -> std::vector<std::uint8_t> {
+    std::vector<std::uint8_t> data(size);
+    for (std::size_t i = 0; i < size; ++i) {
+        data[i] = static_cast<std::uint8_t>(i * 31 + 7);
+    }
+    return data;
+}
+
+} // namespace
+
+TEST(FramingTest, ParseRoundTrip) {
+    const auto manifest = manifest_t::for_payload(1001, 100);
+    EXPECT_EQ(manifest.chunk_count, 11U);
+    EXPECT_EQ(manifest.chunk_length(10), 1U);
+    std::vector<std::uint8_t> payload;
+    framing::write_manifest(payload, manifest);
+    ASSERT_EQ(payload.size(), framing::manifest_size);
+    EXPECT_EQ(std::get<manifest_t>(framing::parse(payload)), manifest);
+
+    const std::vector<std::uint8_t> data{1, 2, 3};
+    payload.clear();
+    framing::write_chunk(payload, 0x01020304, data);
+    const auto chunk = std::get<chunk_t>(framing::parse(payload));
+    EXPECT_EQ(chunk.sequence_number, 0x01020304U);
+    EXPECT_TRUE(std::equal(chunk.data.begin(), chunk.data.end(), data.begin(),
+                           data.end()));
+
+    EXPECT_THROW(framing::parse({}), std::runtime_error);
+    payload = {'X', 0, 0, 0, 0};
+    EXPECT_THROW(framing::parse(payload), std::runtime_error);
+    payload = {framing::manifest_tag, 1, 2};
+    EXPECT_THROW(framing::parse(payload), std::runtime_error);
+}
+
+TEST(FramingTest, ParseErasureCode) {
+    const erasure_code_t erasure{
+        .group_size = 20, .parity_chunks = 3, .interleaving = 4};
+    const auto manifest = manifest_t::for_payload(10'000, 100, erasure);
+    // 100 chunks: a full stripe of 4 groups of 20, then 4 groups of 5
+    EXPECT_EQ(erasure.group_count(manifest.chunk_count), 8U);
+    EXPECT_EQ(erasure.parity_count(manifest.chunk_count), 24U);
+    EXPECT_EQ(erasure.group_data_count(7, manifest.chunk_count), 5U);
+    EXPECT_EQ(erasure.locate(85),
+              (std::pair<std::uint64_t, std::uint32_t>{5, 1}));
+    EXPECT_EQ(erasure.data_chunk(5, 1), 85U);
+    EXPECT_EQ(erasure.stripe_count(manifest.chunk_count), 2U);
+    EXPECT_EQ(erasure.overhead_count(manifest.chunk_count), 26U);
+    EXPECT_EQ(erasure.overhead_before(85), 13U);
+    // Too many parity chunks for the encoder to build a stripe's at once
+    EXPECT_FALSE((erasure_code_t{
+                      .group_size = 10, .parity_chunks = 4, .interleaving = 300}
+                      .valid()));
+    std::vector<std::uint8_t> payload;
+    framing::write_manifest(payload, manifest);
+    ASSERT_EQ(payload.size(), framing::erasure_manifest_size);
+    EXPECT_EQ(std::get<manifest_t>(framing::parse(payload)), manifest);
+
+    payload.clear();
+    const std::vector<std::uint8_t> data(100, 0xAB);
+    framing::write_parity_chunk(payload, 23, data);
+    const auto parity = std::get<parity_chunk_t>(framing::parse(payload));
+    EXPECT_EQ(parity.sequence_number, 23U);
+    EXPECT_EQ(parity.data.size(), 100U);
+
+    // Groups larger than a Reed-Solomon codeword has room for
+    payload.clear();
+    framing::write_manifest(payload, manifest);
+    payload[framing::manifest_size] = 253;
+    EXPECT_THROW(framing::parse(payload), std::runtime_error);
+}
+
+TEST(FrameAssemblerTest, OutOfOrderWithDuplicates) {
+    const auto data = make_data(2'345);
+    auto payloads = frame_payload(data, 100);
+    // Chunks before and after the manifest, in random order, some twice
+    payloads.push_back(payloads[3]);
+    payloads.push_back(payloads[7]);
+    std::mt19937 rng{42};
+    std::shuffle(payloads.begin(), payloads.end(), rng);
+    std::vector<std::uint8_t> dst;
+    frame_assembler_t assembler{dst};
+    for (const auto &payload : payloads) {
+        assembler.add(payload);
+    }
+    assembler.finish();
+    EXPECT_EQ(assembler.duplicates(), 2U);
+    EXPECT_EQ(dst, data);
+}
+
+TEST(FrameAssemblerTest, ReportsMissingChunks) {
+    const auto data = make_data(1'000);
+    auto payloads = frame_payload(data, 100);
+    std::vector<std::uint8_t> dst;
+    frame_assembler_t assembler{dst};
+    for (std::size_t i = 1; i < payloads.size(); ++i) {
+        assembler.add(payloads[i]);
+    }
+    EXPECT_FALSE(assembler.manifest());
+    EXPECT_THROW(assembler.finish(), std::runtime_error);
+    payloads.erase(payloads.begin() + 5);
+    frame_assembler_t incomplete{dst};
+    for (const auto &payload : payloads) {
+        incomplete.add(payload);
+    }
+    EXPECT_EQ(incomplete.missing(), std::vector<std::uint32_t>{4});
+    EXPECT_THROW(incomplete.finish(), std::runtime_error);
+}
+
+TEST(FrameAssemblerTest, RejectsChunksThatContradictManifest) {
+    const auto data = make_data(250);
+    const auto payloads = frame_payload(data, 100);
+    std::vector<std::uint8_t> dst;
+    frame_assembler_t assembler{dst};
+    assembler.add(payloads.front());
+    std::vector<std::uint8_t> payload;
+    framing::write_chunk(payload, 3, std::span{data}.first(10));
+    EXPECT_THROW(assembler.add(payload), std::runtime_error);
+    payload.clear();
+    framing::write_chunk(payload, 2, std::span{data}.first(100));
+    EXPECT_THROW(assembler.add(payload), std::runtime_error);
+}
+
+TEST(FrameAssemblerTest, ConcurrentAdds) {
+    const auto data = make_data(100'000);
+    const auto payloads = frame_payload(data, 100);
+    std::vector<std::uint8_t> dst;
+    frame_assembler_t assembler{dst};
+    thread_pool_t pool{4};
+    std::vector<std::future<void>> tasks;
+    constexpr std::size_t num_tasks = 8;
+    for (std::size_t task = 0; task < num_tasks; ++task) {
+        // Back to front, so many chunks arrive before the manifest
+        tasks.emplace_back(pool.submit([&, task] {
+            for (std::size_t i = task; i < payloads.size(); i += num_tasks) {
+                assembler.add(payloads[payloads.size() - 1 - i]);
+            }
+        }));
+    }
+    for (auto &task : tasks) {
+        task.get();
+    }
+    assembler.finish();
+    EXPECT_EQ(dst, data);
+}
+
+TEST(FrameAssemblerTest, WritesChunksToSinkInOrder) {
+    const auto data = make_data(2'345);
+    auto payloads = frame_payload(data, 100);
+    payloads.push_back(payloads[3]);
+    std::mt19937 rng{7};
+    std::shuffle(payloads.begin(), payloads.end(), rng);
+    std::vector<std::uint8_t> dst;
+    std::size_t writes = 0;
+    callback_output_sink_t sink{[&](std::span<const std::uint8_t> piece) {
+        EXPECT_LE(piece.size(), 100U) << "Chunks are written one by one";
+        dst.insert(dst.end(), piece.begin(), piece.end());
+        ++writes;
+    }};
+    frame_assembler_t assembler{sink};
+    for (const auto &payload : payloads) {
+        assembler.add(payload);
+    }
+    assembler.finish();
+    EXPECT_EQ(assembler.duplicates(), 1U);
+    EXPECT_EQ(writes, 24U);
+    EXPECT_EQ(dst, data);
+}
+
+TEST(FrameAssemblerTest, HoldsChunksAfterAGap) {
+    const auto data = make_data(1'000);
+    const auto payloads = frame_payload(data, 100);
+    std::vector<std::uint8_t> dst;
+    vector_output_sink_t sink{dst};
+    frame_assembler_t assembler{sink};
+    for (std::size_t i = 0; i < payloads.size(); ++i) {
+        if (i != 3) {
+            assembler.add(payloads[i]);
+        }
+    }
+    EXPECT_EQ(dst.size(), 200U) << "Only the chunks before the gap";
+    EXPECT_THROW(assembler.finish(), std::runtime_error);
+    assembler.add(payloads[3]);
+    assembler.finish();
+    EXPECT_EQ(dst, data);
+}
+
+TEST(FrameAssemblerTest, RebuildsLostChunksFromParity) {
+    const erasure_code_t erasure{
+        .group_size = 10, .parity_chunks = 2, .interleaving = 3};
+    const auto data = make_data(4'321);
+    auto payloads = frame_payload(data, 100, erasure);
+    // 44 chunks in a stripe of 30 and one of 14; a run of 6 lost chunks
+    // costs each group of the first stripe 2, and the last chunk is lost too
+    ASSERT_EQ(payloads.size(), 1U + 44 + 6 * 2);
+    payloads.erase(payloads.begin() + 44);
+    payloads.erase(payloads.begin() + 11, payloads.begin() + 17);
+    std::mt19937 rng{5};
+    std::shuffle(payloads.begin() + 1, payloads.end(), rng);
+
+    std::vector<std::uint8_t> dst;
+    frame_assembler_t assembler{dst};
+    std::vector<std::uint8_t> streamed;
+    vector_output_sink_t sink{streamed};
+    frame_assembler_t streaming{sink};
+    for (const auto &payload : payloads) {
+        assembler.add(payload);
+        streaming.add(payload);
+    }
+    assembler.finish();
+    streaming.finish();
+    EXPECT_EQ(assembler.recovered(), 7U);
+    EXPECT_EQ(streaming.recovered(), 7U);
+    EXPECT_EQ(dst, data);
+    EXPECT_EQ(streamed, data);
+}
+
+TEST(FrameAssemblerTest, LateChunksAreNotRebuilt) {
+    const erasure_code_t erasure{
+        .group_size = 10, .parity_chunks = 2, .interleaving = 3};
+    const auto data = make_data(4'321);
+    auto payloads = frame_payload(data, 100, erasure);
+    // Every parity chunk first, so each group could be rebuilt before the
+    // last of its data chunks arrives
+    std::rotate(payloads.begin() + 1, payloads.begin() + 1 + 44,
+                payloads.end());
+
+    std::vector<std::uint8_t> dst;
+    frame_assembler_t assembler{dst};
+    for (const auto &payload : payloads) {
+        assembler.add(payload);
+    }
+    assembler.finish();
+    EXPECT_EQ(assembler.recovered(), 0U);
+    EXPECT_EQ(assembler.duplicates(), 0U);
+    EXPECT_EQ(dst, data);
+}
+
+TEST(FrameAssemblerTest, ReportsChunksTheParityCannotRebuild) {
+    const erasure_code_t erasure{.group_size = 10, .parity_chunks = 2};
+    const auto data = make_data(1'000);
+    auto payloads = frame_payload(data, 100, erasure);
+    // Three chunks of the only group, and a parity chunk that does not exist
+    payloads.erase(payloads.begin() + 2, payloads.begin() + 5);
+    std::vector<std::uint8_t> dst;
+    frame_assembler_t assembler{dst};
+    for (const auto &payload : payloads) {
+        assembler.add(payload);
+    }
+    EXPECT_EQ(assembler.recovered(), 0U);
+    EXPECT_EQ(assembler.missing(), (std::vector<std::uint32_t>{1, 2, 3}));
+    EXPECT_THROW(assembler.finish(), std::runtime_error);
+    std::vector<std::uint8_t> payload;
+    framing::write_parity_chunk(payload, 2, std::span{data}.first(100));
+    EXPECT_THROW(assembler.add(payload), std::runtime_error);
+    // Parity without an erasure code is malformed too
+    frame_assembler_t unprotected{dst};
+    unprotected.add(frame_payload(data, 100).front());
+    EXPECT_THROW(unprotected.add(payload), std::runtime_error);
+}
\ No newline at end of file
@@ -0,0 +1,227 @@
+#include "plain_sight/grid_codec.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fmt/core.h>
+#include <glog/logging.h>
+#include <stdexcept>
+#include <string>
+
+namespace net_zelcon::plain_sight {
+
+namespace {
+
+constexpr std::size_t max_block_size = 255;
+
+/// @brief Reads or writes a byte string `bits` bits at a time, most
+/// significant bit first. Past the end, reads give zeros and writes are
+/// dropped.
+class bit_cursor_t {
+  public:
+    bit_cursor_t(std::uint8_t *bytes, std::size_t size, int bits)
+        : bytes_{bytes}, size_{size}, bits_{bits} {}
+
+    auto read() -> unsigned {
+        unsigned value = 0;
+        for (int i = 0; i < bits_; ++i, ++position_) {
+            const std::size_t byte = position_ / 8;
+            const unsigned bit =
+                byte < size_ ? bytes_[byte] >> (7 - position_ % 8) & 1 : 0;
+            value = value << 1 | bit;
+        }
+        return value;
+    }
+
+    void write(const unsigned value) {
+        for (int i = bits_ - 1; i >= 0; --i, ++position_) {
+            const std::size_t byte = position_ / 8;
+            if (byte < size_ && (value >> i & 1)) {
+                bytes_[byte] |= static_cast<std::uint8_t>(
+                    0x80 >> (position_ % 8));
+            }
+        }
+    }
+
+  private:
+    std::uint8_t *bytes_;
+    std::size_t size_;
+    int bits_;
+    std::size_t position_ = 0;
+};
+
+[[noreturn]] void malformed(const std::string &what) {
+    LOG(ERROR) << "Malformed grid frame: " << what;
+    throw std::runtime_error{fmt::format("Malformed grid frame: {}", what)};
+}
+
+} // namespace
+
+grid_codec_t::grid_codec_t(const grid_layout_t &layout)
+    : layout_{layout},
+      reed_solomon_{static_cast<std::size_t>(layout.parity_size)} {
+    CHECK_GT(layout_.columns, 0);
+    CHECK_GT(layout_.rows, 0);
+    CHECK_GT(layout_.cell_size, 0);
+    CHECK_GE(layout_.border_size, 0);
+    CHECK_GE(layout_.bits_per_cell, 1);
+    CHECK_LE(layout_.bits_per_cell, 4);
+    const std::size_t num_cells =
+        static_cast<std::size_t>(layout_.columns) * layout_.rows;
+    raw_capacity_ = num_cells * layout_.bits_per_cell / 8;
+    num_blocks_ = (raw_capacity_ + max_block_size - 1) / max_block_size;
+    CHECK_GT(num_blocks_, 0U) << "Grid too small for a single byte";
+    CHECK_GT(block_size(num_blocks_ - 1), reed_solomon_.parity_size())
+        << "Grid too small for " << layout_.parity_size
+        << " parity bytes per block";
+    const std::size_t data_size =
+        raw_capacity_ - num_blocks_ * reed_solomon_.parity_size();
+    CHECK_GT(data_size, length_size_) << "Grid too small for any payload";
+    capacity_ = data_size - length_size_;
+
+    const unsigned num_levels = 1U << layout_.bits_per_cell;
+    luma_of_bits_.resize(num_levels);
+    for (unsigned level = 0; level < num_levels; ++level) {
+        luma_of_bits_[level ^ level >> 1] = static_cast<std::uint8_t>(
+            (level * 255 + (num_levels - 1) / 2) / (num_levels - 1));
+    }
+    bits_of_luma_.resize(256);
+    for (unsigned luma = 0; luma < 256; ++luma) {
+        const unsigned level =
+            (luma * (num_levels - 1) + 127) / 255; // nearest level
+        bits_of_luma_[luma] = static_cast<std::uint8_t>(level ^ level >> 1);
+    }
+}
+
+auto grid_codec_t::block_size(const std::size_t block) const -> std::size_t {
+    // Blocks differ in size by at most one byte, the longer ones first.
+    const std::size_t size = raw_capacity_ / num_blocks_;
+    return block < raw_capacity_ % num_blocks_ ? size + 1 : size;
+}
+
+void grid_codec_t::render(std::span<const std::uint8_t> payload,
+                          std::uint8_t *dst,
+                          const std::ptrdiff_t linesize) const {
+    CHECK_LE(payload.size(), capacity_);
+    const std::size_t parity_size = reed_solomon_.parity_size();
+    // Length, payload and padding, in block order
+    std::vector<std::uint8_t> data(raw_capacity_ - num_blocks_ * parity_size,
+                                   0);
+    const auto length = static_cast<std::uint32_t>(payload.size());
+    for (std::size_t i = 0; i < length_size_; ++i) {
+        data[i] = static_cast<std::uint8_t>(length >> (8 * i));
+    }
+    std::copy(payload.begin(), payload.end(), data.begin() + length_size_);
+
+    // Interleave the blocks' codewords: byte i of every block, then byte
+    // i + 1 of every block, and so on. The long blocks come first, so the
+    // final round, where only they take part, leaves no holes.
+    std::vector<std::uint8_t> raw(raw_capacity_);
+    std::vector<std::uint8_t> codeword;
+    std::size_t data_offset = 0;
+    for (std::size_t block = 0; block < num_blocks_; ++block) {
+        const std::size_t size = block_size(block);
+        const std::size_t data_size = size - parity_size;
+        codeword.resize(size);
+        std::copy_n(data.begin() + data_offset, data_size, codeword.begin());
+        data_offset += data_size;
+        reed_solomon_.encode(
+            std::span{codeword}.first(data_size),
+            std::span{codeword}.subspan(data_size, parity_size));
+        for (std::size_t i = 0; i < size; ++i) {
+            raw[i * num_blocks_ + block] = codeword[i];
+        }
+    }
+
+    const int cell_size = layout_.cell_size;
+    const int border = layout_.border_size;
+    const int width = layout_.width();
+    std::vector<std::uint8_t> cell_row(layout_.columns);
+    bit_cursor_t cursor{raw.data(), raw.size(), layout_.bits_per_cell};
+    for (int y = 0; y < border; ++y) {
+        std::memset(dst + y * linesize, 255, width);
+    }
+    for (int row = 0; row < layout_.rows; ++row) {
+        for (auto &luma : cell_row) {
+            luma = luma_of_bits_[cursor.read()];
+        }
+        std::uint8_t *const first_line =
+            dst + (border + row * cell_size) * linesize;
+        std::memset(first_line, 255, border);
+        std::uint8_t *pixel = first_line + border;
+        for (const std::uint8_t luma : cell_row) {
+            std::memset(pixel, luma, cell_size);
+            pixel += cell_size;
+        }
+        std::memset(pixel, 255, border);
+        for (int y = 1; y < cell_size; ++y) {
+            std::memcpy(first_line + y * linesize, first_line, width);
+        }
+    }
+    for (int y = layout_.height() - border; y < layout_.height(); ++y) {
+        std::memset(dst + y * linesize, 255, width);
+    }
+}
+
+auto grid_codec_t::decode(const std::uint8_t *src,
+                          const std::ptrdiff_t linesize,
+                          std::vector<std::uint8_t> &dst) const
+    -> std::size_t {
+    // Sample the middle of every cell; its edges bleed into the neighbors
+    // once the video codec is done with it.
+    const int cell_size = layout_.cell_size;
+    const int inset = cell_size >= 3 ? std::max(1, cell_size / 4) : 0;
+    const int sample_size = cell_size - 2 * inset;
+    const int num_samples = sample_size * sample_size;
+    std::vector<std::uint8_t> raw(raw_capacity_, 0);
+    bit_cursor_t cursor{raw.data(), raw.size(), layout_.bits_per_cell};
+    for (int row = 0; row < layout_.rows; ++row) {
+        const std::uint8_t *const top =
+            src +
+            (layout_.border_size + row * cell_size + inset) * linesize +
+            layout_.border_size + inset;
+        for (int column = 0; column < layout_.columns; ++column) {
+            const std::uint8_t *const corner = top + column * cell_size;
+            int sum = 0;
+            for (int y = 0; y < sample_size; ++y) {
+                for (int x = 0; x < sample_size; ++x) {
+                    sum += corner[y * linesize + x];
+                }
+            }
+            cursor.write(bits_of_luma_[(sum + num_samples / 2) / num_samples]);
+        }
+    }
+
+    const std::size_t parity_size = reed_solomon_.parity_size();
+    std::vector<std::uint8_t> data;
+    data.reserve(raw_capacity_ - num_blocks_ * parity_size);
+    std::vector<std::uint8_t> codeword;
+    std::size_t corrected = 0;
+    for (std::size_t block = 0; block < num_blocks_; ++block) {
+        const std::size_t size = block_size(block);
+        codeword.resize(size);
+        for (std::size_t i = 0; i < size; ++i) {
+            codeword[i] = raw[i * num_blocks_ + block];
+        }
+        const auto errors = reed_solomon_.decode(codeword);
+        if (!errors) {
+            malformed(fmt::format("block {} of {} is beyond repair", block,
+                                  num_blocks_));
+        }
+        corrected += *errors;
+        data.insert(data.end(), codeword.begin(),
+                    codeword.end() - static_cast<std::ptrdiff_t>(parity_size));
+    }
+    std::uint32_t length = 0;
+    for (std::size_t i = 0; i < length_size_; ++i) {
+        length |= static_cast<std::uint32_t>(data[i]) << (8 * i);
+    }
+    if (length > capacity_) {
+        malformed(fmt::format("payload of {} bytes in a frame of {}", length,
+                              capacity_));
+    }
+    dst.insert(dst.end(), data.begin() + length_size_,
+               data.begin() + length_size_ + length);
+    return corrected;
+}
+
+} // namespace net_zelcon::plain_sight
\ No newline at end of file
@@ -0,0 +1,102 @@
+#ifndef _INCLUDE_NET_ZELCON_PLAIN_SIGHT_GRID_CODEC_H_
+#define _INCLUDE_NET_ZELCON_PLAIN_SIGHT_GRID_CODEC_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "plain_sight/reed_solomon.h"
+
+namespace net_zelcon::plain_sight {
+
+/// @brief Fixed geometry of a frame of the grid symbology: `columns` ×
+/// `rows` square cells of `cell_size` pixels, surrounded by a white border of
+/// `border_size` pixels. Every cell is a flat gray level carrying
+/// `bits_per_cell` bits.
+/// @details The grid symbology is an alternative to QR codes for videos that
+/// are produced and consumed by this library, not filmed: the decoder knows
+/// the geometry and samples cells where they are instead of searching the
+/// frame for finder patterns. There are no function patterns, quiet zones or
+/// format information, and cells can carry more than one bit.
+struct grid_layout_t {
+    int columns = 96;
+    int rows = 96;
+    /// @brief Width and height of a cell in pixels. The decoder averages the
+    /// inner part of a cell, so cells of three pixels and up tolerate some
+    /// blurring at their edges.
+    int cell_size = 4;
+    int border_size = 8;
+    /// @brief 1 to 4; a cell is one of `2^bits_per_cell` evenly spaced gray
+    /// levels. More levels leave less room for compression noise.
+    int bits_per_cell = 1;
+    /// @brief Reed-Solomon parity bytes in each block of up to 255 bytes;
+    /// half as many corrupted bytes per block are corrected.
+    int parity_size = 32;
+
+    [[nodiscard]] auto width() const noexcept -> int {
+        return columns * cell_size + border_size * 2;
+    }
+    [[nodiscard]] auto height() const noexcept -> int {
+        return rows * cell_size + border_size * 2;
+    }
+};
+
+/// @brief Encodes payloads into, and decodes them from, 8-bit luma images of
+/// a `grid_layout_t`.
+/// @details A frame holds `raw_capacity()` bytes: the payload length
+/// (u32, little endian), the payload and zero padding, split into
+/// Reed-Solomon blocks. The blocks are interleaved byte by byte, so damage
+/// confined to one area of the frame is spread over all blocks. Bits are laid
+/// out most significant first, cells row by row, with gray levels in Gray
+/// code order so that mistaking a level for its neighbor costs one bit.
+/// Instances are immutable and safe to share between threads.
+class grid_codec_t {
+  public:
+    explicit grid_codec_t(const grid_layout_t &layout);
+
+    [[nodiscard]] auto layout() const noexcept -> const grid_layout_t & {
+        return layout_;
+    }
+    /// @brief Payload bytes per frame.
+    [[nodiscard]] auto capacity() const noexcept -> std::size_t {
+        return capacity_;
+    }
+    /// @brief Bytes per frame, parity and length included.
+    [[nodiscard]] auto raw_capacity() const noexcept -> std::size_t {
+        return raw_capacity_;
+    }
+
+    /// @brief Draws a frame carrying `payload`, at most `capacity()` bytes,
+    /// into the `layout().width()` × `layout().height()` image at `dst`,
+    /// `linesize` bytes per row.
+    void render(std::span<const std::uint8_t> payload, std::uint8_t *dst,
+                std::ptrdiff_t linesize) const;
+
+    /// @brief Samples the grid of the image at `src`, `linesize` bytes per
+    /// row, corrects it and appends the payload to `dst`.
+    /// @return Number of bytes Reed-Solomon had to correct
+    /// @throws std::runtime_error if a block has too many errors or the frame
+    /// is malformed
+    auto decode(const std::uint8_t *src, std::ptrdiff_t linesize,
+                std::vector<std::uint8_t> &dst) const -> std::size_t;
+
+  private:
+    /// @brief Data and parity bytes of block `block`.
+    [[nodiscard]] auto block_size(std::size_t block) const -> std::size_t;
+
+    grid_layout_t layout_;
+    reed_solomon_t reed_solomon_;
+    std::size_t raw_capacity_ = 0;
+    std::size_t num_blocks_ = 0;
+    std::size_t capacity_ = 0;
+    // Luma of each gray level, indexed by the bits the level carries
+    std::vector<std::uint8_t> luma_of_bits_;
+    // Bits carried by each luma value, i.e., by its nearest level
+    std::vector<std::uint8_t> bits_of_luma_;
+    constexpr static std::size_t length_size_ = 4;
+};
+
+} // namespace net_zelcon::plain_sight
+
+#endif // _INCLUDE_NET_ZELCON_PLAIN_SIGHT_GRID_CODEC_H_
\ No newline at end of file
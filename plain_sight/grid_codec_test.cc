@@ -0,0 +1,156 @@
+#include <gtest/gtest.h>
+
+#include "plain_sight/grid_codec.h"
+#include "plain_sight/reed_solomon.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using namespace net_zelcon::plain_sight;
+
+namespace {
+
+auto random_bytes(std::size_t size, std::mt19937 &rng)
+    -> std::vector<std::uint8_t> {
+    std::vector<std::uint8_t> bytes(size);
+    std::uniform_int_distribution<int> byte{0, 255};
+    std::generate(bytes.begin(), bytes.end(),
+                  [&] { return static_cast<std::uint8_t>(byte(rng)); });
+    return bytes;
+}
+
+} // namespace
+
+TEST(ReedSolomonTest, CorrectsUpToHalfTheParity) {
+    std::mt19937 rng{7};
+    for (const std::size_t parity_size : {2, 10, 32, 64}) {
+        for (const std::size_t size : {parity_size + 1, std::size_t{100},
+                                       std::size_t{255}}) {
+            const reed_solomon_t reed_solomon{parity_size};
+            auto codeword = random_bytes(size, rng);
+            const auto data_size = size - parity_size;
+            reed_solomon.encode(std::span{codeword}.first(data_size),
+                                std::span{codeword}.last(parity_size));
+            const auto original = codeword;
+            EXPECT_EQ(reed_solomon.decode(codeword), 0U);
+            // Corrupt as many distinct bytes as the code can correct.
+            std::vector<std::size_t> positions(size);
+            std::iota(positions.begin(), positions.end(), 0);
+            std::shuffle(positions.begin(), positions.end(), rng);
+            for (std::size_t i = 0; i < parity_size / 2; ++i) {
+                codeword[positions[i]] ^= static_cast<std::uint8_t>(1 + i);
+            }
+            EXPECT_EQ(reed_solomon.decode(codeword), parity_size / 2);
+            EXPECT_EQ(codeword, original);
+        }
+    }
+}
+
+TEST(ReedSolomonTest, RejectsTooManyErrors) {
+    std::mt19937 rng{11};
+    const reed_solomon_t reed_solomon{16};
+    auto codeword = random_bytes(200, rng);
+    reed_solomon.encode(std::span{codeword}.first(184),
+                        std::span{codeword}.last(16));
+    for (std::size_t i = 0; i < 30; ++i) {
+        codeword[i * 5] ^= 0x5A;
+    }
+    const auto corrupted = codeword;
+    EXPECT_FALSE(reed_solomon.decode(codeword));
+    EXPECT_EQ(codeword, corrupted);
+}
+
+TEST(ReedSolomonTest, FillsUpToTheParityInErasures) {
+    std::mt19937 rng{13};
+    for (const std::size_t parity_size : {1, 4, 32}) {
+        const reed_solomon_t reed_solomon{parity_size};
+        auto codeword = random_bytes(120, rng);
+        reed_solomon.encode(std::span{codeword}.first(120 - parity_size),
+                            std::span{codeword}.last(parity_size));
+        const auto original = codeword;
+        std::vector<std::size_t> positions(codeword.size());
+        std::iota(positions.begin(), positions.end(), 0);
+        std::shuffle(positions.begin(), positions.end(), rng);
+        positions.resize(parity_size + 1);
+        for (const std::size_t position : positions) {
+            codeword[position] = 0xA5;
+        }
+        // One more erasure than parity bytes is too many, and changes nothing
+        const auto erased = codeword;
+        EXPECT_FALSE(reed_solomon.decode_erasures(codeword, positions));
+        EXPECT_EQ(codeword, erased);
+        codeword[positions.back()] = original[positions.back()];
+        positions.pop_back();
+        EXPECT_TRUE(reed_solomon.decode_erasures(codeword, positions));
+        EXPECT_EQ(codeword, original);
+    }
+}
+
+class GridCodecTest : public ::testing::TestWithParam<int> {};
+
+TEST_P(GridCodecTest, RoundTrip) {
+    const grid_layout_t layout{.columns = 64,
+                               .rows = 48,
+                               .cell_size = 4,
+                               .border_size = 4,
+                               .bits_per_cell = GetParam(),
+                               .parity_size = 16};
+    const grid_codec_t codec{layout};
+    EXPECT_EQ(codec.raw_capacity(), 64U * 48 * GetParam() / 8);
+    std::mt19937 rng{static_cast<unsigned>(GetParam())};
+    const std::ptrdiff_t linesize = layout.width() + 13;
+    std::vector<std::uint8_t> image(linesize * layout.height());
+    for (const std::size_t size : {codec.capacity(), std::size_t{0},
+                                   codec.capacity() / 3}) {
+        const auto payload = random_bytes(size, rng);
+        codec.render(payload, image.data(), linesize);
+        // Noise of up to a quarter of the distance between levels
+        const int noise = 255 / ((1 << GetParam()) - 1) / 4;
+        std::uniform_int_distribution<int> jitter{-noise, noise};
+        for (auto &luma : image) {
+            luma = static_cast<std::uint8_t>(
+                std::clamp(luma + jitter(rng), 0, 255));
+        }
+        std::vector<std::uint8_t> decoded{42};
+        EXPECT_EQ(codec.decode(image.data(), linesize, decoded), 0U);
+        ASSERT_EQ(decoded.size(), size + 1);
+        EXPECT_TRUE(std::equal(payload.begin(), payload.end(),
+                               decoded.begin() + 1));
+    }
+}
+
+TEST_P(GridCodecTest, CorrectsDamagedArea) {
+    const grid_layout_t layout{.columns = 64,
+                               .rows = 64,
+                               .cell_size = 3,
+                               .border_size = 2,
+                               .bits_per_cell = GetParam(),
+                               .parity_size = 32};
+    const grid_codec_t codec{layout};
+    std::mt19937 rng{static_cast<unsigned>(GetParam()) + 100};
+    const auto payload = random_bytes(codec.capacity(), rng);
+    const std::ptrdiff_t linesize = layout.width();
+    std::vector<std::uint8_t> image(linesize * layout.height());
+    codec.render(payload, image.data(), linesize);
+    // Wipe a band of cells; interleaving spreads it over every block.
+    const int band_rows = 2;
+    for (int y = layout.border_size;
+         y < layout.border_size + band_rows * layout.cell_size; ++y) {
+        std::fill_n(image.begin() + y * linesize, linesize, 255);
+    }
+    std::vector<std::uint8_t> decoded;
+    EXPECT_GT(codec.decode(image.data(), linesize, decoded), 0U);
+    EXPECT_EQ(decoded, payload);
+    // Wiping half of the frame is too much.
+    std::fill(image.begin(), image.begin() + image.size() / 2, 0);
+    decoded.clear();
+    EXPECT_THROW(codec.decode(image.data(), linesize, decoded),
+                 std::runtime_error);
+}
+
+INSTANTIATE_TEST_SUITE_P(BitsPerCell, GridCodecTest,
+                         ::testing::Values(1, 2, 3, 4));
\ No newline at end of file
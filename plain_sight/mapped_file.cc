@@ -0,0 +1,84 @@
+#include "plain_sight/mapped_file.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fmt/core.h>
+#include <glog/logging.h>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace net_zelcon::plain_sight {
+
+namespace {
+
+[[noreturn]] void fail(const std::string &what,
+                       const std::filesystem::path &path, const int error) {
+    LOG(ERROR) << "Could not " << what << " " << path << ": "
+               << std::strerror(error);
+    throw std::runtime_error{fmt::format("Could not {} {}: {}", what,
+                                         path.string(),
+                                         std::strerror(error))};
+}
+
+} // namespace
+
+mapped_file_t::mapped_file_t(const std::filesystem::path &path) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        fail("open", path, errno);
+    }
+    struct stat status {};
+    if (::fstat(fd, &status) != 0) {
+        const int error = errno;
+        ::close(fd);
+        fail("stat", path, error);
+    }
+    size_ = static_cast<std::size_t>(status.st_size);
+    if (size_ > 0) {
+        void *const mapping =
+            ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            const int error = errno;
+            ::close(fd);
+            fail("map", path, error);
+        }
+        data_ = static_cast<const std::uint8_t *>(mapping);
+        // Only a hint; the mapping works without it.
+        if (::madvise(mapping, size_, MADV_SEQUENTIAL) != 0) {
+            PLOG(WARNING) << "madvise(MADV_SEQUENTIAL) failed for " << path;
+        }
+    }
+    // The mapping keeps the file referenced.
+    ::close(fd);
+}
+
+mapped_file_t::~mapped_file_t() noexcept { unmap(); }
+
+mapped_file_t::mapped_file_t(mapped_file_t &&other) noexcept
+    : data_{std::exchange(other.data_, nullptr)},
+      size_{std::exchange(other.size_, 0)} {}
+
+mapped_file_t &mapped_file_t::operator=(mapped_file_t &&other) noexcept {
+    if (this != &other) {
+        unmap();
+        data_ = std::exchange(other.data_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+    }
+    return *this;
+}
+
+void mapped_file_t::unmap() noexcept {
+    if (data_ != nullptr) {
+        ::munmap(const_cast<std::uint8_t *>(data_), size_);
+        data_ = nullptr;
+    }
+    size_ = 0;
+}
+
+} // namespace net_zelcon::plain_sight
\ No newline at end of file
@@ -0,0 +1,43 @@
+#ifndef _INCLUDE_NET_ZELCON_PLAIN_SIGHT_MAPPED_FILE_H_
+#define _INCLUDE_NET_ZELCON_PLAIN_SIGHT_MAPPED_FILE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+
+namespace net_zelcon::plain_sight {
+
+/// @brief A file mapped read-only into memory, e.g., a payload to encode.
+/// @details Pages are read in on first touch, so encoding starts right away
+/// and the file is never copied onto the heap; the kernel is told the mapping
+/// is read sequentially, which makes it read ahead aggressively and drop
+/// pages behind the reader. The file must not be truncated while mapped.
+class mapped_file_t {
+  public:
+    /// @throws std::runtime_error if the file cannot be opened or mapped
+    explicit mapped_file_t(const std::filesystem::path &path);
+    ~mapped_file_t() noexcept;
+
+    mapped_file_t(const mapped_file_t &) = delete;
+    mapped_file_t &operator=(const mapped_file_t &) = delete;
+    mapped_file_t(mapped_file_t &&other) noexcept;
+    mapped_file_t &operator=(mapped_file_t &&other) noexcept;
+
+    /// @brief The file's contents; valid as long as the mapping.
+    [[nodiscard]] auto data() const noexcept -> std::span<const std::uint8_t> {
+        return {data_, size_};
+    }
+    [[nodiscard]] auto size() const noexcept -> std::size_t { return size_; }
+
+  private:
+    void unmap() noexcept;
+
+    // Null for an empty file, which cannot be mapped
+    const std::uint8_t *data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+} // namespace net_zelcon::plain_sight
+
+#endif // _INCLUDE_NET_ZELCON_PLAIN_SIGHT_MAPPED_FILE_H_
\ No newline at end of file
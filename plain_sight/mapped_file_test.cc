@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+
+#include "plain_sight/mapped_file.h"
+#include "plain_sight/util.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace net_zelcon::plain_sight;
+
+namespace {
+
+/// @brief A file in the temporary directory, removed at the end of the test.
+class temp_file_t {
+  public:
+    temp_file_t(const std::string &name, const std::vector<std::uint8_t> &data)
+        : path_{std::filesystem::temp_directory_path() / name} {
+        std::ofstream file{path_, std::ios::binary};
+        file.write(reinterpret_cast<const char *>(data.data()),
+                   static_cast<std::streamsize>(data.size()));
+    }
+    ~temp_file_t() { std::filesystem::remove(path_); }
+    auto path() const -> const std::filesystem::path & { return path_; }
+
+  private:
+    std::filesystem::path path_;
+};
+
+auto some_bytes(const std::size_t size) -> std::vector<std::uint8_t> {
+    std::vector<std::uint8_t> bytes(size);
+    for (std::size_t i = 0; i < size; ++i) {
+        bytes[i] = static_cast<std::uint8_t>(i * 131 + 7);
+    }
+    return bytes;
+}
+
+} // namespace
+
+TEST(MappedFileTest, MapsTheWholeFile) {
+    // Not a multiple of the page size, and with a zero byte and whitespace
+    const auto bytes = some_bytes(100'003);
+    const temp_file_t file{"plain_sight_mapped_file_test", bytes};
+    const mapped_file_t mapped{file.path()};
+    ASSERT_EQ(mapped.size(), bytes.size());
+    EXPECT_TRUE(std::equal(mapped.data().begin(), mapped.data().end(),
+                           bytes.begin()));
+}
+
+TEST(MappedFileTest, EmptyFile) {
+    const temp_file_t file{"plain_sight_mapped_file_test_empty", {}};
+    const mapped_file_t mapped{file.path()};
+    EXPECT_EQ(mapped.size(), 0U);
+    EXPECT_TRUE(mapped.data().empty());
+}
+
+TEST(MappedFileTest, MissingFileThrows) {
+    EXPECT_THROW(mapped_file_t{"/nonexistent/plain_sight"}, std::runtime_error);
+}
+
+TEST(MappedFileTest, MovesTheMapping) {
+    const auto bytes = some_bytes(5000);
+    const temp_file_t file{"plain_sight_mapped_file_test_move", bytes};
+    mapped_file_t mapped{file.path()};
+    const std::uint8_t *const data = mapped.data().data();
+    mapped_file_t moved{std::move(mapped)};
+    EXPECT_EQ(moved.data().data(), data);
+    EXPECT_EQ(moved.size(), bytes.size());
+    EXPECT_EQ(mapped.size(), 0U);
+    mapped = std::move(moved);
+    EXPECT_EQ(mapped.data().data(), data);
+}
+
+TEST(ReadFileTest, ReplacesTheContents) {
+    const auto bytes = some_bytes(70'000);
+    const temp_file_t file{"plain_sight_read_file_test", bytes};
+    std::vector<std::uint8_t> dst{1, 2, 3};
+    read_file(dst, file.path());
+    EXPECT_EQ(dst, bytes);
+}
+
+TEST(ReadFileTest, MissingFileThrows) {
+    std::vector<std::uint8_t> dst;
+    EXPECT_THROW(read_file(dst, std::filesystem::path{"/nonexistent/x"}),
+                 std::runtime_error);
+}
\ No newline at end of file
@@ -0,0 +1,156 @@
+#include "plain_sight/output_sink.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fmt/core.h>
+#include <glog/logging.h>
+#include <stdexcept>
+
+#include <unistd.h>
+
+namespace net_zelcon::plain_sight {
+
+void vector_output_sink_t::write(std::span<const std::uint8_t> data) {
+    dst_.insert(dst_.end(), data.begin(), data.end());
+}
+
+void callback_output_sink_t::write(std::span<const std::uint8_t> data) {
+    callback_(data);
+}
+
+void ostream_output_sink_t::write(std::span<const std::uint8_t> data) {
+    dst_.write(reinterpret_cast<const char *>(data.data()),
+               static_cast<std::streamsize>(data.size()));
+    if (!dst_) {
+        LOG(ERROR) << "Could not write " << data.size() << " bytes to stream";
+        throw std::runtime_error{fmt::format(
+            "Could not write {} bytes to stream", data.size())};
+    }
+}
+
+void ostream_output_sink_t::flush() {
+    if (!dst_.flush()) {
+        LOG(ERROR) << "Could not flush stream";
+        throw std::runtime_error{"Could not flush stream"};
+    }
+}
+
+void fd_output_sink_t::write(std::span<const std::uint8_t> data) {
+    while (!data.empty()) {
+        const ssize_t written = ::write(fd_, data.data(), data.size());
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            const int error = errno;
+            LOG(ERROR) << "Could not write to file descriptor " << fd_ << ": "
+                       << std::strerror(error);
+            throw std::runtime_error{
+                fmt::format("Could not write to file descriptor {}: {}", fd_,
+                            std::strerror(error))};
+        }
+        data = data.subspan(static_cast<std::size_t>(written));
+    }
+}
+
+buffered_output_sink_t::buffered_output_sink_t(output_sink_t &dst,
+                                               const std::size_t batch_size)
+    : dst_{dst}, batch_size_{batch_size} {
+    CHECK_GT(batch_size, 0UL);
+    batch_.reserve(batch_size);
+}
+
+void buffered_output_sink_t::write(std::span<const std::uint8_t> data) {
+    if (batch_.size() + data.size() > batch_size_) {
+        pass_on();
+    }
+    if (data.size() >= batch_size_) {
+        dst_.write(data);
+        return;
+    }
+    batch_.insert(batch_.end(), data.begin(), data.end());
+}
+
+void buffered_output_sink_t::flush() {
+    pass_on();
+    dst_.flush();
+}
+
+void buffered_output_sink_t::pass_on() {
+    if (!batch_.empty()) {
+        dst_.write(batch_);
+        batch_.clear();
+    }
+}
+
+write_behind_output_sink_t::write_behind_output_sink_t(
+    output_sink_t &dst, const std::size_t block_size, const std::size_t depth)
+    : dst_{dst}, block_size_{block_size}, blocks_{depth} {
+    CHECK_GT(block_size, 0UL);
+    block_.reserve(block_size);
+    thread_ = std::thread{[this] { run(); }};
+}
+
+write_behind_output_sink_t::~write_behind_output_sink_t() noexcept {
+    blocks_.close();
+    flushed_.close();
+    thread_.join();
+}
+
+void write_behind_output_sink_t::write(std::span<const std::uint8_t> data) {
+    while (!data.empty()) {
+        const std::size_t n =
+            std::min(data.size(), block_size_ - block_.size());
+        block_.insert(block_.end(), data.begin(),
+                      data.begin() + static_cast<std::ptrdiff_t>(n));
+        data = data.subspan(n);
+        if (block_.size() == block_size_) {
+            hand_over();
+        }
+    }
+}
+
+void write_behind_output_sink_t::flush() {
+    if (!block_.empty()) {
+        hand_over();
+    }
+    if (!blocks_.push({}) || !flushed_.pop().has_value()) {
+        rethrow_error();
+    }
+}
+
+void write_behind_output_sink_t::hand_over() {
+    std::vector<std::uint8_t> block;
+    block.reserve(block_size_);
+    std::swap(block, block_);
+    if (!blocks_.push(std::move(block))) {
+        rethrow_error();
+    }
+}
+
+void write_behind_output_sink_t::rethrow_error() {
+    // Only a failed write closes the queues while the sink is in use
+    CHECK(error_ != nullptr);
+    std::rethrow_exception(error_);
+}
+
+void write_behind_output_sink_t::run() {
+    while (auto block = blocks_.pop()) {
+        try {
+            if (block->empty()) {
+                dst_.flush();
+                flushed_.push(true);
+            } else {
+                dst_.write(*block);
+            }
+        } catch (...) {
+            error_ = std::current_exception();
+            blocks_.close();
+            flushed_.close();
+            return;
+        }
+    }
+}
+
+} // namespace net_zelcon::plain_sight
\ No newline at end of file
@@ -0,0 +1,142 @@
+#ifndef _INCLUDE_NET_ZELCON_PLAIN_SIGHT_OUTPUT_SINK_H_
+#define _INCLUDE_NET_ZELCON_PLAIN_SIGHT_OUTPUT_SINK_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <ostream>
+#include <span>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "plain_sight/bounded_queue.h"
+
+namespace net_zelcon::plain_sight {
+
+/// @brief Takes a decoded payload piece by piece, in order, as the frames
+/// holding it are decoded, so that the whole payload never has to be held in
+/// memory.
+class output_sink_t {
+  public:
+    virtual ~output_sink_t() noexcept = default;
+
+    /// @brief Appends `data` to the output.
+    /// @throws std::runtime_error if it cannot be written
+    virtual void write(std::span<const std::uint8_t> data) = 0;
+
+    /// @brief Writes out anything held back. Called once the payload is
+    /// complete.
+    virtual void flush() {}
+};
+
+/// @brief Appends to a vector.
+class vector_output_sink_t : public output_sink_t {
+  public:
+    explicit vector_output_sink_t(std::vector<std::uint8_t> &dst) : dst_{dst} {}
+    void write(std::span<const std::uint8_t> data) override;
+
+  private:
+    std::vector<std::uint8_t> &dst_;
+};
+
+/// @brief Hands every piece to a callback.
+class callback_output_sink_t : public output_sink_t {
+  public:
+    using callback_t = std::function<void(std::span<const std::uint8_t>)>;
+    explicit callback_output_sink_t(callback_t callback)
+        : callback_{std::move(callback)} {}
+    void write(std::span<const std::uint8_t> data) override;
+
+  private:
+    callback_t callback_;
+};
+
+/// @brief Writes to a `std::ostream`, which does its own buffering.
+class ostream_output_sink_t : public output_sink_t {
+  public:
+    explicit ostream_output_sink_t(std::ostream &dst) : dst_{dst} {}
+    void write(std::span<const std::uint8_t> data) override;
+    void flush() override;
+
+  private:
+    std::ostream &dst_;
+};
+
+/// @brief Writes to a file descriptor, e.g., a file, pipe or socket, with
+/// one `write(2)` per piece; see `buffered_output_sink_t` for fewer, larger
+/// writes. The descriptor is not closed.
+class fd_output_sink_t : public output_sink_t {
+  public:
+    explicit fd_output_sink_t(int fd) : fd_{fd} {}
+    void write(std::span<const std::uint8_t> data) override;
+
+  private:
+    int fd_;
+};
+
+/// @brief Gathers pieces into batches of `batch_size` bytes before passing
+/// them on to another sink. Pieces as large as a batch are passed on as is.
+/// What is left of the last batch is only written by `flush()`.
+class buffered_output_sink_t : public output_sink_t {
+  public:
+    buffered_output_sink_t(output_sink_t &dst, std::size_t batch_size);
+
+    buffered_output_sink_t(const buffered_output_sink_t &) = delete;
+    buffered_output_sink_t &operator=(const buffered_output_sink_t &) = delete;
+
+    void write(std::span<const std::uint8_t> data) override;
+    /// @brief Passes the partial batch on and flushes `dst`.
+    void flush() override;
+
+  private:
+    void pass_on();
+
+    output_sink_t &dst_;
+    std::vector<std::uint8_t> batch_;
+    std::size_t batch_size_;
+};
+
+/// @brief Gathers pieces into blocks of `block_size` bytes, which a thread of
+/// its own passes on to another sink, up to `depth` blocks behind the writer,
+/// so that a slow consumer, e.g., the other end of a pipe, does not stall
+/// decoding. A failed write to `dst` is thrown by the next `write()` or by
+/// `flush()`.
+class write_behind_output_sink_t : public output_sink_t {
+  public:
+    write_behind_output_sink_t(output_sink_t &dst,
+                               std::size_t block_size = 1 << 20,
+                               std::size_t depth = 4);
+    /// @brief Drops what was not flushed and stops the thread.
+    ~write_behind_output_sink_t() noexcept override;
+
+    write_behind_output_sink_t(const write_behind_output_sink_t &) = delete;
+    write_behind_output_sink_t &
+    operator=(const write_behind_output_sink_t &) = delete;
+
+    void write(std::span<const std::uint8_t> data) override;
+    /// @brief Waits until every block, the partial one included, has been
+    /// written, then flushes `dst`.
+    void flush() override;
+
+  private:
+    void run();
+    void hand_over();
+    void rethrow_error();
+
+    output_sink_t &dst_;
+    std::size_t block_size_;
+    std::vector<std::uint8_t> block_;
+    // An empty block asks the thread to flush `dst_` and report back on
+    // `flushed_`.
+    bounded_queue_t<std::vector<std::uint8_t>> blocks_;
+    bounded_queue_t<bool> flushed_{1};
+    // Set by the thread before it closes `blocks_`
+    std::exception_ptr error_;
+    std::thread thread_;
+};
+
+} // namespace net_zelcon::plain_sight
+
+#endif // _INCLUDE_NET_ZELCON_PLAIN_SIGHT_OUTPUT_SINK_H_
\ No newline at end of file
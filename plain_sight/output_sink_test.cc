@@ -0,0 +1,129 @@
+#include <gtest/gtest.h>
+
+#include "plain_sight/output_sink.h"
+
+#include <cstdint>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace net_zelcon::plain_sight;
+
+namespace {
+
+auto bytes(const std::string &text) -> std::vector<std::uint8_t> {
+    return {text.begin(), text.end()};
+}
+
+} // namespace
+
+TEST(OutputSinkTest, Vector) {
+    std::vector<std::uint8_t> dst = bytes("ab");
+    vector_output_sink_t sink{dst};
+    sink.write(bytes("cd"));
+    sink.write({});
+    sink.write(bytes("e"));
+    sink.flush();
+    EXPECT_EQ(dst, bytes("abcde"));
+}
+
+TEST(OutputSinkTest, Ostream) {
+    std::ostringstream dst;
+    ostream_output_sink_t sink{dst};
+    sink.write(bytes("hello, "));
+    sink.write(bytes("world"));
+    sink.flush();
+    EXPECT_EQ(dst.str(), "hello, world");
+
+    std::ostream broken{nullptr};
+    ostream_output_sink_t broken_sink{broken};
+    EXPECT_THROW(broken_sink.write(bytes("x")), std::runtime_error);
+}
+
+TEST(OutputSinkTest, FileDescriptor) {
+    int fds[2];
+    ASSERT_EQ(::pipe(fds), 0);
+    fd_output_sink_t sink{fds[1]};
+    sink.write(bytes("through "));
+    sink.write(bytes("a pipe"));
+    ASSERT_EQ(::close(fds[1]), 0);
+    std::string read(64, '\0');
+    const ssize_t size = ::read(fds[0], read.data(), read.size());
+    ASSERT_EQ(::close(fds[0]), 0);
+    ASSERT_GE(size, 0);
+    read.resize(static_cast<std::size_t>(size));
+    EXPECT_EQ(read, "through a pipe");
+
+    fd_output_sink_t invalid{-1};
+    EXPECT_THROW(invalid.write(bytes("x")), std::runtime_error);
+}
+
+TEST(OutputSinkTest, BufferedBatches) {
+    std::vector<std::vector<std::uint8_t>> writes;
+    bool flushed = false;
+    class recording_sink_t : public output_sink_t {
+      public:
+        recording_sink_t(std::vector<std::vector<std::uint8_t>> &writes,
+                         bool &flushed)
+            : writes_{writes}, flushed_{flushed} {}
+        void write(std::span<const std::uint8_t> data) override {
+            writes_.emplace_back(data.begin(), data.end());
+        }
+        void flush() override { flushed_ = true; }
+
+      private:
+        std::vector<std::vector<std::uint8_t>> &writes_;
+        bool &flushed_;
+    } recording{writes, flushed};
+    buffered_output_sink_t sink{recording, 4};
+    sink.write(bytes("ab"));
+    sink.write(bytes("cd"));
+    EXPECT_TRUE(writes.empty()) << "A full batch waits for the next write";
+    sink.write(bytes("e"));
+    sink.write(bytes("fghij"));
+    sink.write(bytes("k"));
+    EXPECT_FALSE(flushed);
+    sink.flush();
+    EXPECT_TRUE(flushed);
+    const std::vector<std::vector<std::uint8_t>> expected{
+        bytes("abcd"), bytes("e"), bytes("fghij"), bytes("k")};
+    EXPECT_EQ(writes, expected);
+}
+TEST(OutputSinkTest, WriteBehindBlocks) {
+    std::vector<std::uint8_t> dst;
+    vector_output_sink_t vector_sink{dst};
+    std::vector<std::uint8_t> expected;
+    {
+        write_behind_output_sink_t sink{vector_sink, 3, 2};
+        for (const char *piece : {"ab", "", "cdefgh", "i", "jklmnopq"}) {
+            sink.write(bytes(piece));
+            const auto piece_bytes = bytes(piece);
+            expected.insert(expected.end(), piece_bytes.begin(),
+                            piece_bytes.end());
+        }
+        sink.flush();
+        EXPECT_EQ(dst, expected);
+        sink.write(bytes("r"));
+        sink.flush();
+        expected.push_back('r');
+        EXPECT_EQ(dst, expected);
+    }
+    EXPECT_EQ(dst, expected);
+}
+
+TEST(OutputSinkTest, WriteBehindError) {
+    fd_output_sink_t invalid{-1};
+    write_behind_output_sink_t sink{invalid, 4, 1};
+    EXPECT_THROW(
+        {
+            for (int i = 0; i < 8; ++i) {
+                sink.write(bytes("abcd"));
+            }
+            sink.flush();
+        },
+        std::runtime_error);
+}
\ No newline at end of file
@@ -1,34 +1,414 @@
 #include "plain_sight/qr_codes.h"
+#include <algorithm>
+#include <fmt/core.h>
+#include <future>
 #include <glog/logging.h>
 #include <iterator>
 #include <opencv2/imgcodecs.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 #include <opencv2/objdetect.hpp>
 #include <qrcodegen.hpp>
+#include <stdexcept>
 #include <string>
 
 namespace net_zelcon::plain_sight {
 
+namespace {
+
+// Least difference, in luma, between the dark and the light function
+// patterns of a sampled symbol; anything flatter is taken for a blank image.
+constexpr int min_contrast = 32;
+
+auto make_qr_code(std::span<const std::uint8_t> chunk,
+                  const chunk_plan_t &plan) -> qrcodegen::QrCode {
+    const std::vector<qrcodegen::QrSegment> segments = {
+        qrcodegen::QrSegment::makeBytes(
+            std::vector<std::uint8_t>(chunk.begin(), chunk.end()))};
+    // No ECC boost, like `qr_symbol_builder_t`
+    return qrcodegen::QrCode::encodeSegments(segments, plan.ecc, plan.version,
+                                             plan.version, plan.mask, false);
+}
+
+/// @brief Builder of `plan`'s symbols, or null if its mask is left to
+/// qrcodegen.
+auto make_builder(const chunk_plan_t &plan)
+    -> std::shared_ptr<const qr_symbol_builder_t> {
+    if (plan.mask < 0) {
+        return nullptr;
+    }
+    return std::make_shared<const qr_symbol_builder_t>(plan.version, plan.ecc,
+                                                       plan.mask);
+}
+
+auto make_symbol(std::span<const std::uint8_t> chunk, const chunk_plan_t &plan,
+                 const qr_symbol_builder_t *builder) -> qr_symbol_t {
+    return builder != nullptr ? builder->build(chunk)
+                              : qr_symbol_t{make_qr_code(chunk, plan)};
+}
+
+/// @brief Calls `f` with every chunk of `src`, in order, framed as `plan`
+/// says.
+/// @param first_sequence_number Sequence number of the first chunk of `src`;
+/// only used with `framing_t::sequenced`.
+template <typename F>
+void for_each_chunk(std::span<const std::uint8_t> src, const chunk_plan_t &plan,
+                    std::uint32_t first_sequence_number, F &&f) {
+    const std::size_t chunk_size = plan.chunk_size;
+    std::vector<std::uint8_t> framed;
+    for (std::size_t i = 0; i < src.size(); i += chunk_size) {
+        const auto chunk = src.subspan(i, std::min(chunk_size, src.size() - i));
+        if (plan.framing == framing_t::none) {
+            f(chunk);
+            continue;
+        }
+        framed.clear();
+        framing::write_chunk(
+            framed,
+            first_sequence_number + static_cast<std::uint32_t>(i / chunk_size),
+            chunk);
+        f(std::span<const std::uint8_t>{framed});
+    }
+}
+
+auto split_frames_serial(std::span<const std::uint8_t> src,
+                         const chunk_plan_t &plan = {})
+    -> std::vector<qrcodegen::QrCode> {
+    std::vector<qrcodegen::QrCode> qr_codes;
+    qr_codes.reserve(plan.chunk_count(src.size()));
+    for_each_chunk(src, plan, 0, [&](std::span<const std::uint8_t> chunk) {
+        qr_codes.emplace_back(make_qr_code(chunk, plan));
+    });
+    return qr_codes;
+}
+
+/// @brief Like `split_frames_serial()`, but symbols, built by `builder`
+/// unless it is null.
+auto build_symbols(std::span<const std::uint8_t> src, const chunk_plan_t &plan,
+                   const qr_symbol_builder_t *builder,
+                   std::uint32_t first_sequence_number = 0)
+    -> std::vector<qr_symbol_t> {
+    std::vector<qr_symbol_t> symbols;
+    symbols.reserve(plan.chunk_count(src.size()));
+    for_each_chunk(src, plan, first_sequence_number,
+                   [&](std::span<const std::uint8_t> chunk) {
+                       symbols.push_back(make_symbol(chunk, plan, builder));
+                   });
+    return symbols;
+}
+
+/// @brief Symbols of the parity chunks of the stripe whose data chunks are
+/// `stripe`, starting with data chunk `first_sequence_number`.
+auto build_parity_symbols(std::span<const std::uint8_t> stripe,
+                          const chunk_plan_t &plan,
+                          const qr_symbol_builder_t *builder,
+                          const erasure_coder_t &coder,
+                          std::uint64_t first_sequence_number)
+    -> std::vector<qr_symbol_t> {
+    const erasure_code_t &erasure = coder.code();
+    const std::size_t chunk_size = plan.chunk_size;
+    const std::uint64_t chunk_count = plan.chunk_count(stripe.size());
+    const std::uint64_t first_group =
+        erasure.locate(first_sequence_number).first;
+    // Groups of the stripe, numbered from 0 as if it were the first one
+    const std::uint64_t groups = erasure.group_count(chunk_count);
+    std::vector<std::vector<std::vector<std::uint8_t>>> parity(groups);
+    std::vector<std::span<const std::uint8_t>> data;
+    for (std::uint64_t group = 0; group < groups; ++group) {
+        data.clear();
+        const std::uint32_t data_count =
+            erasure.group_data_count(group, chunk_count);
+        for (std::uint32_t i = 0; i < data_count; ++i) {
+            const std::size_t offset =
+                erasure.data_chunk(group, i) * chunk_size;
+            data.push_back(stripe.subspan(
+                offset, std::min(chunk_size, stripe.size() - offset)));
+        }
+        coder.encode(data, chunk_size, parity[group]);
+    }
+    // Parity chunk by parity chunk, so that neighbouring QR codes protect
+    // different groups
+    std::vector<qr_symbol_t> symbols;
+    symbols.reserve(groups * erasure.parity_chunks);
+    std::vector<std::uint8_t> framed;
+    for (std::uint32_t i = 0; i < erasure.parity_chunks; ++i) {
+        for (std::uint64_t group = 0; group < groups; ++group) {
+            framed.clear();
+            framing::write_parity_chunk(
+                framed,
+                static_cast<std::uint32_t>((first_group + group) *
+                                               erasure.parity_chunks +
+                                           i),
+                parity[group][i]);
+            symbols.push_back(make_symbol(framed, plan, builder));
+        }
+    }
+    return symbols;
+}
+
+} // namespace
+
 auto split_frames(const std::vector<std::uint8_t> &src)
     -> std::vector<qrcodegen::QrCode> {
+    return split_frames_serial(src);
+}
+
+auto split_frames(std::span<const std::uint8_t> src, thread_pool_t &pool)
+    -> std::vector<qrcodegen::QrCode> {
+    constexpr chunk_plan_t plan{};
+    const std::size_t num_chunks = plan.chunk_count(src.size());
+    // A few batches per worker keeps every worker busy even when some
+    // batches finish early, while keeping the per-task overhead negligible.
+    const std::size_t num_batches =
+        std::min(num_chunks, std::max<std::size_t>(1, pool.size() * 4));
+    if (num_batches <= 1) {
+        return split_frames_serial(src);
+    }
+    std::vector<std::future<std::vector<qrcodegen::QrCode>>> batches;
+    batches.reserve(num_batches);
+    for (std::size_t batch = 0; batch < num_batches; ++batch) {
+        // Batch boundaries always fall on chunk boundaries, so every chunk is
+        // exactly the one the serial overload would have produced.
+        const std::size_t first_chunk = num_chunks * batch / num_batches;
+        const std::size_t last_chunk = num_chunks * (batch + 1) / num_batches;
+        const std::size_t begin = first_chunk * plan.chunk_size;
+        const std::size_t end =
+            std::min(last_chunk * plan.chunk_size, src.size());
+        const auto part = src.subspan(begin, end - begin);
+        batches.emplace_back(
+            pool.submit([part] { return split_frames_serial(part); }));
+    }
     std::vector<qrcodegen::QrCode> qr_codes;
-    constexpr std::ptrdiff_t max_size = 100;
-    constexpr auto qr_version = 20;
-    for (auto it = src.begin(); it != src.end();
-         std::advance(it, std::min(max_size, std::distance(it, src.end())))) {
-        const std::vector<std::uint8_t> chunk(
-            it,
-            std::next(it, std::min(max_size, std::distance(it, src.end()))));
-        const std::vector<qrcodegen::QrSegment> segments = {
-            qrcodegen::QrSegment::makeBytes(chunk)};
-        const auto qr_code = qrcodegen::QrCode::encodeSegments(
-            segments, qrcodegen::QrCode::Ecc::HIGH, qr_version, qr_version, -1,
-            true);
-        qr_codes.emplace_back(std::move(qr_code));
+    qr_codes.reserve(num_chunks);
+    for (auto &batch : batches) {
+        auto batch_qr_codes = batch.get();
+        std::move(batch_qr_codes.begin(), batch_qr_codes.end(),
+                  std::back_inserter(qr_codes));
     }
+    CHECK_EQ(qr_codes.size(), num_chunks);
     return qr_codes;
 }
 
+vector_qr_code_source_t::vector_qr_code_source_t(
+    std::shared_ptr<const std::vector<qrcodegen::QrCode>> qr_codes)
+    : qr_codes_{std::move(qr_codes)} {
+    CHECK(qr_codes_);
+}
+
+auto vector_qr_code_source_t::symbol_size() const -> int {
+    CHECK(!qr_codes_->empty());
+    const auto &first_qr_code = qr_codes_->front();
+    CHECK(std::all_of(qr_codes_->begin(), qr_codes_->end(),
+                      [&first_qr_code](const auto &qr_code) {
+                          return first_qr_code.getSize() == qr_code.getSize();
+                      }))
+        << "All QR codes must be the same size";
+    return first_qr_code.getSize();
+}
+
+auto vector_qr_code_source_t::next() -> std::optional<qr_symbol_t> {
+    if (position_ >= qr_codes_->size()) {
+        return std::nullopt;
+    }
+    return qr_symbol_t{(*qr_codes_)[position_++]};
+}
+
+auto vector_qr_code_source_t::qr_code_count() const
+    -> std::optional<std::size_t> {
+    return qr_codes_->size();
+}
+
+chunked_qr_code_source_t::chunked_qr_code_source_t(
+    std::span<const std::uint8_t> src, std::shared_ptr<thread_pool_t> pool,
+    std::size_t max_batches_in_flight, framing_t framing)
+    : chunked_qr_code_source_t{src, std::move(pool),
+                               chunk_plan_t{.framing = framing},
+                               max_batches_in_flight} {}
+
+chunked_qr_code_source_t::chunked_qr_code_source_t(
+    std::span<const std::uint8_t> src, std::shared_ptr<thread_pool_t> pool,
+    const chunk_plan_t &plan, std::size_t max_batches_in_flight)
+    : src_{src}, pool_{std::move(pool)}, plan_{plan},
+      builder_{make_builder(plan)} {
+    CHECK(pool_);
+    CHECK_GT(plan_.chunk_size, 0U);
+    if (plan_.erasure.enabled()) {
+        CHECK(plan_.framing == framing_t::sequenced)
+            << "Parity chunks need sequenced framing";
+        erasure_coder_ = std::make_shared<const erasure_coder_t>(plan_.erasure);
+    }
+    if (plan_.framing == framing_t::sequenced) {
+        std::vector<std::uint8_t> manifest;
+        framing::write_manifest(
+            manifest,
+            manifest_t::for_payload(
+                src_.size(), static_cast<std::uint32_t>(plan_.chunk_size),
+                plan_.erasure));
+        manifest_ = make_symbol(manifest, plan_, builder_.get());
+        batch_.push_back(*manifest_);
+    }
+    if (max_batches_in_flight == 0) {
+        max_batches_in_flight = pool_->size() * 2;
+    }
+    for (std::size_t i = 0; i < max_batches_in_flight; ++i) {
+        submit_batch();
+    }
+}
+
+chunked_qr_code_source_t::~chunked_qr_code_source_t() noexcept {
+    // Batches still in flight read from `src_`; let them finish before the
+    // caller is allowed to release it.
+    for (auto &batch : in_flight_) {
+        batch.wait();
+    }
+}
+
+auto chunked_qr_code_source_t::symbol_size() const -> int {
+    return plan_.symbol_size();
+}
+
+auto chunked_qr_code_source_t::qr_code_count() const
+    -> std::optional<std::size_t> {
+    return plan_.qr_code_count(src_.size());
+}
+
+auto chunked_qr_code_source_t::chunk_plan() const
+    -> std::optional<chunk_plan_t> {
+    return plan_;
+}
+
+auto chunked_qr_code_source_t::payload_size() const
+    -> std::optional<std::uint64_t> {
+    return src_.size();
+}
+
+void chunked_qr_code_source_t::submit_batch() {
+    if (parity_next_) {
+        const auto stripe =
+            src_.subspan(stripe_offset_, offset_ - stripe_offset_);
+        const std::uint64_t first_sequence_number =
+            stripe_offset_ / plan_.chunk_size;
+        stripe_offset_ = offset_;
+        parity_next_ = false;
+        in_flight_.emplace_back(pool_->submit(
+            [stripe, plan = plan_, builder = builder_,
+             erasure_coder = erasure_coder_, manifest = *manifest_,
+             first_sequence_number] {
+                auto symbols =
+                    build_parity_symbols(stripe, plan, builder.get(),
+                                         *erasure_coder, first_sequence_number);
+                symbols.push_back(manifest);
+                return symbols;
+            }));
+        return;
+    }
+    if (offset_ >= src_.size()) {
+        return;
+    }
+    std::uint64_t chunks = chunks_per_batch_;
+    const std::uint64_t first_chunk = offset_ / plan_.chunk_size;
+    if (erasure_coder_) {
+        // Batches end where stripes do, for their parity to follow
+        const std::uint64_t stripe_size = plan_.erasure.stripe_size();
+        chunks = std::min(chunks, stripe_size - first_chunk % stripe_size);
+    }
+    const auto part = src_.subspan(
+        offset_, std::min<std::size_t>(chunks * plan_.chunk_size,
+                                       src_.size() - offset_));
+    const auto first_sequence_number = static_cast<std::uint32_t>(first_chunk);
+    offset_ += part.size();
+    parity_next_ = erasure_coder_ &&
+                   (offset_ == src_.size() ||
+                    offset_ / plan_.chunk_size % plan_.erasure.stripe_size() ==
+                        0);
+    in_flight_.emplace_back(
+        pool_->submit([part, plan = plan_, builder = builder_,
+                       first_sequence_number] {
+            return build_symbols(part, plan, builder.get(),
+                                 first_sequence_number);
+        }));
+}
+
+auto chunked_qr_code_source_t::next() -> std::optional<qr_symbol_t> {
+    while (batch_position_ >= batch_.size()) {
+        if (in_flight_.empty()) {
+            return std::nullopt;
+        }
+        batch_ = in_flight_.front().get();
+        in_flight_.pop_front();
+        batch_position_ = 0;
+        // Keep the pool busy: replace the batch that was just taken.
+        submit_batch();
+    }
+    return std::move(batch_[batch_position_++]);
+}
+
+streamed_qr_code_source_t::streamed_qr_code_source_t(
+    read_t read, std::shared_ptr<thread_pool_t> pool, const chunk_plan_t &plan,
+    std::size_t max_batches_in_flight)
+    : read_{std::move(read)}, pool_{std::move(pool)}, plan_{plan},
+      builder_{make_builder(plan)} {
+    CHECK(read_);
+    CHECK(pool_);
+    CHECK_GT(plan_.chunk_size, 0U);
+    CHECK(plan_.framing == framing_t::none && !plan_.erasure.enabled())
+        << "A streamed payload cannot be framed: its size is unknown";
+    if (max_batches_in_flight == 0) {
+        max_batches_in_flight = pool_->size() * 2;
+    }
+    for (std::size_t i = 0; i < max_batches_in_flight; ++i) {
+        submit_batch();
+    }
+}
+
+auto streamed_qr_code_source_t::symbol_size() const -> int {
+    return plan_.symbol_size();
+}
+
+auto streamed_qr_code_source_t::chunk_plan() const
+    -> std::optional<chunk_plan_t> {
+    return plan_;
+}
+
+auto streamed_qr_code_source_t::payload_size() const
+    -> std::optional<std::uint64_t> {
+    if (!end_) {
+        return std::nullopt;
+    }
+    return bytes_read_;
+}
+
+void streamed_qr_code_source_t::submit_batch() {
+    if (end_) {
+        return;
+    }
+    std::vector<std::uint8_t> part(chunks_per_batch_ * plan_.chunk_size);
+    const std::size_t size = read_(part);
+    CHECK_LE(size, part.size());
+    bytes_read_ += size;
+    end_ = size < part.size();
+    if (size == 0) {
+        return;
+    }
+    part.resize(size);
+    in_flight_.emplace_back(pool_->submit(
+        [part = std::move(part), plan = plan_, builder = builder_] {
+            return build_symbols(part, plan, builder.get());
+        }));
+}
+
+auto streamed_qr_code_source_t::next() -> std::optional<qr_symbol_t> {
+    while (batch_position_ >= batch_.size()) {
+        if (in_flight_.empty()) {
+            return std::nullopt;
+        }
+        batch_ = in_flight_.front().get();
+        in_flight_.pop_front();
+        batch_position_ = 0;
+        submit_batch();
+    }
+    return std::move(batch_[batch_position_++]);
+}
+
 auto split_frames(std::string_view src) -> std::vector<qrcodegen::QrCode> {
     std::vector<qrcodegen::QrCode> qr_codes;
     constexpr size_t max_size = 500;
@@ -73,33 +453,206 @@ void qr_code_decoder_t::decode(std::vector<std::uint8_t> &dst,
                                const std::span<std::uint8_t> src) {
     CHECK(src.size() > 0) << "Empty image; no QR codes to possibly find";
     DLOG(INFO) << "Decoding " << src.size() << " bytes";
-    std::uint8_t *image = quirc_begin(qr_.get(), &width_, &height_);
+    const auto image = begin();
+    CHECK(image.size() <= src.size()) << "Buffer too small";
+    std::copy_n(src.begin(), image.size(), image.begin());
+    const int num_codes = finish(dst);
+    if (num_codes == 0) {
+        LOG(ERROR) << "No QR codes found";
+        throw std::runtime_error{"No QR codes found"};
+    }
+}
+
+auto qr_code_decoder_t::begin() -> std::span<std::uint8_t> {
+    int width = 0, height = 0;
+    image_ = quirc_begin(qr_.get(), &width, &height);
+    DCHECK_EQ(width, width_);
+    DCHECK_EQ(height, height_);
     // one byte per pixel, `width_` pixels per line, `height_` lines in the
     // buffer
-    CHECK(static_cast<size_t>(width_) * static_cast<size_t>(height_) <=
-          src.size())
-        << "Buffer too small";
-    std::copy(src.begin(), src.end(), image);
-    DCHECK(std::equal(src.begin(), src.end(), image)) << "Copy failed";
-    quirc_end(qr_.get());
-    int num_codes = quirc_count(qr_.get());
-    DLOG(INFO) << "Found " << num_codes << " QR codes";
-    CHECK(num_codes > 0) << "No QR codes found";
-    for (int i = 0; i < num_codes; i++) {
+    return {image_, static_cast<size_t>(width) * static_cast<size_t>(height)};
+}
+
+auto qr_code_decoder_t::finish(std::vector<std::uint8_t> &dst) -> int {
+    return finish([&dst](std::span<const std::uint8_t> payload) {
+        dst.insert(dst.end(), payload.begin(), payload.end());
+    });
+}
+
+auto qr_code_decoder_t::finish(const payload_sink_t &sink) -> int {
+    if (layout_) {
         quirc_code code;
-        quirc_extract(qr_.get(), i, &code);
         quirc_data data;
-        quirc_decode_error_t err = quirc_decode(&code, &data);
+        bool decoded = false;
+        {
+            const stage_timer_t timer{stats_, stage_t::qr_sample};
+            decoded =
+                sample(code) && quirc_decode(&code, &data) == QUIRC_SUCCESS;
+        }
+        if (decoded) {
+            sink({data.payload, static_cast<std::size_t>(data.payload_len)});
+            return 1;
+        }
+        // Not an error yet: a blank tile, or a symbol that is not quite
+        // where the encoder would have drawn it
+    }
+    {
+        const stage_timer_t timer{stats_, stage_t::qr_identify};
+        quirc_end(qr_.get());
+    }
+    const int num_codes = quirc_count(qr_.get());
+    DLOG(INFO) << "Found " << num_codes << " QR codes";
+    std::vector<quirc_code> codes(num_codes);
+    {
+        const stage_timer_t timer{stats_, stage_t::qr_decode};
+        for (int i = 0; i < num_codes; i++) {
+            quirc_extract(qr_.get(), i, &codes[i]);
+        }
+        sort_by_position(codes);
+    }
+    for (const auto &code : codes) {
+        quirc_data data;
+        quirc_decode_error_t err;
+        {
+            // `sink` is the caller's time, not quirc's
+            const stage_timer_t timer{stats_, stage_t::qr_decode};
+            err = quirc_decode(&code, &data);
+        }
         if (err != QUIRC_SUCCESS) {
             LOG(ERROR) << "Failed to decode QR code: " << quirc_strerror(err);
+            if (stats_ != nullptr) {
+                stats_->add_decode_failures(1);
+            }
             continue;
         }
         DLOG(INFO) << "Payload: "
                    << std::string{reinterpret_cast<char *>(data.payload),
                                   static_cast<size_t>(data.payload_len)};
-        std::copy(data.payload, data.payload + data.payload_len,
-                  std::back_inserter(dst));
+        sink({data.payload, static_cast<std::size_t>(data.payload_len)});
+    }
+    return num_codes;
+}
+
+void qr_code_decoder_t::set_geometry(const int scale,
+                                     const int border_size) {
+    if (!fits_geometry(scale, border_size)) {
+        LOG(ERROR) << "No QR code of scale " << scale << " and border "
+                   << border_size << " fits a " << width_ << "x" << height_
+                   << " image";
+        throw std::runtime_error{fmt::format(
+            "No QR code of scale {} and border {} fits a {}x{} image", scale,
+            border_size, width_, height_)};
+    }
+    const int size = (width_ - 2 * border_size) / scale;
+    layout_.emplace(qr_layout_t::version_for_size(size));
+    scale_ = scale;
+    border_size_ = border_size;
+    module_sums_.resize(static_cast<std::size_t>(size) * size);
+}
+
+auto qr_code_decoder_t::fits_geometry(const int scale,
+                                      const int border_size) const -> bool {
+    CHECK_GT(scale, 0);
+    CHECK_GE(border_size, 0);
+    const int size = (width_ - 2 * border_size) / scale;
+    return width_ == height_ && size * scale + 2 * border_size == width_ &&
+           size >= 21 && size <= 177 && (size - 17) % 4 == 0;
+}
+
+auto qr_code_decoder_t::sample(quirc_code &code) -> bool {
+    CHECK(image_ != nullptr) << "`begin()` was not called";
+    const int size = layout_->size();
+    // Only the middle of each module: its edges are blurred into its
+    // neighbors by scaling and compression.
+    const int margin = scale_ / 4;
+    const int extent = scale_ - 2 * margin;
+    std::int64_t dark_sum = 0, light_sum = 0;
+    int dark_count = 0, light_count = 0;
+    for (int y = 0; y < size; ++y) {
+        const int top = border_size_ + y * scale_ + margin;
+        for (int x = 0; x < size; ++x) {
+            const std::uint8_t *pixel =
+                image_ + static_cast<std::ptrdiff_t>(top) * width_ +
+                border_size_ + x * scale_ + margin;
+            int sum = 0;
+            for (int dy = 0; dy < extent; ++dy, pixel += width_) {
+                for (int dx = 0; dx < extent; ++dx) {
+                    sum += pixel[dx];
+                }
+            }
+            module_sums_[static_cast<std::size_t>(y) * size + x] = sum;
+            if (!layout_->is_static(x, y)) {
+                continue;
+            }
+            if (layout_->is_dark(x, y)) {
+                dark_sum += sum;
+                ++dark_count;
+            } else {
+                light_sum += sum;
+                ++light_count;
+            }
+        }
+    }
+    // Every version has finder patterns, so both counts are positive.
+    const double dark = static_cast<double>(dark_sum) / dark_count;
+    const double light = static_cast<double>(light_sum) / light_count;
+    if (light - dark < min_contrast * extent * extent) {
+        return false;
+    }
+    const double threshold = (dark + light) / 2;
+    code = {};
+    code.size = size;
+    for (std::size_t i = 0; i < module_sums_.size(); ++i) {
+        if (module_sums_[i] < threshold) {
+            code.cell_bitmap[i >> 3] |= static_cast<std::uint8_t>(1 << (i & 7));
+        }
+    }
+    const int first = border_size_, last = border_size_ + size * scale_;
+    code.corners[0] = {first, first};
+    code.corners[1] = {last, first};
+    code.corners[2] = {last, last};
+    code.corners[3] = {first, last};
+    return true;
+}
+
+void qr_code_decoder_t::sort_by_position(std::vector<quirc_code> &codes) {
+    // quirc reports codes in detection order. Tiled frames are filled row by
+    // row, so restore that order: codes whose centers are less than half a
+    // code apart vertically share a row, rows go top to bottom and codes
+    // within a row left to right.
+    struct placed_t {
+        double x, y, size;
+        const quirc_code *code;
+    };
+    std::vector<placed_t> placed;
+    placed.reserve(codes.size());
+    for (const auto &code : codes) {
+        double x = 0, y = 0, top = code.corners[0].y, bottom = top;
+        for (const auto &corner : code.corners) {
+            x += corner.x / 4.0;
+            y += corner.y / 4.0;
+            top = std::min<double>(top, corner.y);
+            bottom = std::max<double>(bottom, corner.y);
+        }
+        placed.push_back({x, y, bottom - top, &code});
+    }
+    std::sort(placed.begin(), placed.end(),
+              [](const auto &a, const auto &b) { return a.y < b.y; });
+    for (auto row = placed.begin(); row != placed.end();) {
+        const auto row_end =
+            std::find_if(row, placed.end(), [&](const placed_t &p) {
+                return p.y - row->y > row->size / 2;
+            });
+        std::sort(row, row_end,
+                  [](const auto &a, const auto &b) { return a.x < b.x; });
+        row = row_end;
+    }
+    std::vector<quirc_code> sorted;
+    sorted.reserve(codes.size());
+    for (const auto &p : placed) {
+        sorted.push_back(*p.code);
     }
+    codes = std::move(sorted);
 }
 
 } // namespace net_zelcon::plain_sight
\ No newline at end of file
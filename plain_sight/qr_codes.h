@@ -2,13 +2,23 @@
 #define _INCLUDE_NET_ZELCON_PLAIN_SIGHT_QR_CODES_H_
 
 #include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
 #include <memory>
 #include <opencv2/opencv.hpp>
+#include <optional>
 #include <quirc.h>
 #include <span>
 #include <string_view>
 #include <vector>
 
+#include "plain_sight/capacity.h"
+#include "plain_sight/framing.h"
+#include "plain_sight/qr_layout.h"
+#include "plain_sight/qr_symbol.h"
+#include "plain_sight/stats.h"
+#include "plain_sight/thread_pool.h"
 #include <qrcodegen.hpp>
 
 namespace net_zelcon::plain_sight {
@@ -18,20 +28,231 @@ auto split_frames(const std::vector<uint8_t> &src)
 
 auto split_frames(std::string_view src) -> std::vector<qrcodegen::QrCode>;
 
+/// @brief Parallel variant of `split_frames()`. QR codes are built on the
+/// workers of `pool`; the result is identical to, and in the same order as,
+/// the single-threaded overload.
+auto split_frames(std::span<const std::uint8_t> src, thread_pool_t &pool)
+    -> std::vector<qrcodegen::QrCode>;
+
+/// @brief Lazily produced, ordered sequence of equally sized QR codes. Lets
+/// the encoder consume QR codes as they are built instead of requiring all of
+/// them up front. QR codes come as bit-packed symbols, ready to be rendered.
+class qr_code_source_t {
+  public:
+    virtual ~qr_code_source_t() noexcept {}
+    /// @brief Width (and height) in modules of every QR code in the sequence.
+    virtual auto symbol_size() const -> int = 0;
+    /// @return the next QR code, or `std::nullopt` once the source is
+    /// exhausted
+    virtual auto next() -> std::optional<qr_symbol_t> = 0;
+    /// @brief Total number of QR codes in the sequence, if known up front.
+    virtual auto qr_code_count() const -> std::optional<std::size_t> {
+        return std::nullopt;
+    }
+    /// @brief How the payload is cut into QR codes, if the source chunks one.
+    virtual auto chunk_plan() const -> std::optional<chunk_plan_t> {
+        return std::nullopt;
+    }
+    /// @brief Size in bytes of the payload, if the source chunks one.
+    virtual auto payload_size() const -> std::optional<std::uint64_t> {
+        return std::nullopt;
+    }
+};
+
+/// @brief Source over QR codes that have already been built, converted to
+/// symbols one at a time.
+class vector_qr_code_source_t : public qr_code_source_t {
+  public:
+    explicit vector_qr_code_source_t(
+        std::shared_ptr<const std::vector<qrcodegen::QrCode>> qr_codes);
+    auto symbol_size() const -> int override;
+    auto next() -> std::optional<qr_symbol_t> override;
+    auto qr_code_count() const -> std::optional<std::size_t> override;
+
+  private:
+    std::shared_ptr<const std::vector<qrcodegen::QrCode>> qr_codes_;
+    std::size_t position_ = 0;
+};
+
+/// @brief Source that chunks `src` like `split_frames()` and builds the QR
+/// codes on `pool` ahead of the consumer. At most `max_batches_in_flight`
+/// batches of QR codes exist at any time, so memory stays flat regardless of
+/// the size of `src`.
+/// @details With `framing_t::sequenced`, the first QR code holds the
+/// manifest and every chunk is prefixed with its sequence number. With an
+/// erasure code, every stripe of chunks is followed by its parity chunks and
+/// the manifest again, built by a batch of their own.
+/// Symbols are built with the plan's mask by a `qr_symbol_builder_t`, unless
+/// the mask is -1. They are identical to `split_frames()`'s QR codes.
+/// @note `src` must outlive the source.
+class chunked_qr_code_source_t : public qr_code_source_t {
+  public:
+    /// @brief Chunks `src` with the historical fixed settings, see
+    /// `chunk_plan_t`.
+    chunked_qr_code_source_t(std::span<const std::uint8_t> src,
+                             std::shared_ptr<thread_pool_t> pool,
+                             std::size_t max_batches_in_flight = 0,
+                             framing_t framing = framing_t::none);
+    /// @brief Chunks `src` as `plan` says, typically one from
+    /// `plan_chunks()`.
+    chunked_qr_code_source_t(std::span<const std::uint8_t> src,
+                             std::shared_ptr<thread_pool_t> pool,
+                             const chunk_plan_t &plan,
+                             std::size_t max_batches_in_flight = 0);
+    ~chunked_qr_code_source_t() noexcept override;
+    auto symbol_size() const -> int override;
+    auto next() -> std::optional<qr_symbol_t> override;
+    auto qr_code_count() const -> std::optional<std::size_t> override;
+    auto chunk_plan() const -> std::optional<chunk_plan_t> override;
+    auto payload_size() const -> std::optional<std::uint64_t> override;
+
+  private:
+    void submit_batch();
+
+    std::span<const std::uint8_t> src_;
+    std::shared_ptr<thread_pool_t> pool_;
+    chunk_plan_t plan_;
+    // Shared by the batches; null if the plan's mask is -1
+    std::shared_ptr<const qr_symbol_builder_t> builder_;
+    // Null without an erasure code
+    std::shared_ptr<const erasure_coder_t> erasure_coder_;
+    // With `framing_t::sequenced`
+    std::optional<qr_symbol_t> manifest_;
+    std::size_t offset_ = 0;
+    // With an erasure code, where the stripe being submitted starts, and
+    // whether its data has all been and its parity is next
+    std::size_t stripe_offset_ = 0;
+    bool parity_next_ = false;
+    std::deque<std::future<std::vector<qr_symbol_t>>> in_flight_;
+    std::vector<qr_symbol_t> batch_;
+    std::size_t batch_position_ = 0;
+    // Number of chunks per pool task. Large enough to amortize the task
+    // overhead, small enough to keep the pipeline latency low.
+    constexpr static std::size_t chunks_per_batch_ = 16;
+};
+
+/// @brief Source that chunks a payload of unknown length, e.g., stdin, as
+/// `read` hands it over and builds the QR codes on `pool` ahead of the
+/// consumer, like `chunked_qr_code_source_t`. At most
+/// `max_batches_in_flight` batches are read ahead.
+/// @details The payload is read on the thread calling `next()`, and every
+/// batch owns the part it was read into. `plan` must not frame the chunks, as
+/// `framing_t::sequenced` begins with the payload size.
+class streamed_qr_code_source_t : public qr_code_source_t {
+  public:
+    /// @brief Fills its argument with the next bytes of the payload.
+    /// @return Number of bytes read, fewer than asked for only at the end of
+    /// the payload
+    using read_t = std::function<std::size_t(std::span<std::uint8_t>)>;
+
+    streamed_qr_code_source_t(read_t read,
+                              std::shared_ptr<thread_pool_t> pool,
+                              const chunk_plan_t &plan,
+                              std::size_t max_batches_in_flight = 0);
+    auto symbol_size() const -> int override;
+    auto next() -> std::optional<qr_symbol_t> override;
+    auto chunk_plan() const -> std::optional<chunk_plan_t> override;
+    /// @brief Known once the whole payload has been read.
+    auto payload_size() const -> std::optional<std::uint64_t> override;
+
+  private:
+    void submit_batch();
+
+    read_t read_;
+    std::shared_ptr<thread_pool_t> pool_;
+    chunk_plan_t plan_;
+    std::shared_ptr<const qr_symbol_builder_t> builder_;
+    std::uint64_t bytes_read_ = 0;
+    bool end_ = false;
+    std::deque<std::future<std::vector<qr_symbol_t>>> in_flight_;
+    std::vector<qr_symbol_t> batch_;
+    std::size_t batch_position_ = 0;
+    // Number of chunks per pool task, as for `chunked_qr_code_source_t`
+    constexpr static std::size_t chunks_per_batch_ = 16;
+};
+
 auto decode_qr_code(const std::span<std::uint8_t> src)
     -> std::vector<std::uint8_t>;
 
 void decode_qr_code(std::vector<uint8_t> &dst, cv::Mat src);
 
+/// @brief Receives the payload of each QR code decoded from an image.
+using payload_sink_t = std::function<void(std::span<const std::uint8_t>)>;
+
+/// @brief How the encoder draws each QR code into its tile: `scale` pixels
+/// per module, inside a margin of `border_size` pixels. See
+/// `qr_code_decoder_t::set_geometry()`.
+struct symbol_geometry_t {
+    int scale = 0;
+    int border_size = 0;
+};
+
 class qr_code_decoder_t {
   public:
     explicit qr_code_decoder_t(int width, int height);
+    /// @brief Decodes the QR codes in `src`, an image as `begin()` lays it
+    /// out, appending their payloads to `dst`.
+    /// @throws std::runtime_error if there are none
     void decode(std::vector<std::uint8_t> &dst,
                 const std::span<std::uint8_t> src);
 
+    /// @brief Starts decoding an image that the caller writes straight into
+    /// the returned buffer: one byte of luma per pixel, `width()` pixels per
+    /// row, `height()` rows. Must be followed by `finish()`.
+    [[nodiscard]] auto begin() -> std::span<std::uint8_t>;
+
+    /// @brief Detects the QR codes in the image written since `begin()` and
+    /// appends the payloads that decode successfully to `dst`.
+    /// @return Number of QR codes found, including any that failed to decode.
+    auto finish(std::vector<std::uint8_t> &dst) -> int;
+
+    /// @brief Like `finish(dst)`, but hands each payload to `sink` in turn.
+    auto finish(const payload_sink_t &sink) -> int;
+
+    [[nodiscard]] auto width() const noexcept -> int { return width_; }
+    [[nodiscard]] auto height() const noexcept -> int { return height_; }
+
+    /// @brief Accounts the time of `finish()` to `stage_t::qr_identify`,
+    /// `stage_t::qr_decode` and `stage_t::qr_sample` of `stats`, and QR
+    /// codes that fail to decode to its decode failures. Null, the default,
+    /// turns this off.
+    void set_stats(stats_t *stats) noexcept { stats_ = stats; }
+
+    /// @brief Expect every image to hold one QR code drawn the way the
+    /// encoder draws a tile: axis-aligned, `scale` pixels per module, inside
+    /// a margin of `border_size` pixels. `finish()` then reads the modules
+    /// straight from the centers of their squares, with the threshold set
+    /// by the finder, timing and alignment patterns, and runs quirc's
+    /// detection only if that symbol does not decode, e.g., for a blank
+    /// tile or a heavily compressed frame.
+    /// @throws std::runtime_error if no QR code version fits the image that
+    /// way; see `fits_geometry()`
+    void set_geometry(int scale, int border_size);
+
+    /// @brief Whether a QR code drawn with `scale` and `border_size` fills
+    /// the image exactly, as `set_geometry()` needs.
+    [[nodiscard]] auto fits_geometry(int scale, int border_size) const
+        -> bool;
+
   private:
+    /// @brief Orders `codes` the way the encoder fills a frame's tiles.
+    static void sort_by_position(std::vector<quirc_code> &codes);
+
+    /// @brief Reads the symbol of `set_geometry()` from the image into
+    /// `code`, as `quirc_extract()` would after detecting it.
+    /// @return false if the image has too little contrast to hold a symbol
+    auto sample(quirc_code &code) -> bool;
+
     std::unique_ptr<quirc, decltype(&quirc_destroy)> qr_;
     int width_, height_;
+    stats_t *stats_ = nullptr;
+    // Buffer of `begin()`, not yet thresholded by `quirc_end()`
+    std::uint8_t *image_ = nullptr;
+    // Set by `set_geometry()`
+    std::optional<qr_layout_t> layout_;
+    int scale_ = 0, border_size_ = 0;
+    // Sum of the luma sampled in each module, row by row
+    std::vector<int> module_sums_;
 };
 
 } // namespace net_zelcon::plain_sight
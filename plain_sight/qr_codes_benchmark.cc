@@ -0,0 +1,99 @@
+#include <benchmark/benchmark.h>
+
+#include "plain_sight/benchmark_util.h"
+#include "plain_sight/capacity.h"
+#include "plain_sight/qr_codes.h"
+#include "plain_sight/qr_symbol.h"
+#include "plain_sight/thread_pool.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using net_zelcon::plain_sight::qr_byte_capacity;
+using net_zelcon::plain_sight::qr_symbol_builder_t;
+using net_zelcon::plain_sight::qr_symbol_t;
+using net_zelcon::plain_sight::random_payload;
+using net_zelcon::plain_sight::split_frames;
+using net_zelcon::plain_sight::thread_pool_t;
+
+// Arguments: payload size in MiB, number of worker threads.
+//
+// The payload is fed through `split_frames` one window at a time and each
+// window's QR codes are dropped before the next one is built, the way a
+// streaming encoder would consume them. Materializing every QR code of a
+// multi-hundred-MB payload at once would need tens of GB of RAM.
+void BM_SplitFramesParallel(benchmark::State &state) {
+    constexpr std::size_t window_size = 1 << 20;
+    const auto payload =
+        random_payload(static_cast<std::size_t>(state.range(0)) << 20);
+    thread_pool_t pool{static_cast<std::size_t>(state.range(1))};
+    std::size_t frames = 0;
+    for (auto _ : state) {
+        const std::span<const std::uint8_t> src{payload};
+        for (std::size_t i = 0; i < src.size(); i += window_size) {
+            auto qr_codes = split_frames(
+                src.subspan(i, std::min(window_size, src.size() - i)), pool);
+            frames += qr_codes.size();
+            benchmark::DoNotOptimize(qr_codes.data());
+        }
+    }
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations()) *
+                            static_cast<std::int64_t>(payload.size()));
+    state.counters["frames_per_second"] = benchmark::Counter(
+        static_cast<double>(frames), benchmark::Counter::kIsRate);
+}
+
+void split_frames_arguments(benchmark::internal::Benchmark *benchmark) {
+    const int max_threads =
+        static_cast<int>(std::max(1U, std::thread::hardware_concurrency()));
+    for (const int megabytes : {16, 256}) {
+        for (int threads = 1; threads < max_threads; threads *= 2) {
+            benchmark->Args({megabytes, threads});
+        }
+        benchmark->Args({megabytes, max_threads});
+    }
+}
+
+BENCHMARK(BM_SplitFramesParallel)
+    ->Apply(split_frames_arguments)
+    ->ArgNames({"MiB", "threads"})
+    ->Iterations(1)
+    ->UseRealTime()
+    ->Unit(benchmark::kSecond);
+
+// Arguments: QR code version; how the symbol is built: 0 by qrcodegen,
+// scoring every mask, 1 by qrcodegen with a fixed mask, 2 by
+// `qr_symbol_builder_t`.
+//
+// One full symbol at ECC level HIGH per iteration, on one thread.
+void BM_BuildQrSymbol(benchmark::State &state) {
+    constexpr auto ecc = qrcodegen::QrCode::Ecc::HIGH;
+    const int version = static_cast<int>(state.range(0));
+    const auto payload = random_payload(qr_byte_capacity(version, ecc));
+    const qr_symbol_builder_t builder{version, ecc, 0};
+    for (auto _ : state) {
+        if (state.range(1) == 2) {
+            auto symbol = builder.build(payload);
+            benchmark::DoNotOptimize(symbol);
+            continue;
+        }
+        auto qr_code = qrcodegen::QrCode::encodeSegments(
+            {qrcodegen::QrSegment::makeBytes(payload)}, ecc, version, version,
+            state.range(1) == 0 ? -1 : 0, false);
+        benchmark::DoNotOptimize(qr_code);
+    }
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations()) *
+                            static_cast<std::int64_t>(payload.size()));
+}
+
+BENCHMARK(BM_BuildQrSymbol)
+    ->ArgsProduct({{5, 20, 40}, {0, 1, 2}})
+    ->ArgNames({"version", "builder"})
+    ->Unit(benchmark::kMicrosecond);
+
+} // namespace
\ No newline at end of file
@@ -2,6 +2,10 @@
 
 #include "plain_sight/qr_codes.h"
 
+#include <algorithm>
+#include <memory>
+#include <random>
+
 TEST(QrCodeGenerator, SplitRightNumber) {
     std::vector<std::uint8_t> data(10'000, '1');
     auto qr_codes = net_zelcon::plain_sight::split_frames(data);
@@ -9,4 +13,228 @@ TEST(QrCodeGenerator, SplitRightNumber) {
     data = std::vector<std::uint8_t>(10'001, '1');
     qr_codes = net_zelcon::plain_sight::split_frames(data);
     ASSERT_EQ(qr_codes.size(), 101);
+}
+
+TEST(QrCodeGenerator, ParallelMatchesSerial) {
+    std::vector<std::uint8_t> data(25'050);
+    for (std::size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<std::uint8_t>(i * 31 + 7);
+    }
+    const auto serial = net_zelcon::plain_sight::split_frames(data);
+    net_zelcon::plain_sight::thread_pool_t pool{3};
+    const auto parallel = net_zelcon::plain_sight::split_frames(data, pool);
+    ASSERT_EQ(serial.size(), parallel.size());
+    for (std::size_t i = 0; i < serial.size(); ++i) {
+        ASSERT_EQ(serial[i].getSize(), parallel[i].getSize());
+        ASSERT_EQ(serial[i].getMask(), parallel[i].getMask());
+        for (int y = 0; y < serial[i].getSize(); ++y) {
+            for (int x = 0; x < serial[i].getSize(); ++x) {
+                ASSERT_EQ(serial[i].getModule(x, y),
+                          parallel[i].getModule(x, y))
+                    << "QR code " << i << " differs at (" << x << ", " << y
+                    << ")";
+            }
+        }
+    }
+}
+
+TEST(QrCodeGenerator, ChunkedSourceMatchesSplitFrames) {
+    std::vector<std::uint8_t> data(5'050);
+    for (std::size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<std::uint8_t>(i * 13 + 5);
+    }
+    const auto expected = net_zelcon::plain_sight::split_frames(data);
+    net_zelcon::plain_sight::chunked_qr_code_source_t source{
+        data, std::make_shared<net_zelcon::plain_sight::thread_pool_t>(2), 2};
+    ASSERT_EQ(source.symbol_size(), expected.front().getSize());
+    std::size_t count = 0;
+    while (auto qr_code = source.next()) {
+        ASSERT_LT(count, expected.size());
+        // Built by `qr_symbol_builder_t`, expected by qrcodegen
+        ASSERT_TRUE(*qr_code ==
+                    net_zelcon::plain_sight::qr_symbol_t{expected[count]})
+            << "QR code " << count;
+        ++count;
+    }
+    ASSERT_EQ(count, expected.size());
+}
+TEST(QrCodeGenerator, StreamedSourceMatchesChunkedSource) {
+    std::vector<std::uint8_t> data(5'050);
+    for (std::size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<std::uint8_t>(i * 17 + 3);
+    }
+    const net_zelcon::plain_sight::chunk_plan_t plan{};
+    auto pool = std::make_shared<net_zelcon::plain_sight::thread_pool_t>(2);
+    net_zelcon::plain_sight::chunked_qr_code_source_t chunked{data, pool, plan,
+                                                              2};
+    std::size_t offset = 0;
+    net_zelcon::plain_sight::streamed_qr_code_source_t streamed{
+        [&](std::span<std::uint8_t> dst) {
+            const std::size_t size = std::min(dst.size(), data.size() - offset);
+            std::copy_n(data.begin() + static_cast<std::ptrdiff_t>(offset),
+                        size, dst.begin());
+            offset += size;
+            return size;
+        },
+        pool, plan, 3};
+    ASSERT_EQ(streamed.symbol_size(), chunked.symbol_size());
+    std::size_t count = 0;
+    while (auto expected = chunked.next()) {
+        const auto qr_code = streamed.next();
+        ASSERT_TRUE(qr_code.has_value()) << "QR code " << count;
+        ASSERT_TRUE(*qr_code == *expected) << "QR code " << count;
+        ++count;
+    }
+    EXPECT_FALSE(streamed.next().has_value());
+    ASSERT_EQ(streamed.payload_size(), data.size());
+}
+
+namespace {
+
+/// @brief Gray image of `qr_code` drawn like the encoder draws a tile.
+auto draw(const qrcodegen::QrCode &qr_code, const int scale,
+          const int border_size) -> std::vector<std::uint8_t> {
+    const int width = qr_code.getSize() * scale + 2 * border_size;
+    std::vector<std::uint8_t> image(static_cast<std::size_t>(width) * width,
+                                    235);
+    for (int y = 0; y < qr_code.getSize() * scale; ++y) {
+        for (int x = 0; x < qr_code.getSize() * scale; ++x) {
+            if (qr_code.getModule(x / scale, y / scale)) {
+                image[static_cast<std::size_t>(border_size + y) * width +
+                      border_size + x] = 16;
+            }
+        }
+    }
+    return image;
+}
+
+} // namespace
+
+TEST(QrCodeDecoder, SamplesKnownGeometry) {
+    const std::vector<std::uint8_t> payload(300, 'x');
+    const auto qr_codes = net_zelcon::plain_sight::split_frames(payload);
+    auto image = draw(qr_codes.front(), 3, 8);
+    const int width = qr_codes.front().getSize() * 3 + 16;
+    // Blur every edge a little, as compression would
+    for (std::size_t i = 1; i < image.size(); ++i) {
+        image[i] = static_cast<std::uint8_t>((image[i - 1] + 3 * image[i]) / 4);
+    }
+    net_zelcon::plain_sight::stats_t stats;
+    net_zelcon::plain_sight::qr_code_decoder_t decoder{width, width};
+    decoder.set_stats(&stats);
+    decoder.set_geometry(3, 8);
+    std::vector<std::uint8_t> decoded;
+    decoder.decode(decoded, image);
+    EXPECT_EQ(decoded, std::vector<std::uint8_t>(payload.begin(),
+                                                 payload.begin() + 100));
+    EXPECT_GT(stats.time(net_zelcon::plain_sight::stage_t::qr_sample).count(),
+              0);
+    EXPECT_EQ(stats.time(net_zelcon::plain_sight::stage_t::qr_identify).count(),
+              0)
+        << "Sampling should have made quirc's detection unnecessary";
+}
+
+TEST(QrCodeDecoder, FallsBackToDetection) {
+    const std::vector<std::uint8_t> payload(100, 'y');
+    const auto qr_codes = net_zelcon::plain_sight::split_frames(payload);
+    auto image = draw(qr_codes.front(), 2, 8);
+    const int width = qr_codes.front().getSize() * 2 + 16;
+    // Upside down, the samples do not decode but quirc finds the QR code.
+    std::reverse(image.begin(), image.end());
+    net_zelcon::plain_sight::stats_t stats;
+    net_zelcon::plain_sight::qr_code_decoder_t decoder{width, width};
+    decoder.set_stats(&stats);
+    decoder.set_geometry(2, 8);
+    std::vector<std::uint8_t> decoded;
+    decoder.decode(decoded, image);
+    EXPECT_EQ(decoded, payload);
+    EXPECT_GT(stats.time(net_zelcon::plain_sight::stage_t::qr_identify).count(),
+              0);
+
+    // A blank tile is neither sampled nor found.
+    const auto blank = decoder.begin();
+    std::fill(blank.begin(), blank.end(), 235);
+    decoded.clear();
+    EXPECT_EQ(decoder.finish(decoded), 0);
+    EXPECT_TRUE(decoded.empty());
+}
+
+TEST(QrCodeDecoder, RejectsGeometryThatDoesNotFit) {
+    // A version 1 QR code is 21 modules wide.
+    const int width = 21 * 4 + 16;
+    net_zelcon::plain_sight::qr_code_decoder_t decoder{width, width};
+    EXPECT_FALSE(decoder.fits_geometry(4, 10));
+    EXPECT_THROW(decoder.set_geometry(4, 10), std::runtime_error);
+    EXPECT_FALSE(decoder.fits_geometry(3, 8));
+    EXPECT_THROW(decoder.set_geometry(3, 8), std::runtime_error);
+    EXPECT_TRUE(decoder.fits_geometry(4, 8));
+    EXPECT_NO_THROW(decoder.set_geometry(4, 8));
+}
+
+namespace {
+
+/// @brief What quirc makes of `image` when limited to `simd`: the labelled
+/// pixels, followed by every QR code it found.
+auto identify(const std::vector<std::uint8_t> &image, const int width,
+              const int height, const quirc_simd_t simd)
+    -> std::vector<std::uint8_t> {
+    std::unique_ptr<quirc, decltype(&quirc_destroy)> q{quirc_new(),
+                                                        &quirc_destroy};
+    EXPECT_EQ(quirc_resize(q.get(), width, height), 0);
+    quirc_set_simd(q.get(), simd);
+    std::uint8_t *buffer = quirc_begin(q.get(), nullptr, nullptr);
+    std::copy(image.begin(), image.end(), buffer);
+    quirc_end(q.get());
+    std::vector<std::uint8_t> result(buffer, buffer + image.size());
+    for (int i = 0; i < quirc_count(q.get()); ++i) {
+        quirc_code code;
+        quirc_extract(q.get(), i, &code);
+        const auto *bytes = reinterpret_cast<const std::uint8_t *>(&code);
+        result.insert(result.end(), bytes, bytes + sizeof(code));
+    }
+    return result;
+}
+
+} // namespace
+
+TEST(Quirc, InstructionSetsAgree) {
+    std::mt19937 rng{42};
+    const std::vector<std::uint8_t> payload(300, 'x');
+    const auto qr_codes = net_zelcon::plain_sight::split_frames(payload);
+    const auto tile = draw(qr_codes.front(), 3, 8);
+    const int tile_width = qr_codes.front().getSize() * 3 + 16;
+    // A noisy QR code, in rows that are no multiple of a vector wide
+    const int width = tile_width + 7;
+    std::vector<std::uint8_t> codes(static_cast<std::size_t>(width) *
+                                    tile_width);
+    std::uniform_int_distribution<int> noise{-40, 40};
+    for (int y = 0; y < tile_width; ++y) {
+        for (int x = 0; x < width; ++x) {
+            const int pixel = x < tile_width ? tile[y * tile_width + x] : 235;
+            codes[static_cast<std::size_t>(y) * width + x] =
+                static_cast<std::uint8_t>(
+                    std::clamp(pixel + noise(rng), 0, 255));
+        }
+    }
+    // Runs of random lengths and shades, to be scanned and filled
+    std::vector<std::uint8_t> runs(333 * 97);
+    std::uniform_int_distribution<std::size_t> run_length{1, 70};
+    for (std::size_t i = 0; i < runs.size();) {
+        const std::size_t end = std::min(runs.size(), i + run_length(rng));
+        std::fill(runs.begin() + static_cast<std::ptrdiff_t>(i),
+                  runs.begin() + static_cast<std::ptrdiff_t>(end),
+                  static_cast<std::uint8_t>(rng()));
+        i = end;
+    }
+
+    const auto scalar_codes =
+        identify(codes, width, tile_width, QUIRC_SIMD_NONE);
+    EXPECT_GT(scalar_codes.size(), codes.size()) << "No QR code was found";
+    const auto scalar_runs = identify(runs, 333, 97, QUIRC_SIMD_NONE);
+    for (const auto simd : {QUIRC_SIMD_SSE42, QUIRC_SIMD_AVX2}) {
+        EXPECT_TRUE(identify(codes, width, tile_width, simd) == scalar_codes)
+            << "Instruction set " << simd;
+        EXPECT_TRUE(identify(runs, 333, 97, simd) == scalar_runs)
+            << "Instruction set " << simd;
+    }
 }
\ No newline at end of file
@@ -0,0 +1,138 @@
+#include "plain_sight/qr_layout.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <glog/logging.h>
+
+namespace net_zelcon::plain_sight {
+
+namespace {
+
+// Positions of the alignment pattern centers along either axis. Mirrors
+// `qrcodegen::QrCode::getAlignmentPatternPositions()`, which is private.
+auto alignment_pattern_positions(int version, int size) -> std::vector<int> {
+    if (version == 1) {
+        return {};
+    }
+    const int num_align = version / 7 + 2;
+    const int step =
+        version == 32
+            ? 26
+            : (version * 4 + num_align * 2 + 1) / (num_align * 2 - 2) * 2;
+    std::vector<int> positions(num_align);
+    positions.front() = 6;
+    for (int i = num_align - 1, pos = size - 7; i >= 1; --i, pos -= step) {
+        positions[i] = pos;
+    }
+    return positions;
+}
+
+} // namespace
+
+qr_layout_t::qr_layout_t(int version)
+    : version_{version}, size_{version * 4 + 17},
+      static_(static_cast<std::size_t>(size_) * size_),
+      dark_(static_.size()), format_(static_.size()) {
+    CHECK_GE(version, 1);
+    CHECK_LE(version, 40);
+    // The order follows `qrcodegen::QrCode::drawFunctionPatterns()`, so later
+    // patterns overwrite earlier ones exactly as they do there.
+    for (int i = 0; i < size_; ++i) {
+        set_static(6, i, i % 2 == 0);
+        set_static(i, 6, i % 2 == 0);
+    }
+    draw_finder_pattern(3, 3);
+    draw_finder_pattern(size_ - 4, 3);
+    draw_finder_pattern(3, size_ - 4);
+    const auto positions = alignment_pattern_positions(version_, size_);
+    const std::size_t num_align = positions.size();
+    for (std::size_t i = 0; i < num_align; ++i) {
+        for (std::size_t j = 0; j < num_align; ++j) {
+            // Don't draw on the three finder corners
+            if (!((i == 0 && j == 0) || (i == 0 && j == num_align - 1) ||
+                  (i == num_align - 1 && j == 0))) {
+                draw_alignment_pattern(positions[i], positions[j]);
+            }
+        }
+    }
+    mark_format_areas();
+    draw_version();
+}
+
+auto qr_layout_t::version_for_size(int size) -> int {
+    CHECK_EQ((size - 17) % 4, 0) << "Not a QR symbol size: " << size;
+    return (size - 17) / 4;
+}
+
+void qr_layout_t::set_static(int x, int y, bool dark) {
+    static_[index(x, y)] = true;
+    dark_[index(x, y)] = dark;
+}
+
+void qr_layout_t::draw_finder_pattern(int x, int y) {
+    for (int dy = -4; dy <= 4; ++dy) {
+        for (int dx = -4; dx <= 4; ++dx) {
+            const int dist = std::max(std::abs(dx), std::abs(dy));
+            const int xx = x + dx, yy = y + dy;
+            if (0 <= xx && xx < size_ && 0 <= yy && yy < size_) {
+                set_static(xx, yy, dist != 2 && dist != 4);
+            }
+        }
+    }
+}
+
+void qr_layout_t::draw_alignment_pattern(int x, int y) {
+    for (int dy = -2; dy <= 2; ++dy) {
+        for (int dx = -2; dx <= 2; ++dx) {
+            set_static(x + dx, y + dy,
+                       std::max(std::abs(dx), std::abs(dy)) != 1);
+        }
+    }
+}
+
+void qr_layout_t::draw_version() {
+    if (version_ < 7) {
+        return;
+    }
+    int rem = version_;
+    for (int i = 0; i < 12; ++i) {
+        rem = (rem << 1) ^ ((rem >> 11) * 0x1F25);
+    }
+    const long bits = static_cast<long>(version_) << 12 | rem;
+    for (int i = 0; i < 18; ++i) {
+        const bool dark = ((bits >> i) & 1) != 0;
+        const int a = size_ - 11 + i % 3;
+        const int b = i / 3;
+        set_static(a, b, dark);
+        set_static(b, a, dark);
+    }
+}
+
+void qr_layout_t::mark_format_areas() {
+    const auto mark = [this](int x, int y) {
+        static_[index(x, y)] = false;
+        dark_[index(x, y)] = false;
+        format_[index(x, y)] = true;
+    };
+    // First copy
+    for (int i = 0; i <= 5; ++i) {
+        mark(8, i);
+    }
+    mark(8, 7);
+    mark(8, 8);
+    mark(7, 8);
+    for (int i = 9; i < 15; ++i) {
+        mark(14 - i, 8);
+    }
+    // Second copy
+    for (int i = 0; i < 8; ++i) {
+        mark(size_ - 1 - i, 8);
+    }
+    for (int i = 8; i < 15; ++i) {
+        mark(8, size_ - 15 + i);
+    }
+    // The dark module sits next to the second copy and never changes.
+    set_static(8, size_ - 8, true);
+}
+
+} // namespace net_zelcon::plain_sight
\ No newline at end of file
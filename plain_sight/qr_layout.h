@@ -0,0 +1,61 @@
+#ifndef _INCLUDE_NET_ZELCON_PLAIN_SIGHT_QR_LAYOUT_H_
+#define _INCLUDE_NET_ZELCON_PLAIN_SIGHT_QR_LAYOUT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace net_zelcon::plain_sight {
+
+/// @brief Module layout of a QR symbol of one version: which modules belong to
+/// function patterns and, for the ones that do not depend on the symbol's
+/// contents, their color.
+/// @details Finder, separator, timing and alignment patterns, the version
+/// information and the dark module are identical in every symbol of a
+/// version; they are "static". The format information depends on the ECC
+/// level and mask, so it is a function pattern but not static.
+class qr_layout_t {
+  public:
+    /// @param version QR version, 1 to 40
+    explicit qr_layout_t(int version);
+
+    [[nodiscard]] auto version() const noexcept -> int { return version_; }
+    /// @brief Width (and height) in modules.
+    [[nodiscard]] auto size() const noexcept -> int { return size_; }
+    [[nodiscard]] auto is_static(int x, int y) const -> bool {
+        return static_[index(x, y)];
+    }
+    /// @brief Color of a static module; `false` for every other module.
+    [[nodiscard]] auto is_dark(int x, int y) const -> bool {
+        return dark_[index(x, y)];
+    }
+    /// @brief Whether the module carries format information.
+    [[nodiscard]] auto is_format(int x, int y) const -> bool {
+        return format_[index(x, y)];
+    }
+    /// @brief Whether the module is part of any function pattern, i.e., does
+    /// not carry data or ECC codewords.
+    [[nodiscard]] auto is_function(int x, int y) const -> bool {
+        return is_static(x, y) || is_format(x, y);
+    }
+
+    /// @brief Version of a symbol `size` modules wide.
+    static auto version_for_size(int size) -> int;
+
+  private:
+    auto index(int x, int y) const -> std::size_t {
+        return static_cast<std::size_t>(y) * size_ + x;
+    }
+    void set_static(int x, int y, bool dark);
+    void draw_finder_pattern(int x, int y);
+    void draw_alignment_pattern(int x, int y);
+    void draw_version();
+    void mark_format_areas();
+
+    int version_, size_;
+    std::vector<bool> static_, dark_, format_;
+};
+
+} // namespace net_zelcon::plain_sight
+
+#endif // _INCLUDE_NET_ZELCON_PLAIN_SIGHT_QR_LAYOUT_H_
\ No newline at end of file
@@ -0,0 +1,270 @@
+#include "plain_sight/qr_symbol.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <glog/logging.h>
+
+#include "plain_sight/capacity.h"
+
+namespace net_zelcon::plain_sight {
+
+namespace {
+
+// Codewords of a version 40 symbol
+constexpr std::size_t max_raw_codewords = 3706;
+
+/// @brief Whether mask pattern `mask` inverts the module at (`x`, `y`),
+/// ISO/IEC 18004 table 10.
+auto mask_inverts(const int mask, const int x, const int y) -> bool {
+    switch (mask) {
+    case 0:
+        return (x + y) % 2 == 0;
+    case 1:
+        return y % 2 == 0;
+    case 2:
+        return x % 3 == 0;
+    case 3:
+        return (x + y) % 3 == 0;
+    case 4:
+        return (x / 3 + y / 2) % 2 == 0;
+    case 5:
+        return x * y % 2 + x * y % 3 == 0;
+    case 6:
+        return (x * y % 2 + x * y % 3) % 2 == 0;
+    default:
+        return ((x + y) % 2 + x * y % 3) % 2 == 0;
+    }
+}
+
+/// @brief The 15 format information bits of `ecc` and `mask`, BCH code and
+/// XOR mask included.
+auto format_bits(const qrcodegen::QrCode::Ecc ecc, const int mask) -> int {
+    // Indexed by `qrcodegen::QrCode::Ecc`: L, M, Q, H
+    constexpr std::array<int, 4> ecc_bits = {1, 0, 3, 2};
+    const int data = ecc_bits[static_cast<std::size_t>(ecc)] << 3 | mask;
+    int rem = data;
+    for (int i = 0; i < 10; ++i) {
+        rem = (rem << 1) ^ ((rem >> 9) * 0x537);
+    }
+    return (data << 10 | rem) ^ 0x5412;
+}
+
+/// @brief Appends bits, most significant first, to a byte buffer that is
+/// large enough.
+class bit_writer_t {
+  public:
+    explicit bit_writer_t(std::uint8_t *dst) : dst_{dst} {}
+
+    /// @brief Appends the low `count` bits of `value`, at most 24.
+    void write(const std::uint32_t value, const int count) {
+        accumulator_ = accumulator_ << count | (value & ((1U << count) - 1));
+        pending_ += count;
+        while (pending_ >= 8) {
+            pending_ -= 8;
+            *dst_++ = static_cast<std::uint8_t>(accumulator_ >> pending_);
+        }
+    }
+
+    /// @brief Pads the last byte with clear bits.
+    void flush() {
+        if (pending_ > 0) {
+            write(0, 8 - pending_);
+        }
+    }
+
+  private:
+    std::uint8_t *dst_;
+    std::uint64_t accumulator_ = 0;
+    int pending_ = 0;
+};
+
+} // namespace
+
+qr_symbol_t::qr_symbol_t(const int size)
+    : size_{size}, words_per_row_{(size + 63) / 64},
+      modules_(static_cast<std::size_t>(words_per_row_) * size) {
+    CHECK_GT(size, 0);
+}
+
+qr_symbol_t::qr_symbol_t(const qrcodegen::QrCode &qr_code)
+    : qr_symbol_t{qr_code.getSize()} {
+    for (int y = 0; y < size_; ++y) {
+        for (int x = 0; x < size_; ++x) {
+            set_module(x, y, qr_code.getModule(x, y));
+        }
+    }
+}
+
+void qr_symbol_t::set_module(const int x, const int y, const bool dark) {
+    std::uint64_t &word =
+        modules_[static_cast<std::size_t>(y) * words_per_row_ + x / 64];
+    const std::uint64_t bit = std::uint64_t{1} << (x % 64);
+    word = dark ? word | bit : word & ~bit;
+}
+
+auto qr_symbol_t::run_end(const int x, const int y, const int end) const
+    -> int {
+    const auto words = row(y);
+    // Set bits mark modules of the other color
+    const std::uint64_t flip = module(x, y) ? ~std::uint64_t{0} : 0;
+    int word = x / 64;
+    std::uint64_t other = (words[word] ^ flip) >> (x % 64) << (x % 64);
+    while (other == 0 && ++word < words_per_row_) {
+        other = words[word] ^ flip;
+    }
+    if (other == 0) {
+        return end;
+    }
+    return std::min(end, word * 64 + std::countr_zero(other));
+}
+
+qr_symbol_builder_t::qr_symbol_builder_t(const int version,
+                                         const qrcodegen::QrCode::Ecc ecc,
+                                         const int mask)
+    : version_{version}, capacity_{qr_byte_capacity(version, ecc)},
+      data_codewords_{qr_data_codewords(version, ecc)},
+      blocks_{qr_ecc_blocks(version, ecc)},
+      reed_solomon_{qr_ecc_codewords_per_block(version, ecc)},
+      base_{version * 4 + 17} {
+    CHECK_GE(mask, 0);
+    CHECK_LE(mask, 7);
+    const qr_layout_t layout{version};
+    const int size = layout.size();
+    // Codeword bits go up and down two module columns at a time, from the
+    // right, skipping the vertical timing pattern.
+    for (int right = size - 1; right >= 1; right -= 2) {
+        if (right == 6) {
+            right = 5;
+        }
+        const bool upward = ((right + 1) & 2) == 0;
+        for (int vertical = 0; vertical < size; ++vertical) {
+            const int y = upward ? size - 1 - vertical : vertical;
+            for (int x = right; x > right - 2; --x) {
+                if (layout.is_function(x, y)) {
+                    continue;
+                }
+                bit_positions_.push_back(static_cast<std::uint32_t>(
+                    y * base_.words_per_row() * 64 + x));
+            }
+        }
+    }
+    // What is left over are remainder bits, which stay clear.
+    const std::size_t raw_codewords = bit_positions_.size() / 8;
+    bit_positions_.resize(raw_codewords * 8);
+
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+            if (layout.is_static(x, y)) {
+                base_.set_module(x, y, layout.is_dark(x, y));
+            } else if (!layout.is_format(x, y)) {
+                base_.set_module(x, y, mask_inverts(mask, x, y));
+            }
+        }
+    }
+    // Both copies of the format information, in the order of
+    // `qrcodegen::QrCode::drawFormatBits()`
+    const int format = format_bits(ecc, mask);
+    const auto bit = [format](const int i) { return (format >> i & 1) != 0; };
+    for (int i = 0; i <= 5; ++i) {
+        base_.set_module(8, i, bit(i));
+    }
+    base_.set_module(8, 7, bit(6));
+    base_.set_module(8, 8, bit(7));
+    base_.set_module(7, 8, bit(8));
+    for (int i = 9; i < 15; ++i) {
+        base_.set_module(14 - i, 8, bit(i));
+    }
+    for (int i = 0; i < 8; ++i) {
+        base_.set_module(size - 1 - i, 8, bit(i));
+    }
+    for (int i = 8; i < 15; ++i) {
+        base_.set_module(8, size - 15 + i, bit(i));
+    }
+
+    // Blocks are sent one codeword of each at a time. Short blocks have no
+    // codeword where the long ones have their last data codeword.
+    const std::size_t ecc_size = reed_solomon_.parity_size();
+    short_blocks_ = blocks_ - raw_codewords % blocks_;
+    const std::size_t short_block_size = raw_codewords / blocks_;
+    short_block_data_ = short_block_size - ecc_size;
+    const auto block_offset = [this, short_block_size](const std::size_t j) {
+        return j * short_block_size + std::max(j, short_blocks_) -
+               short_blocks_;
+    };
+    interleaving_.reserve(raw_codewords);
+    for (std::size_t i = 0; i <= short_block_size; ++i) {
+        for (std::size_t j = 0; j < blocks_; ++j) {
+            if (j < short_blocks_ && i == short_block_data_) {
+                continue;
+            }
+            // Short blocks' ECC comes one codeword earlier
+            const std::size_t offset =
+                j < short_blocks_ && i > short_block_data_ ? i - 1 : i;
+            interleaving_.push_back(
+                static_cast<std::uint16_t>(block_offset(j) + offset));
+        }
+    }
+    CHECK_EQ(interleaving_.size(), raw_codewords);
+}
+
+auto qr_symbol_builder_t::build(std::span<const std::uint8_t> data) const
+    -> qr_symbol_t {
+    CHECK_LE(data.size(), capacity_);
+    const std::size_t raw_codewords = interleaving_.size();
+    std::array<std::uint8_t, max_raw_codewords> codewords;
+    std::array<std::uint8_t, max_raw_codewords> blocks;
+
+    // Data codewords: byte mode indicator, character count, the bytes, the
+    // terminator and padding, as `qrcodegen::QrCode::encodeSegments()` lays
+    // them out.
+    const int count_bits = version_ < 10 ? 8 : 16;
+    const std::size_t bits = 4 + count_bits + 8 * data.size();
+    const auto terminator_bits =
+        static_cast<int>(std::min<std::size_t>(4, data_codewords_ * 8 - bits));
+    bit_writer_t writer{codewords.data()};
+    writer.write(0x4, 4);
+    writer.write(static_cast<std::uint32_t>(data.size()), count_bits);
+    for (const std::uint8_t byte : data) {
+        writer.write(byte, 8);
+    }
+    writer.write(0, terminator_bits);
+    writer.flush();
+    std::size_t length = (bits + terminator_bits + 7) / 8;
+    for (std::uint8_t pad = 0xec; length < data_codewords_;
+         pad ^= 0xec ^ 0x11) {
+        codewords[length++] = pad;
+    }
+
+    // Each block's data, followed by its ECC
+    const std::size_t ecc_size = reed_solomon_.parity_size();
+    std::size_t in = 0, out = 0;
+    for (std::size_t j = 0; j < blocks_; ++j) {
+        const std::size_t block_data =
+            short_block_data_ + (j < short_blocks_ ? 0 : 1);
+        std::copy_n(codewords.begin() + static_cast<std::ptrdiff_t>(in),
+                    block_data,
+                    blocks.begin() + static_cast<std::ptrdiff_t>(out));
+        reed_solomon_.encode(
+            std::span<const std::uint8_t>{blocks.data() + out, block_data},
+            std::span<std::uint8_t>{blocks.data() + out + block_data,
+                                    ecc_size});
+        in += block_data;
+        out += block_data + ecc_size;
+    }
+
+    // Codeword bits are random, so they are XORed in without branching
+    qr_symbol_t symbol = base_;
+    for (std::size_t i = 0; i < raw_codewords; ++i) {
+        const std::uint64_t byte = blocks[interleaving_[i]];
+        const std::uint32_t *positions = &bit_positions_[i * 8];
+        for (int bit = 0; bit < 8; ++bit) {
+            const std::uint32_t position = positions[bit];
+            symbol.modules_[position / 64] ^= (byte >> (7 - bit) & 1)
+                                              << (position % 64);
+        }
+    }
+    return symbol;
+}
+
+} // namespace net_zelcon::plain_sight
\ No newline at end of file
@@ -0,0 +1,103 @@
+#ifndef _INCLUDE_NET_ZELCON_PLAIN_SIGHT_QR_SYMBOL_H_
+#define _INCLUDE_NET_ZELCON_PLAIN_SIGHT_QR_SYMBOL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "plain_sight/qr_layout.h"
+#include "plain_sight/reed_solomon.h"
+#include <qrcodegen.hpp>
+
+namespace net_zelcon::plain_sight {
+
+/// @brief Modules of a QR symbol, packed into bits row by row, which is what
+/// the frame renderer reads.
+/// @details Row `y` is `words_per_row()` 64-bit words; module `x` is bit
+/// `x % 64` of word `x / 64`, set if the module is dark. Bits past the end of
+/// a row are clear.
+class qr_symbol_t {
+  public:
+    /// @brief All light symbol `size` modules wide.
+    explicit qr_symbol_t(int size);
+    /// @brief Copies the modules of `qr_code`.
+    explicit qr_symbol_t(const qrcodegen::QrCode &qr_code);
+
+    /// @brief Width (and height) in modules.
+    [[nodiscard]] auto size() const noexcept -> int { return size_; }
+    [[nodiscard]] auto words_per_row() const noexcept -> int {
+        return words_per_row_;
+    }
+    [[nodiscard]] auto module(int x, int y) const -> bool {
+        return (row(y)[x / 64] >> (x % 64) & 1) != 0;
+    }
+    void set_module(int x, int y, bool dark);
+    [[nodiscard]] auto row(int y) const -> std::span<const std::uint64_t> {
+        return {modules_.data() + static_cast<std::size_t>(y) * words_per_row_,
+                static_cast<std::size_t>(words_per_row_)};
+    }
+    /// @brief End of the run of modules of one color that starts at `x` in
+    /// row `y`: the first column after `x` with the other color, or `end` if
+    /// the run reaches it.
+    [[nodiscard]] auto run_end(int x, int y, int end) const -> int;
+
+    friend auto operator==(const qr_symbol_t &, const qr_symbol_t &)
+        -> bool = default;
+
+  private:
+    friend class qr_symbol_builder_t;
+
+    int size_, words_per_row_;
+    std::vector<std::uint64_t> modules_;
+};
+
+/// @brief Builds QR symbols of one version, ECC level and mask, holding a
+/// single byte mode segment, several times faster than
+/// `qrcodegen::QrCode::encodeSegments()`.
+/// @details Symbols are identical to the ones qrcodegen builds for the same
+/// mask, without boosting the ECC level. Penalty scoring, which picks the
+/// mask an optical scanner reads best, is what a fixed mask saves; a video
+/// decoder reads any mask equally well. Everything else that is the same in
+/// every symbol — the function patterns, the format information, the mask
+/// and where each codeword bit goes — is worked out once, by the
+/// constructor. Instances are immutable and safe to share between threads.
+class qr_symbol_builder_t {
+  public:
+    /// @param version QR version, 1 to 40
+    /// @param mask Mask pattern, 0 to 7
+    qr_symbol_builder_t(int version, qrcodegen::QrCode::Ecc ecc, int mask);
+
+    [[nodiscard]] auto version() const noexcept -> int { return version_; }
+    [[nodiscard]] auto size() const noexcept -> int { return base_.size(); }
+    /// @brief Largest payload of `build()`, in bytes.
+    [[nodiscard]] auto capacity() const noexcept -> std::size_t {
+        return capacity_;
+    }
+
+    /// @brief Symbol holding `data`, at most `capacity()` bytes.
+    [[nodiscard]] auto build(std::span<const std::uint8_t> data) const
+        -> qr_symbol_t;
+
+  private:
+    int version_;
+    std::size_t capacity_;
+    std::size_t data_codewords_;
+    // Error correction blocks: the first `short_blocks_` hold one data
+    // codeword less than the others.
+    std::size_t blocks_, short_blocks_, short_block_data_;
+    reed_solomon_t reed_solomon_;
+    // Function patterns and format information, with the mask applied to
+    // every data module, as if all codeword bits were clear
+    qr_symbol_t base_;
+    // Where codeword `i` of the transmitted sequence comes from, in the
+    // blocks laid out one after the other, data before ECC
+    std::vector<std::uint16_t> interleaving_;
+    // Bit index in `base_.modules_` of every codeword bit, most significant
+    // bit first
+    std::vector<std::uint32_t> bit_positions_;
+};
+
+} // namespace net_zelcon::plain_sight
+
+#endif // _INCLUDE_NET_ZELCON_PLAIN_SIGHT_QR_SYMBOL_H_
\ No newline at end of file
@@ -0,0 +1,89 @@
+#include <gtest/gtest.h>
+
+#include "plain_sight/capacity.h"
+#include "plain_sight/qr_symbol.h"
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <qrcodegen.hpp>
+
+using namespace net_zelcon::plain_sight;
+using Ecc = qrcodegen::QrCode::Ecc;
+
+namespace {
+
+auto reference(const std::vector<std::uint8_t> &data, const int version,
+               const Ecc ecc, const int mask) -> qr_symbol_t {
+    return qr_symbol_t{qrcodegen::QrCode::encodeSegments(
+        {qrcodegen::QrSegment::makeBytes(data)}, ecc, version, version, mask,
+        false)};
+}
+
+auto random_bytes(std::mt19937 &rng, const std::size_t size)
+    -> std::vector<std::uint8_t> {
+    std::vector<std::uint8_t> bytes(size);
+    for (auto &byte : bytes) {
+        byte = static_cast<std::uint8_t>(rng());
+    }
+    return bytes;
+}
+
+} // namespace
+
+TEST(QrSymbolBuilder, MatchesQrCodeGenerator) {
+    std::mt19937 rng{7};
+    for (int version = 1; version <= 40; ++version) {
+        for (const Ecc ecc :
+             {Ecc::LOW, Ecc::MEDIUM, Ecc::QUARTILE, Ecc::HIGH}) {
+            const int mask = static_cast<int>(rng() % 8);
+            const qr_symbol_builder_t builder{version, ecc, mask};
+            ASSERT_EQ(builder.capacity(), qr_byte_capacity(version, ecc));
+            // Full, which leaves no room for the terminator, almost full,
+            // and short, which pads
+            for (const std::size_t size :
+                 {builder.capacity(), builder.capacity() - 1,
+                  static_cast<std::size_t>(rng() % builder.capacity())}) {
+                const auto data = random_bytes(rng, size);
+                EXPECT_TRUE(builder.build(data) ==
+                            reference(data, version, ecc, mask))
+                    << "version " << version << ", ECC "
+                    << static_cast<int>(ecc) << ", mask " << mask << ", "
+                    << size << " bytes";
+            }
+        }
+    }
+}
+
+TEST(QrSymbolBuilder, EveryMask) {
+    std::mt19937 rng{8};
+    for (const int version : {1, 7, 20}) {
+        const auto data =
+            random_bytes(rng, qr_byte_capacity(version, Ecc::HIGH) / 2);
+        for (int mask = 0; mask < 8; ++mask) {
+            const qr_symbol_builder_t builder{version, Ecc::HIGH, mask};
+            EXPECT_TRUE(builder.build(data) ==
+                        reference(data, version, Ecc::HIGH, mask))
+                << "version " << version << ", mask " << mask;
+        }
+    }
+}
+
+TEST(QrSymbol, RunEnd) {
+    // Wider than a word, so that runs cross word boundaries
+    qr_symbol_t symbol{101};
+    for (int x = 60; x < 70; ++x) {
+        symbol.set_module(x, 3, true);
+    }
+    symbol.set_module(100, 3, true);
+    EXPECT_EQ(symbol.run_end(0, 3, 101), 60);
+    EXPECT_EQ(symbol.run_end(10, 3, 50), 50);
+    EXPECT_EQ(symbol.run_end(60, 3, 101), 70);
+    EXPECT_EQ(symbol.run_end(65, 3, 101), 70);
+    EXPECT_EQ(symbol.run_end(70, 3, 101), 100);
+    EXPECT_EQ(symbol.run_end(100, 3, 101), 101);
+    EXPECT_EQ(symbol.run_end(0, 4, 101), 101);
+    EXPECT_TRUE(symbol.module(64, 3));
+    EXPECT_FALSE(symbol.module(64, 4));
+}
\ No newline at end of file
@@ -0,0 +1,122 @@
+#include "plain_sight/read_ahead.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fmt/core.h>
+#include <glog/logging.h>
+#include <stdexcept>
+
+#include <poll.h>
+#include <unistd.h>
+
+namespace net_zelcon::plain_sight {
+
+read_ahead_t::read_ahead_t(const int fd, const std::size_t block_size,
+                           const std::size_t depth)
+    : fd_{fd}, block_size_{block_size}, blocks_{depth} {
+    CHECK_GE(fd, 0);
+    CHECK_GT(block_size, 0UL);
+    if (::pipe(stop_pipe_) != 0) {
+        const int error = errno;
+        LOG(ERROR) << "Could not create pipe: " << std::strerror(error);
+        throw std::runtime_error{
+            fmt::format("Could not create pipe: {}", std::strerror(error))};
+    }
+    thread_ = std::thread{[this] { run(); }};
+}
+
+read_ahead_t::~read_ahead_t() noexcept {
+    blocks_.close();
+    const char stop = 0;
+    while (::write(stop_pipe_[1], &stop, 1) < 0 && errno == EINTR) {
+    }
+    thread_.join();
+    ::close(stop_pipe_[0]);
+    ::close(stop_pipe_[1]);
+}
+
+void read_ahead_t::run() {
+    const auto fail = [this](const int error) {
+        LOG(ERROR) << "Could not read file descriptor " << fd_ << ": "
+                   << std::strerror(error);
+        error_ = std::make_exception_ptr(std::runtime_error{
+            fmt::format("Could not read file descriptor {}: {}", fd_,
+                        std::strerror(error))});
+        blocks_.close();
+    };
+    for (;;) {
+        std::vector<std::uint8_t> block(block_size_);
+        std::size_t filled = 0;
+        // Fill the whole block unless the input ends, so that the consumer
+        // sees few, large blocks even from a pipe handing out 64 KiB at a time
+        while (filled < block.size()) {
+            pollfd fds[] = {{fd_, POLLIN, 0}, {stop_pipe_[0], POLLIN, 0}};
+            if (::poll(fds, 2, -1) < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                fail(errno);
+                return;
+            }
+            if (fds[1].revents != 0) {
+                return;
+            }
+            if (fds[0].revents & POLLNVAL) {
+                fail(EBADF);
+                return;
+            }
+            const ssize_t n =
+                ::read(fd_, block.data() + filled, block.size() - filled);
+            if (n < 0) {
+                if (errno == EINTR || errno == EAGAIN) {
+                    continue;
+                }
+                fail(errno);
+                return;
+            }
+            if (n == 0) {
+                break;
+            }
+            filled += static_cast<std::size_t>(n);
+        }
+        const bool end = filled < block.size();
+        block.resize(filled);
+        if (!block.empty() && !blocks_.push(std::move(block))) {
+            return;
+        }
+        if (end) {
+            blocks_.push({});
+            return;
+        }
+    }
+}
+
+auto read_ahead_t::read(std::span<std::uint8_t> dst) -> std::size_t {
+    std::size_t copied = 0;
+    while (copied < dst.size() && !end_) {
+        if (position_ == current_.size()) {
+            auto block = blocks_.pop();
+            if (!block.has_value()) {
+                // Only a failed read closes the queue while we still read
+                CHECK(error_ != nullptr);
+                std::rethrow_exception(error_);
+            }
+            if (block->empty()) {
+                end_ = true;
+                break;
+            }
+            current_ = std::move(*block);
+            position_ = 0;
+        }
+        const std::size_t n =
+            std::min(dst.size() - copied, current_.size() - position_);
+        std::copy_n(current_.begin() + static_cast<std::ptrdiff_t>(position_),
+                    n, dst.begin() + static_cast<std::ptrdiff_t>(copied));
+        position_ += n;
+        copied += n;
+    }
+    return copied;
+}
+
+} // namespace net_zelcon::plain_sight
\ No newline at end of file
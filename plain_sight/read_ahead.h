@@ -0,0 +1,56 @@
+#ifndef _INCLUDE_NET_ZELCON_PLAIN_SIGHT_READ_AHEAD_H_
+#define _INCLUDE_NET_ZELCON_PLAIN_SIGHT_READ_AHEAD_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "plain_sight/bounded_queue.h"
+
+namespace net_zelcon::plain_sight {
+
+/// @brief Reads a file descriptor, e.g., stdin or a pipe, on a thread of its
+/// own, up to `depth` blocks of `block_size` bytes ahead of the consumer, so
+/// that a slow producer at the other end of a pipe and the consumer work at
+/// the same time. The descriptor is not closed.
+class read_ahead_t {
+  public:
+    /// @throws std::runtime_error if the thread's wake-up pipe cannot be
+    /// created
+    explicit read_ahead_t(int fd, std::size_t block_size = 1 << 20,
+                          std::size_t depth = 4);
+    /// @brief Stops the thread, even if it is waiting for input.
+    ~read_ahead_t() noexcept;
+
+    read_ahead_t(const read_ahead_t &) = delete;
+    read_ahead_t &operator=(const read_ahead_t &) = delete;
+
+    /// @brief Fills `dst`, blocking until enough input has been read.
+    /// @return Number of bytes copied: less than `dst.size()` only at the end
+    /// of the input, and zero past it
+    /// @throws std::runtime_error if reading the descriptor failed
+    auto read(std::span<std::uint8_t> dst) -> std::size_t;
+
+  private:
+    void run();
+
+    int fd_;
+    std::size_t block_size_;
+    // Written to by the destructor to wake a thread blocked on `fd_`
+    int stop_pipe_[2] = {-1, -1};
+    // Empty blocks mark the end of the input; a failed read closes the queue
+    // after setting `error_`.
+    bounded_queue_t<std::vector<std::uint8_t>> blocks_;
+    std::exception_ptr error_;
+    std::vector<std::uint8_t> current_;
+    std::size_t position_ = 0;
+    bool end_ = false;
+    std::thread thread_;
+};
+
+} // namespace net_zelcon::plain_sight
+
+#endif // _INCLUDE_NET_ZELCON_PLAIN_SIGHT_READ_AHEAD_H_
\ No newline at end of file
@@ -0,0 +1,73 @@
+#include <gtest/gtest.h>
+
+#include "plain_sight/read_ahead.h"
+
+#include <cstdint>
+#include <numeric>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace net_zelcon::plain_sight;
+
+TEST(ReadAheadTest, ReadsPipeToTheEnd) {
+    int fds[2];
+    ASSERT_EQ(::pipe(fds), 0);
+    std::vector<std::uint8_t> src(100000);
+    std::iota(src.begin(), src.end(), 0);
+    std::thread writer{[&] {
+        // Uneven writes, so that blocks and reads straddle them
+        std::span<const std::uint8_t> rest{src};
+        while (!rest.empty()) {
+            const std::size_t size = std::min<std::size_t>(rest.size(), 777);
+            ASSERT_EQ(::write(fds[1], rest.data(), size),
+                      static_cast<ssize_t>(size));
+            rest = rest.subspan(size);
+        }
+        ::close(fds[1]);
+    }};
+    std::vector<std::uint8_t> dst;
+    {
+        read_ahead_t input{fds[0], 4096, 2};
+        std::vector<std::uint8_t> buffer(1000);
+        for (;;) {
+            const std::size_t size = input.read(buffer);
+            dst.insert(dst.end(), buffer.begin(),
+                       buffer.begin() + static_cast<std::ptrdiff_t>(size));
+            if (size < buffer.size()) {
+                break;
+            }
+        }
+        EXPECT_EQ(input.read(buffer), 0U);
+    }
+    writer.join();
+    ::close(fds[0]);
+    EXPECT_EQ(dst, src);
+}
+
+TEST(ReadAheadTest, StopsWhileWaitingForInput) {
+    int fds[2];
+    ASSERT_EQ(::pipe(fds), 0);
+    {
+        // Nothing is ever written; the destructor must not hang.
+        read_ahead_t input{fds[0]};
+    }
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+TEST(ReadAheadTest, ReadError) {
+    // Reading a directory fails with `EISDIR`.
+    const int fd = ::open("/", O_RDONLY);
+    ASSERT_GE(fd, 0);
+    {
+        read_ahead_t input{fd};
+        std::vector<std::uint8_t> buffer(16);
+        EXPECT_THROW(input.read(buffer), std::runtime_error);
+    }
+    ::close(fd);
+}
\ No newline at end of file
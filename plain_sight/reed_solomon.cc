@@ -0,0 +1,264 @@
+#include "plain_sight/reed_solomon.h"
+
+#include <algorithm>
+#include <array>
+#include <glog/logging.h>
+
+namespace net_zelcon::plain_sight {
+
+namespace {
+
+/// @brief Exponential and logarithm tables of GF(256). `exp` is doubled so
+/// that the sum of two logarithms indexes it without a modulo.
+struct gf256_tables_t {
+    std::array<std::uint8_t, 512> exp{};
+    std::array<std::uint8_t, 256> log{};
+
+    constexpr gf256_tables_t() {
+        unsigned x = 1;
+        for (unsigned i = 0; i < 255; ++i) {
+            exp[i] = static_cast<std::uint8_t>(x);
+            log[x] = static_cast<std::uint8_t>(i);
+            x <<= 1;
+            if (x & 0x100) {
+                x ^= 0x11d;
+            }
+        }
+        for (unsigned i = 255; i < exp.size(); ++i) {
+            exp[i] = exp[i - 255];
+        }
+    }
+};
+
+constexpr gf256_tables_t gf{};
+
+constexpr auto mul(const std::uint8_t a, const std::uint8_t b)
+    -> std::uint8_t {
+    return a == 0 || b == 0 ? 0 : gf.exp[gf.log[a] + gf.log[b]];
+}
+
+constexpr auto div(const std::uint8_t a, const std::uint8_t b)
+    -> std::uint8_t {
+    return a == 0 ? 0 : gf.exp[gf.log[a] + 255 - gf.log[b]];
+}
+
+/// @brief α^power, for any non-negative `power`.
+constexpr auto pow_alpha(const std::size_t power) -> std::uint8_t {
+    return gf.exp[power % 255];
+}
+
+/// @brief Evaluates `poly`, lowest degree first, at `x`.
+auto evaluate_low_first(std::span<const std::uint8_t> poly,
+                        const std::uint8_t x) -> std::uint8_t {
+    std::uint8_t y = 0;
+    for (auto it = poly.rbegin(); it != poly.rend(); ++it) {
+        y = mul(y, x) ^ *it;
+    }
+    return y;
+}
+
+/// @brief Syndromes S_j = c(α^j) of `codeword`, whose byte i is the
+/// coefficient of x^(n - 1 - i).
+/// @return Whether they are all zero, i.e., the codeword is intact
+auto compute_syndromes(std::span<const std::uint8_t> codeword,
+                       std::span<std::uint8_t> syndromes) -> bool {
+    bool clean = true;
+    for (std::size_t j = 0; j < syndromes.size(); ++j) {
+        const std::uint8_t x = pow_alpha(j);
+        std::uint8_t s = 0;
+        for (const std::uint8_t byte : codeword) {
+            s = mul(s, x) ^ byte;
+        }
+        syndromes[j] = s;
+        clean = clean && s == 0;
+    }
+    return clean;
+}
+
+/// @brief Error evaluator Ω(x) = S(x)Λ(x) mod x^(number of syndromes).
+auto error_evaluator(std::span<const std::uint8_t> locator,
+                     std::span<const std::uint8_t> s)
+    -> std::vector<std::uint8_t> {
+    std::vector<std::uint8_t> evaluator(s.size(), 0);
+    for (std::size_t i = 0; i < s.size(); ++i) {
+        for (std::size_t k = 0; k < locator.size() && k <= i; ++k) {
+            evaluator[i] ^= mul(locator[k], s[i - k]);
+        }
+    }
+    return evaluator;
+}
+
+/// @brief Formal derivative Λ'(x): only the odd terms survive in GF(2^8).
+auto formal_derivative(std::span<const std::uint8_t> locator)
+    -> std::vector<std::uint8_t> {
+    std::vector<std::uint8_t> derivative(locator.size() - 1, 0);
+    for (std::size_t k = 1; k < locator.size(); k += 2) {
+        derivative[k - 1] = locator[k];
+    }
+    return derivative;
+}
+
+} // namespace
+
+reed_solomon_t::reed_solomon_t(const std::size_t parity_size) {
+    CHECK_GE(parity_size, 1U);
+    CHECK_LE(parity_size, 254U);
+    // g(x) = (x - α^0)(x - α^1)…(x - α^(parity_size - 1))
+    generator_ = {1};
+    for (std::size_t i = 0; i < parity_size; ++i) {
+        const std::uint8_t root = pow_alpha(i);
+        generator_.push_back(0);
+        for (std::size_t j = generator_.size() - 1; j > 0; --j) {
+            generator_[j] ^= mul(generator_[j - 1], root);
+        }
+    }
+}
+
+void reed_solomon_t::encode(std::span<const std::uint8_t> data,
+                            std::span<std::uint8_t> parity) const {
+    CHECK_EQ(parity.size(), parity_size());
+    CHECK_LE(data.size() + parity.size(), 255U);
+    // Remainder of data(x)·x^parity_size divided by g(x), as an LFSR
+    std::fill(parity.begin(), parity.end(), 0);
+    for (const std::uint8_t byte : data) {
+        const std::uint8_t factor = byte ^ parity[0];
+        std::copy(parity.begin() + 1, parity.end(), parity.begin());
+        parity.back() = 0;
+        if (factor == 0) {
+            continue;
+        }
+        for (std::size_t i = 0; i < parity.size(); ++i) {
+            parity[i] ^= mul(generator_[i + 1], factor);
+        }
+    }
+}
+
+auto reed_solomon_t::decode(std::span<std::uint8_t> codeword) const
+    -> std::optional<std::size_t> {
+    const std::size_t n = codeword.size();
+    const std::size_t num_syndromes = parity_size();
+    CHECK_GT(n, num_syndromes);
+    CHECK_LE(n, 255U);
+    std::array<std::uint8_t, 255> syndromes{};
+    if (compute_syndromes(codeword, {syndromes.data(), num_syndromes})) {
+        return 0;
+    }
+    const std::span<const std::uint8_t> s{syndromes.data(), num_syndromes};
+
+    // Berlekamp-Massey: error locator Λ(x), lowest degree first
+    std::vector<std::uint8_t> locator{1}, previous{1};
+    std::size_t num_errors = 0, shift = 1;
+    std::uint8_t previous_discrepancy = 1;
+    for (std::size_t i = 0; i < num_syndromes; ++i) {
+        std::uint8_t discrepancy = s[i];
+        for (std::size_t k = 1; k <= num_errors && k < locator.size(); ++k) {
+            discrepancy ^= mul(locator[k], s[i - k]);
+        }
+        if (discrepancy == 0) {
+            ++shift;
+            continue;
+        }
+        const std::uint8_t scale = div(discrepancy, previous_discrepancy);
+        auto updated = locator;
+        updated.resize(std::max(locator.size(), previous.size() + shift), 0);
+        for (std::size_t k = 0; k < previous.size(); ++k) {
+            updated[k + shift] ^= mul(scale, previous[k]);
+        }
+        if (2 * num_errors <= i) {
+            previous = std::move(locator);
+            num_errors = i + 1 - num_errors;
+            previous_discrepancy = discrepancy;
+            shift = 1;
+        } else {
+            ++shift;
+        }
+        locator = std::move(updated);
+    }
+    while (locator.size() > 1 && locator.back() == 0) {
+        locator.pop_back();
+    }
+    if (num_errors * 2 > num_syndromes || locator.size() != num_errors + 1) {
+        return std::nullopt;
+    }
+
+    const auto evaluator = error_evaluator(locator, s);
+    const auto derivative = formal_derivative(locator);
+
+    // Chien search for the roots X^-1 of Λ, then Forney's formula for the
+    // error values, e = X·Ω(X^-1)/Λ'(X^-1).
+    std::vector<std::pair<std::size_t, std::uint8_t>> corrections;
+    for (std::size_t i = 0; i < n; ++i) {
+        const std::size_t power = n - 1 - i;
+        const std::uint8_t x_inverse = pow_alpha(255 - power % 255);
+        if (evaluate_low_first(locator, x_inverse) != 0) {
+            continue;
+        }
+        const std::uint8_t denominator =
+            evaluate_low_first(derivative, x_inverse);
+        if (denominator == 0) {
+            return std::nullopt;
+        }
+        corrections.emplace_back(
+            i, mul(pow_alpha(power),
+                   div(evaluate_low_first(evaluator, x_inverse),
+                       denominator)));
+    }
+    if (corrections.size() != num_errors) {
+        return std::nullopt; // roots outside of the (shortened) codeword
+    }
+    for (const auto &[i, error] : corrections) {
+        codeword[i] ^= error;
+    }
+    return corrections.size();
+}
+
+auto reed_solomon_t::decode_erasures(
+    std::span<std::uint8_t> codeword,
+    std::span<const std::size_t> erasures) const -> bool {
+    const std::size_t n = codeword.size();
+    const std::size_t num_syndromes = parity_size();
+    CHECK_GT(n, num_syndromes);
+    CHECK_LE(n, 255U);
+    if (erasures.size() > num_syndromes) {
+        return false;
+    }
+    if (erasures.empty()) {
+        return true;
+    }
+    // Erased bytes count as zero, so that the syndromes are those of the
+    // error that zeroing them made.
+    for (const std::size_t i : erasures) {
+        CHECK_LT(i, n);
+        codeword[i] = 0;
+    }
+    std::array<std::uint8_t, 255> syndromes{};
+    compute_syndromes(codeword, {syndromes.data(), num_syndromes});
+    const std::span<const std::uint8_t> s{syndromes.data(), num_syndromes};
+
+    // The erasures are known, so the locator Λ(x) = Π(1 - X·x) needs no
+    // search; Forney's formula gives the values as in `decode()`.
+    std::vector<std::uint8_t> locator{1};
+    for (const std::size_t i : erasures) {
+        const std::uint8_t x = pow_alpha(n - 1 - i);
+        locator.push_back(0);
+        for (std::size_t k = locator.size() - 1; k > 0; --k) {
+            locator[k] ^= mul(locator[k - 1], x);
+        }
+    }
+    const auto evaluator = error_evaluator(locator, s);
+    const auto derivative = formal_derivative(locator);
+    for (const std::size_t i : erasures) {
+        const std::size_t power = n - 1 - i;
+        const std::uint8_t x_inverse = pow_alpha(255 - power % 255);
+        // Not zero, as the roots of Λ are distinct
+        const std::uint8_t denominator =
+            evaluate_low_first(derivative, x_inverse);
+        DCHECK_NE(denominator, 0);
+        codeword[i] =
+            mul(pow_alpha(power), div(evaluate_low_first(evaluator, x_inverse),
+                                      denominator));
+    }
+    return true;
+}
+
+} // namespace net_zelcon::plain_sight
\ No newline at end of file
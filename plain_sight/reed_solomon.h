@@ -0,0 +1,56 @@
+#ifndef _INCLUDE_NET_ZELCON_PLAIN_SIGHT_REED_SOLOMON_H_
+#define _INCLUDE_NET_ZELCON_PLAIN_SIGHT_REED_SOLOMON_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace net_zelcon::plain_sight {
+
+/// @brief Systematic Reed-Solomon code over GF(256), with the field
+/// polynomial x^8 + x^4 + x^3 + x^2 + 1 (0x11d) and generator roots
+/// α^0 … α^(parity_size - 1), the same field QR codes use.
+/// @details A codeword is up to 255 bytes: the data followed by
+/// `parity_size()` parity bytes. Shorter codewords are shortened codes, so
+/// any data length up to `255 - parity_size()` works with one instance. Up to
+/// `parity_size() / 2` corrupted bytes anywhere in a codeword are corrected.
+/// Instances are immutable and safe to share between threads.
+class reed_solomon_t {
+  public:
+    /// @param parity_size Parity bytes per codeword, 1 to 254
+    explicit reed_solomon_t(std::size_t parity_size);
+
+    [[nodiscard]] auto parity_size() const noexcept -> std::size_t {
+        return generator_.size() - 1;
+    }
+
+    /// @brief Computes the parity of `data` into `parity`, which must hold
+    /// exactly `parity_size()` bytes.
+    void encode(std::span<const std::uint8_t> data,
+                std::span<std::uint8_t> parity) const;
+
+    /// @brief Corrects `codeword`, data followed by parity, in place.
+    /// @return Number of bytes corrected, or `std::nullopt` if the codeword
+    /// has more errors than the code can correct; it is then left as is.
+    auto decode(std::span<std::uint8_t> codeword) const
+        -> std::optional<std::size_t>;
+
+    /// @brief Rebuilds the bytes of `codeword` at the distinct indices
+    /// `erasures`, which are known to be lost, whatever they hold. Up to
+    /// `parity_size()` erasures are rebuilt; the other bytes must be intact.
+    /// @return false if there are more erasures than parity bytes; the
+    /// codeword is then left as is.
+    auto decode_erasures(std::span<std::uint8_t> codeword,
+                         std::span<const std::size_t> erasures) const -> bool;
+
+  private:
+    // Generator polynomial, highest degree first; monic, so `generator_[0]`
+    // is 1.
+    std::vector<std::uint8_t> generator_;
+};
+
+} // namespace net_zelcon::plain_sight
+
+#endif // _INCLUDE_NET_ZELCON_PLAIN_SIGHT_REED_SOLOMON_H_
\ No newline at end of file
@@ -0,0 +1,187 @@
+#include "plain_sight/stats.h"
+
+#include <algorithm>
+#include <bit>
+#include <fmt/core.h>
+#include <glog/logging.h>
+#include <iterator>
+
+namespace net_zelcon::plain_sight {
+
+namespace {
+
+// Indexed by `stage_t`
+constexpr std::string_view stage_names[] = {
+    "qr_generation", "render",    "codec_send",       "codec_receive",
+    "mux",           "demux",     "pixel_conversion", "qr_identify",
+    "qr_decode",     "qr_sample", "grid_decode",
+};
+static_assert(std::size(stage_names) == stage_count);
+
+auto seconds(const std::chrono::nanoseconds time) -> double {
+    return std::chrono::duration<double>(time).count();
+}
+
+} // namespace
+
+auto stage_name(const stage_t stage) noexcept -> std::string_view {
+    return stage_names[static_cast<std::size_t>(stage)];
+}
+
+void latency_histogram_t::record(
+    const std::chrono::nanoseconds latency) noexcept {
+    const auto micros = static_cast<std::uint64_t>(std::max<std::int64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(latency)
+            .count(),
+        0));
+    // 0 µs goes to bucket 0, [2^(i-1), 2^i) µs to bucket i
+    const std::size_t i = std::min<std::size_t>(
+        static_cast<std::size_t>(std::bit_width(micros)), bucket_count - 1);
+    buckets_[i].fetch_add(1, std::memory_order_relaxed);
+}
+
+auto latency_histogram_t::count() const noexcept -> std::uint64_t {
+    std::uint64_t count = 0;
+    for (const auto &bucket : buckets_) {
+        count += bucket.load(std::memory_order_relaxed);
+    }
+    return count;
+}
+
+auto latency_histogram_t::bucket(const std::size_t i) const noexcept
+    -> std::uint64_t {
+    DCHECK_LT(i, bucket_count);
+    return buckets_[i].load(std::memory_order_relaxed);
+}
+
+auto latency_histogram_t::bucket_limit(const std::size_t i) noexcept
+    -> std::chrono::microseconds {
+    DCHECK_LT(i, bucket_count);
+    return std::chrono::microseconds{std::int64_t{1} << i};
+}
+
+auto latency_histogram_t::quantile(const double fraction) const noexcept
+    -> std::chrono::microseconds {
+    const std::uint64_t total = count();
+    if (total == 0) {
+        return std::chrono::microseconds{0};
+    }
+    // Rank of the quantile, counting from one
+    const auto rank = std::max<std::uint64_t>(
+        1, static_cast<std::uint64_t>(fraction * static_cast<double>(total) +
+                                      0.5));
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < bucket_count; ++i) {
+        seen += bucket(i);
+        if (seen >= rank) {
+            return bucket_limit(i);
+        }
+    }
+    return bucket_limit(bucket_count - 1);
+}
+
+void latency_histogram_t::reset() noexcept {
+    for (auto &bucket : buckets_) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+auto stats_t::time(const stage_t stage) const noexcept
+    -> std::chrono::nanoseconds {
+    return std::chrono::nanoseconds{
+        stage_nanoseconds_[static_cast<std::size_t>(stage)].load(
+            std::memory_order_relaxed)};
+}
+
+auto stats_t::elapsed() const noexcept -> std::chrono::nanoseconds {
+    return std::chrono::nanoseconds{
+        elapsed_nanoseconds_.load(std::memory_order_relaxed)};
+}
+
+void stats_t::add_frames(const std::uint64_t frames) noexcept {
+    frames_.fetch_add(frames, std::memory_order_relaxed);
+}
+
+void stats_t::add_payload_bytes(const std::uint64_t bytes) noexcept {
+    payload_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void stats_t::add_video_bytes(const std::uint64_t bytes) noexcept {
+    video_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void stats_t::add_decode_failures(const std::uint64_t failures) noexcept {
+    decode_failures_.fetch_add(failures, std::memory_order_relaxed);
+}
+
+void stats_t::add_recovered_chunks(const std::uint64_t chunks) noexcept {
+    recovered_chunks_.fetch_add(chunks, std::memory_order_relaxed);
+}
+
+void stats_t::add_duplicate_chunks(const std::uint64_t chunks) noexcept {
+    duplicate_chunks_.fetch_add(chunks, std::memory_order_relaxed);
+}
+
+void stats_t::add_time(const stage_t stage,
+                       const std::chrono::nanoseconds time) noexcept {
+    stage_nanoseconds_[static_cast<std::size_t>(stage)].fetch_add(
+        time.count(), std::memory_order_relaxed);
+}
+
+void stats_t::add_elapsed(const std::chrono::nanoseconds time) noexcept {
+    elapsed_nanoseconds_.fetch_add(time.count(), std::memory_order_relaxed);
+}
+
+void stats_t::record_frame_latency(
+    const std::chrono::nanoseconds latency) noexcept {
+    frame_latency_.record(latency);
+}
+
+void stats_t::reset() noexcept {
+    frames_.store(0, std::memory_order_relaxed);
+    payload_bytes_.store(0, std::memory_order_relaxed);
+    video_bytes_.store(0, std::memory_order_relaxed);
+    decode_failures_.store(0, std::memory_order_relaxed);
+    recovered_chunks_.store(0, std::memory_order_relaxed);
+    duplicate_chunks_.store(0, std::memory_order_relaxed);
+    for (auto &time : stage_nanoseconds_) {
+        time.store(0, std::memory_order_relaxed);
+    }
+    elapsed_nanoseconds_.store(0, std::memory_order_relaxed);
+    frame_latency_.reset();
+}
+
+auto stats_t::summary() const -> std::string {
+    const double elapsed_seconds = seconds(elapsed());
+    const auto per_second = [&](const std::uint64_t count) {
+        return elapsed_seconds > 0
+                   ? static_cast<double>(count) / elapsed_seconds
+                   : 0.0;
+    };
+    std::string summary = fmt::format(
+        "{} frames, {} payload bytes, {} video bytes in {:.3f} s "
+        "({:.1f} frames/s, {:.1f} payload KiB/s)\n"
+        "{} decode failures, {} chunks rebuilt from parity, {} duplicate "
+        "chunks\n",
+        frames(), payload_bytes(), video_bytes(), elapsed_seconds,
+        per_second(frames()), per_second(payload_bytes()) / 1024,
+        decode_failures(), recovered_chunks(), duplicate_chunks());
+    for (std::size_t i = 0; i < stage_count; ++i) {
+        const auto stage = static_cast<stage_t>(i);
+        if (time(stage).count() == 0) {
+            continue;
+        }
+        summary += fmt::format("{:>16}: {:.3f} s\n", stage_name(stage),
+                               seconds(time(stage)));
+    }
+    if (frame_latency_.count() > 0) {
+        summary += fmt::format(
+            "frame latency p50 < {} µs, p90 < {} µs, p99 < {} µs\n",
+            frame_latency_.quantile(0.5).count(),
+            frame_latency_.quantile(0.9).count(),
+            frame_latency_.quantile(0.99).count());
+    }
+    return summary;
+}
+
+} // namespace net_zelcon::plain_sight
\ No newline at end of file
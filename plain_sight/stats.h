@@ -0,0 +1,183 @@
+#ifndef _INCLUDE_NET_ZELCON_PLAIN_SIGHT_STATS_H_
+#define _INCLUDE_NET_ZELCON_PLAIN_SIGHT_STATS_H_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace net_zelcon::plain_sight {
+
+/// @brief Stages of the encoder and decoder pipelines whose time is
+/// accounted for in `stats_t`.
+enum class stage_t : std::size_t {
+    /// @brief Encoder: waiting for the QR code source's next QR codes
+    qr_generation,
+    /// @brief Encoder: drawing QR codes or grids into frames
+    render,
+    /// @brief Both: `avcodec_send_frame()` or `avcodec_send_packet()`
+    codec_send,
+    /// @brief Both: `avcodec_receive_packet()` or `avcodec_receive_frame()`
+    codec_receive,
+    /// @brief Encoder: writing the header, packets and trailer
+    mux,
+    /// @brief Decoder: `av_read_frame()`
+    demux,
+    /// @brief Decoder: reading the luma, or a plane, of decoded frames
+    pixel_conversion,
+    /// @brief Decoder: quirc's search for QR codes
+    qr_identify,
+    /// @brief Decoder: extracting and decoding the QR codes quirc found
+    qr_decode,
+    /// @brief Decoder: sampling and decoding QR codes of a known geometry
+    qr_sample,
+    /// @brief Decoder: sampling and correcting grid symbology frames
+    grid_decode,
+};
+
+constexpr std::size_t stage_count =
+    static_cast<std::size_t>(stage_t::grid_decode) + 1;
+
+/// @brief Short name of `stage`, e.g. "codec_send".
+auto stage_name(stage_t stage) noexcept -> std::string_view;
+
+/// @brief Histogram of latencies in power-of-two buckets of microseconds.
+/// Thread-safe and lock-free.
+class latency_histogram_t {
+  public:
+    /// @brief Bucket 0 counts latencies under 1 µs, bucket `i` those from
+    /// 2^(i-1) µs up to 2^i µs; the last bucket also counts everything
+    /// longer.
+    constexpr static std::size_t bucket_count = 32;
+
+    void record(std::chrono::nanoseconds latency) noexcept;
+
+    /// @brief Number of latencies recorded.
+    [[nodiscard]] auto count() const noexcept -> std::uint64_t;
+    [[nodiscard]] auto bucket(std::size_t i) const noexcept -> std::uint64_t;
+    /// @brief Exclusive upper bound of the latencies in bucket `i`.
+    [[nodiscard]] static auto bucket_limit(std::size_t i) noexcept
+        -> std::chrono::microseconds;
+    /// @brief Upper bound of the bucket holding the `fraction` quantile,
+    /// e.g., 0.99 for the 99th percentile; zero if nothing was recorded.
+    [[nodiscard]] auto quantile(double fraction) const noexcept
+        -> std::chrono::microseconds;
+
+    void reset() noexcept;
+
+  private:
+    std::array<std::atomic<std::uint64_t>, bucket_count> buckets_{};
+};
+
+/// @brief Counters and timings of `encoder_t::encode()` or
+/// `decoder_t::decode()`, filled in as they run; see
+/// `encoder_t::builder_t::set_stats()`.
+/// @details All members are atomic, so the pipelines' threads update the
+/// same object and callers may read it while they do. Values accumulate
+/// over every call sharing the object until `reset()`. Stage times are
+/// summed over threads, so with parallel stages they can add up to more than
+/// `elapsed()`.
+class stats_t {
+  public:
+    stats_t() noexcept = default;
+    stats_t(const stats_t &) = delete;
+    stats_t &operator=(const stats_t &) = delete;
+
+    /// @brief Video frames that went through the libav codec.
+    [[nodiscard]] auto frames() const noexcept -> std::uint64_t {
+        return frames_.load(std::memory_order_relaxed);
+    }
+    /// @brief Payload bytes encoded or decoded.
+    [[nodiscard]] auto payload_bytes() const noexcept -> std::uint64_t {
+        return payload_bytes_.load(std::memory_order_relaxed);
+    }
+    /// @brief Bytes of encoded video packets: muxed by the encoder, demuxed
+    /// by the decoder. Container overhead is not included.
+    [[nodiscard]] auto video_bytes() const noexcept -> std::uint64_t {
+        return video_bytes_.load(std::memory_order_relaxed);
+    }
+    /// @brief QR codes that were found in a frame but failed to decode, and
+    /// tiles of framed payloads where none was found.
+    [[nodiscard]] auto decode_failures() const noexcept -> std::uint64_t {
+        return decode_failures_.load(std::memory_order_relaxed);
+    }
+    /// @brief Lost chunks the decoder rebuilt from parity chunks.
+    [[nodiscard]] auto recovered_chunks() const noexcept -> std::uint64_t {
+        return recovered_chunks_.load(std::memory_order_relaxed);
+    }
+    /// @brief Chunks the decoder received more than once and dropped.
+    [[nodiscard]] auto duplicate_chunks() const noexcept -> std::uint64_t {
+        return duplicate_chunks_.load(std::memory_order_relaxed);
+    }
+    /// @brief Time spent in `stage`, summed over threads.
+    [[nodiscard]] auto time(stage_t stage) const noexcept
+        -> std::chrono::nanoseconds;
+    /// @brief Wall time of the `encode()` or `decode()` calls.
+    [[nodiscard]] auto elapsed() const noexcept -> std::chrono::nanoseconds;
+    /// @brief Per frame, the time from the start of its rendering until the
+    /// codec took it (encoder), or from the codec handing it over until its
+    /// payload was decoded (decoder).
+    [[nodiscard]] auto frame_latency() const noexcept
+        -> const latency_histogram_t & {
+        return frame_latency_;
+    }
+
+    void add_frames(std::uint64_t frames) noexcept;
+    void add_payload_bytes(std::uint64_t bytes) noexcept;
+    void add_video_bytes(std::uint64_t bytes) noexcept;
+    void add_decode_failures(std::uint64_t failures) noexcept;
+    void add_recovered_chunks(std::uint64_t chunks) noexcept;
+    void add_duplicate_chunks(std::uint64_t chunks) noexcept;
+    void add_time(stage_t stage, std::chrono::nanoseconds time) noexcept;
+    void add_elapsed(std::chrono::nanoseconds time) noexcept;
+    void record_frame_latency(std::chrono::nanoseconds latency) noexcept;
+
+    void reset() noexcept;
+
+    /// @brief Multi-line, human-readable report of every value, with
+    /// throughputs.
+    [[nodiscard]] auto summary() const -> std::string;
+
+  private:
+    std::atomic<std::uint64_t> frames_{0};
+    std::atomic<std::uint64_t> payload_bytes_{0};
+    std::atomic<std::uint64_t> video_bytes_{0};
+    std::atomic<std::uint64_t> decode_failures_{0};
+    std::atomic<std::uint64_t> recovered_chunks_{0};
+    std::atomic<std::uint64_t> duplicate_chunks_{0};
+    std::array<std::atomic<std::int64_t>, stage_count> stage_nanoseconds_{};
+    std::atomic<std::int64_t> elapsed_nanoseconds_{0};
+    latency_histogram_t frame_latency_;
+};
+
+/// @brief Adds the time from construction to destruction to a stage of
+/// `stats`. Does nothing, without reading the clock, if `stats` is null.
+class stage_timer_t {
+  public:
+    stage_timer_t(stats_t *stats, stage_t stage) noexcept
+        : stats_{stats}, stage_{stage} {
+        if (stats_ != nullptr) {
+            start_ = std::chrono::steady_clock::now();
+        }
+    }
+    ~stage_timer_t() noexcept {
+        if (stats_ != nullptr) {
+            stats_->add_time(stage_, std::chrono::steady_clock::now() - start_);
+        }
+    }
+
+    stage_timer_t(const stage_timer_t &) = delete;
+    stage_timer_t &operator=(const stage_timer_t &) = delete;
+
+  private:
+    stats_t *stats_;
+    stage_t stage_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+} // namespace net_zelcon::plain_sight
+
+#endif // _INCLUDE_NET_ZELCON_PLAIN_SIGHT_STATS_H_
\ No newline at end of file
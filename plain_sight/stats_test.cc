@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+
+#include "plain_sight/stats.h"
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace net_zelcon::plain_sight;
+using namespace std::chrono_literals;
+
+TEST(LatencyHistogramTest, BucketsArePowersOfTwoMicroseconds) {
+    latency_histogram_t histogram;
+    histogram.record(500ns);
+    histogram.record(1us);
+    histogram.record(3us);
+    histogram.record(4us);
+    histogram.record(1000us);
+    histogram.record(24h);
+    EXPECT_EQ(histogram.count(), 6U);
+    EXPECT_EQ(histogram.bucket(0), 1U);
+    EXPECT_EQ(histogram.bucket(1), 1U);
+    EXPECT_EQ(histogram.bucket(2), 1U);
+    EXPECT_EQ(histogram.bucket(3), 1U);
+    // 512 µs <= 1000 µs < 1024 µs
+    EXPECT_EQ(histogram.bucket(10), 1U);
+    EXPECT_EQ(histogram.bucket(latency_histogram_t::bucket_count - 1), 1U);
+    EXPECT_EQ(latency_histogram_t::bucket_limit(0), 1us);
+    EXPECT_EQ(latency_histogram_t::bucket_limit(10), 1024us);
+}
+
+TEST(LatencyHistogramTest, Quantiles) {
+    latency_histogram_t histogram;
+    EXPECT_EQ(histogram.quantile(0.5), 0us);
+    for (int i = 0; i < 90; ++i) {
+        histogram.record(100us);
+    }
+    for (int i = 0; i < 10; ++i) {
+        histogram.record(10ms);
+    }
+    EXPECT_EQ(histogram.quantile(0.5), 128us);
+    EXPECT_EQ(histogram.quantile(0.9), 128us);
+    EXPECT_EQ(histogram.quantile(0.99), 16384us);
+    EXPECT_EQ(histogram.quantile(0), 128us);
+    EXPECT_EQ(histogram.quantile(1), 16384us);
+    histogram.reset();
+    EXPECT_EQ(histogram.count(), 0U);
+}
+
+TEST(StatsTest, AccumulatesAcrossThreadsUntilReset) {
+    stats_t stats;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&] {
+            for (int j = 0; j < 1000; ++j) {
+                stats.add_frames(1);
+                stats.add_payload_bytes(10);
+                stats.add_time(stage_t::render, 1us);
+                stats.record_frame_latency(5us);
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(stats.frames(), 4000U);
+    EXPECT_EQ(stats.payload_bytes(), 40000U);
+    EXPECT_EQ(stats.time(stage_t::render), 4ms);
+    EXPECT_EQ(stats.time(stage_t::mux), 0ns);
+    EXPECT_EQ(stats.frame_latency().count(), 4000U);
+    stats.reset();
+    EXPECT_EQ(stats.frames(), 0U);
+    EXPECT_EQ(stats.payload_bytes(), 0U);
+    EXPECT_EQ(stats.time(stage_t::render), 0ns);
+    EXPECT_EQ(stats.frame_latency().count(), 0U);
+}
+
+TEST(StatsTest, StageTimer) {
+    stats_t stats;
+    {
+        const stage_timer_t timer{&stats, stage_t::qr_identify};
+        std::this_thread::sleep_for(2ms);
+    }
+    EXPECT_GE(stats.time(stage_t::qr_identify), 2ms);
+    // Without stats, nothing to do
+    const stage_timer_t timer{nullptr, stage_t::qr_identify};
+}
+
+TEST(StatsTest, SummaryListsStagesWithTime) {
+    stats_t stats;
+    stats.add_frames(30);
+    stats.add_payload_bytes(3072);
+    stats.add_elapsed(1s);
+    stats.add_time(stage_t::codec_send, 250ms);
+    stats.record_frame_latency(100us);
+    const std::string summary = stats.summary();
+    EXPECT_NE(summary.find("30 frames"), std::string::npos) << summary;
+    EXPECT_NE(summary.find("30.0 frames/s"), std::string::npos) << summary;
+    EXPECT_NE(summary.find("3.0 payload KiB/s"), std::string::npos) << summary;
+    EXPECT_NE(summary.find("codec_send: 0.250 s"), std::string::npos)
+        << summary;
+    EXPECT_EQ(summary.find("render"), std::string::npos) << summary;
+    EXPECT_NE(summary.find("p50 < 128 µs"), std::string::npos) << summary;
+}
\ No newline at end of file
@@ -0,0 +1,52 @@
+#include "plain_sight/thread_pool.h"
+
+#include <algorithm>
+#include <glog/logging.h>
+
+namespace net_zelcon::plain_sight {
+
+thread_pool_t::thread_pool_t(std::size_t num_threads) {
+    if (num_threads == 0) {
+        num_threads = std::max(1U, std::thread::hardware_concurrency());
+    }
+    workers_.reserve(num_threads);
+    for (std::size_t i = 0; i < num_threads; ++i) {
+        workers_.emplace_back(&thread_pool_t::run, this);
+    }
+}
+
+thread_pool_t::~thread_pool_t() noexcept {
+    {
+        std::lock_guard lock{mutex_};
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    for (auto &worker : workers_) {
+        worker.join();
+    }
+}
+
+auto thread_pool_t::size() const noexcept -> std::size_t {
+    return workers_.size();
+}
+
+void thread_pool_t::run() noexcept {
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock lock{mutex_};
+            cv_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+            if (tasks_.empty()) {
+                DCHECK(stopping_);
+                return;
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop();
+        }
+        // Exceptions are captured by the `std::packaged_task` wrapper and
+        // surface through the future returned by `submit()`.
+        task();
+    }
+}
+
+} // namespace net_zelcon::plain_sight
\ No newline at end of file
@@ -0,0 +1,61 @@
+#ifndef _INCLUDE_NET_ZELCON_PLAIN_SIGHT_THREAD_POOL_H_
+#define _INCLUDE_NET_ZELCON_PLAIN_SIGHT_THREAD_POOL_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace net_zelcon::plain_sight {
+
+/// @brief Fixed-size pool of worker threads executing submitted tasks in FIFO
+/// order.
+class thread_pool_t {
+  public:
+    /// @param num_threads Number of worker threads. Zero means one per
+    /// hardware thread.
+    explicit thread_pool_t(std::size_t num_threads = 0);
+    ~thread_pool_t() noexcept;
+
+    thread_pool_t(const thread_pool_t &) = delete;
+    thread_pool_t &operator=(const thread_pool_t &) = delete;
+    thread_pool_t(thread_pool_t &&) = delete;
+    thread_pool_t &operator=(thread_pool_t &&) = delete;
+
+    /// @brief Queue `fn` for execution on one of the workers.
+    /// @return future holding the result (or exception) of `fn`
+    template <typename Fn>
+    auto submit(Fn &&fn) -> std::future<std::invoke_result_t<Fn>> {
+        using result_t = std::invoke_result_t<Fn>;
+        auto task = std::make_shared<std::packaged_task<result_t()>>(
+            std::forward<Fn>(fn));
+        auto result = task->get_future();
+        {
+            std::lock_guard lock{mutex_};
+            tasks_.emplace([task] { (*task)(); });
+        }
+        cv_.notify_one();
+        return result;
+    }
+
+    [[nodiscard]] auto size() const noexcept -> std::size_t;
+
+  private:
+    void run() noexcept;
+
+    std::vector<std::thread> workers_;
+    std::queue<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stopping_ = false;
+};
+
+} // namespace net_zelcon::plain_sight
+
+#endif // _INCLUDE_NET_ZELCON_PLAIN_SIGHT_THREAD_POOL_H_
\ No newline at end of file
@@ -1,26 +1,37 @@
 #include "plain_sight/util.h"
 
+#include <climits>
+#include <fmt/core.h>
 #include <fstream>
-#include <iterator>
 #include <sstream>
+#include <stdexcept>
 
 extern "C" {
 #include <libavutil/error.h>
+#include <libavutil/pixdesc.h>
 }
 
 namespace net_zelcon::plain_sight {
 void read_file(std::vector<std::uint8_t> &dst, std::filesystem::path path) {
     std::ifstream file(path, std::ios::binary);
-    file.unsetf(std::ios::skipws); // No white space skipping!
-    // find file size
-    std::streampos file_size;
-    file.seekg(0, std::ios::end);
-    file_size = file.tellg();
-    file.seekg(0, std::ios::beg);
-    // reserve capacity
-    dst.reserve(file_size);
-    dst.insert(dst.begin(), std::istream_iterator<std::uint8_t>(file),
-               std::istream_iterator<std::uint8_t>());
+    if (!file) {
+        LOG(ERROR) << "Could not open " << path;
+        throw std::runtime_error{
+            fmt::format("Could not open {}", path.string())};
+    }
+    // One bulk read straight into place, instead of a stream iterator that
+    // pushes byte by byte.
+    const auto size = std::filesystem::file_size(path);
+    dst.resize(size);
+    file.read(reinterpret_cast<char *>(dst.data()),
+              static_cast<std::streamsize>(size));
+    if (static_cast<std::uintmax_t>(file.gcount()) != size) {
+        LOG(ERROR) << "Read " << file.gcount() << " of " << size
+                   << " bytes of " << path;
+        throw std::runtime_error{fmt::format("Read {} of {} bytes of {}",
+                                             file.gcount(), size,
+                                             path.string())};
+    }
 }
 
 void read_file(std::string &dst, const std::filesystem::path &path) {
@@ -40,4 +51,52 @@ std::string libav_error(int error) {
     return output;
 }
 
+auto multiplexable_planes(const AVPixelFormat pixel_format) -> int {
+    const AVPixFmtDescriptor *const desc = av_pix_fmt_desc_get(pixel_format);
+    if (desc == nullptr || (desc->flags & AV_PIX_FMT_FLAG_PLANAR) == 0 ||
+        (desc->flags & (AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_BITSTREAM |
+                        AV_PIX_FMT_FLAG_HWACCEL)) != 0 ||
+        desc->log2_chroma_w != 0 || desc->log2_chroma_h != 0) {
+        return 0;
+    }
+    // Alpha, if any, is the last component.
+    const int color_components =
+        desc->nb_components - ((desc->flags & AV_PIX_FMT_FLAG_ALPHA) ? 1 : 0);
+    if (color_components < 2) {
+        return 0;
+    }
+    for (int i = 0; i < color_components; ++i) {
+        const AVComponentDescriptor &comp = desc->comp[i];
+        if (comp.depth != 8 || comp.step != 1 || comp.shift != 0 ||
+            comp.offset != 0 || comp.plane >= color_components) {
+            return 0;
+        }
+        for (int j = 0; j < i; ++j) {
+            if (desc->comp[j].plane == comp.plane) {
+                return 0;
+            }
+        }
+    }
+    return color_components;
+}
+
+void set_codec_threads(AVCodecContext *const codec_context,
+                       const std::size_t threads,
+                       const codec_threading_t threading) {
+    CHECK(codec_context != nullptr);
+    CHECK_LE(threads, static_cast<std::size_t>(INT_MAX));
+    codec_context->thread_count = static_cast<int>(threads);
+    switch (threading) {
+    case codec_threading_t::any:
+        codec_context->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+        break;
+    case codec_threading_t::frame:
+        codec_context->thread_type = FF_THREAD_FRAME;
+        break;
+    case codec_threading_t::slice:
+        codec_context->thread_type = FF_THREAD_SLICE;
+        break;
+    }
+}
+
 } // namespace net_zelcon::plain_sight
\ No newline at end of file
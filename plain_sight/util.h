@@ -1,6 +1,7 @@
 #ifndef _INCLUDE_NET_ZELCON_PLAIN_SIGHT_UTIL_H_
 #define _INCLUDE_NET_ZELCON_PLAIN_SIGHT_UTIL_H_
 
+#include <cstddef>
 #include <cstdint>
 #include <filesystem>
 #include <glog/logging.h>
@@ -14,12 +15,36 @@ extern "C" {
 
 namespace net_zelcon::plain_sight {
 
+/// @brief Replaces the contents of `dst` with the file at `path`, read in one
+/// go. To encode a file without loading it, see `mapped_file_t`.
+/// @throws std::runtime_error if the file cannot be read
 void read_file(std::vector<std::uint8_t> &dst, std::filesystem::path path);
 
 void read_file(std::string &dst, const std::filesystem::path &path);
 
 std::string libav_error(int error);
 
+/// @brief Number of planes of `pixel_format` that can each carry a symbol of
+/// their own: its color planes, if there are several and each is a separate
+/// 8-bit plane at full resolution (e.g., YUV444P, GBRP); zero otherwise.
+auto multiplexable_planes(AVPixelFormat pixel_format) -> int;
+
+/// @brief Kinds of threading a libav encoder or decoder may use.
+enum class codec_threading_t {
+    /// @brief Whatever the codec supports, frame threading first.
+    any,
+    /// @brief Several frames at once; each thread adds a frame of latency.
+    frame,
+    /// @brief Several slices of each frame at once.
+    slice,
+};
+
+/// @brief Sets up `codec_context`, before it is opened, to run on `threads`
+/// threads, or on one per core if `threads` is zero. Codecs that support none
+/// of the kinds in `threading` stay single-threaded.
+void set_codec_threads(AVCodecContext *codec_context, std::size_t threads,
+                       codec_threading_t threading);
+
 /// @brief Deleter for libav types. Points to a function pointer from the C API.
 /// @tparam LibavType the libav struct type, e.g., `AVFrame`
 /// @tparam Fn Function pointer type, e.g., `void(*)(AVFrame**)`
@@ -123,6 +123,315 @@ static void perspective_unmap(const quirc_float_t *c,
 		den;
 }
 
+/************************************************************************
+ * Image kernels
+ *
+ * The histogram, the thresholding and the row scans visit every pixel of
+ * the image, so they come in scalar, SSE4.2 and AVX2 versions, picked at
+ * run time for the CPU. All versions give the same results, bit for bit.
+ */
+
+struct quirc_kernels {
+	/* Add the number of pixels of each value to histogram */
+	void (*histogram)(const uint8_t *image, size_t length,
+			  unsigned int *histogram);
+
+	/* Make pixels darker than threshold black, and the others white */
+	void (*threshold)(const uint8_t *source, quirc_pixel_t *dest,
+			  size_t length, uint8_t threshold);
+
+	/* Return the first i in [from, to) for which (row[i] == value) ==
+	 * equal, or to if there is none.
+	 */
+	int (*find)(const quirc_pixel_t *row, int from, int to,
+		    quirc_pixel_t value, int equal);
+
+	/* Return the last i in [to, from] for which (row[i] == value) ==
+	 * equal, or to - 1 if there is none.
+	 */
+	int (*rfind)(const quirc_pixel_t *row, int from, int to,
+		     quirc_pixel_t value, int equal);
+};
+
+static void histogram_scalar(const uint8_t *image, size_t length,
+			     unsigned int *histogram)
+{
+	while (length--)
+		histogram[*image++]++;
+}
+
+static void threshold_scalar(const uint8_t *source, quirc_pixel_t *dest,
+			     size_t length, uint8_t threshold)
+{
+	while (length--) {
+		uint8_t value = *source++;
+		*dest++ = (value < threshold) ? QUIRC_PIXEL_BLACK : QUIRC_PIXEL_WHITE;
+	}
+}
+
+static int find_scalar(const quirc_pixel_t *row, int from, int to,
+		       quirc_pixel_t value, int equal)
+{
+	while (from < to && (row[from] == value) != equal)
+		from++;
+
+	return from;
+}
+
+static int rfind_scalar(const quirc_pixel_t *row, int from, int to,
+			quirc_pixel_t value, int equal)
+{
+	while (from >= to && (row[from] == value) != equal)
+		from--;
+
+	return from;
+}
+
+static const struct quirc_kernels kernels_scalar = {
+	histogram_scalar,
+	threshold_scalar,
+	find_scalar,
+	rfind_scalar
+};
+
+#if QUIRC_PIXEL_ALIAS_IMAGE && QUIRC_PIXEL_BLACK == 1 && \
+    QUIRC_PIXEL_WHITE == 0 && defined(__GNUC__) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define QUIRC_SIMD_X86
+#endif
+
+#ifdef QUIRC_SIMD_X86
+#include <immintrin.h>
+
+/* There is no vector scatter to count pixels with, so both vector
+ * versions count eight pixels at a time into interleaved histograms
+ * instead: runs of equal pixels then no longer wait on incrementing the
+ * same counter.
+ */
+#define HISTOGRAM_LANES	4
+
+static void histogram_interleaved(const uint8_t *image, size_t length,
+				  unsigned int *histogram)
+{
+	unsigned int lanes[HISTOGRAM_LANES][UINT8_MAX + 1];
+	size_t i;
+	int j;
+
+	(void)memset(lanes, 0, sizeof(lanes));
+	for (i = 0; i + 8 <= length; i += 8) {
+		uint64_t pixels;
+
+		(void)memcpy(&pixels, image + i, sizeof(pixels));
+		for (j = 0; j < 8; j++) {
+			lanes[j % HISTOGRAM_LANES][pixels & 0xff]++;
+			pixels >>= 8;
+		}
+	}
+	histogram_scalar(image + i, length - i, histogram);
+
+	for (j = 0; j <= UINT8_MAX; j++)
+		histogram[j] += lanes[0][j] + lanes[1][j] +
+			lanes[2][j] + lanes[3][j];
+}
+
+/* threshold - value saturates to 0 unless value < threshold, and clamping
+ * it to 1 makes it a pixel.
+ */
+__attribute__((target("sse4.2")))
+static void threshold_sse42(const uint8_t *source, quirc_pixel_t *dest,
+			    size_t length, uint8_t threshold)
+{
+	const __m128i t = _mm_set1_epi8((char)threshold);
+	const __m128i black = _mm_set1_epi8(QUIRC_PIXEL_BLACK);
+	size_t i;
+
+	for (i = 0; i + 16 <= length; i += 16) {
+		const __m128i v =
+			_mm_loadu_si128((const __m128i *)(source + i));
+
+		_mm_storeu_si128((__m128i *)(dest + i),
+				 _mm_min_epu8(_mm_subs_epu8(t, v), black));
+	}
+	threshold_scalar(source + i, dest + i, length - i, threshold);
+}
+
+__attribute__((target("avx2")))
+static void threshold_avx2(const uint8_t *source, quirc_pixel_t *dest,
+			   size_t length, uint8_t threshold)
+{
+	const __m256i t = _mm256_set1_epi8((char)threshold);
+	const __m256i black = _mm256_set1_epi8(QUIRC_PIXEL_BLACK);
+	size_t i;
+
+	for (i = 0; i + 32 <= length; i += 32) {
+		const __m256i v =
+			_mm256_loadu_si256((const __m256i *)(source + i));
+
+		_mm256_storeu_si256((__m256i *)(dest + i),
+				    _mm256_min_epu8(_mm256_subs_epu8(t, v),
+						    black));
+	}
+	threshold_scalar(source + i, dest + i, length - i, threshold);
+}
+
+/* The scans compare 16 or 32 pixels at once, and the bits of the
+ * comparison's mask which are set (or clear, if !equal) are the pixels
+ * they look for.
+ */
+__attribute__((target("sse4.2")))
+static int find_sse42(const quirc_pixel_t *row, int from, int to,
+		      quirc_pixel_t value, int equal)
+{
+	const __m128i v = _mm_set1_epi8((char)value);
+	const unsigned int flip = equal ? 0 : 0xffff;
+
+	while (to - from >= 16) {
+		const __m128i pixels =
+			_mm_loadu_si128((const __m128i *)(row + from));
+		const unsigned int mask =
+			(unsigned int)_mm_movemask_epi8(
+				_mm_cmpeq_epi8(pixels, v)) ^ flip;
+
+		if (mask)
+			return from + __builtin_ctz(mask);
+		from += 16;
+	}
+
+	return find_scalar(row, from, to, value, equal);
+}
+
+__attribute__((target("sse4.2")))
+static int rfind_sse42(const quirc_pixel_t *row, int from, int to,
+		       quirc_pixel_t value, int equal)
+{
+	const __m128i v = _mm_set1_epi8((char)value);
+	const unsigned int flip = equal ? 0 : 0xffff;
+
+	while (from - to >= 15) {
+		const __m128i pixels =
+			_mm_loadu_si128((const __m128i *)(row + from - 15));
+		const unsigned int mask =
+			(unsigned int)_mm_movemask_epi8(
+				_mm_cmpeq_epi8(pixels, v)) ^ flip;
+
+		if (mask)
+			return from - 15 + 31 - __builtin_clz(mask);
+		from -= 16;
+	}
+
+	return rfind_scalar(row, from, to, value, equal);
+}
+
+__attribute__((target("avx2")))
+static int find_avx2(const quirc_pixel_t *row, int from, int to,
+		     quirc_pixel_t value, int equal)
+{
+	const __m256i v = _mm256_set1_epi8((char)value);
+	const unsigned int flip = equal ? 0 : 0xffffffff;
+
+	/* Most runs end within 16 pixels, which a 32 pixel load would only
+	 * slow down.
+	 */
+	if (to - from >= 16) {
+		const __m128i pixels =
+			_mm_loadu_si128((const __m128i *)(row + from));
+		const unsigned int mask =
+			(unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(pixels,
+				_mm256_castsi256_si128(v))) ^ (flip & 0xffff);
+
+		if (mask)
+			return from + __builtin_ctz(mask);
+		from += 16;
+	}
+
+	while (to - from >= 32) {
+		const __m256i pixels =
+			_mm256_loadu_si256((const __m256i *)(row + from));
+		const unsigned int mask =
+			(unsigned int)_mm256_movemask_epi8(
+				_mm256_cmpeq_epi8(pixels, v)) ^ flip;
+
+		if (mask)
+			return from + __builtin_ctz(mask);
+		from += 32;
+	}
+
+	return find_sse42(row, from, to, value, equal);
+}
+
+__attribute__((target("avx2")))
+static int rfind_avx2(const quirc_pixel_t *row, int from, int to,
+		      quirc_pixel_t value, int equal)
+{
+	const __m256i v = _mm256_set1_epi8((char)value);
+	const unsigned int flip = equal ? 0 : 0xffffffff;
+
+	while (from - to >= 31) {
+		const __m256i pixels =
+			_mm256_loadu_si256((const __m256i *)(row + from - 31));
+		const unsigned int mask =
+			(unsigned int)_mm256_movemask_epi8(
+				_mm256_cmpeq_epi8(pixels, v)) ^ flip;
+
+		if (mask)
+			return from - 31 + 31 - __builtin_clz(mask);
+		from -= 32;
+	}
+
+	return rfind_sse42(row, from, to, value, equal);
+}
+
+static const struct quirc_kernels kernels_sse42 = {
+	histogram_interleaved,
+	threshold_sse42,
+	find_sse42,
+	rfind_sse42
+};
+
+static const struct quirc_kernels kernels_avx2 = {
+	histogram_interleaved,
+	threshold_avx2,
+	find_avx2,
+	rfind_avx2
+};
+#endif /* QUIRC_SIMD_X86 */
+
+/* Return the best instruction set up to simd that the CPU supports */
+static quirc_simd_t simd_supported(quirc_simd_t simd)
+{
+	quirc_simd_t supported = QUIRC_SIMD_NONE;
+
+#ifdef QUIRC_SIMD_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		supported = QUIRC_SIMD_AVX2;
+	else if (__builtin_cpu_supports("sse4.2"))
+		supported = QUIRC_SIMD_SSE42;
+#endif
+
+	return simd < supported ? simd : supported;
+}
+
+static const struct quirc_kernels *select_kernels(quirc_simd_t simd)
+{
+	switch (simd_supported(simd)) {
+#ifdef QUIRC_SIMD_X86
+	case QUIRC_SIMD_AVX2:
+		return &kernels_avx2;
+	case QUIRC_SIMD_SSE42:
+		return &kernels_sse42;
+#endif
+	default:
+		return &kernels_scalar;
+	}
+}
+
+quirc_simd_t quirc_set_simd(struct quirc *q, quirc_simd_t simd)
+{
+	q->simd = simd;
+	return simd_supported(simd);
+}
+
 /************************************************************************
  * Span-based floodfill routine
  */
@@ -142,14 +451,8 @@ static void flood_fill_line(struct quirc *q, int x, int y,
 	row = q->pixels + y * q->w;
 	QUIRC_ASSERT(row[x] == from);
 
-	left = x;
-	right = x;
-
-	while (left > 0 && row[left - 1] == from)
-		left--;
-
-	while (right < q->w - 1 && row[right + 1] == from)
-		right++;
+	left = q->kernels->rfind(row, x - 1, 0, from, 0) + 1;
+	right = q->kernels->find(row, x + 1, q->w, from, 0) - 1;
 
 	/* Fill the extent */
 	for (i = left; i <= right; i++)
@@ -171,6 +474,8 @@ static struct quirc_flood_fill_vars *flood_fill_call_next(
 			struct quirc_flood_fill_vars *vars,
 			int direction)
 {
+	struct quirc_flood_fill_vars *next_vars;
+	int next_left;
 	int *leftp;
 
 	if (direction < 0) {
@@ -179,31 +484,26 @@ static struct quirc_flood_fill_vars *flood_fill_call_next(
 		leftp = &vars->left_down;
 	}
 
-	while (*leftp <= vars->right) {
-		if (row[*leftp] == from) {
-			struct quirc_flood_fill_vars *next_vars;
-			int next_left;
-
-			/* Set up the next context */
-			next_vars = vars + 1;
-			next_vars->y = vars->y + direction;
-
-			/* Fill the extent */
-			flood_fill_line(q,
-					*leftp,
-					next_vars->y,
-					from, to,
-					func, user_data,
-					&next_left,
-					&next_vars->right);
-			next_vars->left_down = next_left;
-			next_vars->left_up = next_left;
-
-			return next_vars;
-		}
-		(*leftp)++;
-	}
-	return NULL;
+	*leftp = q->kernels->find(row, *leftp, vars->right + 1, from, 1);
+	if (*leftp > vars->right)
+		return NULL;
+
+	/* Set up the next context */
+	next_vars = vars + 1;
+	next_vars->y = vars->y + direction;
+
+	/* Fill the extent */
+	flood_fill_line(q,
+			*leftp,
+			next_vars->y,
+			from, to,
+			func, user_data,
+			&next_left,
+			&next_vars->right);
+	next_vars->left_down = next_left;
+	next_vars->left_up = next_left;
+
+	return next_vars;
 }
 
 static void flood_fill_seed(struct quirc *q,
@@ -295,12 +595,7 @@ static uint8_t otsu(const struct quirc *q)
 	// Calculate histogram
 	unsigned int histogram[UINT8_MAX + 1];
 	(void)memset(histogram, 0, sizeof(histogram));
-	uint8_t* ptr = q->image;
-	unsigned int length = numPixels;
-	while (length--) {
-		uint8_t value = *ptr++;
-		histogram[value]++;
-	}
+	q->kernels->histogram(q->image, numPixels, histogram);
 
 	// Calculate weighted sum of histogram values
 	quirc_float_t sum = 0;
@@ -534,44 +829,46 @@ static void test_capstone(struct quirc *q, unsigned int x, unsigned int y,
 static void finder_scan(struct quirc *q, unsigned int y)
 {
 	quirc_pixel_t *row = q->pixels + y * q->w;
-	unsigned int x;
-	int last_color = 0;
-	unsigned int run_length = 0;
+	unsigned int x = 0;
 	unsigned int run_count = 0;
 	unsigned int pb[5];
 
 	memset(pb, 0, sizeof(pb));
-	for (x = 0; x < q->w; x++) {
+	while (x < q->w) {
+		/* Skip to the end of the run starting at x. Filling regions
+		 * only ever relabels black pixels, so test_capstone() leaves
+		 * the colors of the row as they were.
+		 */
 		int color = row[x] ? 1 : 0;
+		unsigned int end = q->kernels->find(row, x + 1, q->w,
+						    QUIRC_PIXEL_WHITE, color);
 
-		if (x && color != last_color) {
-			memmove(pb, pb + 1, sizeof(pb[0]) * 4);
-			pb[4] = run_length;
-			run_length = 0;
-			run_count++;
-
-			if (!color && run_count >= 5) {
-				const int scale = 16;
-				static const unsigned int check[5] = {1, 1, 3, 1, 1};
-				unsigned int avg, err;
-				unsigned int i;
-				int ok = 1;
-
-				avg = (pb[0] + pb[1] + pb[3] + pb[4]) * scale / 4;
-				err = avg * 3 / 4;
-
-				for (i = 0; i < 5; i++)
-					if (pb[i] * scale < check[i] * avg - err ||
-					    pb[i] * scale > check[i] * avg + err)
-						ok = 0;
-
-				if (ok)
-					test_capstone(q, x, y, pb);
-			}
-		}
+		if (end == q->w)
+			break;
+
+		memmove(pb, pb + 1, sizeof(pb[0]) * 4);
+		pb[4] = end - x;
+		run_count++;
+		x = end;
+
+		if (color && run_count >= 5) {
+			const int scale = 16;
+			static const unsigned int check[5] = {1, 1, 3, 1, 1};
+			unsigned int avg, err;
+			unsigned int i;
+			int ok = 1;
 
-		run_length++;
-		last_color = color;
+			avg = (pb[0] + pb[1] + pb[3] + pb[4]) * scale / 4;
+			err = avg * 3 / 4;
+
+			for (i = 0; i < 5; i++)
+				if (pb[i] * scale < check[i] * avg - err ||
+				    pb[i] * scale > check[i] * avg + err)
+					ok = 0;
+
+			if (ok)
+				test_capstone(q, x, y, pb);
+		}
 	}
 }
 
@@ -1078,13 +1375,8 @@ static void pixels_setup(struct quirc *q, uint8_t threshold)
 		q->pixels = (quirc_pixel_t *)q->image;
 	}
 
-	uint8_t* source = q->image;
-	quirc_pixel_t* dest = q->pixels;
-	int length = q->w * q->h;
-	while (length--) {
-		uint8_t value = *source++;
-		*dest++ = (value < threshold) ? QUIRC_PIXEL_BLACK : QUIRC_PIXEL_WHITE;
-	}
+	q->kernels->threshold(q->image, q->pixels, (size_t)q->w * q->h,
+			      threshold);
 }
 
 uint8_t *quirc_begin(struct quirc *q, int *w, int *h)
@@ -1105,6 +1397,8 @@ void quirc_end(struct quirc *q)
 {
 	int i;
 
+	q->kernels = select_kernels(q->simd);
+
 	uint8_t threshold = otsu(q);
 	pixels_setup(q, threshold);
 
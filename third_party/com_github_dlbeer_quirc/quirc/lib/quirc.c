@@ -31,6 +31,7 @@ struct quirc *quirc_new(void)
 		return NULL;
 
 	memset(q, 0, sizeof(*q));
+	q->simd = QUIRC_SIMD_BEST;
 	return q;
 }
 
@@ -56,6 +56,22 @@ int quirc_resize(struct quirc *q, int w, int h);
 uint8_t *quirc_begin(struct quirc *q, int *w, int *h);
 void quirc_end(struct quirc *q);
 
+/* Instruction sets quirc_end() may use for thresholding and scanning the
+ * image. They all give the same results, bit for bit.
+ */
+typedef enum {
+	QUIRC_SIMD_NONE = 0,
+	QUIRC_SIMD_SSE42,
+	QUIRC_SIMD_AVX2,
+	QUIRC_SIMD_BEST
+} quirc_simd_t;
+
+/* Limit quirc_end() to the given instruction set, QUIRC_SIMD_BEST by
+ * default. This function returns the instruction set quirc_end() will
+ * use, which is a lesser one if the CPU does not support the given one.
+ */
+quirc_simd_t quirc_set_simd(struct quirc *q, quirc_simd_t simd);
+
 /* This structure describes a location in the input image buffer. */
 struct quirc_point {
 	int	x;
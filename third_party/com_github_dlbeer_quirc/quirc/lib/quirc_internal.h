@@ -117,6 +117,10 @@ struct quirc {
 
 	size_t      		num_flood_fill_vars;
 	struct quirc_flood_fill_vars *flood_fill_vars;
+
+	/* Instruction set asked for, and the kernels quirc_end() uses */
+	quirc_simd_t		simd;
+	const struct quirc_kernels *kernels;
 };
 
 /************************************************************************